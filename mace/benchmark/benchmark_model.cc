@@ -14,6 +14,7 @@
 
 #include <sys/time.h>
 
+#include <algorithm>
 #include <cstdlib>
 #include <fstream>
 #include <memory>
@@ -199,7 +200,112 @@ DEFINE_int32(gpu_perf_hint, 3, "0:DEFAULT/1:LOW/2:NORMAL/3:HIGH");
 DEFINE_int32(gpu_priority_hint, 3, "0:DEFAULT/1:LOW/2:NORMAL/3:HIGH");
 DEFINE_int32(omp_num_threads, -1, "num of openmp threads");
 DEFINE_int32(cpu_affinity_policy, 1,
-             "0:AFFINITY_NONE/1:AFFINITY_BIG_ONLY/2:AFFINITY_LITTLE_ONLY");
+             "0:AFFINITY_NONE/1:AFFINITY_BIG_ONLY/2:AFFINITY_LITTLE_ONLY/"
+             "3:AFFINITY_PHYSICAL_CORES_ONLY/4:AFFINITY_SINGLE_LLC/"
+             "5:AFFINITY_SINGLE_NUMA_NODE");
+DEFINE_int32(batch_split_groups, 0,
+             "CPU only, split batched inputs across this many core groups");
+DEFINE_string(batch_sizes, "",
+              "CPU only, compare serial and batch split runs over these "
+              "batch sizes, separated by comma, e.g., 1,2,4,8,16,32");
+DEFINE_int32(pipeline_stages, 0,
+             "CPU only, compare the throughput of serial runs and a pipeline "
+             "of this many stages");
+DEFINE_int32(pipeline_frames, 100, "number of frames of pipeline benchmark");
+
+// Replicate the first sample of each tensor to the given batch size.
+std::map<std::string, mace::MaceTensor> MakeBatch(
+    const std::map<std::string, mace::MaceTensor> &tensors,
+    int64_t batch) {
+  std::map<std::string, mace::MaceTensor> batched;
+  for (auto &tensor : tensors) {
+    std::vector<int64_t> shape = tensor.second.shape();
+    const int64_t sample_size =
+        std::accumulate(shape.begin() + 1, shape.end(), 1,
+                        std::multiplies<int64_t>());
+    shape[0] = batch;
+    auto buffer = std::shared_ptr<float>(new float[batch * sample_size],
+                                         std::default_delete<float[]>());
+    for (int64_t b = 0; b < batch; ++b) {
+      std::copy_n(tensor.second.data().get(), sample_size,
+                  buffer.get() + b * sample_size);
+    }
+    batched[tensor.first] = mace::MaceTensor(shape, buffer);
+  }
+  return batched;
+}
+
+void BenchmarkBatchSplit(MaceEngine *engine,
+                         const std::map<std::string, mace::MaceTensor> &inputs,
+                         const std::map<std::string, mace::MaceTensor> &outputs,
+                         double max_time_sec) {
+  std::vector<int64_t> batch_sizes;
+  str_util::SplitAndParseToInts(FLAGS_batch_sizes, ',', &batch_sizes);
+  const int num_groups = std::max(FLAGS_batch_split_groups, 2);
+  LOG(INFO) << "Batch split benchmark with " << num_groups << " groups";
+  LOG(INFO) << "batch\tserial(ms)\tserial(img/s)\tsplit(ms)\t"
+            << "split(img/s)\tspeedup";
+  for (int64_t batch : batch_sizes) {
+    if (batch <= 0) continue;
+    auto batch_inputs = MakeBatch(inputs, batch);
+    auto batch_outputs = MakeBatch(outputs, batch);
+    double avg_us[2] = {0, 0};
+    for (int split = 0; split < 2; ++split) {
+      MACE_CHECK(engine->SetBatchSplit(split ? num_groups : 0)
+                     == MACE_SUCCESS, "set batch split failed");
+      int64_t total_time_us = 0;
+      int64_t num_runs = 0;
+      Run("Warm Up", engine, batch_inputs, &batch_outputs, 1, -1.0,
+          &total_time_us, &num_runs, nullptr);
+      total_time_us = 0;
+      num_runs = 0;
+      Run(MakeString("Batch ", batch, split ? " split" : " serial"),
+          engine, batch_inputs, &batch_outputs, FLAGS_max_num_runs,
+          max_time_sec, &total_time_us, &num_runs, nullptr);
+      avg_us[split] = static_cast<double>(total_time_us) /
+          std::max<int64_t>(num_runs, 1);
+    }
+    LOG(INFO) << batch << "\t" << avg_us[0] / 1000 << "\t"
+              << batch * 1e6 / avg_us[0] << "\t" << avg_us[1] / 1000 << "\t"
+              << batch * 1e6 / avg_us[1] << "\t" << avg_us[0] / avg_us[1];
+  }
+  engine->SetBatchSplit(FLAGS_batch_split_groups);
+}
+
+void BenchmarkPipeline(MaceEngine *engine,
+                       const std::map<std::string, mace::MaceTensor> &inputs,
+                       std::map<std::string, mace::MaceTensor> *outputs) {
+  const int num_stages = FLAGS_pipeline_stages;
+  const int num_frames = std::max(FLAGS_pipeline_frames, 1);
+  RunMetadata run_metadata;
+  MACE_CHECK(engine->Run(inputs, outputs, &run_metadata) == MACE_SUCCESS);
+
+  int64_t start_us = NowMicros();
+  for (int i = 0; i < num_frames; ++i) {
+    MACE_CHECK(engine->Run(inputs, outputs) == MACE_SUCCESS);
+  }
+  const double serial_fps = num_frames * 1e6 / (NowMicros() - start_us);
+
+  MACE_CHECK(engine->StartPipeline(num_stages, &run_metadata)
+                 == MACE_SUCCESS, "start pipeline failed");
+  start_us = NowMicros();
+  for (int i = 0; i < num_frames + num_stages; ++i) {
+    if (i >= num_stages) {
+      MACE_CHECK(engine->PullOutput(outputs) == MACE_SUCCESS);
+    }
+    if (i < num_frames) {
+      MACE_CHECK(engine->PushInput(inputs) == MACE_SUCCESS);
+    }
+  }
+  const double pipeline_fps = num_frames * 1e6 / (NowMicros() - start_us);
+  engine->StopPipeline();
+
+  LOG(INFO) << "Pipeline benchmark of " << num_frames << " frames, "
+            << num_stages << " stages";
+  LOG(INFO) << "serial(fps)\tpipeline(fps)\tspeedup";
+  LOG(INFO) << serial_fps << "\t" << pipeline_fps << "\t"
+            << pipeline_fps / serial_fps;
+}
 
 int Main(int argc, char **argv) {
   MACE_CHECK(FLAGS_device != "HEXAGON",
@@ -223,6 +329,8 @@ int Main(int argc, char **argv) {
   LOG(INFO) << "Warmup runs: [" << FLAGS_warmup_runs << "]";
   LOG(INFO) << "Num runs: [" << FLAGS_max_num_runs << "]";
   LOG(INFO) << "Max run time: [" << FLAGS_max_time << "]";
+  LOG(INFO) << "Batch split groups: [" << FLAGS_batch_split_groups << "]";
+  LOG(INFO) << "Pipeline stages: [" << FLAGS_pipeline_stages << "]";
 
   const double max_benchmark_time_seconds =
       std::strtod(FLAGS_max_time.c_str(), nullptr);
@@ -256,6 +364,15 @@ int Main(int argc, char **argv) {
   mace::SetOpenMPThreadPolicy(
       FLAGS_omp_num_threads,
       static_cast<CPUAffinityPolicy >(FLAGS_cpu_affinity_policy));
+  std::vector<int> cpu_ids;
+  std::string cpu_topology;
+  if (mace::GetCPUAffinityCoreIDs(
+          static_cast<CPUAffinityPolicy >(FLAGS_cpu_affinity_policy),
+          &cpu_ids, &cpu_topology) == MaceStatus::MACE_SUCCESS) {
+    LOG(INFO) << "CPU topology: " << cpu_topology
+              << ", selected CPU cores: " << MakeString(cpu_ids);
+  }
+  LOG(INFO) << "CPU ISA: " << mace::GetCPUISAName();
 #ifdef MACE_ENABLE_OPENCL
   if (device_type == DeviceType::GPU) {
     mace::SetGPUHints(
@@ -282,6 +399,7 @@ int Main(int argc, char **argv) {
   // Create Engine
   const char *model_data_file_ptr =
     FLAGS_model_data_file.empty() ? nullptr : FLAGS_model_data_file.c_str();
+  const int64_t create_start_us = NowMicros();
   if (FLAGS_model_file != "") {
     std::vector<unsigned char> model_pb_data;
     if (!mace::ReadBinaryFile(&model_pb_data, FLAGS_model_file)) {
@@ -306,6 +424,12 @@ int Main(int argc, char **argv) {
   if (create_engine_status != MaceStatus::MACE_SUCCESS) {
     LOG(FATAL) << "Create engine error, please check the arguments";
   }
+  LOG(INFO) << "Create engine time: "
+            << (NowMicros() - create_start_us) / 1000.0 << " ms";
+  if (FLAGS_batch_split_groups > 1 &&
+      engine->SetBatchSplit(FLAGS_batch_split_groups) != MACE_SUCCESS) {
+    LOG(FATAL) << "Batch split is only supported on CPU";
+  }
 
   std::map<std::string, mace::MaceTensor> inputs;
   std::map<std::string, mace::MaceTensor> outputs;
@@ -374,6 +498,14 @@ int Main(int argc, char **argv) {
 
   statistician->PrintStat();
 
+  if (!FLAGS_batch_sizes.empty() && device_type == DeviceType::CPU) {
+    BenchmarkBatchSplit(engine.get(), inputs, outputs,
+                        max_benchmark_time_seconds);
+  }
+  if (FLAGS_pipeline_stages > 0 && device_type == DeviceType::CPU) {
+    BenchmarkPipeline(engine.get(), inputs, &outputs);
+  }
+
   return 0;
 }
 
@@ -19,10 +19,13 @@
 #include <unistd.h>
 
 #include <memory>
+#include <thread>  // NOLINT(build/c++11)
 
 #include "mace/core/net.h"
+#include "mace/core/runtime/cpu/cpu_runtime.h"
 #include "mace/core/types.h"
 #include "mace/public/mace.h"
+#include "mace/utils/env_time.h"
 
 #ifdef MACE_ENABLE_OPENCL
 #include "mace/core/runtime/opencl/opencl_runtime.h"
@@ -85,6 +88,18 @@ const std::shared_ptr<float> MaceTensor::data() const { return impl_->data; }
 
 std::shared_ptr<float> MaceTensor::data() { return impl_->data; }
 
+namespace {
+
+// Time spent by each phase of initialization, in microseconds.
+struct InitTimes {
+  int64_t load_tensors;
+  int64_t init_net;
+  int64_t create_net;
+  int64_t prepare_net;
+};
+
+}  // namespace
+
 // Mace Engine
 class MaceEngine::Impl {
  public:
@@ -101,11 +116,65 @@ class MaceEngine::Impl {
                  std::map<std::string, MaceTensor> *outputs,
                  RunMetadata *run_metadata);
 
+  MaceStatus SetBatchSplit(int num_groups);
+
+  MaceStatus StartPipeline(int num_stages, const RunMetadata *run_metadata);
+
+  MaceStatus PushInput(const std::map<std::string, MaceTensor> &inputs);
+
+  MaceStatus PullOutput(std::map<std::string, MaceTensor> *outputs);
+
+  MaceStatus StopPipeline();
+
  private:
+  // Creates the input and output tensors, loads the weights and runs the
+  // INIT net in ws.
+  MaceStatus PrepareWorkspace(const NetDef &net_def,
+                              const unsigned char *model_data,
+                              Workspace *ws,
+                              InitTimes *init_times = nullptr);
+
+  // Copies samples [batch_begin, batch_end) of inputs into ws.
+  MaceStatus FeedInputs(Workspace *ws,
+                        index_t batch_begin,
+                        index_t batch_end,
+                        const std::map<std::string, MaceTensor> &inputs);
+
+  // Copies the outputs in ws to samples [batch_begin, batch_end) of outputs.
+  MaceStatus FetchOutputs(Workspace *ws,
+                          index_t batch_begin,
+                          index_t batch_end,
+                          std::map<std::string, MaceTensor> *outputs);
+
+  MaceStatus RunBatchSplit(const std::map<std::string, MaceTensor> &inputs,
+                           std::map<std::string, MaceTensor> *outputs,
+                           RunMetadata *run_metadata);
+
+  MaceStatus RunBatchGroup(Workspace *ws,
+                           NetBase *net,
+                           index_t batch_begin,
+                           index_t batch_end,
+                           const std::map<std::string, MaceTensor> &inputs,
+                           std::map<std::string, MaceTensor> *outputs,
+                           RunMetadata *run_metadata);
+
   std::shared_ptr<OperatorRegistry> op_registry_;
   DeviceType device_type_;
   std::unique_ptr<Workspace> ws_;
   std::unique_ptr<NetBase> net_;
+  std::vector<std::string> input_nodes_;
+  std::vector<std::string> output_nodes_;
+  // Kept on CPU to build the workspaces of batch split groups and pipeline
+  // slots, the weights are shared through model_data_, which CPU never
+  // unmaps.
+  std::shared_ptr<NetDef> net_def_;
+  const unsigned char *model_data_;
+  // Group 0 runs on ws_ and net_, group i on group_ws_[i - 1].
+  std::vector<std::unique_ptr<Workspace>> group_ws_;
+  std::vector<std::unique_ptr<NetBase>> group_nets_;
+  std::vector<std::unique_ptr<Workspace>> pipeline_ws_;
+  std::vector<std::unique_ptr<SerialNet>> pipeline_nets_;
+  std::unique_ptr<NetPipeline> pipeline_;
   std::map<std::string, mace::InputInfo> input_info_map_;
   std::map<std::string, mace::OutputInfo> output_info_map_;
 #ifdef MACE_ENABLE_HEXAGON
@@ -119,7 +188,8 @@ MaceEngine::Impl::Impl(DeviceType device_type)
     : op_registry_(new OperatorRegistry()),
       device_type_(device_type),
       ws_(new Workspace()),
-      net_(nullptr)
+      net_(nullptr),
+      model_data_(nullptr)
 #ifdef MACE_ENABLE_HEXAGON
       , hexagon_controller_(nullptr)
 #endif
@@ -147,8 +217,6 @@ MaceStatus MaceEngine::Impl::Init(
                  << "' is not belong to model's inputs: "
                  << MakeString(MapKeys(input_info_map_));
     }
-    ws_->CreateTensor(MakeString("mace_input_node_", input_name),
-                      GetDeviceAllocator(device_type_), DT_FLOAT);
   }
   for (auto output_name : output_nodes) {
     if (output_info_map_.find(output_name) == output_info_map_.end()) {
@@ -156,9 +224,9 @@ MaceStatus MaceEngine::Impl::Init(
                  << "' is not belong to model's outputs "
                  << MakeString(MapKeys(output_info_map_));
     }
-    ws_->CreateTensor(MakeString("mace_output_node_", output_name),
-                      GetDeviceAllocator(device_type_), DT_FLOAT);
   }
+  input_nodes_ = input_nodes;
+  output_nodes_ = output_nodes;
 #ifdef MACE_ENABLE_HEXAGON
   if (device_type_ == HEXAGON) {
     hexagon_controller_.reset(new HexagonControlWrapper());
@@ -176,20 +244,82 @@ MaceStatus MaceEngine::Impl::Init(
     }
   } else {
 #endif
-    MACE_RETURN_IF_ERROR(ws_->LoadModelTensor(
-        *net_def, device_type_, model_data));
-
-    // Init model
-    auto net = CreateNet(op_registry_, *net_def, ws_.get(), device_type_,
-                         NetMode::INIT);
-    MACE_RETURN_IF_ERROR(net->Run());
+    InitTimes init_times = {0, 0, 0, 0};
+    MACE_RETURN_IF_ERROR(PrepareWorkspace(*net_def, model_data, ws_.get(),
+                                          &init_times));
+    int64_t start_us = NowMicros();
     net_ = CreateNet(op_registry_, *net_def, ws_.get(), device_type_);
+    init_times.create_net = NowMicros() - start_us;
+    start_us = NowMicros();
+    MACE_RETURN_IF_ERROR(net_->Prepare());
+    init_times.prepare_net = NowMicros() - start_us;
+    LOG(INFO) << "Init time(ms): load tensors "
+              << init_times.load_tensors / 1000.0 << ", init net "
+              << init_times.init_net / 1000.0 << ", create net "
+              << init_times.create_net / 1000.0 << ", prepare net "
+              << init_times.prepare_net / 1000.0;
+    if (device_type_ == CPU) {
+      net_def_ = std::make_shared<NetDef>(*net_def);
+      model_data_ = model_data;
+    }
 #ifdef MACE_ENABLE_HEXAGON
   }
 #endif
   return MaceStatus::MACE_SUCCESS;
 }
 
+MaceStatus MaceEngine::Impl::PrepareWorkspace(
+    const NetDef &net_def,
+    const unsigned char *model_data,
+    Workspace *ws,
+    InitTimes *init_times) {
+  int64_t start_us = NowMicros();
+  for (auto &input_name : input_nodes_) {
+    ws->CreateTensor(MakeString("mace_input_node_", input_name),
+                     GetDeviceAllocator(device_type_), DT_FLOAT);
+  }
+  for (auto &output_name : output_nodes_) {
+    ws->CreateTensor(MakeString("mace_output_node_", output_name),
+                     GetDeviceAllocator(device_type_), DT_FLOAT);
+  }
+  MACE_RETURN_IF_ERROR(ws->LoadModelTensor(net_def, device_type_, model_data));
+  const int64_t load_end_us = NowMicros();
+
+  // Init model
+  auto init_net = CreateNet(op_registry_, net_def, ws, device_type_,
+                            NetMode::INIT);
+  MACE_RETURN_IF_ERROR(init_net->Run());
+  if (init_times != nullptr) {
+    init_times->load_tensors = load_end_us - start_us;
+    init_times->init_net = NowMicros() - load_end_us;
+  }
+  return MaceStatus::MACE_SUCCESS;
+}
+
+MaceStatus MaceEngine::Impl::SetBatchSplit(int num_groups) {
+  if (num_groups <= 1) {
+    group_nets_.clear();
+    group_ws_.clear();
+    return MACE_SUCCESS;
+  }
+  if (device_type_ != CPU || net_def_ == nullptr) {
+    LOG(WARNING) << "Batch split is only supported by initialized CPU engine";
+    return MACE_INVALID_ARGS;
+  }
+  group_nets_.resize(std::min<size_t>(group_nets_.size(), num_groups - 1));
+  group_ws_.resize(group_nets_.size());
+  while (static_cast<int>(group_ws_.size()) < num_groups - 1) {
+    std::unique_ptr<Workspace> ws(new Workspace());
+    MACE_RETURN_IF_ERROR(PrepareWorkspace(*net_def_, model_data_, ws.get()));
+    group_nets_.push_back(CreateNet(op_registry_, net_def_, ws.get(),
+                                    device_type_));
+    MACE_RETURN_IF_ERROR(group_nets_.back()->Prepare());
+    group_ws_.push_back(std::move(ws));
+  }
+  VLOG(1) << "Batch split groups: " << num_groups;
+  return MACE_SUCCESS;
+}
+
 MaceEngine::Impl::~Impl() {
   LOG(INFO) << "Destroying MaceEngine";
 #ifdef MACE_ENABLE_HEXAGON
@@ -209,6 +339,11 @@ MaceStatus MaceEngine::Impl::Run(
     std::map<std::string, MaceTensor> *outputs,
     RunMetadata *run_metadata) {
   MACE_CHECK_NOTNULL(outputs);
+  if (!group_nets_.empty() && !inputs.empty() &&
+      inputs.begin()->second.shape().size() > 0 &&
+      inputs.begin()->second.shape()[0] > 1) {
+    return RunBatchSplit(inputs, outputs, run_metadata);
+  }
   std::vector<Tensor *> input_tensors;
   std::vector<Tensor *> output_tensors;
   for (auto &input : inputs) {
@@ -277,6 +412,212 @@ MaceStatus MaceEngine::Impl::Run(
   return MACE_SUCCESS;
 }
 
+MaceStatus MaceEngine::Impl::RunBatchSplit(
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs,
+    RunMetadata *run_metadata) {
+  const index_t batch = inputs.begin()->second.shape()[0];
+  for (auto &input : inputs) {
+    if (input.second.shape().empty() || input.second.shape()[0] != batch) {
+      LOG(ERROR) << "Batch split needs the same batch for all inputs: "
+                 << MakeString<int64_t>(input.second.shape());
+      return MACE_INVALID_ARGS;
+    }
+  }
+  const int num_groups = static_cast<int>(
+      std::min<index_t>(group_nets_.size() + 1, batch));
+
+  // Each group is an OpenMP team pinned to its slice of the current cpus.
+  std::vector<int> cpu_ids;
+  if (GetThreadAffinityCPUs(&cpu_ids) != MACE_SUCCESS) {
+    cpu_ids.clear();
+  }
+  std::vector<std::vector<int>> group_cpu_ids;
+  std::vector<int> group_num_threads;
+  DivideCPUGroups(cpu_ids, GetOpenMPNumThreads(), num_groups,
+                  &group_cpu_ids, &group_num_threads);
+
+  std::vector<MaceStatus> status(num_groups, MACE_SUCCESS);
+  std::vector<std::thread> threads;
+  for (int g = 0; g < num_groups; ++g) {
+    const index_t batch_begin = batch * g / num_groups;
+    const index_t batch_end = batch * (g + 1) / num_groups;
+    Workspace *ws = g == 0 ? ws_.get() : group_ws_[g - 1].get();
+    NetBase *net = g == 0 ? net_.get() : group_nets_[g - 1].get();
+    threads.emplace_back([&, g, ws, net, batch_begin, batch_end]() {
+      if (group_cpu_ids[g].empty()) {
+        SetOpenMPNumThreads(group_num_threads[g]);
+      } else {
+        SetOpenMPThreadsAndAffinityCPUs(group_num_threads[g],
+                                        group_cpu_ids[g]);
+      }
+      status[g] = RunBatchGroup(ws, net, batch_begin, batch_end, inputs,
+                                outputs, g == 0 ? run_metadata : nullptr);
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  for (auto s : status) {
+    MACE_RETURN_IF_ERROR(s);
+  }
+  return MACE_SUCCESS;
+}
+
+MaceStatus MaceEngine::Impl::RunBatchGroup(
+    Workspace *ws,
+    NetBase *net,
+    index_t batch_begin,
+    index_t batch_end,
+    const std::map<std::string, MaceTensor> &inputs,
+    std::map<std::string, MaceTensor> *outputs,
+    RunMetadata *run_metadata) {
+  MACE_RETURN_IF_ERROR(FeedInputs(ws, batch_begin, batch_end, inputs));
+  MACE_RETURN_IF_ERROR(net->Run(run_metadata));
+  return FetchOutputs(ws, batch_begin, batch_end, outputs);
+}
+
+MaceStatus MaceEngine::Impl::FeedInputs(
+    Workspace *ws,
+    index_t batch_begin,
+    index_t batch_end,
+    const std::map<std::string, MaceTensor> &inputs) {
+  const index_t sub_batch = batch_end - batch_begin;
+  for (auto &input : inputs) {
+    if (input_info_map_.find(input.first) == input_info_map_.end()) {
+      LOG(FATAL) << "'" << input.first
+                 << "' is not belong to model's inputs: "
+                 << MakeString(MapKeys(input_info_map_));
+    }
+    Tensor *input_tensor =
+        ws->GetTensor(MakeString("mace_input_node_", input.first));
+    std::vector<index_t> shape(input.second.shape().begin(),
+                               input.second.shape().end());
+    shape[0] = sub_batch;
+    MACE_RETURN_IF_ERROR(input_tensor->Resize(shape));
+    const index_t sample_size = input_tensor->size() / sub_batch;
+    Tensor::MappingGuard input_guard(input_tensor);
+    memcpy(input_tensor->mutable_data<float>(),
+           input.second.data().get() + batch_begin * sample_size,
+           input_tensor->size() * sizeof(float));
+  }
+  return MACE_SUCCESS;
+}
+
+MaceStatus MaceEngine::Impl::FetchOutputs(
+    Workspace *ws,
+    index_t batch_begin,
+    index_t batch_end,
+    std::map<std::string, MaceTensor> *outputs) {
+  const index_t sub_batch = batch_end - batch_begin;
+  for (auto &output : *outputs) {
+    if (output_info_map_.find(output.first) == output_info_map_.end()) {
+      LOG(FATAL) << "'" << output.first
+                 << "' is not belong to model's outputs: "
+                 << MakeString(MapKeys(output_info_map_));
+    }
+    Tensor *output_tensor =
+        ws->GetTensor(MakeString("mace_output_node_", output.first));
+    if (output_tensor == nullptr || output.second.data() == nullptr) {
+      return MACE_INVALID_ARGS;
+    }
+    Tensor::MappingGuard output_guard(output_tensor);
+    std::vector<int64_t> shape(output_tensor->shape().begin(),
+                               output_tensor->shape().end());
+    MACE_CHECK(!shape.empty() && shape[0] == sub_batch)
+        << "Outputs must be batched as inputs, got "
+        << MakeString<int64_t>(shape);
+    shape[0] = output.second.shape().empty() ? 0 : output.second.shape()[0];
+    MACE_CHECK(shape == output.second.shape())
+        << "Output shape mismatch: "
+        << MakeString<int64_t>(output.second.shape())
+        << " != " << MakeString<int64_t>(shape);
+    const index_t sample_size = output_tensor->size() / sub_batch;
+    std::memcpy(output.second.data().get() + batch_begin * sample_size,
+                output_tensor->data<float>(),
+                output_tensor->size() * sizeof(float));
+  }
+  return MACE_SUCCESS;
+}
+
+MaceStatus MaceEngine::Impl::StartPipeline(int num_stages,
+                                           const RunMetadata *run_metadata) {
+  MACE_RETURN_IF_ERROR(StopPipeline());
+  if (device_type_ != CPU || net_def_ == nullptr || num_stages < 1) {
+    LOG(WARNING) << "Pipeline is only supported by initialized CPU engine";
+    return MACE_INVALID_ARGS;
+  }
+  // One slot per frame in flight, i.e., per stage.
+  for (int s = 0; s < num_stages; ++s) {
+    std::unique_ptr<Workspace> ws(new Workspace());
+    MACE_RETURN_IF_ERROR(PrepareWorkspace(*net_def_, model_data_, ws.get()));
+    pipeline_nets_.emplace_back(
+        new SerialNet(op_registry_, net_def_, ws.get(), device_type_));
+    MACE_RETURN_IF_ERROR(pipeline_nets_.back()->Prepare());
+    pipeline_ws_.push_back(std::move(ws));
+  }
+  std::vector<int> stage_begins;
+  PartitionPipelineStages(
+      pipeline_nets_[0]->OperatorCosts(run_metadata, pipeline_ws_[0].get()),
+      num_stages, &stage_begins);
+  num_stages = static_cast<int>(stage_begins.size()) - 1;
+  pipeline_nets_.resize(num_stages);
+  pipeline_ws_.resize(num_stages);
+  VLOG(1) << "Pipeline stages begin at ops: " << MakeString(stage_begins);
+
+  std::vector<int> cpu_ids;
+  if (GetThreadAffinityCPUs(&cpu_ids) != MACE_SUCCESS) {
+    cpu_ids.clear();
+  }
+  std::vector<std::vector<int>> stage_cpu_ids;
+  std::vector<int> stage_num_threads;
+  DivideCPUGroups(cpu_ids, GetOpenMPNumThreads(), num_stages,
+                  &stage_cpu_ids, &stage_num_threads);
+  std::vector<Workspace *> slot_ws;
+  std::vector<SerialNet *> slot_nets;
+  for (int s = 0; s < num_stages; ++s) {
+    slot_ws.push_back(pipeline_ws_[s].get());
+    slot_nets.push_back(pipeline_nets_[s].get());
+  }
+  pipeline_.reset(new NetPipeline(slot_ws, slot_nets, stage_begins,
+                                  stage_cpu_ids, stage_num_threads));
+  return MACE_SUCCESS;
+}
+
+MaceStatus MaceEngine::Impl::PushInput(
+    const std::map<std::string, MaceTensor> &inputs) {
+  if (pipeline_ == nullptr || inputs.empty() ||
+      inputs.begin()->second.shape().empty()) {
+    return MACE_INVALID_ARGS;
+  }
+  const index_t batch = inputs.begin()->second.shape()[0];
+  return pipeline_->Push([&](Workspace *ws) {
+    return FeedInputs(ws, 0, batch, inputs);
+  });
+}
+
+MaceStatus MaceEngine::Impl::PullOutput(
+    std::map<std::string, MaceTensor> *outputs) {
+  MACE_CHECK_NOTNULL(outputs);
+  if (pipeline_ == nullptr) {
+    return MACE_INVALID_ARGS;
+  }
+  if (outputs->empty() || outputs->begin()->second.shape().empty()) {
+    return MACE_INVALID_ARGS;
+  }
+  const index_t batch = outputs->begin()->second.shape()[0];
+  return pipeline_->Pull([&](Workspace *ws) {
+    return FetchOutputs(ws, 0, batch, outputs);
+  });
+}
+
+MaceStatus MaceEngine::Impl::StopPipeline() {
+  pipeline_.reset();
+  pipeline_nets_.clear();
+  pipeline_ws_.clear();
+  return MACE_SUCCESS;
+}
+
 MaceEngine::MaceEngine(DeviceType device_type):
     impl_(new MaceEngine::Impl(device_type)) {}
 
@@ -300,6 +641,28 @@ MaceStatus MaceEngine::Run(const std::map<std::string, MaceTensor> &inputs,
   return impl_->Run(inputs, outputs, nullptr);
 }
 
+MaceStatus MaceEngine::SetBatchSplit(int num_groups) {
+  return impl_->SetBatchSplit(num_groups);
+}
+
+MaceStatus MaceEngine::StartPipeline(int num_stages,
+                                     const RunMetadata *run_metadata) {
+  return impl_->StartPipeline(num_stages, run_metadata);
+}
+
+MaceStatus MaceEngine::PushInput(
+    const std::map<std::string, MaceTensor> &inputs) {
+  return impl_->PushInput(inputs);
+}
+
+MaceStatus MaceEngine::PullOutput(std::map<std::string, MaceTensor> *outputs) {
+  return impl_->PullOutput(outputs);
+}
+
+MaceStatus MaceEngine::StopPipeline() {
+  return impl_->StopPipeline();
+}
+
 const unsigned char *LoadModelData(const std::string &model_data_file,
                                    const size_t &data_size) {
   int fd = open(model_data_file.c_str(), O_RDONLY);
@@ -12,16 +12,118 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include <algorithm>
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <deque>
+#include <limits>
+#include <map>
+#include <mutex>  // NOLINT(build/c++11)
+#include <set>
+#include <thread>  // NOLINT(build/c++11)
 #include <utility>
 
 #include "mace/core/macros.h"
 #include "mace/core/net.h"
+#include "mace/core/runtime/cpu/cpu_runtime.h"
 #include "mace/utils/memory_logging.h"
 #include "mace/utils/timer.h"
 #include "mace/utils/utils.h"
 
 namespace mace {
 
+namespace {
+
+void RecordOperatorStats(OperatorBase *op,
+                         const CallStats &call_stats,
+                         RunMetadata *run_metadata) {
+  std::vector<int> strides;
+  int padding_type = -1;
+  std::vector<int> paddings;
+  std::vector<int> dilations;
+  std::vector<index_t> kernels;
+  std::string type = op->debug_def().type();
+
+  if (type.compare("Conv2D") == 0 ||
+      type.compare("FusedConv2D") == 0 ||
+      type.compare("DepthwiseConv2d") == 0 ||
+      type.compare("Pooling") == 0) {
+    strides = op->GetRepeatedArgs<int>("strides");
+    padding_type = op->GetOptionalArg<int>("padding", -1);
+    paddings = op->GetRepeatedArgs<int>("padding_values");
+    dilations = op->GetRepeatedArgs<int>("dilations");
+    if (type.compare("Pooling") == 0) {
+      kernels = op->GetRepeatedArgs<index_t>("kernels");
+    } else {
+      kernels = op->Input(1)->shape();
+    }
+  }
+
+  std::vector<std::vector<int64_t>> output_shapes;
+  for (auto output_shape : op->debug_def().output_shape()) {
+    output_shapes.push_back({output_shape.dims().begin(),
+                             output_shape.dims().end()});
+  }
+  OperatorStats op_stats = {op->debug_def().name(), op->debug_def().type(),
+                            output_shapes,
+                            {strides, padding_type, paddings, dilations,
+                             kernels}, call_stats};
+  run_metadata->op_stats.emplace_back(op_stats);
+}
+
+// These ops share the buffer of their input instead of writing a new one,
+// see ShouldPreallocateMemoryForOp in workspace.cc.
+bool IsBufferReusingOp(const OperatorDef &op_def) {
+  return op_def.type() == "Reshape" || op_def.type() == "Identity" ||
+      op_def.type() == "Squeeze";
+}
+
+int OperatorDevice(const OperatorDef &op_def, DeviceType type) {
+  // TODO(liuqi): refactor based on PB
+  return ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
+      op_def, "device", static_cast<int>(type));
+}
+
+// MACC-like estimation: output size, times the weights per output channel.
+int64_t EstimateOperatorCost(const OperatorDef &op_def, Workspace *ws) {
+  int64_t cost = 1;
+  for (auto &output_shape : op_def.output_shape()) {
+    int64_t output_size = 1;
+    for (auto dim : output_shape.dims()) {
+      output_size *= std::max<int64_t>(dim, 1);
+    }
+    cost += output_size;
+  }
+  if (op_def.input_size() > 1 && ws->HasTensor(op_def.input(1))) {
+    const Tensor *weight = ws->GetTensor(op_def.input(1));
+    if (weight->dim_size() >= 2 && weight->dim(0) > 0) {
+      cost *= std::max<int64_t>(weight->size() / weight->dim(0), 1);
+    }
+  }
+  return cost;
+}
+
+MaceStatus PrepareOperators(
+    const std::vector<std::unique_ptr<OperatorBase>> &operators) {
+  MACE_LATENCY_LOGGER(1, "Preparing operators");
+  const int op_count = static_cast<int>(operators.size());
+  std::vector<MaceStatus> status(op_count, MACE_SUCCESS);
+#pragma omp parallel for schedule(dynamic)
+  for (int i = 0; i < op_count; ++i) {
+    status[i] = operators[i]->Prepare();
+  }
+  // report the first failed op whatever the schedule
+  for (int i = 0; i < op_count; ++i) {
+    if (status[i] != MACE_SUCCESS) {
+      LOG(ERROR) << "Prepare operator " << operators[i]->debug_def().name()
+                 << " failed";
+      return status[i];
+    }
+  }
+  return MACE_SUCCESS;
+}
+
+}  // namespace
+
 NetBase::NetBase(const std::shared_ptr<const OperatorRegistry> op_registry,
                  const std::shared_ptr<const NetDef> net_def,
                  Workspace *ws,
@@ -40,11 +142,7 @@ SerialNet::SerialNet(const std::shared_ptr<const OperatorRegistry> op_registry,
   MACE_LATENCY_LOGGER(1, "Constructing SerialNet ", net_def->name());
   for (int idx = 0; idx < net_def->op_size(); ++idx) {
     const auto &operator_def = net_def->op(idx);
-    // TODO(liuqi): refactor based on PB
-    const int op_device =
-        ProtoArgHelper::GetOptionalArg<OperatorDef, int>(
-            operator_def, "device", static_cast<int>(device_type_));
-    if (op_device == type) {
+    if (OperatorDevice(operator_def, device_type_) == type) {
       VLOG(3) << "Creating operator " << operator_def.name() << "("
               << operator_def.type() << ")";
       OperatorDef temp_def(operator_def);
@@ -58,9 +156,19 @@ SerialNet::SerialNet(const std::shared_ptr<const OperatorRegistry> op_registry,
 }
 
 MaceStatus SerialNet::Run(RunMetadata *run_metadata) {
+  return RunOps(0, op_size(), run_metadata);
+}
+
+MaceStatus SerialNet::Prepare() {
+  return PrepareOperators(operators_);
+}
+
+MaceStatus SerialNet::RunOps(int op_begin, int op_end,
+                             RunMetadata *run_metadata) {
   MACE_MEMORY_LOGGING_GUARD();
   MACE_LATENCY_LOGGER(1, "Running net");
-  for (auto iter = operators_.begin(); iter != operators_.end(); ++iter) {
+  auto end = operators_.begin() + op_end;
+  for (auto iter = operators_.begin() + op_begin; iter != end; ++iter) {
     auto &op = *iter;
     MACE_LATENCY_LOGGER(2, "Running operator ", op->debug_def().name(), "(",
                         op->debug_def().type(), "), mem_id: ",
@@ -68,7 +176,7 @@ MaceStatus SerialNet::Run(RunMetadata *run_metadata) {
                                        op->debug_def().mem_id().size()));
     bool future_wait = (device_type_ == DeviceType::GPU &&
                         (run_metadata != nullptr ||
-                         std::distance(iter, operators_.end()) == 1));
+                         std::distance(iter, end) == 1));
 
     CallStats call_stats;
     if (future_wait) {
@@ -88,47 +196,379 @@ MaceStatus SerialNet::Run(RunMetadata *run_metadata) {
     }
 
     if (run_metadata != nullptr) {
-      std::vector<int> strides;
-      int padding_type = -1;
-      std::vector<int> paddings;
-      std::vector<int> dilations;
-      std::vector<index_t> kernels;
-      std::string type = op->debug_def().type();
-
-      if (type.compare("Conv2D") == 0 ||
-          type.compare("FusedConv2D") == 0 ||
-          type.compare("DepthwiseConv2d") == 0 ||
-          type.compare("Pooling") == 0) {
-        strides = op->GetRepeatedArgs<int>("strides");
-        padding_type = op->GetOptionalArg<int>("padding", -1);
-        paddings = op->GetRepeatedArgs<int>("padding_values");
-        dilations = op->GetRepeatedArgs<int>("dilations");
-        if (type.compare("Pooling") == 0) {
-          kernels = op->GetRepeatedArgs<index_t>("kernels");
+      RecordOperatorStats(op.get(), call_stats, run_metadata);
+    }
+
+    VLOG(3) << "Operator " << op->debug_def().name()
+            << " has shape: " << MakeString(op->Output(0)->shape());
+  }
+
+  return MACE_SUCCESS;
+}
+
+std::vector<int64_t> SerialNet::OperatorCosts(const RunMetadata *run_metadata,
+                                              Workspace *ws) const {
+  std::map<std::string, int64_t> measured_costs;
+  if (run_metadata != nullptr) {
+    for (auto &op_stats : run_metadata->op_stats) {
+      measured_costs[op_stats.operator_name] =
+          std::max<int64_t>(
+              op_stats.stats.end_micros - op_stats.stats.start_micros, 1);
+    }
+  }
+  std::vector<int64_t> costs;
+  for (auto &op : operators_) {
+    auto cost_iter = measured_costs.find(op->debug_def().name());
+    costs.push_back(cost_iter != measured_costs.end()
+                    ? cost_iter->second
+                    : EstimateOperatorCost(op->debug_def(), ws));
+  }
+  return costs;
+}
+
+void BuildOpDependencies(const std::vector<const OperatorDef *> &op_defs,
+                         OpDependencies *dependencies) {
+  const int op_count = static_cast<int>(op_defs.size());
+  // Tensors are identified by the memory they live in, so that reusing a
+  // memory block orders its writer after the readers of the previous tensor.
+  std::map<std::string, std::string> memory_keys;
+  std::map<std::string, int> last_writers;
+  std::map<std::string, std::vector<int>> readers;
+  std::vector<std::set<int>> producers(op_count);
+  for (int i = 0; i < op_count; ++i) {
+    const OperatorDef &op_def = *op_defs[i];
+    std::vector<std::string> input_keys;
+    for (const std::string &input : op_def.input()) {
+      auto key_iter = memory_keys.find(input);
+      const std::string key =
+          key_iter == memory_keys.end() ? input : key_iter->second;
+      auto writer_iter = last_writers.find(key);
+      if (writer_iter != last_writers.end()) {
+        producers[i].insert(writer_iter->second);
+      }
+      readers[key].push_back(i);
+      input_keys.push_back(key);
+    }
+    for (int o = 0; o < op_def.output_size(); ++o) {
+      const std::string &output = op_def.output(o);
+      if (IsBufferReusingOp(op_def) && !input_keys.empty()) {
+        memory_keys[output] = input_keys[0];
+        continue;
+      }
+      const std::string key = o < op_def.mem_id_size()
+                              ? MakeString("mem_id:", op_def.mem_id(o))
+                              : output;
+      memory_keys[output] = key;
+      auto writer_iter = last_writers.find(key);
+      if (writer_iter != last_writers.end()) {
+        producers[i].insert(writer_iter->second);
+      }
+      for (int reader : readers[key]) {
+        if (reader != i) producers[i].insert(reader);
+      }
+      readers[key].clear();
+      last_writers[key] = i;
+    }
+  }
+
+  dependencies->consumers.assign(op_count, std::vector<int>());
+  dependencies->num_producers.assign(op_count, 0);
+  for (int i = 0; i < op_count; ++i) {
+    dependencies->num_producers[i] = static_cast<int>(producers[i].size());
+    for (int producer : producers[i]) {
+      dependencies->consumers[producer].push_back(i);
+    }
+  }
+
+  // Producers always precede consumers, so descendants can be collected in
+  // reverse order. Ops that do not reach each other may run concurrently.
+  std::vector<std::vector<bool>> reachable(op_count,
+                                           std::vector<bool>(op_count));
+  for (int i = op_count - 1; i >= 0; --i) {
+    for (int consumer : dependencies->consumers[i]) {
+      reachable[i][consumer] = true;
+      for (int j = consumer + 1; j < op_count; ++j) {
+        if (reachable[consumer][j]) reachable[i][j] = true;
+      }
+    }
+  }
+  dependencies->lanes.assign(op_count, 0);
+  dependencies->num_lanes = op_count > 0 ? 1 : 0;
+  for (int j = 0; j < op_count; ++j) {
+    std::set<int> used_lanes;
+    for (int i = 0; i < j; ++i) {
+      if (!reachable[i][j]) used_lanes.insert(dependencies->lanes[i]);
+    }
+    int lane = 0;
+    while (used_lanes.count(lane) > 0) ++lane;
+    dependencies->lanes[j] = lane;
+    dependencies->num_lanes = std::max(dependencies->num_lanes, lane + 1);
+  }
+}
+
+ParallelNet::ParallelNet(
+    const std::shared_ptr<const OperatorRegistry> op_registry,
+    const std::shared_ptr<const NetDef> net_def,
+    const std::vector<const OperatorDef *> &op_defs,
+    OpDependencies *dependencies,
+    Workspace *ws)
+    : NetBase(op_registry, net_def, ws, DeviceType::CPU) {
+  MACE_LATENCY_LOGGER(1, "Constructing ParallelNet ", net_def->name());
+  dependencies_ = std::move(*dependencies);
+  for (size_t idx = 0; idx < op_defs.size(); ++idx) {
+    VLOG(3) << "Creating operator " << op_defs[idx]->name() << "("
+            << op_defs[idx]->type() << "), lane: "
+            << dependencies_.lanes[idx];
+    OperatorDef temp_def(*op_defs[idx]);
+    ws->SetScratchBufferLane(dependencies_.lanes[idx]);
+    operators_.emplace_back(op_registry->CreateOperator(
+        temp_def, ws, DeviceType::CPU, NetMode::NORMAL));
+    costs_.push_back(EstimateOperatorCost(*op_defs[idx], ws));
+  }
+  ws->SetScratchBufferLane(0);
+}
+
+MaceStatus ParallelNet::Prepare() {
+  return PrepareOperators(operators_);
+}
+
+MaceStatus ParallelNet::Run(RunMetadata *run_metadata) {
+  MACE_MEMORY_LOGGING_GUARD();
+  MACE_LATENCY_LOGGER(1, "Running net");
+  const int num_threads = GetOpenMPNumThreads();
+  const int op_count = static_cast<int>(operators_.size());
+  CPUThreadBudget budget(num_threads);
+
+  std::mutex mutex;
+  std::condition_variable cond;
+  std::vector<int> num_producers(dependencies_.num_producers);
+  std::vector<int64_t> run_costs(costs_);
+  std::deque<int> ready_ops;
+  int64_t ready_cost = 0;
+  int finished_count = 0;
+  MaceStatus status = MACE_SUCCESS;
+  for (int i = 0; i < op_count; ++i) {
+    if (num_producers[i] == 0) {
+      ready_ops.push_back(i);
+      ready_cost += costs_[i];
+    }
+  }
+
+  auto worker = [&]() {
+    while (true) {
+      int idx;
+      int64_t pending_cost;
+      {
+        std::unique_lock<std::mutex> lock(mutex);
+        cond.wait(lock, [&] {
+          return !ready_ops.empty() || finished_count == op_count ||
+              status != MACE_SUCCESS;
+        });
+        if (ready_ops.empty() || status != MACE_SUCCESS) return;
+        idx = ready_ops.front();
+        ready_ops.pop_front();
+        ready_cost -= costs_[idx];
+        pending_cost = ready_cost;
+      }
+
+      OperatorBase *op = operators_[idx].get();
+      const int op_threads = budget.Acquire(costs_[idx], pending_cost);
+      SetOpenMPNumThreads(op_threads);
+      CallStats call_stats;
+      MaceStatus op_status = MACE_SUCCESS;
+      call_stats.start_micros = NowMicros();
+      if (op != nullptr) {
+        MACE_LATENCY_LOGGER(2, "Running operator ", op->debug_def().name(),
+                            "(", op->debug_def().type(), "), threads: ",
+                            op_threads);
+        op_status = op->Run(nullptr);
+      }
+      call_stats.end_micros = NowMicros();
+      budget.Release(op_threads);
+
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (op_status != MACE_SUCCESS) {
+          status = op_status;
         } else {
-          kernels = op->Input(1)->shape();
+          run_costs[idx] = std::max<int64_t>(
+              call_stats.end_micros - call_stats.start_micros, 1);
+          if (op != nullptr && run_metadata != nullptr) {
+            RecordOperatorStats(op, call_stats, run_metadata);
+          }
+          for (int consumer : dependencies_.consumers[idx]) {
+            if (--num_producers[consumer] == 0) {
+              ready_ops.push_back(consumer);
+              ready_cost += costs_[consumer];
+            }
+          }
+          ++finished_count;
         }
       }
+      cond.notify_all();
+    }
+  };
 
-      std::vector<std::vector<int64_t>> output_shapes;
-      for (auto output_shape : op->debug_def().output_shape()) {
-        output_shapes.push_back({output_shape.dims().begin(),
-                                 output_shape.dims().end()});
+  // Every running op holds at least one thread of the budget.
+  const int num_workers = std::min(dependencies_.num_lanes, num_threads);
+  std::vector<std::thread> workers;
+  for (int i = 1; i < num_workers; ++i) {
+    workers.emplace_back(worker);
+  }
+  worker();
+  for (auto &thread : workers) {
+    thread.join();
+  }
+  SetOpenMPNumThreads(num_threads);
+
+  MACE_RETURN_IF_ERROR(status);
+  costs_ = run_costs;
+  return MACE_SUCCESS;
+}
+
+void PartitionPipelineStages(const std::vector<int64_t> &op_costs,
+                             int num_stages,
+                             std::vector<int> *stage_begins) {
+  const int op_count = static_cast<int>(op_costs.size());
+  num_stages = std::max(std::min(num_stages, op_count), 1);
+  std::vector<int64_t> prefix_costs(op_count + 1, 0);
+  for (int i = 0; i < op_count; ++i) {
+    prefix_costs[i + 1] = prefix_costs[i] + op_costs[i];
+  }
+  // max_costs[k][i]: the best max stage cost of the first i ops in k stages
+  const int64_t kInfinity = std::numeric_limits<int64_t>::max();
+  std::vector<std::vector<int64_t>> max_costs(
+      num_stages + 1, std::vector<int64_t>(op_count + 1, kInfinity));
+  std::vector<std::vector<int>> splits(
+      num_stages + 1, std::vector<int>(op_count + 1, 0));
+  max_costs[0][0] = 0;
+  for (int k = 1; k <= num_stages; ++k) {
+    for (int i = k; i <= op_count; ++i) {
+      for (int j = k - 1; j < i; ++j) {
+        if (max_costs[k - 1][j] == kInfinity) continue;
+        const int64_t cost = std::max(max_costs[k - 1][j],
+                                      prefix_costs[i] - prefix_costs[j]);
+        if (cost < max_costs[k][i]) {
+          max_costs[k][i] = cost;
+          splits[k][i] = j;
+        }
       }
-      OperatorStats op_stats = {op->debug_def().name(), op->debug_def().type(),
-                                output_shapes,
-                                {strides, padding_type, paddings, dilations,
-                                 kernels}, call_stats};
-      run_metadata->op_stats.emplace_back(op_stats);
     }
+  }
+  stage_begins->assign(num_stages + 1, op_count);
+  for (int k = num_stages, i = op_count; k > 0; --k) {
+    i = splits[k][i];
+    (*stage_begins)[k - 1] = i;
+  }
+}
 
-    VLOG(3) << "Operator " << op->debug_def().name()
-            << " has shape: " << MakeString(op->Output(0)->shape());
+NetPipeline::NetPipeline(const std::vector<Workspace *> &slot_ws,
+                         const std::vector<SerialNet *> &slot_nets,
+                         const std::vector<int> &stage_begins,
+                         const std::vector<std::vector<int>> &stage_cpu_ids,
+                         const std::vector<int> &stage_num_threads)
+    : slot_ws_(slot_ws),
+      slot_nets_(slot_nets),
+      stage_begins_(stage_begins),
+      pushed_count_(0),
+      pulled_count_(0),
+      stopped_(false) {
+  const int num_stages = static_cast<int>(stage_begins.size()) - 1;
+  MACE_CHECK(num_stages > 0 && slot_ws.size() == slot_nets.size() &&
+             static_cast<int>(slot_nets.size()) == num_stages,
+             "pipeline needs one slot per stage");
+  slot_stages_.assign(num_stages, num_stages);
+  slot_status_.assign(num_stages, MACE_SUCCESS);
+  for (int s = 0; s < num_stages; ++s) {
+    stage_threads_.emplace_back(&NetPipeline::RunStage, this, s,
+                                stage_cpu_ids[s], stage_num_threads[s]);
   }
+}
 
+NetPipeline::~NetPipeline() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    stopped_ = true;
+  }
+  cond_.notify_all();
+  for (auto &thread : stage_threads_) {
+    thread.join();
+  }
+}
+
+MaceStatus NetPipeline::Push(
+    const std::function<MaceStatus(Workspace *)> &feed) {
+  const int num_slots = static_cast<int>(slot_nets_.size());
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [&] { return pushed_count_ - pulled_count_ < num_slots; });
+  const int slot = static_cast<int>(pushed_count_ % num_slots);
+  // the slot is free, nobody else touches its workspace
+  lock.unlock();
+  MACE_RETURN_IF_ERROR(feed(slot_ws_[slot]));
+  lock.lock();
+  slot_stages_[slot] = 0;
+  slot_status_[slot] = MACE_SUCCESS;
+  ++pushed_count_;
+  lock.unlock();
+  cond_.notify_all();
   return MACE_SUCCESS;
 }
 
+MaceStatus NetPipeline::Pull(
+    const std::function<MaceStatus(Workspace *)> &fetch) {
+  const int num_slots = static_cast<int>(slot_nets_.size());
+  std::unique_lock<std::mutex> lock(mutex_);
+  if (pulled_count_ == pushed_count_) {
+    LOG(ERROR) << "No frame to pull";
+    return MACE_INVALID_ARGS;
+  }
+  const int slot = static_cast<int>(pulled_count_ % num_slots);
+  cond_.wait(lock, [&] { return slot_stages_[slot] == num_stages(); });
+  MaceStatus status = slot_status_[slot];
+  lock.unlock();
+  if (status == MACE_SUCCESS) {
+    status = fetch(slot_ws_[slot]);
+  }
+  lock.lock();
+  ++pulled_count_;
+  lock.unlock();
+  cond_.notify_all();
+  return status;
+}
+
+void NetPipeline::RunStage(int stage,
+                           const std::vector<int> &cpu_ids,
+                           int num_threads) {
+  if (cpu_ids.empty()) {
+    SetOpenMPNumThreads(num_threads);
+  } else {
+    SetOpenMPThreadsAndAffinityCPUs(num_threads, cpu_ids);
+  }
+  const int num_slots = static_cast<int>(slot_nets_.size());
+  for (int64_t frame = 0; ; ++frame) {
+    const int slot = static_cast<int>(frame % num_slots);
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cond_.wait(lock, [&] {
+        return stopped_ ||
+            (frame < pushed_count_ && slot_stages_[slot] == stage);
+      });
+      if (stopped_) return;
+    }
+    MaceStatus status = MACE_SUCCESS;
+    if (slot_status_[slot] == MACE_SUCCESS) {
+      status = slot_nets_[slot]->RunOps(stage_begins_[stage],
+                                        stage_begins_[stage + 1]);
+    }
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      if (status != MACE_SUCCESS) slot_status_[slot] = status;
+      slot_stages_[slot] = stage + 1;
+    }
+    cond_.notify_all();
+  }
+}
+
 std::unique_ptr<NetBase> CreateNet(
     const std::shared_ptr<const OperatorRegistry> op_registry,
     const NetDef &net_def,
@@ -145,8 +585,26 @@ std::unique_ptr<NetBase> CreateNet(
     Workspace *ws,
     DeviceType type,
     const NetMode mode) {
-  std::unique_ptr<NetBase> net(
-      new SerialNet(op_registry, net_def, ws, type, mode));
+  std::unique_ptr<NetBase> net;
+  if (type == DeviceType::CPU && mode == NetMode::NORMAL) {
+    std::vector<const OperatorDef *> op_defs;
+    for (auto &op_def : net_def->op()) {
+      if (OperatorDevice(op_def, type) == type) {
+        op_defs.push_back(&op_def);
+      }
+    }
+    OpDependencies dependencies;
+    BuildOpDependencies(op_defs, &dependencies);
+    // Linear nets have nothing to run concurrently.
+    if (dependencies.num_lanes > 1) {
+      VLOG(1) << "Net " << net_def->name() << " has up to "
+              << dependencies.num_lanes << " concurrent ops";
+      net.reset(new ParallelNet(op_registry, net_def, op_defs,
+                                &dependencies, ws));
+      return net;
+    }
+  }
+  net.reset(new SerialNet(op_registry, net_def, ws, type, mode));
   return net;
 }
 
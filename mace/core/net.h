@@ -15,8 +15,12 @@
 #ifndef MACE_CORE_NET_H_
 #define MACE_CORE_NET_H_
 
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <functional>
 #include <memory>
+#include <mutex>  // NOLINT(build/c++11)
 #include <string>
+#include <thread>  // NOLINT(build/c++11)
 #include <vector>
 
 #include "mace/core/operator.h"
@@ -38,6 +42,10 @@ class NetBase {
 
   virtual MaceStatus Run(RunMetadata *run_metadata = nullptr) = 0;
 
+  // Prepares all ops ahead of the first run, concurrently on the OpenMP
+  // threads. The result does not depend on the thread number.
+  virtual MaceStatus Prepare() = 0;
+
   const std::string &Name() const { return name_; }
 
  protected:
@@ -57,6 +65,19 @@ class SerialNet : public NetBase {
 
   MaceStatus Run(RunMetadata *run_metadata = nullptr) override;
 
+  MaceStatus Prepare() override;
+
+  // Runs the ops in [op_begin, op_end) only.
+  MaceStatus RunOps(int op_begin, int op_end,
+                    RunMetadata *run_metadata = nullptr);
+
+  int op_size() const { return static_cast<int>(operators_.size()); }
+
+  // Run time of each op in run_metadata, matched by name, or the estimation
+  // for the ops not in it.
+  std::vector<int64_t> OperatorCosts(const RunMetadata *run_metadata,
+                                     Workspace *ws) const;
+
  protected:
   std::vector<std::unique_ptr<OperatorBase> > operators_;
   DeviceType device_type_;
@@ -64,6 +85,94 @@ class SerialNet : public NetBase {
   MACE_DISABLE_COPY_AND_ASSIGN(SerialNet);
 };
 
+// Dependencies between the ops of a net in their serial order, including
+// the ones introduced by reusing preallocated memory blocks.
+struct OpDependencies {
+  std::vector<std::vector<int>> consumers;
+  std::vector<int> num_producers;
+  // Ops that may run at the same time never share a lane.
+  std::vector<int> lanes;
+  // Upper bound of the number of ops that may run at the same time.
+  int num_lanes;
+};
+
+void BuildOpDependencies(const std::vector<const OperatorDef *> &op_defs,
+                         OpDependencies *dependencies);
+
+// Runs the independent branches of a CPU net concurrently. The OpenMP
+// threads are shared by the running ops in proportion to their cost, and the
+// threads of a finished op are granted to the next ones.
+class ParallelNet : public NetBase {
+ public:
+  ParallelNet(const std::shared_ptr<const OperatorRegistry> op_registry,
+              const std::shared_ptr<const NetDef> net_def,
+              const std::vector<const OperatorDef *> &op_defs,
+              OpDependencies *dependencies,
+              Workspace *ws);
+
+  MaceStatus Run(RunMetadata *run_metadata = nullptr) override;
+
+  MaceStatus Prepare() override;
+
+ private:
+  std::vector<std::unique_ptr<OperatorBase> > operators_;
+  OpDependencies dependencies_;
+  // Estimated by output size and weights at first, measured run time later.
+  std::vector<int64_t> costs_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(ParallelNet);
+};
+
+// Divide ops into num_stages contiguous non-empty stages minimizing the cost
+// of the most expensive one. stage_begins gets the first op of each stage,
+// followed by the op count. Fewer stages are made if there are fewer ops.
+void PartitionPipelineStages(const std::vector<int64_t> &op_costs,
+                             int num_stages,
+                             std::vector<int> *stage_begins);
+
+// Runs a stream of frames through the stages of a CPU net, frame N + 1
+// entering a stage as soon as frame N leaves it. Each frame in flight owns
+// one slot, i.e., a copy of the net with its own workspace, so the tensors
+// of the frames in adjacent stages never alias. Each stage runs on its own
+// thread with its own OpenMP team.
+class NetPipeline {
+ public:
+  // There must be one slot per stage, slots share the weights.
+  NetPipeline(const std::vector<Workspace *> &slot_ws,
+              const std::vector<SerialNet *> &slot_nets,
+              const std::vector<int> &stage_begins,
+              const std::vector<std::vector<int>> &stage_cpu_ids,
+              const std::vector<int> &stage_num_threads);
+  ~NetPipeline();
+
+  // Blocks until a slot is free, then feed fills the workspace of the frame
+  // on the calling thread.
+  MaceStatus Push(const std::function<MaceStatus(Workspace *)> &feed);
+  // Blocks until the oldest frame is done, then fetch reads its workspace on
+  // the calling thread.
+  MaceStatus Pull(const std::function<MaceStatus(Workspace *)> &fetch);
+
+  int num_stages() const { return static_cast<int>(stage_threads_.size()); }
+
+ private:
+  void RunStage(int stage, const std::vector<int> &cpu_ids, int num_threads);
+
+  std::vector<Workspace *> slot_ws_;
+  std::vector<SerialNet *> slot_nets_;
+  std::vector<int> stage_begins_;
+  // The next stage to run of the frame in each slot.
+  std::vector<int> slot_stages_;
+  std::vector<MaceStatus> slot_status_;
+  int64_t pushed_count_;
+  int64_t pulled_count_;
+  bool stopped_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::vector<std::thread> stage_threads_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(NetPipeline);
+};
+
 std::unique_ptr<NetBase> CreateNet(
     const std::shared_ptr<const OperatorRegistry> op_registry,
     const NetDef &net_def,
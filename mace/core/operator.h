@@ -65,6 +65,10 @@ class OperatorBase {
   // Run Op asynchronously (depends on device), return a future if not nullptr.
   virtual MaceStatus Run(StatsFuture *future) = 0;
 
+  // Prepare the constant data, e.g., transform the weights, ahead of the
+  // first run. Only touches the op itself, so ops are prepared concurrently.
+  virtual MaceStatus Prepare() { return MACE_SUCCESS; }
+
   inline const OperatorDef &debug_def() const {
     MACE_CHECK(has_debug_def(), "operator_def was null!");
     return *operator_def_;
@@ -18,12 +18,22 @@
 #include <omp.h>
 #endif
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include <dirent.h>
 #include <errno.h>
 #include <unistd.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <stdlib.h>
 #include <string.h>
 #include <algorithm>
+#include <limits>
+#include <map>
+#include <set>
+#include <string>
 #include <utility>
 #include <vector>
 
@@ -36,8 +46,10 @@ namespace mace {
 
 namespace {
 
-#ifndef MACE_ENABLE_OPENMP
 int GetCPUCount() {
+#ifdef MACE_ENABLE_OPENMP
+  return omp_get_num_procs();
+#else
   char path[32];
   int cpu_count = 0;
   int result = 0;
@@ -53,8 +65,8 @@ int GetCPUCount() {
     }
     cpu_count++;
   }
-}
 #endif
+}
 
 int GetCPUMaxFreq(int cpu_id) {
   char path[64];
@@ -77,6 +89,237 @@ int GetCPUMaxFreq(int cpu_id) {
   return freq;
 }
 
+bool ReadIntFromFile(const std::string &path, int *value) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp) {
+    return false;
+  }
+  int items_read = fscanf(fp, "%d", value);
+  fclose(fp);
+  return items_read == 1;
+}
+
+bool ReadStringFromFile(const std::string &path, std::string *value) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp) {
+    return false;
+  }
+  char buf[64];
+  int items_read = fscanf(fp, "%63s", buf);
+  fclose(fp);
+  if (items_read != 1) {
+    return false;
+  }
+  *value = buf;
+  return true;
+}
+
+bool ReadCPUListFromFile(const std::string &path, std::vector<int> *cpu_ids) {
+  FILE *fp = fopen(path.c_str(), "rb");
+  if (!fp) {
+    return false;
+  }
+  char buf[1024];
+  bool valid = fgets(buf, sizeof(buf), fp) != nullptr &&
+               ParseCPUList(buf, cpu_ids);
+  fclose(fp);
+  return valid;
+}
+
+constexpr int kUnknownNumaNode = -1;
+
+struct CPUCoreTopology {
+  int cpu_id;
+  int package_id;
+  int core_id;
+  // The smallest cpu id sharing the last level cache with this cpu.
+  int llc_id;
+  // kUnknownNumaNode if the cpu is not listed by any exposed node
+  int numa_node;
+};
+
+int GetCPULastLevelCacheID(const std::string &cpu_dir, int fallback_id) {
+  int llc_level = 0;
+  int llc_id = fallback_id;
+  for (int index = 0; ; ++index) {
+    const std::string cache_dir = MakeString(cpu_dir, "/cache/index", index);
+    int level = 0;
+    if (!ReadIntFromFile(cache_dir + "/level", &level)) {
+      break;
+    }
+    std::string type;
+    if (!ReadStringFromFile(cache_dir + "/type", &type) ||
+        type == "Instruction" || level <= llc_level) {
+      continue;
+    }
+    std::vector<int> shared_cpu_ids;
+    if (ReadCPUListFromFile(cache_dir + "/shared_cpu_list",
+                            &shared_cpu_ids)) {
+      llc_level = level;
+      llc_id = *std::min_element(shared_cpu_ids.begin(),
+                                 shared_cpu_ids.end());
+    }
+  }
+  return llc_id;
+}
+
+std::map<int, int> GetCPUNumaNodes(const std::string &sysfs_root) {
+  std::map<int, int> cpu_numa_nodes;
+  const std::string node_root = sysfs_root + "/node";
+  DIR *dir = opendir(node_root.c_str());
+  if (!dir) {
+    return cpu_numa_nodes;
+  }
+  struct dirent *entry = nullptr;
+  while ((entry = readdir(dir)) != nullptr) {
+    int node = 0;
+    if (sscanf(entry->d_name, "node%d", &node) != 1) {
+      continue;
+    }
+    std::vector<int> cpu_ids;
+    if (ReadCPUListFromFile(MakeString(node_root, "/node", node, "/cpulist"),
+                            &cpu_ids)) {
+      for (int cpu_id : cpu_ids) {
+        cpu_numa_nodes[cpu_id] = node;
+      }
+    }
+  }
+  closedir(dir);
+  return cpu_numa_nodes;
+}
+
+// Get the online cpu ids. Fall back to every present cpu directory when the
+// online list is not exposed, offline ones are skipped by GetCPUTopology.
+std::vector<int> GetOnlineCPUIDs(const std::string &sysfs_root) {
+  std::vector<int> cpu_ids;
+  if (ReadCPUListFromFile(sysfs_root + "/cpu/online", &cpu_ids)) {
+    return cpu_ids;
+  }
+  for (int i = 0; ; ++i) {
+    if (access(MakeString(sysfs_root, "/cpu/cpu", i).c_str(), F_OK) != 0) {
+      break;
+    }
+    cpu_ids.push_back(i);
+  }
+  return cpu_ids;
+}
+
+MaceStatus GetCPUTopology(const std::string &sysfs_root,
+                          std::vector<CPUCoreTopology> *topology) {
+  const std::map<int, int> cpu_numa_nodes = GetCPUNumaNodes(sysfs_root);
+  for (int cpu_id : GetOnlineCPUIDs(sysfs_root)) {
+    const std::string cpu_dir = MakeString(sysfs_root, "/cpu/cpu", cpu_id);
+    CPUCoreTopology core;
+    core.cpu_id = cpu_id;
+    if (!ReadIntFromFile(cpu_dir + "/topology/core_id", &core.core_id)) {
+      VLOG(1) << "Skip CPU" << cpu_id << " without topology info, "
+              << "maybe it is offline.";
+      continue;
+    }
+    if (!ReadIntFromFile(cpu_dir + "/topology/physical_package_id",
+                         &core.package_id) || core.package_id < 0) {
+      core.package_id = 0;
+    }
+    // Assume a package shares one last level cache if cache info is absent
+    core.llc_id = GetCPULastLevelCacheID(cpu_dir, -1 - core.package_id);
+    if (cpu_numa_nodes.empty()) {
+      // Assume a package is a node if NUMA info is absent
+      core.numa_node = core.package_id;
+    } else {
+      auto node_iter = cpu_numa_nodes.find(cpu_id);
+      core.numa_node = node_iter == cpu_numa_nodes.end() ?
+                       kUnknownNumaNode : node_iter->second;
+    }
+    topology->push_back(core);
+  }
+  if (topology->empty()) {
+    LOG(WARNING) << "Cannot get CPU topology info from " << sysfs_root;
+    return MACE_INVALID_ARGS;
+  }
+  return MACE_SUCCESS;
+}
+
+// Select the first logical cpu of each physical core, and if group_key is
+// given, only the physical cores of the group with the most cores. Cores
+// whose group key equals skip_key are never selected.
+std::vector<int> SelectPhysicalCores(
+    const std::vector<CPUCoreTopology> &topology,
+    int (*group_key)(const CPUCoreTopology &),
+    int skip_key) {
+  std::set<std::pair<int, int>> visited_cores;
+  std::vector<const CPUCoreTopology *> physical_cores;
+  for (auto &core : topology) {
+    if (visited_cores.insert({core.package_id, core.core_id}).second) {
+      physical_cores.push_back(&core);
+    }
+  }
+
+  std::vector<int> cpu_ids;
+  if (group_key == nullptr) {
+    for (auto core : physical_cores) {
+      cpu_ids.push_back(core->cpu_id);
+    }
+    return cpu_ids;
+  }
+
+  // keep groups in order of first appearance to prefer the lower cpu ids
+  std::vector<int> group_order;
+  std::map<int, std::vector<int>> groups;
+  for (auto core : physical_cores) {
+    int key = group_key(*core);
+    if (key == skip_key) {
+      continue;
+    }
+    if (groups.find(key) == groups.end()) {
+      group_order.push_back(key);
+    }
+    groups[key].push_back(core->cpu_id);
+  }
+  for (int key : group_order) {
+    if (groups[key].size() > cpu_ids.size()) {
+      cpu_ids = groups[key];
+    }
+  }
+  return cpu_ids;
+}
+
+int LastLevelCacheKey(const CPUCoreTopology &core) { return core.llc_id; }
+
+int NumaNodeKey(const CPUCoreTopology &core) { return core.numa_node; }
+
+std::string TopologySummary(const std::vector<CPUCoreTopology> &topology) {
+  std::set<std::pair<int, int>> cores;
+  std::set<int> llcs;
+  std::set<int> numa_nodes;
+  for (auto &core : topology) {
+    cores.insert({core.package_id, core.core_id});
+    llcs.insert(core.llc_id);
+    if (core.numa_node != kUnknownNumaNode) {
+      numa_nodes.insert(core.numa_node);
+    }
+  }
+  return MakeString(topology.size(), " logical CPUs, ", cores.size(),
+                    " physical cores, ", llcs.size(), " LLC domains, ",
+                    numa_nodes.size(), " NUMA nodes");
+}
+
+// Prefer allocating pages of the calling thread on the numa node.
+void SetThreadPreferredNumaNode(int numa_node) {
+#if defined(SYS_set_mempolicy)
+  // MPOL_PREFERRED of linux/mempolicy.h
+  const int kMemPolicyPreferred = 1;
+  unsigned long node_mask = 1UL << numa_node;  // NOLINT(runtime/int)
+  long err = syscall(SYS_set_mempolicy, kMemPolicyPreferred,  // NOLINT
+                     &node_mask, sizeof(node_mask) * 8);
+  if (err != 0) {
+    LOG(WARNING) << "set memory policy error: " << strerror(errno);
+  }
+#else
+  MACE_UNUSED(numa_node);
+  LOG(WARNING) << "Set memory policy failed: set_mempolicy not supported.";
+#endif
+}
+
 void SetThreadAffinity(cpu_set_t mask) {
 #if defined(__ANDROID__)
   pid_t pid = gettid();
@@ -89,15 +332,96 @@ void SetThreadAffinity(cpu_set_t mask) {
 
 }  // namespace
 
+bool ParseCPUList(const std::string &cpu_list, std::vector<int> *cpu_ids) {
+  MACE_CHECK_NOTNULL(cpu_ids);
+  const char *ptr = cpu_list.c_str();
+  bool valid = false;
+  while (true) {
+    char *end_ptr = nullptr;
+    long begin = strtol(ptr, &end_ptr, 10);  // NOLINT(runtime/int)
+    if (end_ptr == ptr) {
+      break;
+    }
+    long end = begin;  // NOLINT(runtime/int)
+    ptr = end_ptr;
+    if (*ptr == '-') {
+      ++ptr;
+      end = strtol(ptr, &end_ptr, 10);
+      if (end_ptr == ptr) {
+        return false;
+      }
+      ptr = end_ptr;
+    }
+    for (long i = begin; i <= end; ++i) {  // NOLINT(runtime/int)
+      cpu_ids->push_back(static_cast<int>(i));
+    }
+    valid = true;
+    if (*ptr != ',') {
+      break;
+    }
+    ++ptr;
+  }
+  return valid;
+}
+
+bool ParseCacheSize(const std::string &size, int64_t *bytes) {
+  MACE_CHECK_NOTNULL(bytes);
+  const char *ptr = size.c_str();
+  char *end_ptr = nullptr;
+  long long value = strtoll(ptr, &end_ptr, 10);  // NOLINT(runtime/int)
+  if (end_ptr == ptr || value <= 0) {
+    return false;
+  }
+  switch (*end_ptr) {
+    case 'K': value <<= 10; break;
+    case 'M': value <<= 20; break;
+    case 'G': value <<= 30; break;
+    case '\0': case '\n': break;
+    default: return false;
+  }
+  *bytes = value;
+  return true;
+}
+
+MaceStatus GetCPUCacheSizes(const std::string &sysfs_root,
+                            CPUCacheSizes *cache_sizes) {
+  MACE_CHECK_NOTNULL(cache_sizes);
+  *cache_sizes = {0, 0, 0};
+  const std::string cpu_dir = sysfs_root + "/cpu/cpu0";
+  for (int index = 0; ; ++index) {
+    const std::string cache_dir = MakeString(cpu_dir, "/cache/index", index);
+    int level = 0;
+    if (!ReadIntFromFile(cache_dir + "/level", &level)) {
+      break;
+    }
+    std::string type;
+    std::string size;
+    int64_t bytes = 0;
+    if (!ReadStringFromFile(cache_dir + "/type", &type) ||
+        type == "Instruction" ||
+        !ReadStringFromFile(cache_dir + "/size", &size) ||
+        !ParseCacheSize(size, &bytes)) {
+      continue;
+    }
+    if (level == 1) {
+      cache_sizes->l1d = bytes;
+    } else if (level == 2) {
+      cache_sizes->l2 = bytes;
+    } else if (level == 3) {
+      cache_sizes->l3 = bytes;
+    }
+  }
+  if (cache_sizes->l1d == 0) {
+    return MACE_INVALID_ARGS;
+  }
+  return MACE_SUCCESS;
+}
+
 MaceStatus GetCPUBigLittleCoreIDs(std::vector<int> *big_core_ids,
                                   std::vector<int> *little_core_ids) {
   MACE_CHECK_NOTNULL(big_core_ids);
   MACE_CHECK_NOTNULL(little_core_ids);
-#ifdef MACE_ENABLE_OPENMP
-  int cpu_count = omp_get_num_procs();
-#else
   int cpu_count = GetCPUCount();
-#endif
   std::vector<int> cpu_max_freq(cpu_count);
 
   // set cpu max frequency
@@ -129,6 +453,58 @@ MaceStatus GetCPUBigLittleCoreIDs(std::vector<int> *big_core_ids,
   return MACE_SUCCESS;
 }
 
+MaceStatus GetCPUTopologyCoreIDs(const std::string &sysfs_root,
+                                 CPUAffinityPolicy policy,
+                                 std::vector<int> *cpu_ids,
+                                 std::string *topology_info) {
+  MACE_CHECK_NOTNULL(cpu_ids);
+  if (policy == CPUAffinityPolicy::AFFINITY_BIG_ONLY ||
+      policy == CPUAffinityPolicy::AFFINITY_LITTLE_ONLY) {
+    std::vector<int> big_core_ids;
+    std::vector<int> little_core_ids;
+    MACE_RETURN_IF_ERROR(
+        GetCPUBigLittleCoreIDs(&big_core_ids, &little_core_ids));
+    if (topology_info != nullptr) {
+      *topology_info = MakeString(big_core_ids.size(), " big cores, ",
+                                  little_core_ids.size(), " little cores");
+    }
+    *cpu_ids = policy == CPUAffinityPolicy::AFFINITY_BIG_ONLY ?
+               std::move(big_core_ids) : std::move(little_core_ids);
+    return MACE_SUCCESS;
+  }
+
+  std::vector<CPUCoreTopology> topology;
+  MACE_RETURN_IF_ERROR(GetCPUTopology(sysfs_root, &topology));
+  if (topology_info != nullptr) {
+    *topology_info = TopologySummary(topology);
+  }
+
+  cpu_ids->clear();
+  switch (policy) {
+    case CPUAffinityPolicy::AFFINITY_NONE:
+      for (auto &core : topology) {
+        cpu_ids->push_back(core.cpu_id);
+      }
+      break;
+    case CPUAffinityPolicy::AFFINITY_PHYSICAL_CORES_ONLY:
+      *cpu_ids = SelectPhysicalCores(topology, nullptr, 0);
+      break;
+    case CPUAffinityPolicy::AFFINITY_SINGLE_LLC:
+      // fallback llc ids are negative, so no key is skipped
+      *cpu_ids = SelectPhysicalCores(topology, LastLevelCacheKey,
+                                     std::numeric_limits<int>::min());
+      break;
+    case CPUAffinityPolicy::AFFINITY_SINGLE_NUMA_NODE:
+      *cpu_ids = SelectPhysicalCores(topology, NumaNodeKey,
+                                     kUnknownNumaNode);
+      break;
+    default:
+      LOG(WARNING) << "Unknown CPU affinity policy: " << policy;
+      return MACE_INVALID_ARGS;
+  }
+  return MACE_SUCCESS;
+}
+
 void SetOpenMPThreadsAndAffinityCPUs(int omp_num_threads,
                                      const std::vector<int> &cpu_ids) {
 #ifdef MACE_ENABLE_OPENMP
@@ -147,6 +523,7 @@ void SetOpenMPThreadsAndAffinityCPUs(int omp_num_threads,
     CPU_SET(cpu_id, &mask);
   }
 
+  SetThreadAffinity(mask);
 #ifdef MACE_ENABLE_OPENMP
 #pragma omp parallel for
   for (int i = 0; i < omp_num_threads; ++i) {
@@ -155,7 +532,6 @@ void SetOpenMPThreadsAndAffinityCPUs(int omp_num_threads,
     SetThreadAffinity(mask);
   }
 #else
-  SetThreadAffinity(mask);
   VLOG(1) << "Set affinity without OpenMP: " << mask.__bits[0];
 #endif
 }
@@ -173,28 +549,234 @@ MaceStatus SetOpenMPThreadsAndAffinityPolicy(int omp_num_threads_hint,
     return MACE_SUCCESS;
   }
 
-  std::vector<int> big_core_ids;
-  std::vector<int> little_core_ids;
-  MaceStatus res = GetCPUBigLittleCoreIDs(&big_core_ids, &little_core_ids);
+  std::vector<int> use_cpu_ids;
+  std::string topology_info;
+  MaceStatus res = GetCPUTopologyCoreIDs(kSysfsSystemRoot, policy,
+                                         &use_cpu_ids, &topology_info);
   if (res != MACE_SUCCESS) {
     return res;
   }
-
-  std::vector<int> use_cpu_ids;
-  if (policy == CPUAffinityPolicy::AFFINITY_BIG_ONLY) {
-    use_cpu_ids = std::move(big_core_ids);
-  } else {
-    use_cpu_ids = std::move(little_core_ids);
-  }
+  VLOG(1) << "CPU topology: " << topology_info
+          << ", selected CPU cores: " << MakeString(use_cpu_ids);
 
   if (omp_num_threads_hint <= 0 ||
       omp_num_threads_hint > static_cast<int>(use_cpu_ids.size())) {
     omp_num_threads_hint = use_cpu_ids.size();
   }
   SetOpenMPThreadsAndAffinityCPUs(omp_num_threads_hint, use_cpu_ids);
+
+  if (policy == CPUAffinityPolicy::AFFINITY_SINGLE_NUMA_NODE) {
+    const std::map<int, int> cpu_numa_nodes =
+        GetCPUNumaNodes(kSysfsSystemRoot);
+    auto node_iter = cpu_numa_nodes.find(use_cpu_ids.front());
+    // node mask of set_mempolicy is a single unsigned long here
+    const int max_numa_node = sizeof(unsigned long) * 8;  // NOLINT
+    if (node_iter != cpu_numa_nodes.end() &&
+        node_iter->second < max_numa_node) {
+      const int numa_node = node_iter->second;
+      VLOG(1) << "Set preferred memory node: " << numa_node;
+      SetThreadPreferredNumaNode(numa_node);
+#ifdef MACE_ENABLE_OPENMP
+#pragma omp parallel for
+      for (int i = 0; i < omp_num_threads_hint; ++i) {
+        SetThreadPreferredNumaNode(numa_node);
+      }
+#endif
+    }
+  }
   return MACE_SUCCESS;
 }
 
+MaceStatus GetThreadAffinityCPUs(std::vector<int> *cpu_ids) {
+  MACE_CHECK_NOTNULL(cpu_ids);
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  // pid 0 is the calling thread
+  if (sched_getaffinity(0, sizeof(mask), &mask) != 0) {
+    LOG(WARNING) << "get affinity error: " << strerror(errno);
+    return MACE_INVALID_ARGS;
+  }
+  cpu_ids->clear();
+  for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+    if (CPU_ISSET(cpu, &mask)) cpu_ids->push_back(cpu);
+  }
+  return cpu_ids->empty() ? MACE_INVALID_ARGS : MACE_SUCCESS;
+}
+
+void DivideCPUGroups(const std::vector<int> &cpu_ids,
+                     int num_threads,
+                     int num_groups,
+                     std::vector<std::vector<int>> *group_cpu_ids,
+                     std::vector<int> *group_num_threads) {
+  MACE_CHECK(num_groups > 0, "invalid group number: ", num_groups);
+  group_cpu_ids->assign(num_groups, std::vector<int>());
+  group_num_threads->assign(num_groups, 1);
+  const int cpu_count = static_cast<int>(cpu_ids.size());
+  size_t cpu_idx = 0;
+  for (int g = 0; g < num_groups; ++g) {
+    if (cpu_count >= num_groups) {
+      const int group_cpu_count =
+          cpu_count / num_groups + (g < cpu_count % num_groups ? 1 : 0);
+      for (int i = 0; i < group_cpu_count; ++i) {
+        (*group_cpu_ids)[g].push_back(cpu_ids[cpu_idx++]);
+      }
+    }
+    (*group_num_threads)[g] = std::max(
+        num_threads / num_groups + (g < num_threads % num_groups ? 1 : 0), 1);
+  }
+}
+
+int GetOpenMPNumThreads() {
+#ifdef MACE_ENABLE_OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+void SetOpenMPNumThreads(int num_threads) {
+#ifdef MACE_ENABLE_OPENMP
+  omp_set_num_threads(num_threads);
+#else
+  MACE_UNUSED(num_threads);
+#endif
+}
+
+CPUThreadBudget::CPUThreadBudget(int num_threads)
+    : num_threads_(std::max(num_threads, 1)),
+      free_threads_(num_threads_) {}
+
+int CPUThreadBudget::Acquire(int64_t cost, int64_t pending_cost) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  cond_.wait(lock, [this] { return free_threads_ > 0; });
+  cost = std::max<int64_t>(cost, 1);
+  pending_cost = std::max<int64_t>(pending_cost, 0);
+  int granted = free_threads_;
+  if (pending_cost > 0) {
+    granted = static_cast<int>(
+        (static_cast<double>(free_threads_) * cost) / (cost + pending_cost)
+            + 0.5);
+    granted = std::min(std::max(granted, 1), free_threads_);
+  }
+  free_threads_ -= granted;
+  return granted;
+}
+
+void CPUThreadBudget::Release(int num_threads) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    free_threads_ += num_threads;
+    MACE_CHECK(free_threads_ <= num_threads_, "release more threads than ",
+               "acquired: ", free_threads_, " > ", num_threads_);
+  }
+  cond_.notify_all();
+}
+
+int CPUThreadBudget::free_threads() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return free_threads_;
+}
+
+const char *CPUISAToString(CPUISA isa) {
+  switch (isa) {
+    case CPU_ISA_GENERIC:
+      return "generic";
+    case CPU_ISA_NEON:
+      return "neon";
+    case CPU_ISA_SSE42:
+      return "sse4.2";
+    case CPU_ISA_AVX2:
+      return "avx2";
+    case CPU_ISA_AVX512:
+      return "avx512";
+    default:
+      return "unknown";
+  }
+}
+
+bool ParseCPUISA(const std::string &name, CPUISA *isa) {
+  for (CPUISA candidate : {CPU_ISA_GENERIC, CPU_ISA_NEON, CPU_ISA_SSE42,
+                           CPU_ISA_AVX2, CPU_ISA_AVX512}) {
+    if (name == CPUISAToString(candidate)) {
+      *isa = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+CPUISA DetectCPUISA() {
+#if defined(MACE_ENABLE_NEON)
+  return CPU_ISA_NEON;
+#elif defined(__x86_64__) || defined(__i386__)
+  unsigned int eax, ebx, ecx, edx;
+  if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx) || !(ecx & bit_SSE4_2)) {
+    return CPU_ISA_GENERIC;
+  }
+  // the OS must save the ymm/zmm states as well, see XCR0
+  uint64_t xcr0 = 0;
+  if (ecx & bit_OSXSAVE) {
+    uint32_t xcr0_lo, xcr0_hi;
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+    xcr0 = (static_cast<uint64_t>(xcr0_hi) << 32) | xcr0_lo;
+  }
+  const bool has_avx_fma =
+      (ecx & bit_AVX) && (ecx & bit_FMA) && (xcr0 & 0x6) == 0x6;
+  if (!has_avx_fma || __get_cpuid_max(0, nullptr) < 7) {
+    return CPU_ISA_SSE42;
+  }
+  __cpuid_count(7, 0, eax, ebx, ecx, edx);
+  if (!(ebx & bit_AVX2)) {
+    return CPU_ISA_SSE42;
+  }
+  if ((ebx & bit_AVX512F) && (xcr0 & 0xe0) == 0xe0) {
+    return CPU_ISA_AVX512;
+  }
+  return CPU_ISA_AVX2;
+#else
+  return CPU_ISA_GENERIC;
+#endif
+}
+
+bool IsCPUISASupported(CPUISA isa, CPUISA detected) {
+  if (isa == detected) {
+    return true;
+  }
+  // NEON builds have no portable variants left to fall back to
+  if (isa == CPU_ISA_GENERIC) {
+    return detected != CPU_ISA_NEON;
+  }
+  return isa >= CPU_ISA_SSE42 && detected >= isa;
+}
+
+CPUISA SelectCPUISA(CPUISA detected, const char *override_isa) {
+  if (override_isa == nullptr || strlen(override_isa) == 0) {
+    return detected;
+  }
+  CPUISA isa;
+  if (!ParseCPUISA(override_isa, &isa)) {
+    LOG(WARNING) << "Unknown CPU ISA " << override_isa << ", use "
+                 << CPUISAToString(detected);
+    return detected;
+  }
+  if (!IsCPUISASupported(isa, detected)) {
+    LOG(WARNING) << "CPU ISA " << override_isa << " is not supported, use "
+                 << CPUISAToString(detected);
+    return detected;
+  }
+  return isa;
+}
+
+CPUISA GetCPUISA() {
+  static const CPUISA isa =
+      SelectCPUISA(DetectCPUISA(), getenv("MACE_CPU_ISA"));
+  return isa;
+}
+
+const char *GetCPUISAName() {
+  return CPUISAToString(GetCPUISA());
+}
+
 MaceStatus SetOpenMPThreadPolicy(int num_threads_hint,
                                  CPUAffinityPolicy policy) {
   VLOG(1) << "Set OpenMP threads number hint: " << num_threads_hint
@@ -211,5 +793,12 @@ MaceStatus GetBigLittleCoreIDs(std::vector<int> *big_core_ids,
   return GetCPUBigLittleCoreIDs(big_core_ids, little_core_ids);
 }
 
+MaceStatus GetCPUAffinityCoreIDs(CPUAffinityPolicy policy,
+                                 std::vector<int> *cpu_ids,
+                                 std::string *topology_info) {
+  return GetCPUTopologyCoreIDs(kSysfsSystemRoot, policy, cpu_ids,
+                               topology_info);
+}
+
 }  // namespace mace
 
@@ -15,22 +15,126 @@
 #ifndef MACE_CORE_RUNTIME_CPU_CPU_RUNTIME_H_
 #define MACE_CORE_RUNTIME_CPU_CPU_RUNTIME_H_
 
+#include <condition_variable>  // NOLINT(build/c++11)
+#include <cstdint>
+#include <mutex>  // NOLINT(build/c++11)
+#include <string>
 #include <vector>
 
 #include "mace/public/mace.h"
 #include "mace/public/mace_runtime.h"
+#include "mace/utils/utils.h"
 
 namespace mace {
 
+// SIMD instruction sets the CPU kernels have variants for, the x86 ones are
+// ordered by capability.
+enum CPUISA {
+  CPU_ISA_GENERIC = 0,
+  CPU_ISA_NEON = 1,
+  CPU_ISA_SSE42 = 2,
+  CPU_ISA_AVX2 = 3,
+  CPU_ISA_AVX512 = 4,
+};
+
+const char *CPUISAToString(CPUISA isa);
+
+// Accepts the names returned by CPUISAToString, e.g., "sse4.2".
+bool ParseCPUISA(const std::string &name, CPUISA *isa);
+
+// The best instruction set supported by both the build and the running cpu,
+// probed once via cpuid and xgetbv on x86. NEON builds always report NEON.
+CPUISA DetectCPUISA();
+
+// Whether kernels built for isa can run where detected is the best one.
+bool IsCPUISASupported(CPUISA isa, CPUISA detected);
+
+// Lowers the detected instruction set to override_isa, e.g., the value of
+// MACE_CPU_ISA. An unknown or unsupported override is ignored with a warning.
+CPUISA SelectCPUISA(CPUISA detected, const char *override_isa);
+
+// The instruction set the CPU kernels dispatch to, selected once.
+CPUISA GetCPUISA();
+
 MaceStatus GetCPUBigLittleCoreIDs(std::vector<int> *big_core_ids,
                                   std::vector<int> *little_core_ids);
 
+constexpr const char *kSysfsSystemRoot = "/sys/devices/system";
+
+// Parse cpu list in sysfs format, e.g., "0-3,8,10-11".
+bool ParseCPUList(const std::string &cpu_list, std::vector<int> *cpu_ids);
+
+// Select cores by policy with the topology read from sysfs_root, which is
+// kSysfsSystemRoot except for tests.
+MaceStatus GetCPUTopologyCoreIDs(const std::string &sysfs_root,
+                                 CPUAffinityPolicy policy,
+                                 std::vector<int> *cpu_ids,
+                                 std::string *topology_info);
+
+// Data cache sizes in bytes, 0 if the level is missing.
+struct CPUCacheSizes {
+  int64_t l1d;
+  int64_t l2;
+  int64_t l3;
+};
+
+// Parse cache size in sysfs format, e.g., "48K" or "32M".
+bool ParseCacheSize(const std::string &size, int64_t *bytes);
+
+// Data and unified cache sizes of cpu0 read from sysfs_root, fails if even
+// the L1 data cache is not exposed.
+MaceStatus GetCPUCacheSizes(const std::string &sysfs_root,
+                            CPUCacheSizes *cache_sizes);
+
 void SetOpenMPThreadsAndAffinityCPUs(int omp_num_threads,
                                      const std::vector<int> &cpu_ids);
 
 MaceStatus SetOpenMPThreadsAndAffinityPolicy(int omp_num_threads_hint,
                                              CPUAffinityPolicy policy);
 
+// CPUs the calling thread is allowed to run on.
+MaceStatus GetThreadAffinityCPUs(std::vector<int> *cpu_ids);
+
+// Divide cpus and threads into num_groups contiguous groups, sizes differ by
+// at most one. A group gets no cpu if there are fewer cpus than groups.
+void DivideCPUGroups(const std::vector<int> &cpu_ids,
+                     int num_threads,
+                     int num_groups,
+                     std::vector<std::vector<int>> *group_cpu_ids,
+                     std::vector<int> *group_num_threads);
+
+// Number of threads the parallel regions started by the calling thread use,
+// 1 if OpenMP is disabled.
+int GetOpenMPNumThreads();
+
+// Only changes the thread number of the parallel regions started by the
+// calling thread, the affinity is left untouched.
+void SetOpenMPNumThreads(int num_threads);
+
+// A fixed number of threads shared by concurrently running ops, so that
+// inter-op and intra-op parallelism together never oversubscribe the cores.
+class CPUThreadBudget {
+ public:
+  explicit CPUThreadBudget(int num_threads);
+
+  // Blocks until a thread is free, then grants the part of the free threads
+  // proportional to cost / (cost + pending_cost), at least one, where
+  // pending_cost is the cost of the ready ops still waiting for threads.
+  int Acquire(int64_t cost, int64_t pending_cost);
+  void Release(int num_threads);
+
+  int num_threads() const { return num_threads_; }
+  int free_threads();
+
+ private:
+  const int num_threads_;
+  int free_threads_;
+  std::mutex mutex_;
+  std::condition_variable cond_;
+
+  MACE_DISABLE_COPY_AND_ASSIGN(CPUThreadBudget);
+};
+
 }  // namespace mace
 
 #endif  // MACE_CORE_RUNTIME_CPU_CPU_RUNTIME_H_
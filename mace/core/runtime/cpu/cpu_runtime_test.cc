@@ -0,0 +1,258 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+#include "mace/core/runtime/cpu/cpu_runtime.h"
+#include "mace/utils/logging.h"
+#include "mace/utils/string_util.h"
+
+namespace mace {
+namespace {
+
+class FakeSysfs {
+ public:
+  FakeSysfs() {
+    char root[] = "/tmp/mace_sysfs_XXXXXX";
+    MACE_CHECK(mkdtemp(root) != nullptr);
+    root_ = root;
+  }
+
+  ~FakeSysfs() {
+    std::string cmd = "rm -rf " + root_;
+    if (system(cmd.c_str()) != 0) {
+      LOG(WARNING) << "Remove " << root_ << " failed";
+    }
+  }
+
+  void WriteFile(const std::string &path, const std::string &content) {
+    std::string full_path = root_ + "/" + path;
+    for (size_t pos = full_path.find('/', 1); pos != std::string::npos;
+         pos = full_path.find('/', pos + 1)) {
+      mkdir(full_path.substr(0, pos).c_str(), 0755);
+    }
+    std::ofstream out(full_path);
+    out << content << "\n";
+  }
+
+  void AddCPU(int cpu, int package, int core, const std::string &llc_list) {
+    const std::string cpu_dir = MakeString("cpu/cpu", cpu);
+    const std::string self = MakeString(cpu);
+    WriteFile(cpu_dir + "/topology/core_id", MakeString(core));
+    WriteFile(cpu_dir + "/topology/physical_package_id", MakeString(package));
+    AddCache(cpu_dir, 0, 1, "Data", self);
+    AddCache(cpu_dir, 1, 1, "Instruction", self);
+    AddCache(cpu_dir, 2, 2, "Unified", self);
+    AddCache(cpu_dir, 3, 3, "Unified", llc_list);
+  }
+
+  const std::string &root() const { return root_; }
+
+ private:
+  void AddCache(const std::string &cpu_dir, int index, int level,
+                const std::string &type, const std::string &shared_list) {
+    const std::string cache_dir = MakeString(cpu_dir, "/cache/index", index);
+    WriteFile(cache_dir + "/level", MakeString(level));
+    WriteFile(cache_dir + "/type", type);
+    WriteFile(cache_dir + "/shared_cpu_list", shared_list);
+  }
+
+  std::string root_;
+};
+
+std::vector<int> SelectCores(const std::string &root,
+                             CPUAffinityPolicy policy,
+                             std::string *topology_info = nullptr) {
+  std::vector<int> cpu_ids;
+  EXPECT_EQ(MACE_SUCCESS,
+            GetCPUTopologyCoreIDs(root, policy, &cpu_ids, topology_info));
+  return cpu_ids;
+}
+
+}  // namespace
+
+TEST(CPURuntimeTest, ParseCPUList) {
+  std::vector<int> cpu_ids;
+  EXPECT_TRUE(ParseCPUList("0-3,8,10-11\n", &cpu_ids));
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 8, 10, 11}), cpu_ids);
+
+  cpu_ids.clear();
+  EXPECT_TRUE(ParseCPUList("5", &cpu_ids));
+  EXPECT_EQ(std::vector<int>({5}), cpu_ids);
+
+  cpu_ids.clear();
+  EXPECT_FALSE(ParseCPUList("", &cpu_ids));
+  EXPECT_FALSE(ParseCPUList("2-", &cpu_ids));
+}
+
+// Two packages, each with its own LLC and NUMA node. Package 0 has two SMT
+// cores (cpu 0/4, 1/5), package 1 has three cores (cpu 2, 3, 6/7) and cpu 6
+// is offline, i.e., excluded by the online list.
+TEST(CPURuntimeTest, TopologyPolicies) {
+  FakeSysfs sysfs;
+  sysfs.WriteFile("cpu/online", "0-5,7");
+  sysfs.AddCPU(0, 0, 0, "0-1,4-5");
+  sysfs.AddCPU(1, 0, 1, "0-1,4-5");
+  sysfs.AddCPU(4, 0, 0, "0-1,4-5");
+  sysfs.AddCPU(5, 0, 1, "0-1,4-5");
+  sysfs.AddCPU(2, 1, 0, "2-3,6-7");
+  sysfs.AddCPU(3, 1, 1, "2-3,6-7");
+  sysfs.AddCPU(7, 1, 2, "2-3,6-7");
+  // offline cpu only exposes its directory
+  sysfs.WriteFile("cpu/cpu6/online", "0");
+  sysfs.WriteFile("node/node0/cpulist", "0-1,4-5");
+  sysfs.WriteFile("node/node1/cpulist", "2-3,6-7");
+
+  std::string topology_info;
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 4, 5, 7}),
+            SelectCores(sysfs.root(), AFFINITY_NONE, &topology_info));
+  EXPECT_EQ("7 logical CPUs, 5 physical cores, 2 LLC domains, 2 NUMA nodes",
+            topology_info);
+  EXPECT_EQ(std::vector<int>({0, 1, 2, 3, 7}),
+            SelectCores(sysfs.root(), AFFINITY_PHYSICAL_CORES_ONLY));
+  EXPECT_EQ(std::vector<int>({2, 3, 7}),
+            SelectCores(sysfs.root(), AFFINITY_SINGLE_LLC));
+  EXPECT_EQ(std::vector<int>({2, 3, 7}),
+            SelectCores(sysfs.root(), AFFINITY_SINGLE_NUMA_NODE));
+}
+
+// Without online list and NUMA info, offline cpus are detected by the missing
+// topology, and equal sized groups prefer lower ids.
+TEST(CPURuntimeTest, TopologyFallbackAndTieBreak) {
+  FakeSysfs sysfs;
+  sysfs.AddCPU(0, 0, 0, "0");
+  sysfs.AddCPU(1, 0, 1, "1");
+  sysfs.WriteFile("cpu/cpu2/online", "0");
+
+  std::string topology_info;
+  EXPECT_EQ(std::vector<int>({0, 1}),
+            SelectCores(sysfs.root(), AFFINITY_PHYSICAL_CORES_ONLY,
+                        &topology_info));
+  EXPECT_EQ("2 logical CPUs, 2 physical cores, 2 LLC domains, 1 NUMA nodes",
+            topology_info);
+  EXPECT_EQ(std::vector<int>({0}),
+            SelectCores(sysfs.root(), AFFINITY_SINGLE_LLC));
+  EXPECT_EQ(std::vector<int>({0, 1}),
+            SelectCores(sysfs.root(), AFFINITY_SINGLE_NUMA_NODE));
+}
+
+// CPUs not listed by any exposed node are never merged into another node.
+TEST(CPURuntimeTest, PartialNumaInfo) {
+  FakeSysfs sysfs;
+  sysfs.WriteFile("cpu/online", "0-3");
+  for (int cpu = 0; cpu < 4; ++cpu) {
+    sysfs.AddCPU(cpu, cpu / 3, cpu, "0-3");
+  }
+  sysfs.WriteFile("node/node1/cpulist", "3");
+
+  std::string topology_info;
+  EXPECT_EQ(std::vector<int>({3}),
+            SelectCores(sysfs.root(), AFFINITY_SINGLE_NUMA_NODE,
+                        &topology_info));
+  EXPECT_EQ("4 logical CPUs, 4 physical cores, 1 LLC domains, 1 NUMA nodes",
+            topology_info);
+}
+
+TEST(CPURuntimeTest, MissingTopology) {
+  FakeSysfs sysfs;
+  std::vector<int> cpu_ids;
+  EXPECT_EQ(MACE_INVALID_ARGS,
+            GetCPUTopologyCoreIDs(sysfs.root(), AFFINITY_PHYSICAL_CORES_ONLY,
+                                  &cpu_ids, nullptr));
+}
+
+TEST(CPURuntimeTest, CacheSizes) {
+  int64_t bytes = 0;
+  EXPECT_TRUE(ParseCacheSize("48K\n", &bytes));
+  EXPECT_EQ(48 << 10, bytes);
+  EXPECT_TRUE(ParseCacheSize("32M", &bytes));
+  EXPECT_EQ(32 << 20, bytes);
+  EXPECT_FALSE(ParseCacheSize("", &bytes));
+  EXPECT_FALSE(ParseCacheSize("8X", &bytes));
+
+  FakeSysfs sysfs;
+  CPUCacheSizes cache_sizes;
+  EXPECT_EQ(MACE_INVALID_ARGS, GetCPUCacheSizes(sysfs.root(), &cache_sizes));
+
+  // the instruction cache is skipped, a missing level is 0
+  sysfs.AddCPU(0, 0, 0, "0");
+  sysfs.WriteFile("cpu/cpu0/cache/index0/size", "32K");
+  sysfs.WriteFile("cpu/cpu0/cache/index1/size", "64K");
+  sysfs.WriteFile("cpu/cpu0/cache/index2/size", "1024K");
+  EXPECT_EQ(MACE_SUCCESS, GetCPUCacheSizes(sysfs.root(), &cache_sizes));
+  EXPECT_EQ(32 << 10, cache_sizes.l1d);
+  EXPECT_EQ(1 << 20, cache_sizes.l2);
+  EXPECT_EQ(0, cache_sizes.l3);
+}
+
+TEST(CPURuntimeTest, DivideCPUGroups) {
+  std::vector<std::vector<int>> group_cpu_ids;
+  std::vector<int> group_num_threads;
+  DivideCPUGroups({0, 1, 2, 4, 5}, 5, 2, &group_cpu_ids, &group_num_threads);
+  EXPECT_EQ(std::vector<std::vector<int>>({{0, 1, 2}, {4, 5}}),
+            group_cpu_ids);
+  EXPECT_EQ(std::vector<int>({3, 2}), group_num_threads);
+
+  // too few cpus to pin, every group still gets a thread
+  DivideCPUGroups({3}, 2, 3, &group_cpu_ids, &group_num_threads);
+  EXPECT_EQ(std::vector<std::vector<int>>(3), group_cpu_ids);
+  EXPECT_EQ(std::vector<int>({1, 1, 1}), group_num_threads);
+}
+
+TEST(CPURuntimeTest, ThreadBudget) {
+  CPUThreadBudget budget(8);
+  // alone, an op gets every free thread
+  EXPECT_EQ(8, budget.Acquire(100, 0));
+  budget.Release(8);
+  // shared by cost with the ready ops still waiting
+  EXPECT_EQ(6, budget.Acquire(300, 100));
+  EXPECT_EQ(2, budget.Acquire(100, 0));
+  EXPECT_EQ(0, budget.free_threads());
+  budget.Release(6);
+  // a cheap op still gets a thread, reclaimed threads go to the next op
+  EXPECT_EQ(1, budget.Acquire(1, 1000));
+  EXPECT_EQ(5, budget.Acquire(100, 0));
+  budget.Release(1);
+  budget.Release(5);
+  budget.Release(2);
+  EXPECT_EQ(8, budget.free_threads());
+}
+
+TEST(CPURuntimeTest, SelectCPUISA) {
+  CPUISA isa;
+  EXPECT_TRUE(ParseCPUISA("sse4.2", &isa));
+  EXPECT_EQ(CPU_ISA_SSE42, isa);
+  EXPECT_TRUE(ParseCPUISA("avx512", &isa));
+  EXPECT_EQ(CPU_ISA_AVX512, isa);
+  EXPECT_FALSE(ParseCPUISA("avx3", &isa));
+
+  EXPECT_EQ(CPU_ISA_AVX2, SelectCPUISA(CPU_ISA_AVX2, nullptr));
+  EXPECT_EQ(CPU_ISA_AVX2, SelectCPUISA(CPU_ISA_AVX2, ""));
+  EXPECT_EQ(CPU_ISA_SSE42, SelectCPUISA(CPU_ISA_AVX2, "sse4.2"));
+  EXPECT_EQ(CPU_ISA_GENERIC, SelectCPUISA(CPU_ISA_AVX2, "generic"));
+  // never raised beyond the detected one, nor across architectures
+  EXPECT_EQ(CPU_ISA_AVX2, SelectCPUISA(CPU_ISA_AVX2, "avx512"));
+  EXPECT_EQ(CPU_ISA_AVX2, SelectCPUISA(CPU_ISA_AVX2, "neon"));
+  EXPECT_EQ(CPU_ISA_AVX2, SelectCPUISA(CPU_ISA_AVX2, "unknown"));
+  EXPECT_EQ(CPU_ISA_NEON, SelectCPUISA(CPU_ISA_NEON, "generic"));
+  EXPECT_EQ(CPU_ISA_GENERIC, SelectCPUISA(CPU_ISA_GENERIC, "sse4.2"));
+}
+
+}  // namespace mace
@@ -105,18 +105,21 @@ class Tensor {
         dtype_(type),
         buffer_(nullptr),
         is_buffer_owner_(true),
+        is_weight_(false),
         name_("") {}
 
   Tensor(BufferBase *buffer, DataType dtype)
     : dtype_(dtype),
       buffer_(buffer),
       is_buffer_owner_(false),
+      is_weight_(false),
       name_("") {}
 
   Tensor(const BufferSlice &buffer_slice, DataType dtype)
       : dtype_(dtype),
         buffer_slice_(buffer_slice),
         is_buffer_owner_(false),
+        is_weight_(false),
         name_("") {
     buffer_ = &buffer_slice_;
   }
@@ -307,6 +310,11 @@ class Tensor {
 
   inline void SetSourceOpName(const std::string name) { name_ = name; }
 
+  // Constant tensor loaded from the model data, never written by ops.
+  inline bool is_weight() const { return is_weight_; }
+
+  inline void SetIsWeight(bool is_weight) { is_weight_ = is_weight; }
+
   inline void DebugPrint() const {
     using namespace numerical_chars;  // NOLINT(build/namespaces)
     std::stringstream os;
@@ -330,7 +338,13 @@ class Tensor {
     explicit MappingGuard(const Tensor *tensor) : tensor_(tensor) {
       if (tensor_ != nullptr) {
         MACE_CHECK_NOTNULL(tensor_->buffer_);
-        tensor_->buffer_->Map(&mapped_image_pitch_);
+        // Host memory needs no mapping, skipping it also allows concurrently
+        // running ops to read the same tensor.
+        if (tensor_->buffer_->OnHost()) {
+          tensor_ = nullptr;
+        } else {
+          tensor_->buffer_->Map(&mapped_image_pitch_);
+        }
       }
     }
 
@@ -362,6 +376,7 @@ class Tensor {
   BufferBase *buffer_;
   BufferSlice buffer_slice_;
   bool is_buffer_owner_;
+  bool is_weight_;
   std::string name_;
 
   MACE_DISABLE_COPY_AND_ASSIGN(Tensor);
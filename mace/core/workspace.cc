@@ -32,8 +32,9 @@ bool ShouldPreallocateMemoryForOp(const OperatorDef &op) {
 }
 }  // namespace
 
-Workspace::Workspace() : host_scratch_buffer_(new ScratchBuffer(
-  GetDeviceAllocator(DeviceType::CPU))) {}
+Workspace::Workspace() : scratch_buffer_lane_(0) {
+  SetScratchBufferLane(0);
+}
 
 Tensor *Workspace::CreateTensor(const std::string &name,
                                 Allocator *alloc,
@@ -119,6 +120,7 @@ MaceStatus Workspace::LoadModelTensor(const NetDef &net_def,
                    const_tensor.data_type()));
 
     tensor->Reshape(dims);
+    tensor->SetIsWeight(true);
     tensor_map_[const_tensor.name()] = std::move(tensor);
   }
 
@@ -226,10 +228,19 @@ MaceStatus Workspace::CreateOutputTensorBuffer(const NetDef &net_def,
 
 ScratchBuffer *Workspace::GetScratchBuffer(DeviceType device_type) {
   if (device_type == CPU) {
-    return host_scratch_buffer_.get();
+    return host_scratch_buffers_[scratch_buffer_lane_].get();
   } else {
     return nullptr;
   }
 }
 
+void Workspace::SetScratchBufferLane(int lane) {
+  MACE_CHECK(lane >= 0, "invalid scratch buffer lane: ", lane);
+  while (static_cast<int>(host_scratch_buffers_.size()) <= lane) {
+    host_scratch_buffers_.emplace_back(
+        new ScratchBuffer(GetDeviceAllocator(DeviceType::CPU)));
+  }
+  scratch_buffer_lane_ = lane;
+}
+
 }  // namespace mace
@@ -53,6 +53,10 @@ class Workspace {
 
   ScratchBuffer *GetScratchBuffer(DeviceType device_type);
 
+  // Ops created after this call get the host scratch buffer of the lane,
+  // ops that may run concurrently must be created with different lanes.
+  void SetScratchBufferLane(int lane);
+
  private:
   MaceStatus CreateOutputTensorBuffer(const NetDef &net_def,
                                       DeviceType device_type);
@@ -63,7 +67,8 @@ class Workspace {
 
   PreallocatedPooledAllocator preallocated_allocator_;
 
-  std::unique_ptr<ScratchBuffer> host_scratch_buffer_;
+  std::vector<std::unique_ptr<ScratchBuffer>> host_scratch_buffers_;
+  int scratch_buffer_lane_;
 
   MACE_DISABLE_COPY_AND_ASSIGN(Workspace);
 };
@@ -23,6 +23,7 @@
 #include "mace/core/future.h"
 #include "mace/core/tensor.h"
 #include "mace/core/types.h"
+#include "mace/kernels/epilogue.h"
 
 #ifdef MACE_ENABLE_OPENCL
 #include "mace/core/runtime/opencl/cl2_header.h"
@@ -31,15 +32,6 @@
 namespace mace {
 namespace kernels {
 
-enum ActivationType {
-  NOOP = 0,
-  RELU = 1,
-  RELUX = 2,
-  PRELU = 3,
-  TANH = 4,
-  SIGMOID = 5
-};
-
 inline ActivationType StringToActivationType(const std::string type) {
   if (type == "RELU") {
     return ActivationType::RELU;
@@ -100,6 +92,25 @@ void DoActivation(const T *input_ptr,
   }
 }
 
+// RELU and RELUX go through the dispatched SIMD clamp kernel
+inline void DoActivation(const float *input_ptr,
+                         float *output_ptr,
+                         const index_t size,
+                         const ActivationType type,
+                         const float relux_max_limit) {
+  if (type == RELU || type == RELUX) {
+    const Epilogue epilogue(nullptr, type, relux_max_limit);
+    const index_t block_size = 4096;
+#pragma omp parallel for
+    for (index_t i = 0; i < size; i += block_size) {
+      ApplyEpilogue(epilogue, 0, input_ptr + i,
+                    std::min(block_size, size - i), output_ptr + i);
+    }
+  } else {
+    DoActivation<float>(input_ptr, output_ptr, size, type, relux_max_limit);
+  }
+}
+
 template <typename T>
 void PReLUActivation(const T *input_ptr,
                      const index_t outer_size,
@@ -15,15 +15,13 @@
 #ifndef MACE_KERNELS_ADDN_H_
 #define MACE_KERNELS_ADDN_H_
 
-#if defined(MACE_ENABLE_NEON) && defined(__aarch64__)
-#include <arm_neon.h>
-#endif
 #include <algorithm>
 #include <memory>
 #include <vector>
 
 #include "mace/core/future.h"
 #include "mace/core/tensor.h"
+#include "mace/kernels/simd.h"
 
 #ifdef MACE_ENABLE_OPENCL
 #include "mace/core/runtime/opencl/cl2_header.h"
@@ -68,16 +66,8 @@ struct AddNFunctor {
         const float *input_ptr = input_data + i;
         float *output_ptr = output_data + i;
         for (int k = 0; k < nn; ++k) {
-#if defined(MACE_ENABLE_NEON) && defined(__aarch64__)
-          float32x4_t in = vld1q_f32(input_ptr);
-          float32x4_t out = vld1q_f32(output_ptr);
-          out = vaddq_f32(out, in);
-          vst1q_f32(output_ptr, out);
-#else
-          for (int m = 0; m < 4; ++m) {
-            output_ptr[m] += input_ptr[m];
-          }
-#endif
+          Float4::Store(output_ptr, Float4::Add(Float4::Load(output_ptr),
+                                                Float4::Load(input_ptr)));
 
           input_ptr += 4;
           output_ptr += 4;
@@ -16,10 +16,14 @@
 #define MACE_KERNELS_ARM_CONV_2D_NEON_H_
 
 #include "mace/core/types.h"
+#include "mace/kernels/epilogue.h"
 
 namespace mace {
 namespace kernels {
 
+// The kernels taking an epilogue apply it to each finished output channel.
+
+// filter is packed by PackGemmA when is_filter_packed is set
 void Conv2dNeonK1x1S1(const float *input,
                       const float *filter,
                       const index_t batch,
@@ -27,18 +31,22 @@ void Conv2dNeonK1x1S1(const float *input,
                       const index_t width,
                       const index_t in_channels,
                       const index_t out_channels,
+                      const bool is_filter_packed,
+                      const Epilogue *epilogue,
                       float *output);
 
 void Conv2dNeonK3x3S1(const float *input,
                       const float *filter,
                       const index_t *in_shape,
                       const index_t *out_shape,
+                      const Epilogue *epilogue,
                       float *output);
 
 void Conv2dNeonK3x3S2(const float *input,
                       const float *filter,
                       const index_t *in_shape,
                       const index_t *out_shape,
+                      const Epilogue *epilogue,
                       float *output);
 
 void Conv2dNeonK5x5S1(const float *input,
@@ -29,11 +29,14 @@ void Conv2dNeonK1x1S1(const float *input,
                       const index_t width,
                       const index_t in_channels,
                       const index_t out_channels,
+                      const bool is_filter_packed,
+                      const Epilogue *epilogue,
                       float *output) {
   for (index_t b = 0; b < batch; ++b) {
     Gemm(filter, input + b * in_channels * height * width, 1, out_channels,
          in_channels, height * width,
-         output + b * out_channels * height * width);
+         output + b * out_channels * height * width, false, false,
+         is_filter_packed, false, epilogue);
   }
 }
 
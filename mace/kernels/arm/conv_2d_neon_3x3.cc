@@ -27,6 +27,7 @@ void Conv2dNeonK3x3S1(const float *input,
                       const float *filter,
                       const index_t *in_shape,
                       const index_t *out_shape,
+                      const Epilogue *epilogue,
                       float *output) {
   const index_t in_image_size = in_shape[2] * in_shape[3];
   const index_t out_image_size = out_shape[2] * out_shape[3];
@@ -309,6 +310,13 @@ void Conv2dNeonK3x3S1(const float *input,
           }
 #endif
         }  // c
+        // both output planes are finished while still in cache
+        if (epilogue != nullptr) {
+          for (index_t oc = 0; oc < 2; ++oc) {
+            float *out_ptr = out_ptr0_base + oc * out_image_size;
+            ApplyEpilogue(*epilogue, m + oc, out_ptr, out_image_size, out_ptr);
+          }
+        }
       } else {
         for (index_t mm = m; mm < out_channels; ++mm) {
           float *out_ptr0_base =
@@ -499,6 +507,10 @@ void Conv2dNeonK3x3S1(const float *input,
                                out_width, out_ptr0_base, 1);
 #endif
           }  // c
+          if (epilogue != nullptr) {
+            ApplyEpilogue(*epilogue, mm, out_ptr0_base, out_image_size,
+                          out_ptr0_base);
+          }
         }    // mm
       }      // if
     }        // m
@@ -509,6 +521,7 @@ void Conv2dNeonK3x3S2(const float *input,
                       const float *filter,
                       const index_t *in_shape,
                       const index_t *out_shape,
+                      const Epilogue *epilogue,
                       float *output) {
   const index_t in_image_size = in_shape[2] * in_shape[3];
   const index_t out_image_size = out_shape[2] * out_shape[3];
@@ -654,6 +667,10 @@ void Conv2dNeonK3x3S2(const float *input,
                            out_width, out_base, 2);
 #endif
       }  // c
+      if (epilogue != nullptr) {
+        float *out_base = output + b * out_batch_size + m * out_image_size;
+        ApplyEpilogue(*epilogue, m, out_base, out_image_size, out_base);
+      }
     }    // m
   }      // b
 }
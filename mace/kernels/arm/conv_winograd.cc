@@ -17,6 +17,7 @@
 
 #include "mace/kernels/arm/conv_winograd.h"
 #include "mace/kernels/gemm.h"
+#include "mace/kernels/simd.h"
 #include "mace/utils/logging.h"
 #include "mace/utils/utils.h"
 
@@ -24,102 +25,116 @@ namespace mace {
 namespace kernels {
 
 namespace {
-// NCHW => NTCB (T: in tile pixels, B: tile indices)
-void TransformInput4x4(const float *input,
-                       const index_t batch,
-                       const index_t in_height,
-                       const index_t in_width,
-                       const index_t in_channels,
-                       const index_t tile_count,
-                       float *output) {
-  const index_t stride = in_channels * tile_count;
-  const index_t in_height_width = in_height * in_width;
-  const index_t input_batch_size = in_height_width * in_channels;
-  const index_t output_batch_size = 16 * in_channels * tile_count;
 
-#pragma omp parallel for collapse(2)
-  for (index_t n = 0; n < batch; ++n) {
-    for (index_t c = 0; c < in_channels; ++c) {
-      index_t tile_index = 0;
-      for (index_t h = 0; h < in_height - 2; h += 2) {
-        for (index_t w = 0; w < in_width - 2; w += 2) {
-          float d0, d1, d2, d3, d4, d5, d6, d7, d8, d9, d10, d11, d12, d13, d14,
-              d15;
-          float s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11, s12, s13, s14,
-              s15;
-
-          // load tile data
-          const float *input_ptr = input + n * input_batch_size +
-                                   c * in_height_width + h * in_width + w;
-          d0 = input_ptr[0];
-          d1 = input_ptr[1];
-          d2 = input_ptr[2];
-          d3 = input_ptr[3];
-
-          d4 = input_ptr[in_width];
-          d5 = input_ptr[in_width + 1];
-          d6 = input_ptr[in_width + 2];
-          d7 = input_ptr[in_width + 3];
-
-          d8 = input_ptr[2 * in_width];
-          d9 = input_ptr[2 * in_width + 1];
-          d10 = input_ptr[2 * in_width + 2];
-          d11 = input_ptr[2 * in_width + 3];
-
-          d12 = input_ptr[3 * in_width];
-          d13 = input_ptr[3 * in_width + 1];
-          d14 = input_ptr[3 * in_width + 2];
-          d15 = input_ptr[3 * in_width + 3];
-
-          // s = BT * d * B
-          s0 = (d0 - d8) - (d2 - d10);
-          s1 = (d1 - d9) + (d2 - d10);
-          s2 = (d2 - d10) - (d1 - d9);
-          s3 = (d1 - d9) - (d3 - d11);
-          s4 = (d4 + d8) - (d6 + d10);
-          s5 = (d5 + d9) + (d6 + d10);
-          s6 = (d6 + d10) - (d5 + d9);
-          s7 = (d5 + d9) - (d7 + d11);
-          s8 = (d8 - d4) - (d10 - d6);
-          s9 = (d9 - d5) + (d10 - d6);
-          s10 = (d10 - d6) - (d9 - d5);
-          s11 = (d9 - d5) - (d11 - d7);
-          s12 = (d4 - d12) - (d6 - d14);
-          s13 = (d5 - d13) + (d6 - d14);
-          s14 = (d6 - d14) - (d5 - d13);
-          s15 = (d5 - d13) - (d7 - d15);
-
-          // store output
-          float *output_ptr =
-              output + n * output_batch_size + c * tile_count + tile_index;
-          output_ptr[0] = s0;
-          output_ptr[1 * stride] = s1;
-          output_ptr[2 * stride] = s2;
-          output_ptr[3 * stride] = s3;
-
-          output_ptr[4 * stride] = s4;
-          output_ptr[5 * stride] = s5;
-          output_ptr[6 * stride] = s6;
-          output_ptr[7 * stride] = s7;
-
-          output_ptr[8 * stride] = s8;
-          output_ptr[9 * stride] = s9;
-          output_ptr[10 * stride] = s10;
-          output_ptr[11 * stride] = s11;
-
-          output_ptr[12 * stride] = s12;
-          output_ptr[13 * stride] = s13;
-          output_ptr[14 * stride] = s14;
-          output_ptr[15 * stride] = s15;
-
-          ++tile_index;
-        }
-      }
-    }
+// The transforms compute Float4::kWidth tiles at a time, one per lane, the
+// adjacent tiles of a row of tiles for the 2D ones.
+typedef Float4::Reg Reg;
+const index_t kLanes = Float4::kWidth;
+
+// [p[0], p[step], ...] of count <= kLanes tiles, the lanes past count repeat
+// the last tile, so nothing past it is read.
+inline Reg LoadTiles(const float *p, const index_t step, const index_t count) {
+  if (count == kLanes) {
+    return step == 1 ? Float4::Load(p) : Float4::Gather(p, step);
   }
+  float lanes[kLanes];
+  for (index_t k = 0; k < kLanes; ++k) {
+    lanes[k] = p[std::min(k, count - 1) * step];
+  }
+  return Float4::Load(lanes);
+}
+
+inline void StoreTiles(float *p,
+                       const index_t step,
+                       const index_t count,
+                       const Reg v) {
+  if (count == kLanes && step == 1) {
+    Float4::Store(p, v);
+    return;
+  }
+  float lanes[kLanes];
+  Float4::Store(lanes, v);
+  for (index_t k = 0; k < count; ++k) {
+    p[k * step] = lanes[k];
+  }
+}
+
+// The first of the kLanes tiles starting at tile of a row of tiles, moved
+// back to end at the last tile, as recomputing tiles is cheaper than a
+// partial vector.
+inline index_t TileGroupStart(const index_t tile, const index_t tiles) {
+  return std::max<index_t>(0, std::min(tile, tiles - kLanes));
+}
+
+inline Reg Scale(const Reg v, const float f) {
+  return Float4::Mul(v, Float4::Set1(f));
+}
+
+inline Reg ScaleAdd(const Reg v, const float f, const Reg c) {
+  return Float4::MulAdd(v, Float4::Set1(f), c);
+}
+
+// s = BT * d of the n interpolation points, d and s are d_step and s_step
+// apart. The points are 0, 1, -1, 2, -2 and infinity for n of 6, and 1/2,
+// -1/2 as well for n of 8.
+template <int n>
+void InputTransform(const Reg *d, const int d_step, Reg *s, const int s_step);
+
+template <>
+inline void InputTransform<4>(const Reg *d,
+                              const int d_step,
+                              Reg *s,
+                              const int s_step) {
+  const Reg d0 = d[0];
+  const Reg d1 = d[d_step];
+  const Reg d2 = d[2 * d_step];
+  const Reg d3 = d[3 * d_step];
+  s[0] = Float4::Sub(d0, d2);
+  s[s_step] = Float4::Add(d1, d2);
+  s[2 * s_step] = Float4::Sub(d2, d1);
+  s[3 * s_step] = Float4::Sub(d1, d3);
+}
+
+/**
+ * BT =
+⎡4   0   -5   0   1  0⎤
+⎢                     ⎥
+⎢0  -4   -4   1   1  0⎥
+⎢                     ⎥
+⎢0   4   -4  -1   1  0⎥
+⎢                     ⎥
+⎢0  -2   -1   2   1  0⎥
+⎢                     ⎥
+⎢0   2   -1  -2   1  0⎥
+⎢                     ⎥
+⎣0   4    0  -5   0  1⎦
+ */
+template <>
+inline void InputTransform<6>(const Reg *d,
+                              const int d_step,
+                              Reg *s,
+                              const int s_step) {
+  const Reg d0 = d[0];
+  const Reg d1 = d[d_step];
+  const Reg d2 = d[2 * d_step];
+  const Reg d3 = d[3 * d_step];
+  const Reg d4 = d[4 * d_step];
+  const Reg d5 = d[5 * d_step];
+
+  s[0] = ScaleAdd(d0, 4, ScaleAdd(d2, -5, d4));
+  s[5 * s_step] = ScaleAdd(d1, 4, ScaleAdd(d3, -5, d5));
+
+  Reg u = ScaleAdd(d2, -4, d4);
+  Reg v = ScaleAdd(d1, -4, d3);
+  s[s_step] = Float4::Add(u, v);
+  s[2 * s_step] = Float4::Sub(u, v);
+
+  u = Float4::Sub(d4, d2);
+  v = Scale(Float4::Sub(d3, d1), 2);
+  s[3 * s_step] = Float4::Add(u, v);
+  s[4 * s_step] = Float4::Sub(u, v);
 }
 
-// NCHW => NTCB (T: in tile pixels, B: tile indices)
 /**
  * BT =
 ⎡1   0    -21/4    0    21/4     0    -1  0⎤
@@ -137,469 +152,543 @@ void TransformInput4x4(const float *input,
 ⎢0   -2     4     5/2    -5    -1/2   1   0⎥
 ⎢                                          ⎥
 ⎣0   -1     0    21/4     0    -21/4  0   1⎦
+ */
+template <>
+inline void InputTransform<8>(const Reg *d,
+                              const int d_step,
+                              Reg *s,
+                              const int s_step) {
+  const Reg d0 = d[0];
+  const Reg d1 = d[d_step];
+  const Reg d2 = d[2 * d_step];
+  const Reg d3 = d[3 * d_step];
+  const Reg d4 = d[4 * d_step];
+  const Reg d5 = d[5 * d_step];
+  const Reg d6 = d[6 * d_step];
+  const Reg d7 = d[7 * d_step];
+
+  s[0] = ScaleAdd(Float4::Sub(d4, d2), 5.25f, Float4::Sub(d0, d6));
+  s[7 * s_step] = ScaleAdd(Float4::Sub(d3, d5), 5.25f, Float4::Sub(d7, d1));
+
+  Reg u = ScaleAdd(d4, -4.25f, Float4::Add(d2, d6));
+  Reg v = ScaleAdd(d3, -4.25f, Float4::Add(d1, d5));
+  s[s_step] = Float4::Add(u, v);
+  s[2 * s_step] = Float4::Sub(u, v);
+
+  u = ScaleAdd(d2, 0.25f, ScaleAdd(d4, -1.25f, d6));
+  v = ScaleAdd(d1, 0.5f, ScaleAdd(d3, -2.5f, Scale(d5, 2)));
+  s[3 * s_step] = Float4::Add(u, v);
+  s[4 * s_step] = Float4::Sub(u, v);
+
+  u = ScaleAdd(ScaleAdd(d4, -1.25f, d2), 4, d6);
+  v = ScaleAdd(d1, 2, ScaleAdd(d3, -2.5f, Scale(d5, 0.5f)));
+  s[5 * s_step] = Float4::Add(u, v);
+  s[6 * s_step] = Float4::Sub(u, v);
+}
+
+// o = AT * s, the m outputs of the n points of InputTransform.
+template <int m, int n>
+void OutputTransform(const Reg *s, const int s_step, Reg *o, const int o_step);
+
+template <>
+inline void OutputTransform<2, 4>(const Reg *s,
+                                  const int s_step,
+                                  Reg *o,
+                                  const int o_step) {
+  const Reg s1 = s[s_step];
+  const Reg s2 = s[2 * s_step];
+  o[0] = Float4::Add(Float4::Add(s[0], s1), s2);
+  o[o_step] = Float4::Sub(Float4::Sub(s1, s2), s[3 * s_step]);
+}
 
- * @param input
- * @param batch
- * @param in_height
- * @param in_width
- * @param in_channels
- * @param tile_count
- * @param output
+/**
+ * AT =
+⎡1  1   1  1   1  0⎤
+⎢                  ⎥
+⎢0  1  -1  2  -2  0⎥
+⎢                  ⎥
+⎢0  1   1  4   4  0⎥
+⎢                  ⎥
+⎣0  1  -1  8  -8  1⎦
  */
-void TransformInput8x8(const float *input,
-                       const index_t batch,
-                       const index_t in_height,
-                       const index_t in_width,
+template <>
+inline void OutputTransform<4, 6>(const Reg *s,
+                                  const int s_step,
+                                  Reg *o,
+                                  const int o_step) {
+  const Reg u = Float4::Add(s[s_step], s[2 * s_step]);
+  const Reg v = Float4::Sub(s[s_step], s[2 * s_step]);
+  const Reg w = Float4::Add(s[3 * s_step], s[4 * s_step]);
+  const Reg x = Float4::Sub(s[3 * s_step], s[4 * s_step]);
+  o[0] = Float4::Add(Float4::Add(s[0], u), w);
+  o[o_step] = ScaleAdd(x, 2, v);
+  o[2 * o_step] = ScaleAdd(w, 4, u);
+  o[3 * o_step] = Float4::Add(ScaleAdd(x, 8, v), s[5 * s_step]);
+}
+
+/**
+ * AT, the first m rows of
+⎡1  1  1   1    1   32  32   0⎤
+⎢                             ⎥
+⎢0  1  -1  2   -2   16  -16  0⎥
+⎢                             ⎥
+⎢0  1  1   4    4   8    8   0⎥
+⎢                             ⎥
+⎢0  1  -1  8   -8   4   -4   0⎥
+⎢                             ⎥
+⎢0  1  1   16  16   2    2   0⎥
+⎢                             ⎥
+⎣0  1  -1  32  -32  1   -1   0⎦
+ * with the last column of row m - 1 set to 1.
+ */
+template <int m>
+inline void OutputTransform8(const Reg *s,
+                             const int s_step,
+                             Reg *o,
+                             const int o_step) {
+  const Reg u = Float4::Add(s[s_step], s[2 * s_step]);
+  const Reg v = Float4::Sub(s[s_step], s[2 * s_step]);
+  const Reg w = Float4::Add(s[3 * s_step], s[4 * s_step]);
+  const Reg x = Float4::Sub(s[3 * s_step], s[4 * s_step]);
+  const Reg y = Float4::Add(s[5 * s_step], s[6 * s_step]);
+  const Reg z = Float4::Sub(s[5 * s_step], s[6 * s_step]);
+  o[0] = Float4::Add(s[0], ScaleAdd(y, 32, Float4::Add(u, w)));
+  o[o_step] = ScaleAdd(x, 2, ScaleAdd(z, 16, v));
+  if (m > 2) {
+    o[2 * o_step] = ScaleAdd(w, 4, ScaleAdd(y, 8, u));
+    o[3 * o_step] = ScaleAdd(x, 8, ScaleAdd(z, 4, v));
+  }
+  if (m > 4) {
+    o[4 * o_step] = ScaleAdd(w, 16, ScaleAdd(y, 2, u));
+    o[5 * o_step] = ScaleAdd(x, 32, Float4::Add(z, v));
+  }
+  o[(m - 1) * o_step] = Float4::Add(o[(m - 1) * o_step], s[7 * s_step]);
+}
+
+template <>
+inline void OutputTransform<2, 8>(const Reg *s,
+                                  const int s_step,
+                                  Reg *o,
+                                  const int o_step) {
+  OutputTransform8<2>(s, s_step, o, o_step);
+}
+
+template <>
+inline void OutputTransform<4, 8>(const Reg *s,
+                                  const int s_step,
+                                  Reg *o,
+                                  const int o_step) {
+  OutputTransform8<4>(s, s_step, o, o_step);
+}
+
+template <>
+inline void OutputTransform<6, 8>(const Reg *s,
+                                  const int s_step,
+                                  Reg *o,
+                                  const int o_step) {
+  OutputTransform8<6>(s, s_step, o, o_step);
+}
+
+// G of the 8 points, the rows of 1/2 and -1/2 scaled by 1/32 to match AT,
+// of r taps. The 8x8 3x3 one is
+/**
+ * G =
+⎡ 1      0      0  ⎤
+⎢                  ⎥
+⎢-2/9  -2/9   -2/9 ⎥
+⎢                  ⎥
+⎢-2/9   2/9   -2/9 ⎥
+⎢                  ⎥
+⎢1/90  1/45   2/45 ⎥
+⎢                  ⎥
+⎢1/90  -1/45  2/45 ⎥
+⎢                  ⎥
+⎢1/45  1/90   1/180⎥
+⎢                  ⎥
+⎢1/45  -1/90  1/180⎥
+⎢                  ⎥
+⎣ 0      0      1  ⎦
+ */
+float G8(const int point, const int tap, const int r) {
+  static const float kPoints[7] = {0, 1, -1, 2, -2, 0.5f, -0.5f};
+  static const float kScales[7] = {1, -2.f / 9, -2.f / 9, 1.f / 90,
+                                   1.f / 90, 1.f / 45, 1.f / 45};
+  if (point == 7) {
+    return tap == r - 1 ? 1 : 0;
+  }
+  return kScales[point] * powf(kPoints[point], tap);
+}
+
+// s = G * g * GT of n x 3 G, OCHW => TOC, Float4::kWidth input channels at a
+// time.
+template <int n>
+void TransformFilter2D(const float *filter,
+                       const float (*G)[3],
                        const index_t in_channels,
-                       const index_t tile_count,
+                       const index_t out_channels,
                        float *output) {
+  const index_t stride = out_channels * in_channels;
+
+#pragma omp parallel for collapse(2)
+  for (index_t m = 0; m < out_channels; ++m) {
+    for (index_t c = 0; c < in_channels; c += kLanes) {
+      const index_t count = std::min(kLanes, in_channels - c);
+      const float *filter_ptr = filter + (m * in_channels + c) * 9;
+      Reg g[9];
+      for (int i = 0; i < 9; ++i) {
+        g[i] = LoadTiles(filter_ptr + i, 9, count);
+      }
+
+      Reg s[3][n];
+      for (int i = 0; i < 3; ++i) {
+        for (int j = 0; j < n; ++j) {
+          s[i][j] = ScaleAdd(g[i * 3], G[j][0],
+                             ScaleAdd(g[i * 3 + 1], G[j][1],
+                                      Scale(g[i * 3 + 2], G[j][2])));
+        }
+      }
+
+      float *output_ptr = output + m * in_channels + c;
+      for (int i = 0; i < n; ++i) {
+        for (int j = 0; j < n; ++j) {
+          const Reg t = ScaleAdd(s[0][j], G[i][0],
+                                 ScaleAdd(s[1][j], G[i][1],
+                                          Scale(s[2][j], G[i][2])));
+          StoreTiles(output_ptr + (i * n + j) * stride, 1, count, t);
+        }
+      }
+    }
+  }
+}
+
+// NCHW => NTCB (T: in tile pixels, B: tile indices), F(m x m, 3 x 3) of
+// n = m + 2 points. The input of n + (tiles - 1) * m rows and columns holds
+// the tiles exactly.
+template <int m>
+void TransformInput(const float *input,
+                    const index_t batch,
+                    const index_t in_height,
+                    const index_t in_width,
+                    const index_t in_channels,
+                    const index_t tile_count,
+                    float *output) {
+  const int n = m + 2;
   const index_t stride = in_channels * tile_count;
   const index_t in_height_width = in_height * in_width;
   const index_t input_batch_size = in_height_width * in_channels;
-  const index_t output_batch_size = 64 * in_channels * tile_count;
+  const index_t output_batch_size = n * n * stride;
+  const index_t tile_height_count = (in_height - 2) / m;
+  const index_t tile_width_count = (in_width - 2) / m;
 
 #pragma omp parallel for collapse(2)
-  for (index_t n = 0; n < batch; ++n) {
+  for (index_t b = 0; b < batch; ++b) {
     for (index_t c = 0; c < in_channels; ++c) {
-      index_t tile_index = 0;
-      float s[8][8];
-      for (index_t h = 0; h < in_height - 2; h += 6) {
-        for (index_t w = 0; w < in_width - 2; w += 6) {
-          const float *input_ptr = input + n * input_batch_size +
-                                   c * in_height_width + h * in_width + w;
-
-          for (int i = 0; i < 8; ++i) {
-            float d0, d1, d2, d3, d4, d5, d6, d7;
-            d0 = input_ptr[0];
-            d1 = input_ptr[1];
-            d2 = input_ptr[2];
-            d3 = input_ptr[3];
-            d4 = input_ptr[4];
-            d5 = input_ptr[5];
-            d6 = input_ptr[6];
-            d7 = input_ptr[7];
-
-            s[i][0] = d0 - d6 + (d4 - d2) * 5.25;
-            s[i][7] = d7 - d1 + (d3 - d5) * 5.25;
-
-            float u = d2 + d6 - d4 * 4.25;
-            float v = d1 + d5 - d3 * 4.25;
-            s[i][1] = u + v;
-            s[i][2] = u - v;
-
-            u = d6 + d2 * 0.25 - d4 * 1.25;
-            v = d1 * 0.5 - d3 * 2.5 + d5 * 2;
-            s[i][3] = u + v;
-            s[i][4] = u - v;
-
-            u = d6 + (d2 - d4 * 1.25) * 4;
-            v = d1 * 2 - d3 * 2.5 + d5 * 0.5;
-            s[i][5] = u + v;
-            s[i][6] = u - v;
-
-            input_ptr += in_width;
+      const float *input_base =
+          input + b * input_batch_size + c * in_height_width;
+      float *output_base = output + b * output_batch_size + c * tile_count;
+      for (index_t th = 0; th < tile_height_count; ++th) {
+        for (index_t tw0 = 0; tw0 < tile_width_count; tw0 += kLanes) {
+          const index_t tw = TileGroupStart(tw0, tile_width_count);
+          const index_t count = std::min(kLanes, tile_width_count - tw);
+          const float *input_ptr = input_base + (th * in_width + tw) * m;
+
+          // d * B row by row, then BT * (d * B) column by column
+          Reg t[n][n];
+          for (int i = 0; i < n; ++i) {
+            Reg d[n];
+            for (int j = 0; j < n; ++j) {
+              d[j] = LoadTiles(input_ptr + i * in_width + j, m, count);
+            }
+            InputTransform<n>(d, 1, t[i], 1);
           }
 
-          float *output_ptr =
-              output + n * output_batch_size + c * tile_count + tile_index;
-          for (int i = 0; i < 8; ++i) {
-            float d0, d1, d2, d3, d4, d5, d6, d7;
-            d0 = s[0][i];
-            d1 = s[1][i];
-            d2 = s[2][i];
-            d3 = s[3][i];
-            d4 = s[4][i];
-            d5 = s[5][i];
-            d6 = s[6][i];
-            d7 = s[7][i];
-
-            output_ptr[i * stride] = d0 - d6 + (d4 - d2) * 5.25;
-            output_ptr[(56 + i) * stride] = d7 - d1 + (d3 - d5) * 5.25;
-
-            float u = d2 + d6 - d4 * 4.25;
-            float v = d1 + d5 - d3 * 4.25;
-            output_ptr[(8 + i) * stride] = u + v;
-            output_ptr[(16 + i) * stride] = u - v;
-
-            u = d6 + d2 * 0.25 - d4 * 1.25;
-            v = d1 * 0.5 - d3 * 2.5 + d5 * 2;
-            output_ptr[(24 + i) * stride] = u + v;
-            output_ptr[(32 + i) * stride] = u - v;
-
-            u = d6 + (d2 - d4 * 1.25) * 4;
-            v = d1 * 2 - d3 * 2.5 + d5 * 0.5;
-            output_ptr[(40 + i) * stride] = u + v;
-            output_ptr[(48 + i) * stride] = u - v;
+          float *output_ptr = output_base + th * tile_width_count + tw;
+          for (int j = 0; j < n; ++j) {
+            Reg s[n];
+            InputTransform<n>(&t[0][j], n, s, 1);
+            for (int i = 0; i < n; ++i) {
+              StoreTiles(output_ptr + (i * n + j) * stride, 1, count, s[i]);
+            }
           }
-
-          ++tile_index;
         }
       }
     }
   }
 }
 
-// TOC * NTCB => NTOB
-void BatchGemm(const float *input,
-               const float *filter,
-               index_t batch,
-               index_t in_channels,
-               index_t out_channels,
-               index_t tile_count,
-               int out_tile_size,
-               float *output) {
-  const index_t filter_stride = out_channels * in_channels;
-  const int in_tile_area = (out_tile_size + 2) * (out_tile_size + 2);
-  const index_t in_batch_size = in_tile_area * in_channels * tile_count;
-  const index_t in_stride = in_channels * tile_count;
-  const index_t out_batch_size = in_tile_area * out_channels * tile_count;
-  const index_t out_stride = out_channels * tile_count;
-
-  if (batch == 1) {
-    Gemm(filter, input, in_tile_area, out_channels, in_channels, tile_count,
-         output);
-  } else {
+// NTOB => NToOB => NOHoWo, out_height and out_width are multiples of m.
+template <int m>
+void TransformOutput(const float *input,
+                     const index_t batch,
+                     const index_t out_height,
+                     const index_t out_width,
+                     const index_t out_channels,
+                     const index_t tile_count,
+                     const Epilogue *epilogue,
+                     float *output) {
+  const int n = m + 2;
+  const index_t stride = out_channels * tile_count;
+  const index_t input_batch_size = n * n * stride;
+  const index_t out_image_size = out_height * out_width;
+  const index_t output_batch_size = out_channels * out_image_size;
+  const index_t tile_height_count = out_height / m;
+  const index_t tile_width_count = out_width / m;
+
 #pragma omp parallel for collapse(2)
-    for (int b = 0; b < batch; ++b) {
-      for (int i = 0; i < in_tile_area; ++i) {
-        const float *in_ptr = input + b * in_batch_size + i * in_stride;
-        const float *filter_ptr = filter + i * filter_stride;
-        float *out_ptr = output + b * out_batch_size + i * out_stride;
-        Gemm(filter_ptr, in_ptr, 1, out_channels, /* rows */
-             in_channels,                         /* K */
-             tile_count,                          /* cols */
-             out_ptr);
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t o = 0; o < out_channels; ++o) {
+      const float *input_base =
+          input + b * input_batch_size + o * tile_count;
+      float *output_base =
+          output + b * output_batch_size + o * out_image_size;
+      for (index_t th = 0; th < tile_height_count; ++th) {
+        for (index_t tw0 = 0; tw0 < tile_width_count; tw0 += kLanes) {
+          const index_t tw = TileGroupStart(tw0, tile_width_count);
+          const index_t count = std::min(kLanes, tile_width_count - tw);
+          const float *input_ptr = input_base + th * tile_width_count + tw;
+
+          // AT * s column by column, then (AT * s) * A row by row
+          Reg t[m][n];
+          for (int j = 0; j < n; ++j) {
+            Reg s[n];
+            for (int i = 0; i < n; ++i) {
+              s[i] = LoadTiles(input_ptr + (i * n + j) * stride, 1, count);
+            }
+            OutputTransform<m, n>(s, 1, &t[0][j], n);
+          }
+
+          float *output_ptr = output_base + (th * out_width + tw) * m;
+          for (int i = 0; i < m; ++i) {
+            Reg y[m];
+            OutputTransform<m, n>(t[i], 1, y, 1);
+            for (int j = 0; j < m; ++j) {
+              StoreTiles(output_ptr + i * out_width + j, m, count, y[j]);
+            }
+          }
+        }
+      }
+      if (epilogue != nullptr) {
+        ApplyEpilogue(*epilogue, o, output_base, out_image_size,
+                      output_base);
       }
     }
   }
 }
 
-// NTOB => NToOB => NOHoWo
-void TransformOutput4x4(const float *input,
-                        index_t batch,
-                        index_t out_height,
-                        index_t out_width,
-                        index_t out_channels,
-                        index_t tile_count,
-                        float *output) {
-  const index_t stride = out_channels * tile_count;
-  const index_t input_batch_size = 16 * stride;
-  const index_t out_image_size = out_height * out_width;
-  const index_t output_batch_size = out_channels * out_image_size;
+// The tiles of F(m, r) along the width of 1 x r filters or the height of
+// r x 1 ones: lines of tiles line_step apart, tiles of a line tile_step
+// apart, and the points of a tile point_step apart.
+struct Winograd1DGeometry {
+  Winograd1DGeometry(const index_t width,
+                     const index_t out_height,
+                     const index_t out_width,
+                     const int m,
+                     const bool horizontal)
+      : lines(horizontal ? out_height : out_height / m),
+        line_tiles(horizontal ? out_width / m : out_width),
+        line_step(horizontal ? width : m * width),
+        tile_step(horizontal ? m : 1),
+        point_step(horizontal ? 1 : width) {}
+
+  const index_t lines;
+  const index_t line_tiles;
+  const index_t line_step;
+  const index_t tile_step;
+  const index_t point_step;
+};
+
+// NCHW => NTCB of F(m, 9 - m) of 8 points, each tap segment of the filter
+// of a channel is an input channel of its own for the gemm.
+template <int m>
+void TransformInput1D(const float *input,
+                      const index_t batch,
+                      const index_t in_height,
+                      const index_t in_width,
+                      const index_t in_channels,
+                      const index_t segments,
+                      const bool horizontal,
+                      const index_t tile_count,
+                      float *output) {
+  const int n = 8;
+  const index_t taps = segments * (n - m + 1);
+  const Winograd1DGeometry geometry(
+      in_width,
+      horizontal ? in_height : in_height - taps + 1,
+      horizontal ? in_width - taps + 1 : in_width, m, horizontal);
+  const index_t segment_step = (n - m + 1) * geometry.point_step;
+  const index_t stride = in_channels * segments * tile_count;
+  const index_t in_height_width = in_height * in_width;
+  const index_t input_batch_size = in_height_width * in_channels;
+  const index_t output_batch_size = n * stride;
 
-#pragma omp parallel for collapse(2)
-  for (index_t n = 0; n < batch; ++n) {
-    for (index_t m = 0; m < out_channels; ++m) {
-      index_t tile_offset = 0;
-      for (index_t h = 0; h < out_height; h += 2) {
-        for (index_t w = 0; w < out_width; w += 2) {
-          float d0, d1, d2, d3, d4, d5, d6, d7, d8, d9, d10, d11, d12, d13, d14,
-              d15;
-          float s0, s1, s2, s3, s4, s5, s6, s7;
-          float v0, v1, v2, v3;
-
-          const float *input_ptr =
-              input + n * input_batch_size + m * tile_count + tile_offset;
-          d0 = input_ptr[0];
-          d1 = input_ptr[1 * stride];
-          d2 = input_ptr[2 * stride];
-          d3 = input_ptr[3 * stride];
-
-          d4 = input_ptr[4 * stride];
-          d5 = input_ptr[5 * stride];
-          d6 = input_ptr[6 * stride];
-          d7 = input_ptr[7 * stride];
-
-          d8 = input_ptr[8 * stride];
-          d9 = input_ptr[9 * stride];
-          d10 = input_ptr[10 * stride];
-          d11 = input_ptr[11 * stride];
-
-          d12 = input_ptr[12 * stride];
-          d13 = input_ptr[13 * stride];
-          d14 = input_ptr[14 * stride];
-          d15 = input_ptr[15 * stride];
-
-          s0 = d0 + d1 + d2;
-          s1 = d1 - d2 - d3;
-          s2 = d4 + d5 + d6;
-          s3 = d5 - d6 - d7;
-          s4 = d8 + d9 + d10;
-          s5 = d9 - d10 - d11;
-          s6 = d12 + d13 + d14;
-          s7 = d13 - d14 - d15;
-
-          v0 = s0 + s2 + s4;
-          v1 = s1 + s3 + s5;
-          v2 = s2 - s4 - s6;
-          v3 = s3 - s5 - s7;
-
-          float *output_ptr = output + n * output_batch_size +
-                              m * out_image_size + h * out_width + w;
-          output_ptr[0] = v0;
-          output_ptr[1] = v1;
-          output_ptr[out_width] = v2;
-          output_ptr[out_width + 1] = v3;
-
-          ++tile_offset;
+#pragma omp parallel for collapse(3)
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t c = 0; c < in_channels; ++c) {
+      for (index_t s = 0; s < segments; ++s) {
+        const float *input_base = input + b * input_batch_size +
+                                  c * in_height_width + s * segment_step;
+        float *output_base = output + b * output_batch_size +
+                             (c * segments + s) * tile_count;
+        for (index_t l = 0; l < geometry.lines; ++l) {
+          for (index_t t0 = 0; t0 < geometry.line_tiles; t0 += kLanes) {
+            const index_t t = TileGroupStart(t0, geometry.line_tiles);
+            const index_t count = std::min(kLanes, geometry.line_tiles - t);
+            const float *input_ptr = input_base + l * geometry.line_step +
+                                     t * geometry.tile_step;
+            Reg d[n];
+            for (int i = 0; i < n; ++i) {
+              d[i] = LoadTiles(input_ptr + i * geometry.point_step,
+                               geometry.tile_step, count);
+            }
+            Reg v[n];
+            InputTransform<n>(d, 1, v, 1);
+            float *output_ptr = output_base + l * geometry.line_tiles + t;
+            for (int i = 0; i < n; ++i) {
+              StoreTiles(output_ptr + i * stride, 1, count, v[i]);
+            }
+          }
         }
       }
     }
   }
 }
 
-// NTOB => NToOB => NOHoWo
-/**
- * AT =
-⎡1  1  1   1    1   32  32   0⎤
-⎢                             ⎥
-⎢0  1  -1  2   -2   16  -16  0⎥
-⎢                             ⎥
-⎢0  1  1   4    4   8    8   0⎥
-⎢                             ⎥
-⎢0  1  -1  8   -8   4   -4   0⎥
-⎢                             ⎥
-⎢0  1  1   16  16   2    2   0⎥
-⎢                             ⎥
-⎣0  1  -1  32  -32  1   -1   1⎦
- *
- * @param input
- * @param batch
- * @param out_height
- * @param out_width
- * @param out_channels
- * @param tile_count
- * @param output
- */
-void TransformOutput8x8(const float *input,
-                        index_t batch,
-                        index_t out_height,
-                        index_t out_width,
-                        index_t out_channels,
-                        index_t tile_count,
-                        float *output) {
+// NTOB => NOHoWo of F(m, 9 - m)
+template <int m>
+void TransformOutput1D(const float *input,
+                       const index_t batch,
+                       const index_t out_height,
+                       const index_t out_width,
+                       const index_t out_channels,
+                       const bool horizontal,
+                       const index_t tile_count,
+                       const Epilogue *epilogue,
+                       float *output) {
+  const int n = 8;
+  const Winograd1DGeometry geometry(out_width, out_height, out_width, m,
+                                    horizontal);
   const index_t stride = out_channels * tile_count;
-  const index_t input_batch_size = 64 * stride;
+  const index_t input_batch_size = n * stride;
   const index_t out_image_size = out_height * out_width;
   const index_t output_batch_size = out_channels * out_image_size;
 
 #pragma omp parallel for collapse(2)
-  for (index_t n = 0; n < batch; ++n) {
-    for (index_t m = 0; m < out_channels; ++m) {
-      index_t tile_offset = 0;
-      float s[8][6];
-      for (index_t h = 0; h < out_height; h += 6) {
-        for (index_t w = 0; w < out_width; w += 6) {
-          const float *input_ptr =
-              input + n * input_batch_size + m * tile_count + tile_offset;
-          for (int i = 0; i < 8; ++i) {
-            float d0, d1, d2, d3, d4, d5, d6, d7;
-
-            d0 = input_ptr[0];
-            d1 = input_ptr[1 * stride];
-            d2 = input_ptr[2 * stride];
-            d3 = input_ptr[3 * stride];
-            d4 = input_ptr[4 * stride];
-            d5 = input_ptr[5 * stride];
-            d6 = input_ptr[6 * stride];
-            d7 = input_ptr[7 * stride];
-
-            float u = d1 + d2;
-            float v = d1 - d2;
-            float w = d3 + d4;
-            float x = d3 - d4;
-            float y = d5 + d6;
-            float z = d5 - d6;
-
-            s[i][0] = d0 + u + w + y * 32;
-            s[i][1] = v + x + x + z * 16;
-            s[i][2] = u + w * 4 + y * 8;
-            s[i][3] = v + x * 8 + z * 4;
-            s[i][4] = u + w * 16 + y + y;
-            s[i][5] = v + x * 32 + z + d7;
-
-            input_ptr += 8 * stride;
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t o = 0; o < out_channels; ++o) {
+      const float *input_base =
+          input + b * input_batch_size + o * tile_count;
+      float *output_base =
+          output + b * output_batch_size + o * out_image_size;
+      for (index_t l = 0; l < geometry.lines; ++l) {
+        for (index_t t0 = 0; t0 < geometry.line_tiles; t0 += kLanes) {
+          const index_t t = TileGroupStart(t0, geometry.line_tiles);
+          const index_t count = std::min(kLanes, geometry.line_tiles - t);
+          const float *input_ptr = input_base + l * geometry.line_tiles + t;
+          Reg s[n];
+          for (int i = 0; i < n; ++i) {
+            s[i] = LoadTiles(input_ptr + i * stride, 1, count);
           }
-
-          float *output_ptr = output + n * output_batch_size +
-                              m * out_image_size + h * out_width + w;
-
-          for (int i = 0; i < 6; ++i) {
-            float d0, d1, d2, d3, d4, d5, d6, d7;
-            d0 = s[0][i];
-            d1 = s[1][i];
-            d2 = s[2][i];
-            d3 = s[3][i];
-            d4 = s[4][i];
-            d5 = s[5][i];
-            d6 = s[6][i];
-            d7 = s[7][i];
-
-            float u = d1 + d2;
-            float v = d1 - d2;
-            float w = d3 + d4;
-            float x = d3 - d4;
-            float y = d5 + d6;
-            float z = d5 - d6;
-
-            output_ptr[i] = d0 + u + w + y * 32;
-            output_ptr[1 * out_width + i] = v + x + x + z * 16;
-            output_ptr[2 * out_width + i] = u + w * 4 + y * 8;
-            output_ptr[3 * out_width + i] = v + x * 8 + z * 4;
-            output_ptr[4 * out_width + i] = u + w * 16 + y + y;
-            output_ptr[5 * out_width + i] = v + x * 32 + z + d7;
+          Reg y[m];
+          OutputTransform<m, n>(s, 1, y, 1);
+          float *output_ptr = output_base + l * geometry.line_step +
+                              t * geometry.tile_step;
+          for (int i = 0; i < m; ++i) {
+            StoreTiles(output_ptr + i * geometry.point_step,
+                       geometry.tile_step, count, y[i]);
           }
-
-          ++tile_offset;
         }
       }
+      if (epilogue != nullptr) {
+        ApplyEpilogue(*epilogue, o, output_base, out_image_size,
+                      output_base);
+      }
     }
   }
 }
 }  // namespace
 
 // OCHW => TOC
-// no need to optimize, it will exist in converter
 void TransformFilter4x4(const float *filter,
                         const index_t in_channels,
                         const index_t out_channels,
                         float *output) {
-  const index_t stride = out_channels * in_channels;
-
-#pragma omp parallel for collapse(2)
-  for (index_t m = 0; m < out_channels; ++m) {
-    for (index_t c = 0; c < in_channels; ++c) {
-      float g0, g1, g2, g3, g4, g5, g6, g7, g8;
-      float s0, s1, s2, s3, s4, s5, s6, s7, s8, s9, s10, s11, s12, s13, s14,
-          s15;
-
-      // load filter
-      index_t filter_offset = (m * in_channels + c) * 9;
-      g0 = filter[filter_offset];
-      g1 = filter[filter_offset + 1];
-      g2 = filter[filter_offset + 2];
-      g3 = filter[filter_offset + 3];
-      g4 = filter[filter_offset + 4];
-      g5 = filter[filter_offset + 5];
-      g6 = filter[filter_offset + 6];
-      g7 = filter[filter_offset + 7];
-      g8 = filter[filter_offset + 8];
-
-      // s = G * g * GT
-      s0 = g0;
-      s1 = (g0 + g2 + g1) * 0.5f;
-      s2 = (g0 + g2 - g1) * 0.5f;
-      s3 = g2;
-      s4 = (g0 + g6 + g3) * 0.5f;
-      s5 = ((g0 + g6 + g3) + (g2 + g8 + g5) + (g1 + g7 + g4)) * 0.25f;
-      s6 = ((g0 + g6 + g3) + (g2 + g8 + g5) - (g1 + g7 + g4)) * 0.25f;
-      s7 = (g2 + g8 + g5) * 0.5f;
-      s8 = (g0 + g6 - g3) * 0.5f;
-      s9 = ((g0 + g6 - g3) + (g2 + g8 - g5) + (g1 + g7 - g4)) * 0.25f;
-      s10 = ((g0 + g6 - g3) + (g2 + g8 - g5) - (g1 + g7 - g4)) * 0.25f;
-      s11 = (g2 + g8 - g5) * 0.5f;
-      s12 = g6;
-      s13 = (g6 + g8 + g7) * 0.5f;
-      s14 = (g6 + g8 - g7) * 0.5f;
-      s15 = g8;
-
-      // store output
-      index_t output_offset = m * in_channels + c;
-      output[output_offset + 0 * stride] = s0;
-      output[output_offset + 1 * stride] = s1;
-      output[output_offset + 2 * stride] = s2;
-      output[output_offset + 3 * stride] = s3;
-
-      output[output_offset + 4 * stride] = s4;
-      output[output_offset + 5 * stride] = s5;
-      output[output_offset + 6 * stride] = s6;
-      output[output_offset + 7 * stride] = s7;
-
-      output[output_offset + 8 * stride] = s8;
-      output[output_offset + 9 * stride] = s9;
-      output[output_offset + 10 * stride] = s10;
-      output[output_offset + 11 * stride] = s11;
-
-      output[output_offset + 12 * stride] = s12;
-      output[output_offset + 13 * stride] = s13;
-      output[output_offset + 14 * stride] = s14;
-      output[output_offset + 15 * stride] = s15;
-    }
-  }
+  static const float G[4][3] = {{1.0f, 0.0f, 0.0f},
+                                {0.5f, 0.5f, 0.5f},
+                                {0.5f, -0.5f, 0.5f},
+                                {0.0f, 0.0f, 1.0f}};
+  TransformFilter2D<4>(filter, G, in_channels, out_channels, output);
 }
 
 // OCHW => TOC
-// no need to optimize, it will exist in converter
 /**
  * G =
-⎡ 1      0      0  ⎤
-⎢                  ⎥
-⎢-2/9  -2/9   -2/9 ⎥
-⎢                  ⎥
-⎢-2/9   2/9   -2/9 ⎥
+⎡ 1/4     0     0  ⎤
 ⎢                  ⎥
-⎢1/90  1/45   2/45 ⎥
+⎢-1/6   -1/6  -1/6 ⎥
 ⎢                  ⎥
-⎢1/90  -1/45  2/45 ⎥
+⎢-1/6    1/6  -1/6 ⎥
 ⎢                  ⎥
-⎢1/45  1/90   1/180⎥
+⎢1/24   1/12   1/6 ⎥
 ⎢                  ⎥
-⎢1/45  -1/90  1/180⎥
+⎢1/24  -1/12   1/6 ⎥
 ⎢                  ⎥
-⎣ 0      0      1  ⎦
- *
- * @param filter
- * @param in_channels
- * @param out_channels
- * @param output
+⎣ 0       0     1  ⎦
  */
-void TransformFilter8x8(const float *filter,
+void TransformFilter6x6(const float *filter,
                         const index_t in_channels,
                         const index_t out_channels,
                         float *output) {
-  const index_t stride = out_channels * in_channels;
+  static const float G[6][3] = {{1.0f / 4, 0.0f, 0.0f},
+                                {-1.0f / 6, -1.0f / 6, -1.0f / 6},
+                                {-1.0f / 6, 1.0f / 6, -1.0f / 6},
+                                {1.0f / 24, 1.0f / 12, 1.0f / 6},
+                                {1.0f / 24, -1.0f / 12, 1.0f / 6},
+                                {0.0f, 0.0f, 1.0f}};
+  TransformFilter2D<6>(filter, G, in_channels, out_channels, output);
+}
 
-  const float G[8][3] = {{1.0f, 0.0f, 0.0f},
-                         {-2.0f / 9, -2.0f / 9, -2.0f / 9},
-                         {-2.0f / 9, 2.0f / 9, -2.0f / 9},
-                         {1.0f / 90, 1.0f / 45, 2.0f / 45},
-                         {1.0f / 90, -1.0f / 45, 2.0f / 45},
-                         {1.0f / 45, 1.0f / 90, 1.0f / 180},
-                         {1.0f / 45, -1.0f / 90, 1.0f / 180},
-                         {0.0f, 0.0f, 1.0f}};
+// OCHW => TOC
+void TransformFilter8x8(const float *filter,
+                        const index_t in_channels,
+                        const index_t out_channels,
+                        float *output) {
+  float G[8][3];
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j < 3; ++j) {
+      G[i][j] = G8(i, j, 3);
+    }
+  }
+  TransformFilter2D<8>(filter, G, in_channels, out_channels, output);
+}
 
-#pragma omp parallel for collapse(2)
-  for (index_t m = 0; m < out_channels; ++m) {
-    for (index_t c = 0; c < in_channels; ++c) {
-      // load filter
-      index_t filter_offset = (m * in_channels + c) * 9;
-      float g0, g1, g2, g3, g4, g5, g6, g7, g8;
-      g0 = filter[filter_offset];
-      g1 = filter[filter_offset + 1];
-      g2 = filter[filter_offset + 2];
-      g3 = filter[filter_offset + 3];
-      g4 = filter[filter_offset + 4];
-      g5 = filter[filter_offset + 5];
-      g6 = filter[filter_offset + 6];
-      g7 = filter[filter_offset + 7];
-      g8 = filter[filter_offset + 8];
-
-      float s[3][8];
-      for (int i = 0; i < 8; ++i) {
-        s[0][i] = g0 * G[i][0] + g1 * G[i][1] + g2 * G[i][2];
-        s[1][i] = g3 * G[i][0] + g4 * G[i][1] + g5 * G[i][2];
-        s[2][i] = g6 * G[i][0] + g7 * G[i][1] + g8 * G[i][2];
-      }
+index_t WinogradInTileArea(const index_t out_tile_size) {
+  switch (out_tile_size) {
+    case 2:
+    case 4:
+    case 6:
+      return (out_tile_size + 2) * (out_tile_size + 2);
+    default:
+      return 0;
+  }
+}
 
-      // store output
-      index_t output_offset = m * in_channels + c;
-      for (int i = 0; i < 8; ++i) {
-        for (int j = 0; j < 8; ++j) {
-          output[output_offset + (i * 8 + j) * stride] =
-              G[i][0] * s[0][j] + G[i][1] * s[1][j] + G[i][2] * s[2][j];
-        }
-      }
-    }
+void WinogradTransformFilter(const float *filter,
+                             const index_t in_channels,
+                             const index_t out_channels,
+                             const int out_tile_size,
+                             float *output) {
+  switch (out_tile_size) {
+    case 2:
+      TransformFilter4x4(filter, in_channels, out_channels, output);
+      break;
+    case 4:
+      TransformFilter6x6(filter, in_channels, out_channels, output);
+      break;
+    case 6:
+      TransformFilter8x8(filter, in_channels, out_channels, output);
+      break;
+    default:
+      MACE_NOT_IMPLEMENTED;
   }
 }
 
@@ -611,41 +700,56 @@ void WinoGradConv3x3s1(const float *input,
                        const index_t in_channels,
                        const index_t out_channels,
                        const int out_tile_size,
+                       const bool is_filter_packed,
+                       const Epilogue *epilogue,
                        float *transformed_input,
                        float *transformed_output,
                        float *output) {
   index_t out_height = in_height - 2;
   index_t out_width = in_width - 2;
-  index_t tile_height_count =
-      RoundUpDiv(out_height, static_cast<index_t>(out_tile_size));
-  index_t tile_width_count =
-      RoundUpDiv(out_width, static_cast<index_t>(out_tile_size));
-  index_t tile_count = tile_height_count * tile_width_count;
+  MACE_CHECK(out_height % out_tile_size == 0 &&
+             out_width % out_tile_size == 0,
+             "winograd output ", out_height, "x", out_width,
+             " is not made of ", out_tile_size, "x", out_tile_size, " tiles");
+  index_t tile_count = (out_height / out_tile_size) *
+                       (out_width / out_tile_size);
 
   switch (out_tile_size) {
     case 2:
-      TransformInput4x4(input, batch, in_height, in_width, in_channels,
+      TransformInput<2>(input, batch, in_height, in_width, in_channels,
+                        tile_count, transformed_input);
+      break;
+    case 4:
+      TransformInput<4>(input, batch, in_height, in_width, in_channels,
                         tile_count, transformed_input);
       break;
     case 6:
-      TransformInput8x8(input, batch, in_height, in_width, in_channels,
+      TransformInput<6>(input, batch, in_height, in_width, in_channels,
                         tile_count, transformed_input);
       break;
     default:
       MACE_NOT_IMPLEMENTED;
   }
 
-  BatchGemm(transformed_input, transformed_filter, batch, in_channels,
-            out_channels, tile_count, out_tile_size, transformed_output);
+  // TOC * NTCB => NTOB, the filter of each tile position is shared by the
+  // images of the batch
+  const index_t in_tile_area = (out_tile_size + 2) * (out_tile_size + 2);
+  BatchGemm(transformed_filter, transformed_input, batch * in_tile_area,
+            in_tile_area, out_channels, in_channels, tile_count,
+            transformed_output, false, false, is_filter_packed);
 
   switch (out_tile_size) {
     case 2:
-      TransformOutput4x4(transformed_output, batch, out_height, out_width,
-                         out_channels, tile_count, output);
+      TransformOutput<2>(transformed_output, batch, out_height, out_width,
+                         out_channels, tile_count, epilogue, output);
+      break;
+    case 4:
+      TransformOutput<4>(transformed_output, batch, out_height, out_width,
+                         out_channels, tile_count, epilogue, output);
       break;
     case 6:
-      TransformOutput8x8(transformed_output, batch, out_height, out_width,
-                         out_channels, tile_count, output);
+      TransformOutput<6>(transformed_output, batch, out_height, out_width,
+                         out_channels, tile_count, epilogue, output);
       break;
     default:
       MACE_NOT_IMPLEMENTED;
@@ -668,7 +772,7 @@ void WinoGradConv3x3s1(const float *input,
   index_t tile_width_count =
       RoundUpDiv(out_width, static_cast<index_t>(out_tile_size));
   index_t tile_count = tile_height_count * tile_width_count;
-  index_t in_tile_area = (out_tile_size + 2) * (out_tile_size + 2);
+  index_t in_tile_area = WinogradInTileArea(out_tile_size);
   index_t transformed_input_size =
       in_tile_area * batch * in_channels * tile_count;
   index_t transformed_filter_size = in_tile_area * out_channels * in_channels;
@@ -679,24 +783,135 @@ void WinoGradConv3x3s1(const float *input,
   float *transformed_filter = new float[transformed_filter_size];  // TOC
   float *transformed_output = new float[transformed_output_size];
 
+  WinogradTransformFilter(filter, in_channels, out_channels, out_tile_size,
+                          transformed_filter);
+
+  WinoGradConv3x3s1(input, transformed_filter, batch, in_height, in_width,
+                    in_channels, out_channels, out_tile_size, false, nullptr,
+                    transformed_input, transformed_output, output);
+
+  delete[] transformed_input;
+  delete[] transformed_filter;
+  delete[] transformed_output;
+}
+
+index_t Winograd1DOutTileSize(const index_t filter_size) {
+  switch (filter_size) {
+    case 7:
+      return 2;
+    case 15:
+      return 4;
+    default:
+      return 0;
+  }
+}
+
+index_t Winograd1DSegments(const index_t filter_size) {
+  const index_t out_tile_size = Winograd1DOutTileSize(filter_size);
+  return out_tile_size == 0 ? 0 : filter_size / (9 - out_tile_size);
+}
+
+// OIHW => TOC of the segments of each input channel, the filter is 1 x r or
+// r x 1, so its taps are contiguous either way.
+void TransformFilter1D(const float *filter,
+                       const index_t in_channels,
+                       const index_t out_channels,
+                       const index_t filter_size,
+                       float *output) {
+  const index_t out_tile_size = Winograd1DOutTileSize(filter_size);
+  MACE_CHECK(out_tile_size > 0, "no winograd of ", filter_size, " taps");
+  const index_t segments = Winograd1DSegments(filter_size);
+  const int taps = static_cast<int>(9 - out_tile_size);
+  const index_t channels = in_channels * segments;
+  const index_t stride = out_channels * channels;
+  float G[8][8];
+  for (int i = 0; i < 8; ++i) {
+    for (int j = 0; j < taps; ++j) {
+      G[i][j] = G8(i, j, taps);
+    }
+  }
+
+#pragma omp parallel for collapse(3)
+  for (index_t m = 0; m < out_channels; ++m) {
+    for (index_t s = 0; s < segments; ++s) {
+      for (index_t c = 0; c < in_channels; c += kLanes) {
+        const index_t count = std::min(kLanes, in_channels - c);
+        const float *filter_ptr =
+            filter + (m * in_channels + c) * filter_size + s * taps;
+        Reg g[8];
+        for (int j = 0; j < taps; ++j) {
+          g[j] = LoadTiles(filter_ptr + j, filter_size, count);
+        }
+        float *output_ptr = output + m * channels + c * segments + s;
+        for (int i = 0; i < 8; ++i) {
+          Reg t = Float4::Zero();
+          for (int j = 0; j < taps; ++j) {
+            t = ScaleAdd(g[j], G[i][j], t);
+          }
+          StoreTiles(output_ptr + i * stride, segments, count, t);
+        }
+      }
+    }
+  }
+}
+
+void WinogradConv1D(const float *input,
+                    const float *transformed_filter,
+                    const index_t batch,
+                    const index_t in_height,
+                    const index_t in_width,
+                    const index_t in_channels,
+                    const index_t out_channels,
+                    const index_t filter_size,
+                    const bool horizontal,
+                    const bool is_filter_packed,
+                    const Epilogue *epilogue,
+                    float *transformed_input,
+                    float *transformed_output,
+                    float *output) {
+  const index_t out_tile_size = Winograd1DOutTileSize(filter_size);
+  const index_t segments = Winograd1DSegments(filter_size);
+  const index_t out_height =
+      horizontal ? in_height : in_height - filter_size + 1;
+  const index_t out_width = horizontal ? in_width - filter_size + 1 : in_width;
+  const index_t tiled_size = horizontal ? out_width : out_height;
+  MACE_CHECK(out_tile_size > 0 && tiled_size % out_tile_size == 0,
+             "winograd output ", tiled_size, " of ", filter_size,
+             " taps is not made of ", out_tile_size, " tiles");
+  const index_t tile_count = out_height * out_width / out_tile_size;
+
   switch (out_tile_size) {
     case 2:
-      TransformFilter4x4(filter, in_channels, out_channels, transformed_filter);
+      TransformInput1D<2>(input, batch, in_height, in_width, in_channels,
+                          segments, horizontal, tile_count, transformed_input);
       break;
-    case 6:
-      TransformFilter8x8(filter, in_channels, out_channels, transformed_filter);
+    case 4:
+      TransformInput1D<4>(input, batch, in_height, in_width, in_channels,
+                          segments, horizontal, tile_count, transformed_input);
       break;
     default:
       MACE_NOT_IMPLEMENTED;
   }
 
-  WinoGradConv3x3s1(input, transformed_filter, batch, in_height, in_width,
-                    in_channels, out_channels, out_tile_size, transformed_input,
-                    transformed_output, output);
+  // the segments sum up in the gemm
+  BatchGemm(transformed_filter, transformed_input, batch * 8, 8, out_channels,
+            in_channels * segments, tile_count, transformed_output, false,
+            false, is_filter_packed);
 
-  delete[] transformed_input;
-  delete[] transformed_filter;
-  delete[] transformed_output;
+  switch (out_tile_size) {
+    case 2:
+      TransformOutput1D<2>(transformed_output, batch, out_height, out_width,
+                           out_channels, horizontal, tile_count, epilogue,
+                           output);
+      break;
+    case 4:
+      TransformOutput1D<4>(transformed_output, batch, out_height, out_width,
+                           out_channels, horizontal, tile_count, epilogue,
+                           output);
+      break;
+    default:
+      MACE_NOT_IMPLEMENTED;
+  }
 }
 
 void ConvRef3x3s1(const float *input,
@@ -20,20 +20,37 @@
 #endif
 
 #include "mace/core/types.h"
+#include "mace/kernels/epilogue.h"
 
 namespace mace {
 namespace kernels {
 
+// Winograd F(m x m, 3 x 3) of output tiles of m = 2, 4 or 6, whose filter
+// is transformed from OIHW to TOC, T: the (m + 2)^2 input tile pixels.
 void TransformFilter4x4(const float *filter,
                         const index_t in_channels,
                         const index_t out_channels,
                         float *output);
 
+void TransformFilter6x6(const float *filter,
+                        const index_t in_channels,
+                        const index_t out_channels,
+                        float *output);
+
 void TransformFilter8x8(const float *filter,
                         const index_t in_channels,
                         const index_t out_channels,
                         float *output);
 
+// (m + 2)^2, 0 if there is no winograd of output tile size m
+index_t WinogradInTileArea(const index_t out_tile_size);
+
+void WinogradTransformFilter(const float *filter,
+                             const index_t in_channels,
+                             const index_t out_channels,
+                             const int out_tile_size,
+                             float *output);
+
 void WinoGradConv3x3s1(const float *input,
                        const float *filter,
                        const index_t batch,
@@ -44,6 +61,9 @@ void WinoGradConv3x3s1(const float *input,
                        const int out_tile_size,
                        float *output);
 
+// transformed_filter is packed by PackGemmA when is_filter_packed is set, the
+// epilogue, if any, is applied to each output channel as it is transformed.
+// The output, in_height - 2 x in_width - 2, is made of whole tiles.
 void WinoGradConv3x3s1(const float *input,
                        const float *transformed_filter,
                        const index_t batch,
@@ -52,10 +72,46 @@ void WinoGradConv3x3s1(const float *input,
                        const index_t in_channels,
                        const index_t out_channels,
                        const int out_tile_size,
+                       const bool is_filter_packed,
+                       const Epilogue *epilogue,
                        float *transformed_input,
                        float *transformed_output,
                        float *output);
 
+// Winograd F(m, r) of 8 points along the width of 1 x r filters or the height
+// of r x 1 ones, F(2, 7) for 7 taps and F(4, 5) for 15 taps, summing 3
+// segments of 5 taps, 0 if there is none for filter_size taps.
+index_t Winograd1DOutTileSize(const index_t filter_size);
+
+// The tap segments of the filter, each adds in_channels to the gemm.
+index_t Winograd1DSegments(const index_t filter_size);
+
+// OIHW => TOC, T: the 8 points, C: in_channels * segments.
+void TransformFilter1D(const float *filter,
+                       const index_t in_channels,
+                       const index_t out_channels,
+                       const index_t filter_size,
+                       float *output);
+
+// The convolution of the filter along the width if horizontal, else along
+// the height, whose output size is made of whole tiles. transformed_input
+// holds 8 * batch * in_channels * segments * tiles floats, and
+// transformed_output 8 * batch * out_channels * tiles.
+void WinogradConv1D(const float *input,
+                    const float *transformed_filter,
+                    const index_t batch,
+                    const index_t in_height,
+                    const index_t in_width,
+                    const index_t in_channels,
+                    const index_t out_channels,
+                    const index_t filter_size,
+                    const bool horizontal,
+                    const bool is_filter_packed,
+                    const Epilogue *epilogue,
+                    float *transformed_input,
+                    float *transformed_output,
+                    float *output);
+
 void ConvRef3x3s1(const float *input,
                   const float *filter,
                   const index_t batch,
@@ -14,64 +14,133 @@
 
 #include <gtest/gtest.h>
 #include <algorithm>
-#include <memory>
 #include <random>
+#include <vector>
 
-#include "mace/core/tensor.h"
 #include "mace/core/types.h"
 #include "mace/kernels/arm/conv_winograd.h"
 
 namespace mace {
 namespace kernels {
 
-TEST(ConvWinogradTest, winograd) {
-  index_t batch = 1;
-  index_t in_height = 32;
-  index_t in_width = 32;
-  index_t in_channels = 64;
-  index_t out_channels = 128;
-
-  index_t out_height = in_height - 2;
-  index_t out_width = in_width - 2;
-  index_t input_size = batch * in_channels * in_height * in_width;
-  index_t filter_size = 3 * 3 * in_channels * out_channels;
-  index_t output_size = batch * out_channels * out_height * out_width;
-
-  Tensor input;
-  Tensor filter;
-  Tensor output;
-  Tensor output_ref;
-
-  input.Resize({batch, in_channels, in_height, in_width});
-  filter.Resize({out_channels, in_channels, 3, 3});
-  output.Resize({batch, out_channels, out_height, out_width});
-  output_ref.Resize({batch, out_channels, out_height, out_width});
-
-  float *input_data = input.mutable_data<float>();
-  float *filter_data = filter.mutable_data<float>();
-  float *output_data = output.mutable_data<float>();
-  float *output_data_ref = output.mutable_data<float>();
+namespace {
 
+void RandomFill(std::vector<float> *data) {
   std::random_device rd;
   std::mt19937 gen(rd());
   std::normal_distribution<float> nd(0, 1);
-  std::generate(input_data, input_data + input_size, [&gen, &nd] {
-    return std::max(-1.0f, std::min(1.0f, nd(gen)));
-  });
-  std::generate(filter_data, filter_data + filter_size, [&gen, &nd] {
+  std::generate(data->begin(), data->end(), [&gen, &nd] {
     return std::max(-1.0f, std::min(1.0f, nd(gen)));
   });
+}
+
+void WinogradTest(const index_t batch,
+                  const index_t in_height,
+                  const index_t in_width,
+                  const index_t in_channels,
+                  const index_t out_channels,
+                  const int out_tile_size) {
+  const index_t out_height = in_height - 2;
+  const index_t out_width = in_width - 2;
+  std::vector<float> input(batch * in_channels * in_height * in_width);
+  std::vector<float> filter(out_channels * in_channels * 9);
+  std::vector<float> output(batch * out_channels * out_height * out_width);
+  std::vector<float> output_ref(output.size());
+  RandomFill(&input);
+  RandomFill(&filter);
 
-  kernels::ConvRef3x3s1(input_data, filter_data, batch, in_height, in_width,
-                        in_channels, out_channels, output_data_ref);
+  ConvRef3x3s1(input.data(), filter.data(), batch, in_height, in_width,
+               in_channels, out_channels, output_ref.data());
+  WinoGradConv3x3s1(input.data(), filter.data(), batch, in_height, in_width,
+                    in_channels, out_channels, out_tile_size, output.data());
 
-  kernels::WinoGradConv3x3s1(input_data, filter_data, batch, in_height,
-                             in_width, in_channels, out_channels, 6,
-                             output_data);
+  for (size_t i = 0; i < output.size(); ++i) {
+    EXPECT_NEAR(output_ref[i], output[i], 1e-3 * in_channels)
+        << "F(" << out_tile_size << ", 3) index " << i;
+  }
+}
+
+// The convolution of a 1 x filter_size filter if horizontal, else of a
+// filter_size x 1 one, with a bias and relu.
+void Winograd1DTest(const index_t batch,
+                    const index_t in_height,
+                    const index_t in_width,
+                    const index_t in_channels,
+                    const index_t out_channels,
+                    const index_t filter_size,
+                    const bool horizontal) {
+  const index_t out_height =
+      horizontal ? in_height : in_height - filter_size + 1;
+  const index_t out_width = horizontal ? in_width - filter_size + 1 : in_width;
+  const index_t out_image_size = out_height * out_width;
+  const index_t segments = Winograd1DSegments(filter_size);
+  const index_t tile_count =
+      out_image_size / Winograd1DOutTileSize(filter_size);
+  std::vector<float> input(batch * in_channels * in_height * in_width);
+  std::vector<float> filter(out_channels * in_channels * filter_size);
+  std::vector<float> bias(out_channels);
+  RandomFill(&input);
+  RandomFill(&filter);
+  RandomFill(&bias);
+  std::vector<float> transformed_filter(8 * filter.size() / filter_size *
+                                        segments);
+  std::vector<float> transformed_input(8 * batch * in_channels * segments *
+                                       tile_count);
+  std::vector<float> transformed_output(8 * batch * out_channels *
+                                        tile_count);
+  std::vector<float> output(batch * out_channels * out_image_size);
+
+  const Epilogue epilogue(bias.data(), RELU, 0);
+  TransformFilter1D(filter.data(), in_channels, out_channels, filter_size,
+                    transformed_filter.data());
+  WinogradConv1D(input.data(), transformed_filter.data(), batch, in_height,
+                 in_width, in_channels, out_channels, filter_size, horizontal,
+                 false, &epilogue, transformed_input.data(),
+                 transformed_output.data(), output.data());
+
+  const index_t tap_step = horizontal ? 1 : in_width;
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t m = 0; m < out_channels; ++m) {
+      for (index_t h = 0; h < out_height; ++h) {
+        for (index_t w = 0; w < out_width; ++w) {
+          float sum = 0;
+          for (index_t c = 0; c < in_channels; ++c) {
+            const float *input_ptr = input.data() +
+                ((b * in_channels + c) * in_height + h) * in_width + w;
+            const float *filter_ptr =
+                filter.data() + (m * in_channels + c) * filter_size;
+            for (index_t k = 0; k < filter_size; ++k) {
+              sum += input_ptr[k * tap_step] * filter_ptr[k];
+            }
+          }
+          const index_t i = (b * out_channels + m) * out_image_size +
+                            h * out_width + w;
+          EXPECT_NEAR(ApplyEpilogue(epilogue, m, sum), output[i],
+                      1e-3 * in_channels)
+              << filter_size << (horizontal ? " wide" : " high") << " index "
+              << i;
+        }
+      }
+    }
+  }
+}
+
+}  // namespace
+
+TEST(ConvWinogradTest, winograd) {
+  for (int out_tile_size : {2, 4, 6}) {
+    WinogradTest(1, 26, 26, 64, 128, out_tile_size);
+    // rows of tiles not made of whole vectors
+    WinogradTest(2, 14, 38, 3, 5, out_tile_size);
+  }
+}
 
-  // test
-  for (index_t i = 0; i < output_size; ++i) {
-    EXPECT_NEAR(output_data_ref[i], output_data[i], 0.1) << " with index " << i;
+TEST(ConvWinogradTest, winograd1D) {
+  for (bool horizontal : {true, false}) {
+    Winograd1DTest(1, 18, 18, 32, 16, 7, horizontal);
+    Winograd1DTest(2, 8, 20, 3, 5, 7, horizontal);
+    Winograd1DTest(1, 30, 30, 16, 8, 15, horizontal);
+    Winograd1DTest(2, 22, 26, 3, 5, 15, horizontal);
   }
 }
 
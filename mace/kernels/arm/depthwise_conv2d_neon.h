@@ -16,10 +16,12 @@
 #define MACE_KERNELS_ARM_DEPTHWISE_CONV2D_NEON_H_
 
 #include "mace/core/types.h"
+#include "mace/kernels/epilogue.h"
 
 namespace mace {
 namespace kernels {
 
+// The epilogue, if any, is applied to each finished output channel.
 void DepthwiseConv2dNeonK3x3S1(const float *input,
                                const float *filter,
                                const index_t *in_shape,
@@ -29,6 +31,7 @@ void DepthwiseConv2dNeonK3x3S1(const float *input,
                                const index_t valid_h_stop,
                                const index_t valid_w_start,
                                const index_t valid_w_stop,
+                               const Epilogue *epilogue,
                                float *output);
 
 void DepthwiseConv2dNeonK3x3S2(const float *input,
@@ -40,6 +43,7 @@ void DepthwiseConv2dNeonK3x3S2(const float *input,
                                const index_t valid_h_stop,
                                const index_t valid_w_start,
                                const index_t valid_w_stop,
+                               const Epilogue *epilogue,
                                float *output);
 
 }  // namespace kernels
@@ -59,6 +59,7 @@ void DepthwiseConv2dNeonK3x3S1(const float *input,
                                const index_t valid_h_stop,
                                const index_t valid_w_start,
                                const index_t valid_w_stop,
+                               const Epilogue *epilogue,
                                float *output) {
 #if !defined(MACE_ENABLE_NEON)
   MACE_UNUSED(valid_w_start);
@@ -226,6 +227,9 @@ void DepthwiseConv2dNeonK3x3S1(const float *input,
                                3, out_base);
         }
       }
+      if (epilogue != nullptr) {
+        ApplyEpilogue(*epilogue, m, out_base, out_image_size, out_base);
+      }
     }  // m
   }    // b
 }
@@ -239,6 +243,7 @@ void DepthwiseConv2dNeonK3x3S2(const float *input,
                                const index_t valid_h_stop,
                                const index_t valid_w_start,
                                const index_t valid_w_stop,
+                               const Epilogue *epilogue,
                                float *output) {
 #if !defined(MACE_ENABLE_NEON)
   MACE_UNUSED(valid_w_start);
@@ -377,6 +382,9 @@ void DepthwiseConv2dNeonK3x3S2(const float *input,
                                3, 3, out_base);
         }
       }
+      if (epilogue != nullptr) {
+        ApplyEpilogue(*epilogue, m, out_base, out_image_size, out_base);
+      }
     }  // m
   }    // b
 }
@@ -27,8 +27,13 @@
 #include "mace/core/tensor.h"
 #include "mace/kernels/activation.h"
 #include "mace/kernels/conv_pool_2d_util.h"
+#include "mace/kernels/cpu_blocking.h"
+#include "mace/kernels/cpu_dispatch.h"
 #include "mace/kernels/arm/conv_2d_neon.h"
 #include "mace/kernels/arm/conv_winograd.h"
+#include "mace/kernels/conv_2d_gemm.h"
+#include "mace/kernels/gemm.h"
+#include "mace/kernels/sparse_gemm.h"
 #include "mace/utils/utils.h"
 
 #ifdef MACE_ENABLE_OPENCL
@@ -52,6 +57,19 @@ struct Conv2dFunctorBase {
       activation_(activation),
       relux_max_limit_(relux_max_limit) {}
 
+  // Prepares the constant data before the first run, given the output shape
+  // recorded by the converter, empty if unknown, and the rows of the sparse
+  // blocks of a pruned filter, 0 if dense. May run concurrently with other
+  // functors.
+  MaceStatus Prepare(const Tensor *filter,
+                     const std::vector<index_t> &output_shape,
+                     const int sparse_block_rows) {
+    MACE_UNUSED(filter);
+    MACE_UNUSED(output_shape);
+    MACE_UNUSED(sparse_block_rows);
+    return MACE_SUCCESS;
+  }
+
   const int *strides_;  // [stride_h, stride_w]
   const Padding padding_type_;
   std::vector<int> paddings_;
@@ -80,180 +98,140 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
                         activation,
                         relux_max_limit),
       is_filter_transformed_(is_filter_transformed),
+      transformed_filter_tile_size_(0),
+      is_filter_packed_(false),
       scratch_(scratch) {}
 
-  void Conv2dGeneral(const float *input,
-                     const float *filter,
-                     const index_t *in_shape,
-                     const index_t *out_shape,
-                     const index_t *filter_shape,
-                     const int *stride_hw,
-                     const int *dilation_hw,
-                     float *output) {
-    const index_t in_image_size = in_shape[2] * in_shape[3];
-    const index_t out_image_size = out_shape[2] * out_shape[3];
-    const index_t in_batch_size = filter_shape[1] * in_image_size;
-    const index_t out_batch_size = filter_shape[0] * out_image_size;
-    const index_t filter_size = filter_shape[2] * filter_shape[3];
+  // Winograd output tile size, 0 if winograd is not used.
+  index_t WinogradOutTileSize(const std::vector<index_t> &filter_shape,
+                              index_t input_height,
+                              index_t input_width) const {
+    const bool use_winograd = is_filter_transformed_ ||
+        (filter_shape[2] == 3 && filter_shape[3] == 3 &&
+         strides_[0] == 1 && strides_[1] == 1 &&
+         dilations_[0] == 1 && dilations_[1] == 1 &&
+         filter_shape[1] >= 8 && filter_shape[0] >= 8);
+    if (!use_winograd) return 0;
+    // When size of input feature map is bigger than 16x16,
+    // set winograd out tile size to 6 to get higher performance.
+    return input_height > 16 && input_width > 16 ? 6 : 2;
+  }
 
-#pragma omp parallel for collapse(2)
-    for (index_t b = 0; b < in_shape[0]; b++) {
-      for (index_t m = 0; m < filter_shape[0]; m += 4) {
-        const index_t in_width = in_shape[3];
-        const index_t out_height = out_shape[2];
-        const index_t out_width = out_shape[3];
-        const index_t out_channels = filter_shape[0];
-        const index_t in_channels = filter_shape[1];
-
-        const int stride_h = stride_hw[0];
-        const int stride_w = stride_hw[1];
-        const int dilation_h = dilation_hw[0];
-        const int dilation_w = dilation_hw[1];
-        if (m + 3 < out_channels) {
-          float *out_ptr0_base =
-              output + b * out_batch_size + m * out_image_size;
-          float *out_ptr1_base = out_ptr0_base + out_image_size;
-          float *out_ptr2_base = out_ptr1_base + out_image_size;
-          float *out_ptr3_base = out_ptr2_base + out_image_size;
-          for (index_t c = 0; c < in_channels; ++c) {
-            const float *in_ptr_base =
-                input + b * in_batch_size + c * in_image_size;
-            const float *filter_ptr0 =
-                filter + m * in_channels * filter_size + c * filter_size;
-            const float *filter_ptr1 = filter_ptr0 + in_channels * filter_size;
-            const float *filter_ptr2 = filter_ptr1 + in_channels * filter_size;
-            const float *filter_ptr3 = filter_ptr2 + in_channels * filter_size;
-            for (index_t h = 0; h < out_height; ++h) {
-              for (index_t w = 0; w + 3 < out_width; w += 4) {
-                 // input offset
-                index_t ih = h * stride_h;
-                index_t iw = w * stride_w;
-                index_t in_offset = ih * in_width + iw;
-                // output (4 outch x 1 height x 4 width): vo_outch_height
-                float vo0[4], vo1[4], vo2[4], vo3[4];
-                // load output
-                index_t out_offset = h * out_width + w;
-                for (index_t ow = 0; ow < 4; ++ow) {
-                   vo0[ow] = out_ptr0_base[out_offset + ow];
-                   vo1[ow] = out_ptr1_base[out_offset + ow];
-                   vo2[ow] = out_ptr2_base[out_offset + ow];
-                   vo3[ow] = out_ptr3_base[out_offset + ow];
-                }
-                // calc by row
-                for (index_t kh = 0; kh < filter_shape[2]; ++kh) {
-                  for (index_t kw = 0; kw < filter_shape[3]; ++kw) {
-                    // outch 0
-                    vo0[0] += in_ptr_base[in_offset
-                        + kw * dilation_w] * filter_ptr0[kw];
-                    vo0[1] += in_ptr_base[in_offset + stride_w
-                        + kw * dilation_w] * filter_ptr0[kw];
-                    vo0[2] += in_ptr_base[in_offset + 2 * stride_w
-                        + kw * dilation_w] * filter_ptr0[kw];
-                    vo0[3] += in_ptr_base[in_offset + 3 * stride_w
-                        + kw * dilation_w] * filter_ptr0[kw];
-                    // outch 1
-                    vo1[0] += in_ptr_base[in_offset
-                        + kw * dilation_w] * filter_ptr1[kw];
-                    vo1[1] += in_ptr_base[in_offset + stride_w
-                        + kw * dilation_w] * filter_ptr1[kw];
-                    vo1[2] += in_ptr_base[in_offset + 2 * stride_w
-                        + kw * dilation_w] * filter_ptr1[kw];
-                    vo1[3] += in_ptr_base[in_offset + 3 * stride_w
-                        + kw * dilation_w] * filter_ptr1[kw];
-                    // outch 2
-                    vo2[0] += in_ptr_base[in_offset
-                        + kw * dilation_w] * filter_ptr2[kw];
-                    vo2[1] += in_ptr_base[in_offset + stride_w
-                        + kw * dilation_w] * filter_ptr2[kw];
-                    vo2[2] += in_ptr_base[in_offset + 2 * stride_w
-                        + kw * dilation_w] * filter_ptr2[kw];
-                    vo2[3] += in_ptr_base[in_offset + 3 * stride_w
-                        + kw * dilation_w] * filter_ptr2[kw];
-                    // outch 3
-                    vo3[0] += in_ptr_base[in_offset
-                        + kw * dilation_w] * filter_ptr3[kw];
-                    vo3[1] += in_ptr_base[in_offset + stride_w
-                        + kw * dilation_w] * filter_ptr3[kw];
-                    vo3[2] += in_ptr_base[in_offset + 2 * stride_w
-                        + kw * dilation_w] * filter_ptr3[kw];
-                    vo3[3] += in_ptr_base[in_offset + 3 * stride_w
-                        + kw * dilation_w] * filter_ptr3[kw];
-                  }  // kw
-
-                  in_offset += dilation_h * in_width;
-                  filter_ptr0 += filter_shape[3];
-                  filter_ptr1 += filter_shape[3];
-                  filter_ptr2 += filter_shape[3];
-                  filter_ptr3 += filter_shape[3];
-                }  // kh
-
-                for (index_t ow = 0; ow < 4; ++ow) {
-                  out_ptr0_base[out_offset + ow] = vo0[ow];
-                  out_ptr1_base[out_offset + ow] = vo1[ow];
-                  out_ptr2_base[out_offset + ow] = vo2[ow];
-                  out_ptr3_base[out_offset + ow] = vo3[ow];
-                }
-
-                filter_ptr0 -= filter_size;
-                filter_ptr1 -= filter_size;
-                filter_ptr2 -= filter_size;
-                filter_ptr3 -= filter_size;
-              }  // w
-            }  // h
-          }  // c
-        } else {
-          for (index_t mm = m; mm < out_channels; ++mm) {
-            float *out_ptr0_base =
-                output + b * out_batch_size + mm * out_image_size;
-            for (index_t c = 0; c < in_channels; ++c) {
-              const float *in_ptr_base =
-                  input + b * in_batch_size + c * in_image_size;
-              const float *filter_ptr0 =
-                  filter + mm * in_channels * filter_size + c * filter_size;
-
-              for (index_t h = 0; h < out_height; ++h) {
-                for (index_t w = 0; w + 3 < out_width; w += 4) {
-                  // input offset
-                  index_t ih = h * stride_h;
-                  index_t iw = w * stride_w;
-                  index_t in_offset = ih * in_width + iw;
-                  // output (1 outch x 1 height x 4 width): vo_outch_height
-                  float vo0[4];
-                  // load output
-                  index_t out_offset = h * out_width + w;
-                  for (index_t ow = 0; ow < 4; ++ow) {
-                     vo0[ow] = out_ptr0_base[out_offset + ow];
-                  }
-
-                  // calc by row
-                  for (index_t kh = 0; kh < filter_shape[2]; ++kh) {
-                    for (index_t kw = 0; kw < filter_shape[3]; ++kw) {
-                      // outch 0
-                      vo0[0] += in_ptr_base[in_offset
-                          + kw * dilation_w] * filter_ptr0[kw];
-                      vo0[1] += in_ptr_base[in_offset + stride_w
-                          + kw * dilation_w] * filter_ptr0[kw];
-                      vo0[2] += in_ptr_base[in_offset + 2 * stride_w
-                          + kw * dilation_w] * filter_ptr0[kw];
-                      vo0[3] += in_ptr_base[in_offset + 3 * stride_w
-                          + kw * dilation_w] * filter_ptr0[kw];
-                    }  // kw
-
-                    in_offset += dilation_h * in_width;
-                    filter_ptr0 += filter_shape[3];
-                  }  // kh
-
-                  for (index_t ow = 0; ow < 4; ++ow) {
-                    out_ptr0_base[out_offset + ow] = vo0[ow];
-                  }
-                  filter_ptr0 -= filter_size;
-                }  // w
-              }  // h
-            }  // c
-          }  // mm
-        }  // if
-      }  // m
-    }  // b
+  MaceStatus TransformFilter(const float *filter_data,
+                             const std::vector<index_t> &filter_shape,
+                             index_t out_tile_size) {
+    const index_t in_tile_area = (out_tile_size + 2) * (out_tile_size + 2);
+    Tensor transformed_filter;
+    MACE_RETURN_IF_ERROR(transformed_filter.Resize(
+        {in_tile_area, filter_shape[0], filter_shape[1]}));
+    switch (out_tile_size) {
+      case 2:
+        TransformFilter4x4(filter_data,
+                           filter_shape[1],
+                           filter_shape[0],
+                           transformed_filter.mutable_data<float>());
+        break;
+      case 6:
+        TransformFilter8x8(filter_data,
+                           filter_shape[1],
+                           filter_shape[0],
+                           transformed_filter.mutable_data<float>());
+        break;
+      default:MACE_NOT_IMPLEMENTED;
+    }
+    // the transformed filter is the lhs of the batched gemm
+    MACE_RETURN_IF_ERROR(transformed_filter_.Resize(
+        transformed_filter.shape()));
+    PackGemmA(transformed_filter.data<float>(), in_tile_area, filter_shape[0],
+              filter_shape[1], false,
+              transformed_filter_.mutable_data<float>());
+    transformed_filter_tile_size_ = out_tile_size;
+    return MACE_SUCCESS;
+  }
+
+  // The filter of 1x1 convolution and Conv2dGemm is the lhs of the gemm, an
+  // out_channels x (in_channels * filter_h * filter_w) matrix, pack it once.
+  MaceStatus PackFilter(const Tensor *filter) {
+    MACE_RETURN_IF_ERROR(packed_filter_.Resize(filter->shape()));
+    Tensor::MappingGuard filter_guard(filter);
+    PackGemmA(filter->data<float>(), 1, filter->dim(0),
+              filter->size() / filter->dim(0), false,
+              packed_filter_.mutable_data<float>());
+    is_filter_packed_ = true;
+    return MACE_SUCCESS;
+  }
+
+  bool UseConv1x1S1(const std::vector<index_t> &filter_shape) const {
+    return filter_shape[2] == 1 && filter_shape[3] == 1 &&
+        strides_[0] == 1 && strides_[1] == 1 &&
+        dilations_[0] == 1 && dilations_[1] == 1;
+  }
+
+  // Whether no hand-written kernel covers the filter, stride and dilation,
+  // which then run as Conv2dGemm.
+  bool UseConv2dGemm(const std::vector<index_t> &filter_shape) const {
+    if (is_filter_transformed_) return false;
+    if (dilations_[0] != 1 || dilations_[1] != 1 ||
+        strides_[0] != strides_[1]) {
+      return true;
+    }
+    // filter height, width and stride of the kernels
+    static const index_t kDirectKernels[][3] = {
+        {1, 1, 1}, {3, 3, 1}, {3, 3, 2}, {5, 5, 1}, {1, 7, 1}, {7, 1, 1},
+        {7, 7, 1}, {7, 7, 2}, {7, 7, 3}, {1, 15, 1}, {15, 1, 1}};
+    for (const auto &kernel : kDirectKernels) {
+      if (filter_shape[2] == kernel[0] && filter_shape[3] == kernel[1] &&
+          strides_[0] == kernel[2]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // Transforms the filter for winograd or packs the filter for gemm, i.e.,
+  // 1x1 and Conv2dGemm, ahead of the first run, the input size is derived
+  // from the output shape. A pruned 1x1 filter is packed in sparse blocks for
+  // BlockSparseGemm instead.
+  MaceStatus Prepare(const Tensor *filter,
+                     const std::vector<index_t> &output_shape,
+                     const int sparse_block_rows) {
+    if (is_filter_transformed_ || filter->dim_size() != 4) {
+      return MACE_SUCCESS;
+    }
+    const std::vector<index_t> &filter_shape = filter->shape();
+    if (UseConv1x1S1(filter_shape)) {
+      if (sparse_block_rows > 0 && filter->is_weight()) {
+        Tensor::MappingGuard filter_guard(filter);
+        if (TryPackBlockSparse(filter->data<float>(), filter_shape[0],
+                               filter_shape[1], sparse_block_rows,
+                               &sparse_filter_)) {
+          return MACE_SUCCESS;
+        }
+      }
+      return PackFilter(filter);
+    }
+    if (UseConv2dGemm(filter_shape)) {
+      return PackFilter(filter);
+    }
+    if (output_shape.size() != 4) return MACE_SUCCESS;
+    int paddings[2] = {0, 0};
+    if (!paddings_.empty()) {
+      paddings[0] = paddings_[0];
+      paddings[1] = paddings_[1];
+    } else if (padding_type_ != VALID) {
+      const int factor = padding_type_ == SAME ? 1 : 2;
+      paddings[0] = factor * static_cast<int>(filter_shape[2] - 1);
+      paddings[1] = factor * static_cast<int>(filter_shape[3] - 1);
+    }
+    // only winograd matters, whose stride and dilation are 1
+    const index_t out_tile_size = WinogradOutTileSize(
+        filter_shape,
+        output_shape[2] + filter_shape[2] - 1 - paddings[0],
+        output_shape[3] + filter_shape[3] - 1 - paddings[1]);
+    if (out_tile_size == 0) return MACE_SUCCESS;
+    Tensor::MappingGuard filter_guard(filter);
+    return TransformFilter(filter->data<float>(), filter_shape,
+                           out_tile_size);
   }
 
   MaceStatus operator()(const Tensor *input,
@@ -342,19 +320,19 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
     auto filter_data = filter->data<float>();
     auto bias_data = bias == nullptr ? nullptr : bias->data<float>();
     auto output_data = output->mutable_data<float>();
+    const Epilogue epilogue(bias_data, activation_, relux_max_limit_);
+    const Epilogue *epilogue_ptr = epilogue.IsNoop() ? nullptr : &epilogue;
 
     std::function<void(const float *input, float *output)> conv_func;
 
-    bool
-      use_winograd = is_filter_transformed_ || (filter_h == 3 && filter_w == 3
-      && stride_h == 1 && stride_w == 1 && dilation_h == 1 && dilation_w == 1
-      && input_channels >= 8 && channels >= 8);
+    const index_t winograd_out_tile_size =
+        WinogradOutTileSize(filter_shape, input_height, input_width);
+    bool use_winograd = winograd_out_tile_size > 0;
     bool use_neon_3x3_s1 = filter_h == 3 && filter_w == 3
       && stride_h == 1 && stride_w == 1 && dilation_h == 1 && dilation_w == 1;
     bool use_neon_3x3_s2 = filter_h == 3 && filter_w == 3
       && stride_h == 2 && stride_w == 2 && dilation_h == 1 && dilation_w == 1;
-    bool use_neon_1x1_s1 = filter_h == 1 && filter_w == 1
-      && stride_h == 1 && stride_w == 1 && dilation_h == 1 && dilation_w == 1;
+    bool use_neon_1x1_s1 = UseConv1x1S1(filter_shape);
     bool use_neon_5x5_s1 = filter_h == 5 && filter_w == 5
         && stride_h == 1 && stride_w == 1 && dilation_h == 1 && dilation_w == 1;
     bool use_neon_1x7_s1 = filter_h == 1 && filter_w == 7
@@ -371,17 +349,10 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
         && stride_h == 1 && stride_w == 1 && dilation_h == 1 && dilation_w == 1;
     bool use_neon_15x1_s1 = filter_h == 15 && filter_w == 1
         && stride_h == 1 && stride_w == 1 && dilation_h == 1 && dilation_w == 1;
+    bool use_gemm = UseConv2dGemm(filter_shape);
 
     std::vector<index_t> transformed_input_shape;
     std::vector<index_t> transformed_output_shape;
-    std::vector<index_t> transformed_filter_shape;
-
-    // When size of input feature map is bigger than 16x16,
-    // set winograd out tile size to 6 to get higher performance.
-    index_t winograd_out_tile_size = 2;
-    if (input_height > 16 && input_width > 16) {
-      winograd_out_tile_size = 6;
-    }
 
     if (use_winograd) {
       extra_output_height = RoundUp<index_t>(height, winograd_out_tile_size);
@@ -408,11 +379,9 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
       transformed_output_shape.insert(transformed_output_shape.end(),
                                       {in_tile_area, batch, channels,
                                        tile_count});
-      transformed_filter_shape.insert(transformed_filter_shape.end(),
-                                      {in_tile_area, channels, input_channels});
     } else {
       index_t tile_h, tile_w;
-      if (use_neon_1x1_s1) {
+      if (use_neon_1x1_s1 || use_gemm) {
         tile_h = 1;
         tile_w = 1;
       } else if (use_neon_3x3_s1) {
@@ -447,6 +416,8 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
     index_t transformed_output_size = 0;
     index_t padded_input_size = 0;
     index_t padded_output_size = 0;
+    index_t col_size = 0;
+    index_t gemm_tile_pixels = 0;
     if (use_winograd) {
       transformed_input_size =
         std::accumulate(transformed_input_shape.begin(),
@@ -474,6 +445,12 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
           * sizeof(float);
       total_scratch_size += padded_output_size;
     }
+    if (use_gemm) {
+      const index_t K = input_channels * filter_h * filter_w;
+      gemm_tile_pixels = Conv2dGemmTilePixels(K, height * width);
+      col_size = K * gemm_tile_pixels * sizeof(float);
+      total_scratch_size += col_size;
+    }
     // Init scratch buffer
     scratch_->Rewind();
     scratch_->GrowSize(total_scratch_size);
@@ -483,40 +460,46 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
       transformed_output(scratch_->Scratch(transformed_output_size), DT_FLOAT);
     Tensor padded_input(scratch_->Scratch(padded_input_size), DT_FLOAT);
     Tensor padded_output(scratch_->Scratch(padded_output_size), DT_FLOAT);
+    Tensor col(scratch_->Scratch(col_size), DT_FLOAT);
     const index_t extra_input_shape[4] =
         {batch, input_channels, extra_input_height, extra_input_width};
     const index_t extra_output_shape[4] =
         {batch, channels, extra_output_height, extra_output_width};
 
     // decide which convolution function to call
+    const CPUKernelTable &cpu_kernels = GetCPUKernels();
+    Conv2dDirectFunc direct_conv = nullptr;
+    if (use_neon_5x5_s1) {
+      direct_conv = cpu_kernels.conv_2d_5x5s1;
+    } else if (use_neon_1x7_s1) {
+      direct_conv = cpu_kernels.conv_2d_1x7s1;
+    } else if (use_neon_7x1_s1) {
+      direct_conv = cpu_kernels.conv_2d_7x1s1;
+    } else if (use_neon_7x7_s1) {
+      direct_conv = cpu_kernels.conv_2d_7x7s1;
+    } else if (use_neon_7x7_s2) {
+      direct_conv = cpu_kernels.conv_2d_7x7s2;
+    } else if (use_neon_7x7_s3) {
+      direct_conv = cpu_kernels.conv_2d_7x7s3;
+    } else if (use_neon_1x15_s1) {
+      direct_conv = cpu_kernels.conv_2d_1x15s1;
+    } else if (use_neon_15x1_s1) {
+      direct_conv = cpu_kernels.conv_2d_15x1s1;
+    }
     if (use_winograd) {
       transformed_input.Reshape(transformed_input_shape);
       transformed_output.Reshape(transformed_output_shape);
       const float *transformed_filter_ptr;
-      if (transformed_filter_.dim_size() == 0) {
-        if (is_filter_transformed_) {
-          transformed_filter_ptr = filter_data;
-        } else {
-          MACE_RETURN_IF_ERROR(transformed_filter_.Resize(
-              transformed_filter_shape));
-          switch (winograd_out_tile_size) {
-            case 2:
-              TransformFilter4x4(filter_data,
-                                 filter_shape[1],
-                                 filter_shape[0],
-                                 transformed_filter_.mutable_data<float>());
-              break;
-            case 6:
-              TransformFilter8x8(filter_data,
-                                 filter_shape[1],
-                                 filter_shape[0],
-                                 transformed_filter_.mutable_data<float>());
-              break;
-            default:MACE_NOT_IMPLEMENTED;
-          }
-          transformed_filter_ptr = transformed_filter_.data<float>();
-        }
+      bool is_filter_packed = false;
+      if (is_filter_transformed_) {
+        transformed_filter_ptr = filter_data;
       } else {
+        is_filter_packed = true;
+        // the tile size follows the input size, which may change
+        if (transformed_filter_tile_size_ != winograd_out_tile_size) {
+          MACE_RETURN_IF_ERROR(TransformFilter(filter_data, filter_shape,
+                                               winograd_out_tile_size));
+        }
         transformed_filter_ptr = transformed_filter_.data<float>();
       }
 
@@ -532,111 +515,84 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
                           input_channels,
                           channels,
                           winograd_out_tile_size,
+                          is_filter_packed,
+                          epilogue_ptr,
                           transformed_input_data,
                           transformed_output_data,
                           pad_output);
       };
     } else if (use_neon_3x3_s1) {
+      const Conv2dK3x3Func conv_2d_3x3 = cpu_kernels.conv_2d_3x3s1;
       conv_func = [=](const float *pad_input, float *pad_output) {
-        Conv2dNeonK3x3S1(pad_input,
-                         filter_data,
-                         extra_input_shape,
-                         extra_output_shape,
-                         pad_output);
+        conv_2d_3x3(pad_input,
+                    filter_data,
+                    extra_input_shape,
+                    extra_output_shape,
+                    epilogue_ptr,
+                    pad_output);
       };
     } else if (use_neon_3x3_s2) {
+      const Conv2dK3x3Func conv_2d_3x3 = cpu_kernels.conv_2d_3x3s2;
       conv_func = [=](const float *pad_input, float *pad_output) {
-        Conv2dNeonK3x3S2(pad_input,
-                         filter_data,
-                         extra_input_shape,
-                         extra_output_shape,
-                         pad_output);
+        conv_2d_3x3(pad_input,
+                    filter_data,
+                    extra_input_shape,
+                    extra_output_shape,
+                    epilogue_ptr,
+                    pad_output);
+      };
+    } else if (use_neon_1x1_s1 && !sparse_filter_.empty()) {
+      const BlockSparseMatrix *sparse_filter = &sparse_filter_;
+      conv_func = [=](const float *pad_input, float *pad_output) {
+        BlockSparseGemm(*sparse_filter,
+                        pad_input,
+                        batch,
+                        extra_input_height * extra_input_width,
+                        pad_output,
+                        epilogue_ptr);
       };
     } else if (use_neon_1x1_s1) {
+      const bool is_filter_packed = is_filter_packed_;
+      const float *filter_ptr =
+          is_filter_packed ? packed_filter_.data<float>() : filter_data;
       conv_func = [=](const float *pad_input, float *pad_output) {
         Conv2dNeonK1x1S1(pad_input,
-                         filter_data,
+                         filter_ptr,
                          batch,
                          extra_input_height,
                          extra_input_width,
                          input_channels,
                          channels,
+                         is_filter_packed,
+                         epilogue_ptr,
                          pad_output);
       };
-    } else if (use_neon_5x5_s1) {
-      conv_func = [=](const float *pad_input, float *pad_output) {
-        Conv2dNeonK5x5S1(pad_input,
-                         filter_data,
-                         extra_input_shape,
-                         extra_output_shape,
-                         pad_output);
-      };
-    } else if (use_neon_1x7_s1) {
-      conv_func = [=](const float *pad_input, float *pad_output) {
-        Conv2dNeonK1x7S1(pad_input,
-                         filter_data,
-                         extra_input_shape,
-                         extra_output_shape,
-                         pad_output);
-      };
-    } else if (use_neon_7x1_s1) {
-      conv_func = [=](const float *pad_input, float *pad_output) {
-        Conv2dNeonK7x1S1(pad_input,
-                         filter_data,
-                         extra_input_shape,
-                         extra_output_shape,
-                         pad_output);
-      };
-    } else if (use_neon_7x7_s1) {
-      conv_func = [=](const float *pad_input, float *pad_output) {
-        Conv2dNeonK7x7S1(pad_input,
-                         filter_data,
-                         extra_input_shape,
-                         extra_output_shape,
-                         pad_output);
-      };
-    } else if (use_neon_7x7_s2) {
-      conv_func = [=](const float *pad_input, float *pad_output) {
-        Conv2dNeonK7x7S2(pad_input,
-                         filter_data,
-                         extra_input_shape,
-                         extra_output_shape,
-                         pad_output);
-      };
-    } else if (use_neon_7x7_s3) {
-      conv_func = [=](const float *pad_input, float *pad_output) {
-        Conv2dNeonK7x7S3(pad_input,
-                         filter_data,
-                         extra_input_shape,
-                         extra_output_shape,
-                         pad_output);
-      };
-    } else if (use_neon_1x15_s1) {
-      conv_func = [=](const float *pad_input, float *pad_output) {
-        Conv2dNeonK1x15S1(pad_input,
-                         filter_data,
-                         extra_input_shape,
-                         extra_output_shape,
-                         pad_output);
-      };
-    } else if (use_neon_15x1_s1) {
+    } else if (direct_conv != nullptr) {
       conv_func = [=](const float *pad_input, float *pad_output) {
-        Conv2dNeonK15x1S1(pad_input,
-                          filter_data,
-                          extra_input_shape,
-                          extra_output_shape,
-                          pad_output);
+        direct_conv(pad_input,
+                    filter_data,
+                    extra_input_shape,
+                    extra_output_shape,
+                    pad_output);
       };
     } else {
+      const bool is_filter_packed = is_filter_packed_;
+      const float *filter_ptr =
+          is_filter_packed ? packed_filter_.data<float>() : filter_data;
+      float *col_data = col.mutable_data<float>();
       conv_func = [=](const float *pad_input, float *pad_output) {
-        Conv2dGeneral(pad_input,
-                      filter_data,
-                      extra_input_shape,
-                      extra_output_shape,
-                      filter_shape.data(),
-                      strides_,
-                      dilations_,
-                      pad_output);
+        Conv2dGemm(pad_input,
+                   filter_ptr,
+                   extra_input_shape,
+                   extra_output_shape,
+                   filter_shape.data(),
+                   strides_,
+                   dilations_,
+                   is_filter_packed,
+                   gemm_tile_pixels,
+                   epilogue_ptr,
+                   col_data,
+                   pad_output);
       };
     }
 
@@ -660,7 +616,7 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
                             extra_output_width});
       padded_output.Clear();
       pad_output_ptr = &padded_output;
-    } else if (!use_neon_1x1_s1) {
+    } else if (!use_neon_1x1_s1 && !use_gemm) {
       output->Clear();
     }
 
@@ -669,45 +625,46 @@ struct Conv2dFunctor<DeviceType::CPU, float> : Conv2dFunctorBase {
 
     conv_func(pad_input_data, pad_output_data);
 
+    // The other kernels leave the epilogue to the unpacking, or to one pass.
+    const bool is_epilogue_fused = use_winograd || use_neon_3x3_s1
+        || use_neon_3x3_s2 || use_neon_1x1_s1 || use_gemm;
+    const Epilogue *unpack_epilogue =
+        is_epilogue_fused ? nullptr : epilogue_ptr;
+
     // unpack output
     if (extra_output_height != height || extra_output_width != width) {
 #pragma omp parallel for collapse(2)
       for (index_t b = 0; b < batch; ++b) {
         for (index_t c = 0; c < channels; ++c) {
           for (index_t h = 0; h < height; ++h) {
-            memcpy(
-              output_data + b * channels * height * width + c * height * width
-                + h * width,
-              pad_output_data
+            float *out_ptr = output_data + b * channels * height * width
+                + c * height * width + h * width;
+            const float *pad_out_ptr = pad_output_data
                 + b * channels * extra_output_height * extra_output_width
                 + c * extra_output_height * extra_output_width
-                + h * extra_output_width,
-              sizeof(float) * width);
+                + h * extra_output_width;
+            if (unpack_epilogue != nullptr) {
+              ApplyEpilogue(*unpack_epilogue, c, pad_out_ptr, width, out_ptr);
+            } else {
+              memcpy(out_ptr, pad_out_ptr, sizeof(float) * width);
+            }
           }
         }
       }
+    } else if (unpack_epilogue != nullptr) {
+      ApplyEpilogueNCHW(*unpack_epilogue, batch, channels, height * width,
+                        output_data);
     }
 
-    if (bias_data != nullptr) {
-#pragma omp parallel for collapse(2)
-      for (index_t b = 0; b < batch; ++b) {
-        for (index_t c = 0; c < channels; ++c) {
-          for (index_t i = 0; i < height * width; ++i) {
-            output_data[(b * channels + c) * height * width + i] +=
-              bias_data[c];
-          }
-        }
-      }
-    }
-
-    DoActivation(output_data, output_data, output->size(), activation_,
-                 relux_max_limit_);
-
     return MACE_SUCCESS;
   }
 
   Tensor transformed_filter_;
   bool is_filter_transformed_;
+  index_t transformed_filter_tile_size_;
+  Tensor packed_filter_;
+  bool is_filter_packed_;
+  BlockSparseMatrix sparse_filter_;
   ScratchBuffer *scratch_;
 };
 
@@ -0,0 +1,116 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/kernels/conv_2d_gemm.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "mace/kernels/cpu_blocking.h"
+#include "mace/kernels/gemm.h"
+
+namespace mace {
+namespace kernels {
+
+void Im2Col(const float *input,
+            const index_t channels,
+            const index_t in_height,
+            const index_t in_width,
+            const index_t filter_h,
+            const index_t filter_w,
+            const int *stride_hw,
+            const int *dilation_hw,
+            const index_t out_width,
+            const index_t pixel_begin,
+            const index_t pixels,
+            float *col) {
+  const index_t stride_h = stride_hw[0];
+  const index_t stride_w = stride_hw[1];
+  const index_t dilation_h = dilation_hw[0];
+  const index_t dilation_w = dilation_hw[1];
+  const index_t filter_size = filter_h * filter_w;
+
+#pragma omp parallel for
+  for (index_t k = 0; k < channels * filter_size; ++k) {
+    const index_t c = k / filter_size;
+    const index_t kh = k % filter_size / filter_w;
+    const index_t kw = k % filter_w;
+    const float *in_ptr = input + c * in_height * in_width +
+                          kh * dilation_h * in_width + kw * dilation_w;
+    float *col_ptr = col + k * pixels;
+    // the pixels of an output row are stride_w apart in the input row
+    index_t oh = pixel_begin / out_width;
+    index_t ow = pixel_begin % out_width;
+    for (index_t p = 0; p < pixels; ++oh, ow = 0) {
+      const index_t run = std::min(out_width - ow, pixels - p);
+      const float *src = in_ptr + oh * stride_h * in_width + ow * stride_w;
+      if (stride_w == 1) {
+        memcpy(col_ptr + p, src, run * sizeof(float));
+      } else {
+        for (index_t i = 0; i < run; ++i) {
+          col_ptr[p + i] = src[i * stride_w];
+        }
+      }
+      p += run;
+    }
+  }
+}
+
+index_t Conv2dGemmTilePixels(const index_t K, const index_t out_image_size) {
+  const CPUBlocking &blocking = GetCPUBlocking();
+  const index_t fit_pixels =
+      blocking.cache_sizes.l2 / 2 / (K * static_cast<index_t>(sizeof(float)));
+  // whole gemm column blocks, at least one
+  const index_t tile_pixels =
+      std::max(blocking.gemm_n, fit_pixels / blocking.gemm_n * blocking.gemm_n);
+  return std::min(tile_pixels, out_image_size);
+}
+
+void Conv2dGemm(const float *input,
+                const float *filter,
+                const index_t *in_shape,
+                const index_t *out_shape,
+                const index_t *filter_shape,
+                const int *stride_hw,
+                const int *dilation_hw,
+                const bool is_filter_packed,
+                const index_t tile_pixels,
+                const Epilogue *epilogue,
+                float *col,
+                float *output) {
+  const index_t batch = in_shape[0];
+  const index_t in_channels = in_shape[1];
+  const index_t in_image_size = in_shape[2] * in_shape[3];
+  const index_t out_channels = out_shape[1];
+  const index_t out_image_size = out_shape[2] * out_shape[3];
+  const index_t K = in_channels * filter_shape[2] * filter_shape[3];
+
+  for (index_t b = 0; b < batch; ++b) {
+    const float *in_ptr = input + b * in_channels * in_image_size;
+    float *out_ptr = output + b * out_channels * out_image_size;
+    for (index_t p = 0; p < out_image_size; p += tile_pixels) {
+      const index_t pixels = std::min(tile_pixels, out_image_size - p);
+      Im2Col(in_ptr, in_channels, in_shape[2], in_shape[3], filter_shape[2],
+             filter_shape[3], stride_hw, dilation_hw, out_shape[3], p, pixels,
+             col);
+      // the pixels of the tile are a column range of each output channel,
+      // whose rows are the channels of the epilogue
+      GemmStridedC(filter, col, out_channels, K, pixels, out_image_size,
+                   out_ptr + p, is_filter_packed, epilogue);
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -0,0 +1,65 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_CONV_2D_GEMM_H_
+#define MACE_KERNELS_CONV_2D_GEMM_H_
+
+#include "mace/core/types.h"
+#include "mace/kernels/epilogue.h"
+
+namespace mace {
+namespace kernels {
+
+// Copies the receptive fields of the output pixels [pixel_begin,
+// pixel_begin + pixels) of one image to col, a (channels * filter_h *
+// filter_w) x pixels matrix whose rows follow the OIHW filter. The input is
+// padded, i.e., every field lies in it.
+void Im2Col(const float *input,
+            const index_t channels,
+            const index_t in_height,
+            const index_t in_width,
+            const index_t filter_h,
+            const index_t filter_w,
+            const int *stride_hw,
+            const int *dilation_hw,
+            const index_t out_width,
+            const index_t pixel_begin,
+            const index_t pixels,
+            float *col);
+
+// Output pixels of a tile of Conv2dGemm, whose K x tile_pixels im2col
+// matrix stays in half of L2, K being in_channels * filter_h * filter_w.
+index_t Conv2dGemmTilePixels(const index_t K, const index_t out_image_size);
+
+// Convolution of any filter, stride and dilation as the gemm of the filter,
+// an out_channels x K matrix, and the im2col of tile_pixels output pixels at
+// a time, which col holds. The input is padded, in_shape and out_shape are
+// NCHW and the filter is OIHW, packed by PackGemmA if is_filter_packed.
+void Conv2dGemm(const float *input,
+                const float *filter,
+                const index_t *in_shape,
+                const index_t *out_shape,
+                const index_t *filter_shape,
+                const int *stride_hw,
+                const int *dilation_hw,
+                const bool is_filter_packed,
+                const index_t tile_pixels,
+                const Epilogue *epilogue,
+                float *col,
+                float *output);
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_CONV_2D_GEMM_H_
@@ -0,0 +1,177 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "mace/kernels/conv_2d_gemm.h"
+#include "mace/kernels/gemm.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+
+// Direct convolution of the padded NCHW input by the OIHW filter.
+void Conv2dRef(const std::vector<float> &input,
+               const std::vector<float> &filter,
+               const index_t *in_shape,
+               const index_t *out_shape,
+               const index_t *filter_shape,
+               const int *stride_hw,
+               const int *dilation_hw,
+               std::vector<float> *output) {
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t m = 0; m < out_shape[1]; ++m) {
+      for (index_t h = 0; h < out_shape[2]; ++h) {
+        for (index_t w = 0; w < out_shape[3]; ++w) {
+          float sum = 0;
+          for (index_t c = 0; c < in_shape[1]; ++c) {
+            for (index_t kh = 0; kh < filter_shape[2]; ++kh) {
+              for (index_t kw = 0; kw < filter_shape[3]; ++kw) {
+                const index_t ih = h * stride_hw[0] + kh * dilation_hw[0];
+                const index_t iw = w * stride_hw[1] + kw * dilation_hw[1];
+                sum += input[((b * in_shape[1] + c) * in_shape[2] + ih) *
+                             in_shape[3] + iw] *
+                       filter[((m * filter_shape[1] + c) * filter_shape[2] +
+                               kh) * filter_shape[3] + kw];
+              }
+            }
+          }
+          (*output)[((b * out_shape[1] + m) * out_shape[2] + h) *
+                    out_shape[3] + w] = sum;
+        }
+      }
+    }
+  }
+}
+
+// tile_pixels 0 takes Conv2dGemmTilePixels
+void Conv2dGemmTest(const index_t batch,
+                    const index_t in_channels,
+                    const index_t in_height,
+                    const index_t in_width,
+                    const index_t out_channels,
+                    const index_t filter_h,
+                    const index_t filter_w,
+                    const int stride,
+                    const int dilation,
+                    const bool packed_filter,
+                    index_t tile_pixels = 0,
+                    const Epilogue *epilogue = nullptr) {
+  const int stride_hw[2] = {stride, stride};
+  const int dilation_hw[2] = {dilation, dilation};
+  const index_t in_shape[4] = {batch, in_channels, in_height, in_width};
+  const index_t filter_shape[4] = {out_channels, in_channels, filter_h,
+                                   filter_w};
+  const index_t out_shape[4] = {
+      batch, out_channels,
+      (in_height - (filter_h - 1) * dilation - 1) / stride + 1,
+      (in_width - (filter_w - 1) * dilation - 1) / stride + 1};
+  const index_t K = in_channels * filter_h * filter_w;
+  const index_t out_image_size = out_shape[2] * out_shape[3];
+  if (tile_pixels == 0) {
+    tile_pixels = Conv2dGemmTilePixels(K, out_image_size);
+  }
+
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::normal_distribution<float> nd(0, 1);
+  std::vector<float> input(batch * in_channels * in_height * in_width);
+  std::vector<float> filter(out_channels * K);
+  std::generate(input.begin(), input.end(), [&gen, &nd] { return nd(gen); });
+  std::generate(filter.begin(), filter.end(),
+                [&gen, &nd] { return nd(gen); });
+  std::vector<float> packed(filter.size());
+  if (packed_filter) {
+    PackGemmA(filter.data(), 1, out_channels, K, false, packed.data());
+  }
+  std::vector<float> col(K * tile_pixels);
+  std::vector<float> output(batch * out_channels * out_image_size);
+  std::vector<float> output_ref(output.size());
+  Conv2dGemm(input.data(), packed_filter ? packed.data() : filter.data(),
+             in_shape, out_shape, filter_shape, stride_hw, dilation_hw,
+             packed_filter, tile_pixels, epilogue, col.data(), output.data());
+  Conv2dRef(input, filter, in_shape, out_shape, filter_shape, stride_hw,
+            dilation_hw, &output_ref);
+
+  for (size_t i = 0; i < output.size(); ++i) {
+    const float expected =
+        epilogue == nullptr
+            ? output_ref[i]
+            : ApplyEpilogue(*epilogue, i / out_image_size % out_channels,
+                            output_ref[i]);
+    EXPECT_NEAR(expected, output[i], 1e-3) << "index " << i;
+  }
+}
+
+}  // namespace
+
+TEST(Conv2dGemmTest, Im2Col) {
+  // 1 channel 4x5, 2x2 filter of stride 2 and dilation 1, 2x2 output
+  std::vector<float> input(20);
+  for (size_t i = 0; i < input.size(); ++i) input[i] = i;
+  const int stride_hw[2] = {2, 2};
+  const int dilation_hw[2] = {1, 1};
+  std::vector<float> col(4 * 3);
+  // the pixels [1, 4) of the output
+  Im2Col(input.data(), 1, 4, 5, 2, 2, stride_hw, dilation_hw, 2, 1, 3,
+         col.data());
+  EXPECT_EQ(std::vector<float>({2, 10, 12,
+                                3, 11, 13,
+                                7, 15, 17,
+                                8, 16, 18}),
+            col);
+}
+
+TEST(Conv2dGemmTest, Shapes) {
+  for (bool packed_filter : {false, true}) {
+    // 1x1 stride 2
+    Conv2dGemmTest(1, 16, 14, 14, 32, 1, 1, 2, 1, packed_filter);
+    // 3x3 dilation 2, 5x5 stride 2 and 3x5
+    Conv2dGemmTest(2, 8, 17, 19, 13, 3, 3, 1, 2, packed_filter);
+    Conv2dGemmTest(1, 5, 23, 21, 16, 5, 5, 2, 1, packed_filter);
+    Conv2dGemmTest(1, 3, 12, 12, 9, 3, 5, 1, 1, packed_filter);
+    Conv2dGemmTest(1, 3, 35, 35, 96, 11, 11, 4, 1, packed_filter);
+  }
+}
+
+TEST(Conv2dGemmTest, Tiles) {
+  // tiles splitting the output rows, the last one partial
+  Conv2dGemmTest(2, 8, 17, 19, 13, 3, 3, 1, 2, true, 7);
+  Conv2dGemmTest(1, 70, 20, 20, 100, 3, 3, 2, 1, false, 16);
+  Conv2dGemmTest(1, 4, 9, 9, 4, 2, 2, 3, 1, true, 1);
+}
+
+TEST(Conv2dGemmTest, Epilogue) {
+  std::vector<float> bias(32);
+  std::vector<float> alpha(32, 0.25f);
+  for (size_t i = 0; i < bias.size(); ++i) {
+    bias[i] = i * 0.1f - 1.5f;
+  }
+  const Epilogue epilogues[] = {
+      Epilogue(bias.data(), RELU, 0),
+      Epilogue(bias.data(), RELUX, 0.5f),
+      Epilogue(nullptr, PRELU, 0, alpha.data()),
+  };
+  for (const Epilogue &epilogue : epilogues) {
+    Conv2dGemmTest(1, 8, 17, 19, 32, 3, 3, 1, 2, true, 0, &epilogue);
+    Conv2dGemmTest(2, 8, 17, 19, 13, 5, 3, 2, 1, false, 11, &epilogue);
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
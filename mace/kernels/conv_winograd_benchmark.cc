@@ -0,0 +1,194 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <vector>
+
+#include "mace/core/testing/test_benchmark.h"
+#include "mace/kernels/arm/conv_winograd.h"
+#include "mace/kernels/cpu_dispatch.h"
+#include "mace/kernels/gemm.h"
+
+namespace mace {
+namespace kernels {
+namespace test {
+
+namespace {
+
+// 3x3 stride 1 convolution of an output of height x width, by F(m, 3) of the
+// packed transformed filter, or by the direct kernel of the cpu if m is 0.
+void Conv3x3Benchmark(int iters, int batch, int height, int width,
+                      int in_channels, int out_channels, int m) {
+  mace::testing::StopTiming();
+  const index_t in_shape[4] = {batch, in_channels, height + 2, width + 2};
+  const index_t out_shape[4] = {batch, out_channels, height, width};
+  std::vector<float> input(batch * in_channels * (height + 2) * (width + 2));
+  std::vector<float> filter(out_channels * in_channels * 9);
+  std::vector<float> output(batch * out_channels * height * width);
+  const index_t in_tile_area = WinogradInTileArea(m);
+  const index_t tile_count = m == 0 ? 0 : (height / m) * (width / m);
+  std::vector<float> transformed_filter(in_tile_area * filter.size() / 9);
+  std::vector<float> packed_filter(transformed_filter.size());
+  std::vector<float> transformed_input(in_tile_area * batch * in_channels *
+                                       tile_count);
+  std::vector<float> transformed_output(in_tile_area * batch * out_channels *
+                                        tile_count);
+  const Conv2dK3x3Func direct_conv = GetCPUKernels().conv_2d_3x3s1;
+  if (m > 0) {
+    WinogradTransformFilter(filter.data(), in_channels, out_channels, m,
+                            transformed_filter.data());
+    PackGemmA(transformed_filter.data(), in_tile_area, out_channels,
+              in_channels, false, packed_filter.data());
+  }
+  auto run = [&]() {
+    if (m == 0) {
+      direct_conv(input.data(), filter.data(), in_shape, out_shape, nullptr,
+                  output.data());
+    } else {
+      WinoGradConv3x3s1(input.data(), packed_filter.data(), batch,
+                        height + 2, width + 2, in_channels, out_channels, m,
+                        true, nullptr, transformed_input.data(),
+                        transformed_output.data(), output.data());
+    }
+  };
+  // warm up
+  run();
+  mace::testing::StartTiming();
+  while (iters--) {
+    run();
+  }
+}
+
+// 1 x k or k x 1 stride 1 convolution of an output of height x width, by 1D
+// winograd if is_winograd, else by the direct kernel of the cpu.
+void Conv1DBenchmark(int iters, int batch, int height, int width,
+                     int in_channels, int out_channels, int filter_h,
+                     int filter_w, bool is_winograd) {
+  mace::testing::StopTiming();
+  const bool horizontal = filter_h == 1;
+  const index_t filter_size = horizontal ? filter_w : filter_h;
+  const index_t in_shape[4] = {batch, in_channels, height + filter_h - 1,
+                               width + filter_w - 1};
+  const index_t out_shape[4] = {batch, out_channels, height, width};
+  std::vector<float> input(in_shape[0] * in_shape[1] * in_shape[2] *
+                           in_shape[3]);
+  std::vector<float> filter(out_channels * in_channels * filter_size);
+  std::vector<float> output(batch * out_channels * height * width);
+  const index_t segments = Winograd1DSegments(filter_size);
+  const index_t tile_count =
+      height * width / Winograd1DOutTileSize(filter_size);
+  std::vector<float> transformed_filter(8 * out_channels * in_channels *
+                                        segments);
+  std::vector<float> packed_filter(transformed_filter.size());
+  std::vector<float> transformed_input(8 * batch * in_channels * segments *
+                                       tile_count);
+  std::vector<float> transformed_output(8 * batch * out_channels *
+                                        tile_count);
+  const CPUKernelTable &cpu_kernels = GetCPUKernels();
+  Conv2dDirectFunc direct_conv = nullptr;
+  if (filter_h == 1) {
+    direct_conv = filter_w == 7 ? cpu_kernels.conv_2d_1x7s1
+                                : cpu_kernels.conv_2d_1x15s1;
+  } else {
+    direct_conv = filter_h == 7 ? cpu_kernels.conv_2d_7x1s1
+                                : cpu_kernels.conv_2d_15x1s1;
+  }
+  TransformFilter1D(filter.data(), in_channels, out_channels, filter_size,
+                    transformed_filter.data());
+  PackGemmA(transformed_filter.data(), 8, out_channels,
+            in_channels * segments, false, packed_filter.data());
+  auto run = [&]() {
+    if (is_winograd) {
+      WinogradConv1D(input.data(), packed_filter.data(), batch, in_shape[2],
+                     in_shape[3], in_channels, out_channels, filter_size,
+                     horizontal, true, nullptr, transformed_input.data(),
+                     transformed_output.data(), output.data());
+    } else {
+      direct_conv(input.data(), filter.data(), in_shape, out_shape,
+                  output.data());
+    }
+  };
+  // warm up
+  run();
+  mace::testing::StartTiming();
+  while (iters--) {
+    run();
+  }
+}
+
+}  // namespace
+
+// MACC of the direct convolution, i.e., the equivalent throughput
+#define MACE_BM_CONV_3X3_FUNC(N, H, W, C, O, M)                            \
+  static void MACE_BM_WINOGRAD_3X3_##N##_##H##_##W##_##C##_##O##_F##M(     \
+      int iters) {                                                         \
+    const int64_t macc = static_cast<int64_t>(iters) * N * H * W * C * O   \
+        * 9;                                                               \
+    mace::testing::MaccProcessed(macc);                                    \
+    mace::testing::BytesProcessed(                                         \
+        static_cast<int64_t>(iters) * N * C * H * W * sizeof(float));      \
+    Conv3x3Benchmark(iters, N, H, W, C, O, M);                             \
+  }                                                                        \
+  MACE_BENCHMARK(MACE_BM_WINOGRAD_3X3_##N##_##H##_##W##_##C##_##O##_F##M)
+
+// The direct kernel (F0) against F(2, 3), F(4, 3) and F(6, 3), the output
+// size is a multiple of 12 to be made of whole tiles of each
+#define MACE_BM_CONV_3X3(N, H, W, C, O)    \
+  MACE_BM_CONV_3X3_FUNC(N, H, W, C, O, 0); \
+  MACE_BM_CONV_3X3_FUNC(N, H, W, C, O, 2); \
+  MACE_BM_CONV_3X3_FUNC(N, H, W, C, O, 4); \
+  MACE_BM_CONV_3X3_FUNC(N, H, W, C, O, 6);
+
+#define MACE_BM_CONV_1D_FUNC(N, H, W, C, O, KH, KW, TYPE, IS_WINOGRAD)       \
+  static void                                                                \
+      MACE_BM_WINOGRAD_1D_##N##_##H##_##W##_##C##_##O##_K##KH##x##KW##_##\
+        TYPE(int iters) {                                                    \
+    const int64_t macc = static_cast<int64_t>(iters) * N * H * W * C * O     \
+        * KH * KW;                                                           \
+    mace::testing::MaccProcessed(macc);                                      \
+    mace::testing::BytesProcessed(                                           \
+        static_cast<int64_t>(iters) * N * C * H * W * sizeof(float));        \
+    Conv1DBenchmark(iters, N, H, W, C, O, KH, KW, IS_WINOGRAD);              \
+  }                                                                          \
+  MACE_BENCHMARK(                                                            \
+      MACE_BM_WINOGRAD_1D_##N##_##H##_##W##_##C##_##O##_K##KH##x##KW##_##TYPE)
+
+// The direct kernel against 1D winograd, the output size is a multiple of 4
+#define MACE_BM_CONV_1D(N, H, W, C, O, KH, KW)                  \
+  MACE_BM_CONV_1D_FUNC(N, H, W, C, O, KH, KW, Direct, false);   \
+  MACE_BM_CONV_1D_FUNC(N, H, W, C, O, KH, KW, Winograd, true);
+
+MACE_BM_CONV_3X3(1, 12, 12, 8, 8);
+MACE_BM_CONV_3X3(1, 12, 12, 64, 64);
+MACE_BM_CONV_3X3(1, 24, 24, 4, 4);
+MACE_BM_CONV_3X3(1, 24, 24, 16, 16);
+MACE_BM_CONV_3X3(1, 24, 24, 256, 256);
+MACE_BM_CONV_3X3(1, 48, 48, 3, 16);
+MACE_BM_CONV_3X3(1, 48, 48, 32, 32);
+MACE_BM_CONV_3X3(1, 48, 48, 128, 128);
+MACE_BM_CONV_3X3(1, 96, 96, 16, 16);
+MACE_BM_CONV_3X3(1, 96, 96, 64, 64);
+MACE_BM_CONV_3X3(8, 24, 24, 32, 32);
+
+MACE_BM_CONV_1D(1, 16, 16, 192, 192, 1, 7);
+MACE_BM_CONV_1D(1, 16, 16, 192, 192, 7, 1);
+MACE_BM_CONV_1D(1, 64, 64, 32, 32, 1, 7);
+MACE_BM_CONV_1D(1, 64, 64, 32, 32, 7, 1);
+MACE_BM_CONV_1D(1, 32, 32, 64, 128, 1, 15);
+MACE_BM_CONV_1D(1, 32, 32, 64, 128, 15, 1);
+MACE_BM_CONV_1D(1, 256, 256, 32, 4, 1, 15);
+MACE_BM_CONV_1D(1, 256, 256, 32, 4, 15, 1);
+
+}  // namespace test
+}  // namespace kernels
+}  // namespace mace
@@ -0,0 +1,217 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/kernels/cpu_blocking.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+#include "mace/kernels/gemm.h"
+#include "mace/public/mace_runtime.h"
+#include "mace/utils/env_time.h"
+#include "mace/utils/logging.h"
+#include "mace/utils/string_util.h"
+
+namespace mace {
+
+extern std::shared_ptr<KVStorageFactory> kStorageFactory;
+
+namespace kernels {
+
+namespace {
+
+const int64_t kDefaultL1DataCacheSize = 32 << 10;
+const int64_t kDefaultL2CacheSize = 256 << 10;
+const char *kCPUBlockingStorageName = "mace_cpu_blocking.bin";
+
+// Rounds value to the nearest multiple of factor within [min, max].
+index_t RoundClamp(int64_t value, index_t factor, index_t min, index_t max) {
+  const index_t rounded = (value + factor / 2) / factor * factor;
+  return std::min(std::max(rounded, min), max);
+}
+
+CPUBlocking MakeCPUBlocking(int64_t m, int64_t k, int64_t n,
+                            const CPUCacheSizes &cache_sizes) {
+  CPUBlocking blocking;
+  blocking.gemm_m = RoundClamp(m, 24, 24, 384);
+  blocking.gemm_k = RoundClamp(k, 16, 64, 512);
+  blocking.gemm_n = RoundClamp(n, 16, 64, 1024);
+  blocking.cache_sizes = cache_sizes;
+  return blocking;
+}
+
+bool SameGemmBlocking(const CPUBlocking &a, const CPUBlocking &b) {
+  return a.gemm_m == b.gemm_m && a.gemm_k == b.gemm_k &&
+         a.gemm_n == b.gemm_n;
+}
+
+// The fastest candidate for a gemm spanning several blocks in each dimension.
+CPUBlocking CalibrateCPUBlocking(const CPUBlocking &blocking) {
+  const index_t height = 192;
+  const index_t K = 512;
+  const index_t width = 384;
+  std::vector<float> A(height * K, 0.5f);
+  std::vector<float> B(K * width, 0.25f);
+  std::vector<float> C(height * width);
+
+  CPUBlocking best = blocking;
+  int64_t best_duration = std::numeric_limits<int64_t>::max();
+  for (const CPUBlocking &candidate : CPUBlockingCandidates(blocking)) {
+    // warm up, then take the fastest run
+    GemmWithBlocking(A.data(), B.data(), height, K, width, candidate,
+                     C.data());
+    int64_t duration = std::numeric_limits<int64_t>::max();
+    for (int i = 0; i < 3; ++i) {
+      const int64_t start = NowMicros();
+      GemmWithBlocking(A.data(), B.data(), height, K, width, candidate,
+                       C.data());
+      duration = std::min(duration, NowMicros() - start);
+    }
+    VLOG(2) << "CPU blocking " << candidate.gemm_m << "x" << candidate.gemm_k
+            << "x" << candidate.gemm_n << ": " << duration << " us";
+    if (duration < best_duration) {
+      best_duration = duration;
+      best = candidate;
+    }
+  }
+  return best;
+}
+
+CPUBlocking InitCPUBlocking() {
+  CPUCacheSizes cache_sizes;
+  if (GetCPUCacheSizes(kSysfsSystemRoot, &cache_sizes) != MACE_SUCCESS) {
+    LOG(WARNING) << "CPU caches are unknown, use the default blocking";
+    return DefaultCPUBlocking();
+  }
+  CPUBlocking blocking = DeriveCPUBlocking(cache_sizes);
+  if (kStorageFactory != nullptr) {
+    std::unique_ptr<KVStorage> storage =
+        kStorageFactory->CreateStorage(kCPUBlockingStorageName);
+    if (storage->Load() != 0) {
+      LOG(WARNING) << "Load CPU blocking cache file failed.";
+    }
+    const std::string key = CPUBlockingKey(GetCPUISA(), cache_sizes);
+    const std::vector<unsigned char> *cached = storage->Find(key);
+    if (cached == nullptr || !DeserializeCPUBlocking(*cached, &blocking)) {
+      blocking = CalibrateCPUBlocking(blocking);
+      storage->Insert(key, SerializeCPUBlocking(blocking));
+      if (storage->Flush() != 0) {
+        LOG(WARNING) << "Write CPU blocking cache file failed.";
+      }
+    }
+  }
+  VLOG(1) << "CPU caches L1d " << cache_sizes.l1d << ", L2 "
+          << cache_sizes.l2 << ", L3 " << cache_sizes.l3 << ", gemm blocking "
+          << blocking.gemm_m << "x" << blocking.gemm_k << "x"
+          << blocking.gemm_n;
+  return blocking;
+}
+
+}  // namespace
+
+CPUBlocking DefaultCPUBlocking() {
+  return MakeCPUBlocking(72, 128, 128,
+                         {kDefaultL1DataCacheSize, kDefaultL2CacheSize, 0});
+}
+
+// The widest (32 column) panel of B takes half of L1, the block of B a
+// quarter of L2 and the block of A an eighth, leaving room for C and the
+// streamed operands. 32K L1 and 256K L2 give the default blocking.
+CPUBlocking DeriveCPUBlocking(const CPUCacheSizes &cache_sizes) {
+  const int64_t l1d =
+      cache_sizes.l1d > 0 ? cache_sizes.l1d : kDefaultL1DataCacheSize;
+  const int64_t l2 = cache_sizes.l2 > 0 ? cache_sizes.l2 : kDefaultL2CacheSize;
+  const index_t k = RoundClamp(l1d / 2 / (32 * sizeof(float)), 16, 64, 512);
+  const int64_t k_bytes = k * sizeof(float);
+  return MakeCPUBlocking(l2 / 8 / k_bytes, k, l2 / 4 / k_bytes,
+                         {l1d, l2, cache_sizes.l3});
+}
+
+std::vector<CPUBlocking> CPUBlockingCandidates(const CPUBlocking &blocking) {
+  const index_t m = blocking.gemm_m;
+  const index_t k = blocking.gemm_k;
+  const index_t n = blocking.gemm_n;
+  const CPUCacheSizes &caches = blocking.cache_sizes;
+  const CPUBlocking variants[] = {
+      blocking,
+      DefaultCPUBlocking(),
+      MakeCPUBlocking(m / 2, k, n, caches),
+      MakeCPUBlocking(m * 2, k, n, caches),
+      MakeCPUBlocking(m, k / 2, n, caches),
+      MakeCPUBlocking(m, k * 2, n, caches),
+      MakeCPUBlocking(m, k, n / 2, caches),
+      MakeCPUBlocking(m, k, n * 2, caches),
+  };
+  std::vector<CPUBlocking> candidates;
+  for (const CPUBlocking &variant : variants) {
+    bool duplicated = false;
+    for (const CPUBlocking &candidate : candidates) {
+      duplicated = duplicated || SameGemmBlocking(candidate, variant);
+    }
+    if (!duplicated) {
+      candidates.push_back(variant);
+      candidates.back().cache_sizes = caches;
+    }
+  }
+  return candidates;
+}
+
+std::string CPUBlockingKey(CPUISA isa, const CPUCacheSizes &cache_sizes) {
+  return MakeString("gemm_blocking:", CPUISAToString(isa), ":",
+                    cache_sizes.l1d, ":", cache_sizes.l2, ":",
+                    cache_sizes.l3);
+}
+
+std::vector<unsigned char> SerializeCPUBlocking(const CPUBlocking &blocking) {
+  const int32_t values[] = {static_cast<int32_t>(blocking.gemm_m),
+                            static_cast<int32_t>(blocking.gemm_k),
+                            static_cast<int32_t>(blocking.gemm_n)};
+  std::vector<unsigned char> data(sizeof(values));
+  memcpy(data.data(), values, sizeof(values));
+  return data;
+}
+
+bool DeserializeCPUBlocking(const std::vector<unsigned char> &data,
+                            CPUBlocking *blocking) {
+  MACE_CHECK_NOTNULL(blocking);
+  int32_t values[3];
+  if (data.size() != sizeof(values)) {
+    return false;
+  }
+  memcpy(values, data.data(), sizeof(values));
+  const CPUBlocking parsed = MakeCPUBlocking(values[0], values[1], values[2],
+                                             blocking->cache_sizes);
+  // reject anything MakeCPUBlocking would have changed
+  if (parsed.gemm_m != values[0] || parsed.gemm_k != values[1] ||
+      parsed.gemm_n != values[2]) {
+    return false;
+  }
+  *blocking = parsed;
+  return true;
+}
+
+index_t ConvChannelBlock(const CPUBlocking &blocking, index_t plane_size) {
+  const index_t plane_bytes = plane_size * sizeof(float);
+  return std::max<index_t>(1, blocking.cache_sizes.l2 / 2 / plane_bytes);
+}
+
+const CPUBlocking &GetCPUBlocking() {
+  static const CPUBlocking blocking = InitCPUBlocking();
+  return blocking;
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -0,0 +1,70 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_CPU_BLOCKING_H_
+#define MACE_KERNELS_CPU_BLOCKING_H_
+
+#include <string>
+#include <vector>
+
+#include "mace/core/runtime/cpu/cpu_runtime.h"
+#include "mace/core/types.h"
+
+namespace mace {
+namespace kernels {
+
+// Cache blocking of the CPU kernels. The gemm blocks follow BLIS: the
+// gemm_m x gemm_k block of A and the gemm_k x gemm_n block of B stay in L2,
+// while the micro kernel reuses a gemm_k x 16 (or 32) panel of B in L1.
+// gemm_m is a multiple of the register tile heights (6 and 8), gemm_k and
+// gemm_n are multiples of the register tile width (16). The cache sizes it
+// is derived from have the defaults in place of the missing L1 and L2.
+struct CPUBlocking {
+  index_t gemm_m;
+  index_t gemm_k;
+  index_t gemm_n;
+  CPUCacheSizes cache_sizes;
+};
+
+// The blocking tuned for 32K L1 and 256K L2, used if sysfs has no caches.
+CPUBlocking DefaultCPUBlocking();
+
+// The blocking sized for cache_sizes, see CPUBlocking.
+CPUBlocking DeriveCPUBlocking(const CPUCacheSizes &cache_sizes);
+
+// Variants of blocking tried by the calibration, blocking itself first.
+std::vector<CPUBlocking> CPUBlockingCandidates(const CPUBlocking &blocking);
+
+// The cache key of the calibrated blocking, which is only valid for the same
+// instruction set and caches.
+std::string CPUBlockingKey(CPUISA isa, const CPUCacheSizes &cache_sizes);
+
+std::vector<unsigned char> SerializeCPUBlocking(const CPUBlocking &blocking);
+bool DeserializeCPUBlocking(const std::vector<unsigned char> &data,
+                            CPUBlocking *blocking);
+
+// Channels of plane_size floats whose planes fill half of L2, at least one,
+// e.g., the input channels a direct convolution sweeps at a time.
+index_t ConvChannelBlock(const CPUBlocking &blocking, index_t plane_size);
+
+// The blocking of this process, chosen once: derived from the caches of
+// sysfs and, if a KV storage factory is set, calibrated by timing a gemm
+// with the candidates and cached in the storage. Packed gemm operands depend
+// on it, so it never changes afterwards.
+const CPUBlocking &GetCPUBlocking();
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_CPU_BLOCKING_H_
@@ -0,0 +1,88 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "mace/kernels/cpu_blocking.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+
+void ExpectGemmBlocking(index_t m, index_t k, index_t n,
+                        const CPUBlocking &blocking) {
+  EXPECT_EQ(m, blocking.gemm_m);
+  EXPECT_EQ(k, blocking.gemm_k);
+  EXPECT_EQ(n, blocking.gemm_n);
+}
+
+}  // namespace
+
+TEST(CPUBlockingTest, Derive) {
+  ExpectGemmBlocking(72, 128, 128, DefaultCPUBlocking());
+  ExpectGemmBlocking(72, 128, 128,
+                     DeriveCPUBlocking({32 << 10, 256 << 10, 0}));
+  ExpectGemmBlocking(168, 192, 336,
+                     DeriveCPUBlocking({48 << 10, 1 << 20, 32 << 20}));
+  // clamped, and the missing caches take the defaults
+  ExpectGemmBlocking(384, 512, 1024,
+                     DeriveCPUBlocking({1 << 20, 64 << 20, 0}));
+  const CPUBlocking blocking = DeriveCPUBlocking({64 << 10, 0, 0});
+  ExpectGemmBlocking(24, 256, 64, blocking);
+  EXPECT_EQ(256 << 10, blocking.cache_sizes.l2);
+}
+
+TEST(CPUBlockingTest, Candidates) {
+  const CPUBlocking blocking = DeriveCPUBlocking({48 << 10, 1 << 20, 0});
+  const std::vector<CPUBlocking> candidates = CPUBlockingCandidates(blocking);
+  ASSERT_EQ(8u, candidates.size());
+  ExpectGemmBlocking(168, 192, 336, candidates[0]);
+  ExpectGemmBlocking(72, 128, 128, candidates[1]);
+  // the default blocking is not repeated
+  EXPECT_EQ(7u, CPUBlockingCandidates(DefaultCPUBlocking()).size());
+  for (const CPUBlocking &candidate : candidates) {
+    EXPECT_EQ(1 << 20, candidate.cache_sizes.l2);
+  }
+}
+
+TEST(CPUBlockingTest, Serialize) {
+  CPUBlocking blocking = DefaultCPUBlocking();
+  const CPUBlocking derived = DeriveCPUBlocking({48 << 10, 1 << 20, 0});
+  EXPECT_TRUE(DeserializeCPUBlocking(SerializeCPUBlocking(derived),
+                                     &blocking));
+  ExpectGemmBlocking(168, 192, 336, blocking);
+  // the cache sizes are kept
+  EXPECT_EQ(256 << 10, blocking.cache_sizes.l2);
+
+  EXPECT_FALSE(DeserializeCPUBlocking({1, 2, 3}, &blocking));
+  CPUBlocking invalid = derived;
+  invalid.gemm_m = 100;
+  EXPECT_FALSE(DeserializeCPUBlocking(SerializeCPUBlocking(invalid),
+                                      &blocking));
+  ExpectGemmBlocking(168, 192, 336, blocking);
+
+  EXPECT_EQ("gemm_blocking:avx2:49152:1048576:0",
+            CPUBlockingKey(CPU_ISA_AVX2, {48 << 10, 1 << 20, 0}));
+}
+
+TEST(CPUBlockingTest, ConvChannelBlock) {
+  const CPUBlocking blocking = DefaultCPUBlocking();
+  EXPECT_EQ(32, ConvChannelBlock(blocking, 32 * 32));
+  EXPECT_EQ(1, ConvChannelBlock(blocking, 512 * 512));
+}
+
+}  // namespace kernels
+}  // namespace mace
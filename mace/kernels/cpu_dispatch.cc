@@ -0,0 +1,169 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/kernels/cpu_dispatch.h"
+
+#include "mace/kernels/epilogue.h"
+#include "mace/kernels/gemm.h"
+#include "mace/kernels/pooling.h"
+#include "mace/kernels/sparse_gemm.h"
+#include "mace/kernels/arm/conv_2d_neon.h"
+#include "mace/kernels/arm/depthwise_conv2d_neon.h"
+#include "mace/kernels/x86/activation_x86.h"
+#include "mace/kernels/x86/conv_2d_x86.h"
+#include "mace/kernels/x86/gemm_avx2.h"
+#include "mace/kernels/x86/gemm_avx512.h"
+#include "mace/kernels/x86/gemm_sse.h"
+#include "mace/utils/logging.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+
+// NEON builds compile the defaults with NEON intrinsics
+#if defined(MACE_ENABLE_NEON)
+const CPUISA kDefaultISA = CPU_ISA_NEON;
+#else
+const CPUISA kDefaultISA = CPU_ISA_GENERIC;
+#endif
+
+const CPUKernelTable kDefaultKernels = {
+    kDefaultISA,
+    GemmTileDefault,
+    GemvDefault,
+    SkinnyGemmDefault,
+    BlockSparseGemmDefault,
+    BlockSparseGemvDefault,
+    BiasClampDefault,
+    Conv2dNeonK3x3S1,
+    Conv2dNeonK3x3S2,
+    Conv2dNeonK5x5S1,
+    Conv2dNeonK1x7S1,
+    Conv2dNeonK7x1S1,
+    Conv2dNeonK7x7S1,
+    Conv2dNeonK7x7S2,
+    Conv2dNeonK7x7S3,
+    Conv2dNeonK1x15S1,
+    Conv2dNeonK15x1S1,
+    DepthwiseConv2dNeonK3x3S1,
+    DepthwiseConv2dNeonK3x3S2,
+    MaxPoolingDefault,
+    AvgPoolingDefault,
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+const CPUKernelTable kSSE42Kernels = {
+    CPU_ISA_SSE42,
+    GemmTileSSE,
+    GemvSSE,
+    SkinnyGemmSSE,
+    BlockSparseGemmSSE,
+    BlockSparseGemvSSE,
+    BiasClampSSE,
+    Conv2dK3x3S1SSE,
+    Conv2dK3x3S2SSE,
+    Conv2dK5x5S1SSE,
+    Conv2dK1x7S1SSE,
+    Conv2dK7x1S1SSE,
+    Conv2dK7x7S1SSE,
+    Conv2dK7x7S2SSE,
+    Conv2dK7x7S3SSE,
+    Conv2dK1x15S1SSE,
+    Conv2dK15x1S1SSE,
+    DepthwiseConv2dK3x3S1SSE,
+    DepthwiseConv2dK3x3S2SSE,
+    MaxPoolingDefault,
+    AvgPoolingDefault,
+};
+
+// the sparse blocks are 4 floats wide, the SSE Gemv fits them
+const CPUKernelTable kAVX2Kernels = {
+    CPU_ISA_AVX2,
+    GemmTileAVX2,
+    GemvAVX2,
+    SkinnyGemmAVX2,
+    BlockSparseGemmAVX2,
+    BlockSparseGemvSSE,
+    BiasClampAVX2,
+    Conv2dK3x3S1AVX2,
+    Conv2dK3x3S2AVX2,
+    Conv2dK5x5S1AVX2,
+    Conv2dK1x7S1AVX2,
+    Conv2dK7x1S1AVX2,
+    Conv2dK7x7S1AVX2,
+    Conv2dK7x7S2AVX2,
+    Conv2dK7x7S3AVX2,
+    Conv2dK1x15S1AVX2,
+    Conv2dK15x1S1AVX2,
+    DepthwiseConv2dK3x3S1AVX2,
+    DepthwiseConv2dK3x3S2AVX2,
+    MaxPoolingDefault,
+    AvgPoolingDefault,
+};
+
+// GEMV and the sparse kernels are bound by memory bandwidth, wider vectors
+// do not pay off, nor do they for the direct convolutions, whose rows are
+// rarely a multiple of 16
+const CPUKernelTable kAVX512Kernels = {
+    CPU_ISA_AVX512,
+    GemmTileAVX512,
+    GemvAVX2,
+    SkinnyGemmAVX2,
+    BlockSparseGemmAVX2,
+    BlockSparseGemvSSE,
+    BiasClampAVX512,
+    Conv2dK3x3S1AVX2,
+    Conv2dK3x3S2AVX2,
+    Conv2dK5x5S1AVX2,
+    Conv2dK1x7S1AVX2,
+    Conv2dK7x1S1AVX2,
+    Conv2dK7x7S1AVX2,
+    Conv2dK7x7S2AVX2,
+    Conv2dK7x7S3AVX2,
+    Conv2dK1x15S1AVX2,
+    Conv2dK15x1S1AVX2,
+    DepthwiseConv2dK3x3S1AVX2,
+    DepthwiseConv2dK3x3S2AVX2,
+    MaxPoolingDefault,
+    AvgPoolingDefault,
+};
+#endif  // __x86_64__ || __i386__
+
+}  // namespace
+
+const CPUKernelTable &GetCPUKernels(CPUISA isa) {
+  MACE_CHECK(IsCPUISASupported(isa, DetectCPUISA()), "CPU ISA ",
+             CPUISAToString(isa), " is not supported");
+  switch (isa) {
+#if defined(__x86_64__) || defined(__i386__)
+    case CPU_ISA_SSE42:
+      return kSSE42Kernels;
+    case CPU_ISA_AVX2:
+      return kAVX2Kernels;
+    case CPU_ISA_AVX512:
+      return kAVX512Kernels;
+#endif  // __x86_64__ || __i386__
+    default:
+      return kDefaultKernels;
+  }
+}
+
+const CPUKernelTable &GetCPUKernels() {
+  static const CPUKernelTable &kernels = GetCPUKernels(GetCPUISA());
+  return kernels;
+}
+
+}  // namespace kernels
+}  // namespace mace
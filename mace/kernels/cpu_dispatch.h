@@ -0,0 +1,164 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_CPU_DISPATCH_H_
+#define MACE_KERNELS_CPU_DISPATCH_H_
+
+#include "mace/core/runtime/cpu/cpu_runtime.h"
+#include "mace/core/types.h"
+#include "mace/kernels/epilogue.h"
+
+namespace mace {
+namespace kernels {
+
+// The kernels apply the epilogue, if not null, to their finished output.
+
+// C[height, width] += A[height, K] * B[K, width], all row major with strides.
+// The epilogue applies to the block of C, i.e., it is offset to the block.
+typedef void (*GemmTileFunc)(const float *A,
+                             const float *B,
+                             const index_t height,
+                             const index_t K,
+                             const index_t width,
+                             const index_t stride_a,
+                             const index_t stride_b,
+                             const index_t stride_c,
+                             const Epilogue *epilogue,
+                             float *C);
+
+// out[b, h] = sum_w m[h, w] * v[b, w], h is the channel of the epilogue
+typedef void (*GemvFunc)(const float *m_ptr,
+                         const float *v_ptr,
+                         const index_t batch,
+                         const index_t width,
+                         const index_t height,
+                         const Epilogue *epilogue,
+                         float *out_ptr);
+
+// out[b, h] = sum_k m[h, k] * v[b, k] for k < K and a few b, i.e., a skinny
+// Gemv computing a slice of K. Rows of m and v are stride apart, those of out
+// out_stride apart. It is single threaded, callers split the work.
+typedef void (*SkinnyGemmFunc)(const float *m_ptr,
+                               const float *v_ptr,
+                               const index_t batch,
+                               const index_t K,
+                               const index_t height,
+                               const index_t stride,
+                               const index_t out_stride,
+                               float *out_ptr);
+
+// C[r, w] = sum_j sum_c values[j][r][c] * B[block_col[j] + c, w] for the
+// num_blocks block_rows x 4 blocks of one block row of a BlockSparseMatrix,
+// i.e., the block_rows x width rows of C. It is single threaded.
+typedef void (*BlockSparseGemmFunc)(const float *values,
+                                    const int32_t *block_col,
+                                    const index_t num_blocks,
+                                    const index_t block_rows,
+                                    const float *B,
+                                    const index_t width,
+                                    const index_t stride_b,
+                                    const index_t stride_c,
+                                    float *C);
+
+// out[r] = sum_j sum_c values[j][r][c] * v[block_col[j] + c], the Gemv of
+// one block row like BlockSparseGemmFunc.
+typedef void (*BlockSparseGemvFunc)(const float *values,
+                                    const int32_t *block_col,
+                                    const index_t num_blocks,
+                                    const index_t block_rows,
+                                    const float *v,
+                                    float *out);
+
+// output[i] = min(max(input[i] + bias, lower), upper), i.e., bias with RELU or
+// RELUX. It is single threaded, callers split the work.
+typedef void (*BiasClampFunc)(const float *input,
+                              const index_t size,
+                              const float bias,
+                              const float lower,
+                              const float upper,
+                              float *output);
+
+typedef void (*Conv2dK3x3Func)(const float *input,
+                               const float *filter,
+                               const index_t *in_shape,
+                               const index_t *out_shape,
+                               const Epilogue *epilogue,
+                               float *output);
+
+// The direct kernels of the other filters, whose epilogue is left to the
+// caller.
+typedef void (*Conv2dDirectFunc)(const float *input,
+                                 const float *filter,
+                                 const index_t *in_shape,
+                                 const index_t *out_shape,
+                                 float *output);
+
+typedef void (*DepthwiseConv2dK3x3Func)(const float *input,
+                                        const float *filter,
+                                        const index_t *in_shape,
+                                        const index_t *out_shape,
+                                        const int *pad_hw,
+                                        const index_t valid_h_start,
+                                        const index_t valid_h_stop,
+                                        const index_t valid_w_start,
+                                        const index_t valid_w_stop,
+                                        const Epilogue *epilogue,
+                                        float *output);
+
+typedef void (*PoolingFunc)(const float *input,
+                            const index_t *in_shape,
+                            const index_t *out_shape,
+                            const int *filter_hw,
+                            const int *stride_hw,
+                            const int *dilation_hw,
+                            const int *pad_hw,
+                            float *output);
+
+// The hot CPU kernels built for one instruction set. Slots without a
+// dedicated variant hold the one of the next lower instruction set.
+struct CPUKernelTable {
+  CPUISA isa;
+  GemmTileFunc gemm_tile;
+  GemvFunc gemv;
+  SkinnyGemmFunc skinny_gemm;
+  BlockSparseGemmFunc block_sparse_gemm;
+  BlockSparseGemvFunc block_sparse_gemv;
+  BiasClampFunc bias_clamp;
+  Conv2dK3x3Func conv_2d_3x3s1;
+  Conv2dK3x3Func conv_2d_3x3s2;
+  Conv2dDirectFunc conv_2d_5x5s1;
+  Conv2dDirectFunc conv_2d_1x7s1;
+  Conv2dDirectFunc conv_2d_7x1s1;
+  Conv2dDirectFunc conv_2d_7x7s1;
+  Conv2dDirectFunc conv_2d_7x7s2;
+  Conv2dDirectFunc conv_2d_7x7s3;
+  Conv2dDirectFunc conv_2d_1x15s1;
+  Conv2dDirectFunc conv_2d_15x1s1;
+  DepthwiseConv2dK3x3Func depthwise_conv_2d_3x3s1;
+  DepthwiseConv2dK3x3Func depthwise_conv_2d_3x3s2;
+  PoolingFunc max_pooling;
+  PoolingFunc avg_pooling;
+};
+
+// Kernels for isa, which must be supported by the running cpu.
+const CPUKernelTable &GetCPUKernels(CPUISA isa);
+
+// Kernels for GetCPUISA(), i.e., the best instruction set unless overridden
+// by MACE_CPU_ISA.
+const CPUKernelTable &GetCPUKernels();
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_CPU_DISPATCH_H_
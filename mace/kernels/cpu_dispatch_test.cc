@@ -0,0 +1,448 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "mace/kernels/cpu_dispatch.h"
+#include "mace/kernels/gemm.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+
+std::vector<CPUISA> SupportedISAs() {
+  std::vector<CPUISA> isas;
+  for (CPUISA isa : {CPU_ISA_GENERIC, CPU_ISA_NEON, CPU_ISA_SSE42,
+                     CPU_ISA_AVX2, CPU_ISA_AVX512}) {
+    if (IsCPUISASupported(isa, DetectCPUISA())) {
+      isas.push_back(isa);
+    }
+  }
+  return isas;
+}
+
+void RandomFill(float *data, index_t size) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::normal_distribution<float> nd(0, 1);
+  std::generate(data, data + size, [&gen, &nd] { return nd(gen); });
+}
+
+// the tile is a strided block of bigger matrices
+void GemmTileTest(const CPUKernelTable &kernels,
+                  index_t height,
+                  index_t K,
+                  index_t width,
+                  const Epilogue *epilogue = nullptr) {
+  const index_t stride_a = K + 3;
+  const index_t stride_b = width + 5;
+  const index_t stride_c = width + 7;
+  std::vector<float> A(height * stride_a);
+  std::vector<float> B(K * stride_b);
+  std::vector<float> C(height * stride_c);
+  RandomFill(A.data(), A.size());
+  RandomFill(B.data(), B.size());
+  RandomFill(C.data(), C.size());
+  std::vector<float> C_ref(C);
+  for (index_t h = 0; h < height; ++h) {
+    for (index_t w = 0; w < width; ++w) {
+      for (index_t k = 0; k < K; ++k) {
+        C_ref[h * stride_c + w] += A[h * stride_a + k] * B[k * stride_b + w];
+      }
+      if (epilogue != nullptr) {
+        C_ref[h * stride_c + w] = ApplyEpilogue(
+            *epilogue, epilogue->per_column ? w : h, C_ref[h * stride_c + w]);
+      }
+    }
+  }
+
+  kernels.gemm_tile(A.data(), B.data(), height, K, width, stride_a, stride_b,
+                    stride_c, epilogue, C.data());
+  for (size_t i = 0; i < C.size(); ++i) {
+    EXPECT_NEAR(C_ref[i], C[i], 1e-3) << CPUISAToString(kernels.isa);
+  }
+}
+
+void GemvTest(const CPUKernelTable &kernels,
+              index_t batch,
+              index_t height,
+              index_t width,
+              const Epilogue *epilogue = nullptr) {
+  std::vector<float> m(height * width);
+  std::vector<float> v(batch * width);
+  std::vector<float> out(batch * height);
+  std::vector<float> out_ref(batch * height);
+  RandomFill(m.data(), m.size());
+  RandomFill(v.data(), v.size());
+
+  kernels.gemv(m.data(), v.data(), batch, width, height, epilogue,
+               out.data());
+  GemvRef(m.data(), v.data(), batch, width, height, out_ref.data());
+  if (epilogue != nullptr) {
+    for (size_t i = 0; i < out_ref.size(); ++i) {
+      out_ref[i] = ApplyEpilogue(*epilogue, i % height, out_ref[i]);
+    }
+  }
+  for (size_t i = 0; i < out.size(); ++i) {
+    EXPECT_NEAR(out_ref[i], out[i], 1e-3) << CPUISAToString(kernels.isa);
+  }
+}
+
+// a K slice of bigger matrices
+void SkinnyGemmTest(const CPUKernelTable &kernels,
+                    index_t batch,
+                    index_t height,
+                    index_t K) {
+  const index_t stride = K + 5;
+  const index_t out_stride = height + 3;
+  std::vector<float> m(height * stride);
+  std::vector<float> v(batch * stride);
+  std::vector<float> out(batch * out_stride, -1);
+  RandomFill(m.data(), m.size());
+  RandomFill(v.data(), v.size());
+  std::vector<float> out_ref(out);
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t h = 0; h < height; ++h) {
+      float sum = 0;
+      for (index_t k = 0; k < K; ++k) {
+        sum += m[h * stride + k] * v[b * stride + k];
+      }
+      out_ref[b * out_stride + h] = sum;
+    }
+  }
+
+  kernels.skinny_gemm(m.data(), v.data(), batch, K, height, stride,
+                      out_stride, out.data());
+  for (size_t i = 0; i < out.size(); ++i) {
+    EXPECT_NEAR(out_ref[i], out[i], 1e-3) << CPUISAToString(kernels.isa);
+  }
+}
+
+// num_blocks random blocks of a block row over cols columns, C is a strided
+// block of a bigger matrix
+void BlockSparseTest(const CPUKernelTable &kernels,
+                     index_t block_rows,
+                     index_t num_blocks,
+                     index_t cols,
+                     index_t width) {
+  const index_t block_size = block_rows * 4;
+  std::vector<float> values(num_blocks * block_size);
+  RandomFill(values.data(), values.size());
+  std::vector<int32_t> block_col(num_blocks);
+  std::mt19937 gen(num_blocks);
+  std::uniform_int_distribution<int32_t> col(0, cols - 4);
+  std::generate(block_col.begin(), block_col.end(),
+                [&gen, &col] { return col(gen); });
+
+  const index_t stride_b = width + 3;
+  const index_t stride_c = width + 5;
+  std::vector<float> B(cols * stride_b);
+  RandomFill(B.data(), B.size());
+  std::vector<float> C(block_rows * stride_c, -1);
+  std::vector<float> C_ref(C);
+  std::vector<float> out(block_rows);
+  std::vector<float> out_ref(block_rows, 0);
+  for (index_t r = 0; r < block_rows; ++r) {
+    for (index_t w = 0; w < width; ++w) {
+      C_ref[r * stride_c + w] = 0;
+    }
+    for (index_t j = 0; j < num_blocks; ++j) {
+      for (index_t c = 0; c < 4; ++c) {
+        const float a = values[j * block_size + r * 4 + c];
+        for (index_t w = 0; w < width; ++w) {
+          C_ref[r * stride_c + w] += a * B[(block_col[j] + c) * stride_b + w];
+        }
+        // the first cols floats of B are the vector
+        out_ref[r] += a * B[block_col[j] + c];
+      }
+    }
+  }
+
+  kernels.block_sparse_gemm(values.data(), block_col.data(), num_blocks,
+                            block_rows, B.data(), width, stride_b, stride_c,
+                            C.data());
+  for (size_t i = 0; i < C.size(); ++i) {
+    EXPECT_NEAR(C_ref[i], C[i], 1e-3) << CPUISAToString(kernels.isa);
+  }
+  kernels.block_sparse_gemv(values.data(), block_col.data(), num_blocks,
+                            block_rows, B.data(), out.data());
+  for (index_t r = 0; r < block_rows; ++r) {
+    EXPECT_NEAR(out_ref[r], out[r], 1e-3) << CPUISAToString(kernels.isa);
+  }
+}
+
+// The padded input is as wide as the output needs, the vectors of the last
+// pixels of a row reach past it
+void Conv2dDirectTest(const CPUKernelTable &kernels,
+                      Conv2dK3x3Func conv_2d_3x3,
+                      Conv2dDirectFunc conv_2d,
+                      index_t filter_h,
+                      index_t filter_w,
+                      int stride,
+                      const Epilogue *epilogue = nullptr) {
+  const index_t out_shape[4] = {2, 6, 4, 28};
+  const index_t in_shape[4] = {2, 3, (out_shape[2] - 1) * stride + filter_h,
+                               (out_shape[3] - 1) * stride + filter_w};
+  const index_t in_image_size = in_shape[2] * in_shape[3];
+  const index_t out_image_size = out_shape[2] * out_shape[3];
+  std::vector<float> input(in_shape[0] * in_shape[1] * in_image_size);
+  std::vector<float> filter(out_shape[1] * in_shape[1] * filter_h * filter_w);
+  RandomFill(input.data(), input.size());
+  RandomFill(filter.data(), filter.size());
+  // the default kernels accumulate
+  std::vector<float> output(out_shape[0] * out_shape[1] * out_image_size, 0);
+  std::vector<float> output_ref(output.size());
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t m = 0; m < out_shape[1]; ++m) {
+      for (index_t h = 0; h < out_shape[2]; ++h) {
+        for (index_t w = 0; w < out_shape[3]; ++w) {
+          float sum = 0;
+          for (index_t c = 0; c < in_shape[1]; ++c) {
+            for (index_t kh = 0; kh < filter_h; ++kh) {
+              for (index_t kw = 0; kw < filter_w; ++kw) {
+                sum += input[(b * in_shape[1] + c) * in_image_size +
+                             (h * stride + kh) * in_shape[3] + w * stride +
+                             kw] *
+                       filter[((m * in_shape[1] + c) * filter_h + kh) *
+                              filter_w + kw];
+              }
+            }
+          }
+          output_ref[(b * out_shape[1] + m) * out_image_size +
+                     h * out_shape[3] + w] =
+              epilogue == nullptr ? sum : ApplyEpilogue(*epilogue, m, sum);
+        }
+      }
+    }
+  }
+
+  if (conv_2d_3x3 != nullptr) {
+    conv_2d_3x3(input.data(), filter.data(), in_shape, out_shape, epilogue,
+                output.data());
+  } else {
+    conv_2d(input.data(), filter.data(), in_shape, out_shape, output.data());
+  }
+  for (size_t i = 0; i < output.size(); ++i) {
+    EXPECT_NEAR(output_ref[i], output[i], 1e-3)
+        << CPUISAToString(kernels.isa) << " " << filter_h << "x" << filter_w
+        << " stride " << stride << " index " << i;
+  }
+}
+
+// 3x3 over the unpadded input, padded by 1 on each side
+void DepthwiseConv2dTest(const CPUKernelTable &kernels,
+                         index_t height,
+                         index_t width,
+                         int stride,
+                         const Epilogue *epilogue = nullptr) {
+  const index_t multiplier = 2;
+  const index_t in_shape[4] = {2, 3, height, width};
+  const index_t out_shape[4] = {2, 3 * multiplier, (height - 1) / stride + 1,
+                                (width - 1) / stride + 1};
+  const int pad_hw[2] = {1, 1};
+  const index_t valid_h_stop = out_shape[2] - 1;
+  const index_t valid_w_stop = out_shape[3] - 1;
+  const index_t in_image_size = height * width;
+  const index_t out_image_size = out_shape[2] * out_shape[3];
+  std::vector<float> input(in_shape[0] * in_shape[1] * in_image_size);
+  std::vector<float> filter(multiplier * in_shape[1] * 9);
+  RandomFill(input.data(), input.size());
+  RandomFill(filter.data(), filter.size());
+  std::vector<float> output(out_shape[0] * out_shape[1] * out_image_size, -1);
+  std::vector<float> output_ref(output.size());
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t m = 0; m < out_shape[1]; ++m) {
+      const index_t c = m / multiplier;
+      const float *filter_ptr =
+          filter.data() + (m % multiplier * in_shape[1] + c) * 9;
+      for (index_t h = 0; h < out_shape[2]; ++h) {
+        for (index_t w = 0; w < out_shape[3]; ++w) {
+          float sum = 0;
+          for (index_t kh = 0; kh < 3; ++kh) {
+            for (index_t kw = 0; kw < 3; ++kw) {
+              const index_t ih = h * stride - pad_hw[0] + kh;
+              const index_t iw = w * stride - pad_hw[1] + kw;
+              if (ih >= 0 && ih < height && iw >= 0 && iw < width) {
+                sum += input[(b * in_shape[1] + c) * in_image_size +
+                             ih * width + iw] * filter_ptr[kh * 3 + kw];
+              }
+            }
+          }
+          output_ref[(b * out_shape[1] + m) * out_image_size +
+                     h * out_shape[3] + w] =
+              epilogue == nullptr ? sum : ApplyEpilogue(*epilogue, m, sum);
+        }
+      }
+    }
+  }
+
+  const DepthwiseConv2dK3x3Func depthwise_conv_2d_3x3 =
+      stride == 1 ? kernels.depthwise_conv_2d_3x3s1
+                  : kernels.depthwise_conv_2d_3x3s2;
+  depthwise_conv_2d_3x3(input.data(), filter.data(), in_shape, out_shape,
+                        pad_hw, 1, valid_h_stop, 1, valid_w_stop, epilogue,
+                        output.data());
+  for (size_t i = 0; i < output.size(); ++i) {
+    EXPECT_NEAR(output_ref[i], output[i], 1e-3)
+        << CPUISAToString(kernels.isa) << " stride " << stride << " index "
+        << i;
+  }
+}
+
+}  // namespace
+
+TEST(CPUDispatchTest, DefaultISA) {
+  EXPECT_EQ(GetCPUISA(), GetCPUKernels().isa);
+  EXPECT_TRUE(IsCPUISASupported(GetCPUISA(), DetectCPUISA()));
+}
+
+TEST(CPUDispatchTest, GemmTile) {
+  for (CPUISA isa : SupportedISAs()) {
+    const CPUKernelTable &kernels = GetCPUKernels(isa);
+    EXPECT_EQ(isa, kernels.isa);
+    GemmTileTest(kernels, 1, 1, 1);
+    GemmTileTest(kernels, 6, 17, 16);
+    GemmTileTest(kernels, 8, 64, 32);
+    GemmTileTest(kernels, 13, 31, 45);
+    GemmTileTest(kernels, 72, 128, 128);
+  }
+}
+
+TEST(CPUDispatchTest, Gemv) {
+  for (CPUISA isa : SupportedISAs()) {
+    const CPUKernelTable &kernels = GetCPUKernels(isa);
+    GemvTest(kernels, 1, 1, 1);
+    GemvTest(kernels, 1, 7, 13);
+    GemvTest(kernels, 3, 33, 67);
+  }
+}
+
+TEST(CPUDispatchTest, SkinnyGemm) {
+  for (CPUISA isa : SupportedISAs()) {
+    const CPUKernelTable &kernels = GetCPUKernels(isa);
+    for (index_t batch : {1, 2, 3, 16}) {
+      SkinnyGemmTest(kernels, batch, 1, 1);
+      SkinnyGemmTest(kernels, batch, 4, 0);
+      SkinnyGemmTest(kernels, batch, 7, 13);
+      SkinnyGemmTest(kernels, batch, 16, 64);
+      SkinnyGemmTest(kernels, batch, 13, 131);
+    }
+  }
+}
+
+TEST(CPUDispatchTest, BlockSparse) {
+  for (CPUISA isa : SupportedISAs()) {
+    const CPUKernelTable &kernels = GetCPUKernels(isa);
+    for (index_t block_rows : {1, 4}) {
+      BlockSparseTest(kernels, block_rows, 0, 4, 8);
+      BlockSparseTest(kernels, block_rows, 1, 4, 1);
+      BlockSparseTest(kernels, block_rows, 3, 9, 13);
+      BlockSparseTest(kernels, block_rows, 17, 64, 32);
+      BlockSparseTest(kernels, block_rows, 40, 131, 67);
+    }
+  }
+}
+
+TEST(CPUDispatchTest, Epilogue) {
+  std::vector<float> bias(256);
+  RandomFill(bias.data(), bias.size());
+  std::vector<Epilogue> epilogues = {
+      Epilogue(bias.data(), NOOP, 0),
+      Epilogue(bias.data(), RELU, 0),
+      Epilogue(bias.data(), RELUX, 0.5f),
+      Epilogue(nullptr, RELUX, 6),
+      Epilogue(bias.data(), TANH, 0),
+      Epilogue(nullptr, SIGMOID, 0),
+  };
+  for (CPUISA isa : SupportedISAs()) {
+    const CPUKernelTable &kernels = GetCPUKernels(isa);
+    for (Epilogue epilogue : epilogues) {
+      for (bool per_column : {false, true}) {
+        epilogue.per_column = per_column;
+        GemmTileTest(kernels, 1, 1, 1, &epilogue);
+        GemmTileTest(kernels, 6, 17, 16, &epilogue);
+        GemmTileTest(kernels, 13, 31, 45, &epilogue);
+        GemmTileTest(kernels, 72, 128, 128, &epilogue);
+      }
+      GemvTest(kernels, 1, 7, 13, &epilogue);
+      GemvTest(kernels, 3, 33, 67, &epilogue);
+    }
+  }
+}
+
+TEST(CPUDispatchTest, Conv2dDirect) {
+  std::vector<float> bias(6);
+  RandomFill(bias.data(), bias.size());
+  const Epilogue epilogue(bias.data(), RELU, 0);
+  for (CPUISA isa : SupportedISAs()) {
+    const CPUKernelTable &k = GetCPUKernels(isa);
+    Conv2dDirectTest(k, k.conv_2d_3x3s1, nullptr, 3, 3, 1);
+    Conv2dDirectTest(k, k.conv_2d_3x3s2, nullptr, 3, 3, 2);
+    Conv2dDirectTest(k, k.conv_2d_3x3s1, nullptr, 3, 3, 1, &epilogue);
+    Conv2dDirectTest(k, k.conv_2d_3x3s2, nullptr, 3, 3, 2, &epilogue);
+    Conv2dDirectTest(k, nullptr, k.conv_2d_5x5s1, 5, 5, 1);
+    Conv2dDirectTest(k, nullptr, k.conv_2d_1x7s1, 1, 7, 1);
+    Conv2dDirectTest(k, nullptr, k.conv_2d_7x1s1, 7, 1, 1);
+    Conv2dDirectTest(k, nullptr, k.conv_2d_7x7s1, 7, 7, 1);
+    Conv2dDirectTest(k, nullptr, k.conv_2d_7x7s2, 7, 7, 2);
+    Conv2dDirectTest(k, nullptr, k.conv_2d_7x7s3, 7, 7, 3);
+    Conv2dDirectTest(k, nullptr, k.conv_2d_1x15s1, 1, 15, 1);
+    Conv2dDirectTest(k, nullptr, k.conv_2d_15x1s1, 15, 1, 1);
+  }
+}
+
+TEST(CPUDispatchTest, DepthwiseConv2d) {
+  std::vector<float> bias(6);
+  RandomFill(bias.data(), bias.size());
+  const Epilogue epilogue(bias.data(), RELUX, 1);
+  for (CPUISA isa : SupportedISAs()) {
+    const CPUKernelTable &kernels = GetCPUKernels(isa);
+    for (int stride : {1, 2}) {
+      DepthwiseConv2dTest(kernels, 13, 30, stride);
+      DepthwiseConv2dTest(kernels, 5, 7, stride);
+      DepthwiseConv2dTest(kernels, 9, 53, stride, &epilogue);
+    }
+  }
+}
+
+TEST(CPUDispatchTest, BiasClamp) {
+  const float nan = std::numeric_limits<float>::quiet_NaN();
+  std::vector<float> input = {-2, -0.5f, 0, 0.5f, 2, 6, 7, nan};
+  for (int i = 0; i < 29; ++i) {
+    input.push_back(i - 10.5f);
+  }
+  for (CPUISA isa : SupportedISAs()) {
+    const CPUKernelTable &kernels = GetCPUKernels(isa);
+    std::vector<float> output(input.size());
+    kernels.bias_clamp(input.data(), input.size(), 1.5f, 0, 6,
+                       output.data());
+    for (size_t i = 0; i < input.size(); ++i) {
+      if (std::isnan(input[i])) {
+        EXPECT_TRUE(std::isnan(output[i])) << CPUISAToString(isa);
+      } else {
+        EXPECT_EQ(std::min(std::max(input[i] + 1.5f, 0.f), 6.f), output[i])
+            << CPUISAToString(isa);
+      }
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
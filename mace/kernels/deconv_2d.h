@@ -40,7 +40,7 @@ namespace deconv {
 template<typename T>
 void Deconv2dNCHW(const T *input,
                   const T *filter,
-                  const T *bias,
+                  const Epilogue &epilogue,
                   const index_t *in_shape,
                   const index_t *out_shape,
                   const index_t *kernel_hw,
@@ -79,9 +79,7 @@ void Deconv2dNCHW(const T *input,
               }
             }
           }
-          if (bias != nullptr)
-            out_value += bias[oc];
-          output[out_pos] = out_value;
+          output[out_pos] = ApplyEpilogue(epilogue, oc, out_value);
         }
       }
     }
@@ -283,9 +281,10 @@ struct Deconv2dFunctor : Deconv2dFunctorBase {
     int padding[2];
     padding[0] = (paddings_[0] + 1) >> 1;
     padding[1] = (paddings_[1] + 1) >> 1;
+    const Epilogue epilogue(bias_data, activation_, relux_max_limit_);
     deconv::Deconv2dNCHW(input_data,
                          filter_data,
-                         bias_data,
+                         epilogue,
                          in_shape,
                          out_shape,
                          kernel_hw,
@@ -293,12 +292,6 @@ struct Deconv2dFunctor : Deconv2dFunctorBase {
                          padding,
                          output_data);
 
-    DoActivation(output_data,
-                 output_data,
-                 output->size(),
-                 activation_,
-                 relux_max_limit_);
-
     return MACE_SUCCESS;
   }
 };
@@ -25,6 +25,7 @@
 #include "mace/core/future.h"
 #include "mace/kernels/conv_pool_2d_util.h"
 #include "mace/kernels/activation.h"
+#include "mace/kernels/cpu_dispatch.h"
 #include "mace/kernels/arm/depthwise_conv2d_neon.h"
 #include "mace/public/mace.h"
 
@@ -84,6 +85,7 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
                               const int *stride_hw,
                               const int *dilation_hw,
                               const int *pad_hw,
+                              const Epilogue *epilogue,
                               float *output) {
     const index_t multiplier = filter_shape[0] / filter_shape[1];
 #pragma omp parallel for collapse(2)
@@ -120,7 +122,8 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
                 }
               }
             }
-            output[out_offset] = sum;
+            output[out_offset] =
+                epilogue == nullptr ? sum : ApplyEpilogue(*epilogue, m, sum);
           }
         }
       }
@@ -212,6 +215,8 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
     auto filter_data = filter->data<float>();
     auto bias_data = bias == nullptr ? nullptr : bias->data<float>();
     auto output_data = output->mutable_data<float>();
+    const Epilogue epilogue(bias_data, activation_, relux_max_limit_);
+    const Epilogue *epilogue_ptr = epilogue.IsNoop() ? nullptr : &epilogue;
 
     const int pad_hw[2] = {pad_top, pad_left};
     const index_t input_shape[4] =
@@ -219,31 +224,37 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
 
     if (filter_h == 3 && filter_w == 3 && stride_h == 1 && stride_w == 1
       && dilation_h == 1 && dilation_w == 1) {
+      const DepthwiseConv2dK3x3Func depthwise_conv_2d_3x3 =
+          GetCPUKernels().depthwise_conv_2d_3x3s1;
       conv_func = [=](const float *input, float *output) {
-        DepthwiseConv2dNeonK3x3S1(input,
-                                  filter_data,
-                                  input_shape,
-                                  output_shape.data(),
-                                  pad_hw,
-                                  valid_h_start,
-                                  valid_h_stop,
-                                  valid_w_start,
-                                  valid_w_stop,
-                                  output);
+        depthwise_conv_2d_3x3(input,
+                              filter_data,
+                              input_shape,
+                              output_shape.data(),
+                              pad_hw,
+                              valid_h_start,
+                              valid_h_stop,
+                              valid_w_start,
+                              valid_w_stop,
+                              epilogue_ptr,
+                              output);
       };
     } else if (filter_h == 3 && filter_w == 3 && stride_h == 2 && stride_w == 2
       && dilation_h == 1 && dilation_w == 1) {
+      const DepthwiseConv2dK3x3Func depthwise_conv_2d_3x3 =
+          GetCPUKernels().depthwise_conv_2d_3x3s2;
       conv_func = [=](const float *input, float *output) {
-        DepthwiseConv2dNeonK3x3S2(input,
-                                  filter_data,
-                                  input_shape,
-                                  output_shape.data(),
-                                  pad_hw,
-                                  valid_h_start,
-                                  valid_h_stop,
-                                  valid_w_start,
-                                  valid_w_stop,
-                                  output);
+        depthwise_conv_2d_3x3(input,
+                              filter_data,
+                              input_shape,
+                              output_shape.data(),
+                              pad_hw,
+                              valid_h_start,
+                              valid_h_stop,
+                              valid_w_start,
+                              valid_w_stop,
+                              epilogue_ptr,
+                              output);
       };
     } else {
       conv_func = [=](const float *input, float *output) {
@@ -255,27 +266,13 @@ struct DepthwiseConv2dFunctor<DeviceType::CPU, float>
                                strides_,
                                dilations_,
                                pad_hw,
+                               epilogue_ptr,
                                output);
       };
     }
 
     conv_func(input_data, output_data);
 
-    if (bias_data != nullptr) {
-#pragma omp parallel for collapse(2)
-      for (index_t b = 0; b < batch; ++b) {
-        for (index_t c = 0; c < channels; ++c) {
-          for (index_t i = 0; i < height * width; ++i) {
-            output_data[(b * channels + c) * height * width + i] +=
-              bias_data[c];
-          }
-        }
-      }
-    }
-
-    DoActivation(output_data, output_data, output->size(), activation_,
-                 relux_max_limit_);
-
     return MACE_SUCCESS;
   }
 };
@@ -0,0 +1,88 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/kernels/epilogue.h"
+
+#include "mace/kernels/cpu_dispatch.h"
+#include "mace/utils/logging.h"
+
+namespace mace {
+namespace kernels {
+
+void BiasClampDefault(const float *input,
+                      const index_t size,
+                      const float bias,
+                      const float lower,
+                      const float upper,
+                      float *output) {
+  for (index_t i = 0; i < size; ++i) {
+    output[i] = std::min(std::max(input[i] + bias, lower), upper);
+  }
+}
+
+void ApplyEpilogue(const Epilogue &epilogue,
+                   const index_t channel,
+                   const float *input,
+                   const index_t size,
+                   float *output) {
+  if (epilogue.IsBiasClamp()) {
+    const float bias =
+        epilogue.bias == nullptr ? 0 : epilogue.bias[channel];
+    GetCPUKernels().bias_clamp(input, size, bias, epilogue.lower(),
+                               epilogue.upper(), output);
+  } else {
+    MACE_CHECK(epilogue.activation != PRELU ||
+               epilogue.prelu_alpha != nullptr, "PRELU without alpha");
+    for (index_t i = 0; i < size; ++i) {
+      output[i] = ApplyEpilogue(epilogue, channel, input[i]);
+    }
+  }
+}
+
+void ApplyEpilogue(const Epilogue &epilogue,
+                   const index_t rows,
+                   const index_t cols,
+                   const index_t stride,
+                   float *output) {
+  for (index_t h = 0; h < rows; ++h) {
+    float *output_row = output + h * stride;
+    if (epilogue.per_column) {
+      for (index_t w = 0; w < cols; ++w) {
+        output_row[w] = ApplyEpilogue(epilogue, w, output_row[w]);
+      }
+    } else {
+      ApplyEpilogue(epilogue, h, output_row, cols, output_row);
+    }
+  }
+}
+
+void ApplyEpilogueNCHW(const Epilogue &epilogue,
+                       const index_t batch,
+                       const index_t channels,
+                       const index_t image_size,
+                       float *output) {
+  if (epilogue.IsNoop()) {
+    return;
+  }
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t c = 0; c < channels; ++c) {
+      float *output_ptr = output + (b * channels + c) * image_size;
+      ApplyEpilogue(epilogue, c, output_ptr, image_size, output_ptr);
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
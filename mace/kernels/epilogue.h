@@ -0,0 +1,142 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_EPILOGUE_H_
+#define MACE_KERNELS_EPILOGUE_H_
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "mace/core/types.h"
+
+namespace mace {
+namespace kernels {
+
+enum ActivationType {
+  NOOP = 0,
+  RELU = 1,
+  RELUX = 2,
+  PRELU = 3,
+  TANH = 4,
+  SIGMOID = 5
+};
+
+// Per-channel bias and activation applied by a kernel to its output tile
+// while it is still in registers or cache, which saves the extra passes over
+// the whole output tensor.
+struct Epilogue {
+  Epilogue()
+      : bias(nullptr),
+        activation(NOOP),
+        relux_max_limit(0),
+        prelu_alpha(nullptr),
+        per_column(false) {}
+  Epilogue(const float *bias,
+           const ActivationType activation,
+           const float relux_max_limit,
+           const float *prelu_alpha = nullptr)
+      : bias(bias),
+        activation(activation),
+        relux_max_limit(relux_max_limit),
+        prelu_alpha(prelu_alpha),
+        per_column(false) {}
+
+  bool IsNoop() const { return bias == nullptr && activation == NOOP; }
+
+  // Bias, RELU and RELUX are an add and a clamp, cheap in SIMD registers.
+  bool IsBiasClamp() const {
+    return activation == NOOP || activation == RELU || activation == RELUX;
+  }
+  float lower() const {
+    return activation == NOOP ? -std::numeric_limits<float>::infinity() : 0;
+  }
+  float upper() const {
+    return activation == RELUX ? relux_max_limit
+                               : std::numeric_limits<float>::infinity();
+  }
+
+  // The epilogue of the sub-matrix starting at (row, col).
+  Epilogue Offset(const index_t row, const index_t col) const {
+    Epilogue epilogue(*this);
+    const index_t channel = per_column ? col : row;
+    if (bias != nullptr) epilogue.bias += channel;
+    if (prelu_alpha != nullptr) epilogue.prelu_alpha += channel;
+    return epilogue;
+  }
+
+  const float *bias;  // nullable
+  ActivationType activation;
+  float relux_max_limit;
+  const float *prelu_alpha;
+  // Channels of a matrix output are its rows, e.g., conv 1x1, or its
+  // columns, e.g., fully connected with batch.
+  bool per_column;
+};
+
+inline float ApplyEpilogue(const Epilogue &epilogue,
+                           const index_t channel,
+                           float value) {
+  if (epilogue.bias != nullptr) {
+    value += epilogue.bias[channel];
+  }
+  switch (epilogue.activation) {
+    case RELU:
+      return std::max(value, 0.f);
+    case RELUX:
+      return std::min(std::max(value, 0.f), epilogue.relux_max_limit);
+    case PRELU:
+      return value < 0 ? value * epilogue.prelu_alpha[channel] : value;
+    case TANH:
+      return std::tanh(value);
+    case SIGMOID:
+      return 1 / (1 + std::exp(-value));
+    default:
+      return value;
+  }
+}
+
+// Default of the bias_clamp kernel in cpu_dispatch.h
+void BiasClampDefault(const float *input,
+                      const index_t size,
+                      const float bias,
+                      const float lower,
+                      const float upper,
+                      float *output);
+
+// size values of one channel, single threaded, input may be output
+void ApplyEpilogue(const Epilogue &epilogue,
+                   const index_t channel,
+                   const float *input,
+                   const index_t size,
+                   float *output);
+
+// rows x cols block of a row major matrix output
+void ApplyEpilogue(const Epilogue &epilogue,
+                   const index_t rows,
+                   const index_t cols,
+                   const index_t stride,
+                   float *output);
+
+// The whole NCHW tensor in one pass, parallelized across planes.
+void ApplyEpilogueNCHW(const Epilogue &epilogue,
+                       const index_t batch,
+                       const index_t channels,
+                       const index_t image_size,
+                       float *output);
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_EPILOGUE_H_
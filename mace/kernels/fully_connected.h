@@ -22,6 +22,7 @@
 #include "mace/core/tensor.h"
 #include "mace/kernels/activation.h"
 #include "mace/kernels/gemm.h"
+#include "mace/kernels/sparse_gemm.h"
 
 #ifdef MACE_ENABLE_OPENCL
 #include "mace/core/runtime/opencl/cl2_header.h"
@@ -37,6 +38,18 @@ struct FullyConnectedBase {
       : activation_(activation),
         relux_max_limit_(relux_max_limit) {}
 
+  // Prepares the constant weight before the first run, given the output
+  // shape recorded by the converter and the rows of the sparse blocks the
+  // converter tagged the pruned weight with, 0 if dense.
+  MaceStatus Prepare(const Tensor *weight,
+                     const std::vector<index_t> &output_shape,
+                     const int sparse_block_rows) {
+    MACE_UNUSED(weight);
+    MACE_UNUSED(output_shape);
+    MACE_UNUSED(sparse_block_rows);
+    return MACE_SUCCESS;
+  }
+
   const ActivationType activation_;
   const float relux_max_limit_;
 };
@@ -48,7 +61,37 @@ template <>
 struct FullyConnectedFunctor<DeviceType::CPU, float>: FullyConnectedBase {
   FullyConnectedFunctor(const ActivationType activation,
                         const float relux_max_limit)
-      : FullyConnectedBase(activation, relux_max_limit) {}
+      : FullyConnectedBase(activation, relux_max_limit),
+        is_weight_packed_(false) {}
+
+  // A small batch streams the weight once by SkinnyGemm, a bigger one runs as
+  // gemm with the transposed weight as rhs, which is packed once if constant.
+  // A pruned weight is packed in sparse blocks for BlockSparseGemv instead.
+  MaceStatus Prepare(const Tensor *weight,
+                     const std::vector<index_t> &output_shape,
+                     const int sparse_block_rows) {
+    if (weight->is_weight() && sparse_block_rows > 0) {
+      const index_t output_size = weight->dim(0);
+      Tensor::MappingGuard guard_weight(weight);
+      if (TryPackBlockSparse(weight->data<float>(), output_size,
+                             weight->size() / output_size, sparse_block_rows,
+                             &sparse_weight_)) {
+        return MACE_SUCCESS;
+      }
+    }
+    if (!weight->is_weight() || output_shape.empty()
+        || output_shape[0] <= kSkinnyGemmMaxBatch) {
+      return MACE_SUCCESS;
+    }
+    const index_t output_size = weight->dim(0);
+    const index_t input_size = weight->size() / output_size;
+    MACE_RETURN_IF_ERROR(packed_weight_.Resize(weight->shape()));
+    Tensor::MappingGuard guard_weight(weight);
+    PackGemmB(weight->data<float>(), 1, input_size, output_size, true,
+              packed_weight_.mutable_data<float>());
+    is_weight_packed_ = true;
+    return MACE_SUCCESS;
+  }
 
   MaceStatus operator()(const Tensor *input,
                   const Tensor *weight,
@@ -70,19 +113,29 @@ struct FullyConnectedFunctor<DeviceType::CPU, float>: FullyConnectedBase {
     const float *weight_ptr = weight->data<float>();
     const float *bias_ptr = bias == nullptr ? nullptr : bias->data<float>();
     float *output_ptr = output->mutable_data<float>();
-
-    Gemv(weight_ptr, input_ptr, N, input_size, output_size, output_ptr);
-    for (int i = 0; i < N; ++i) {
-      for (int j = 0; j < output_size; ++j) {
-        output_ptr[j + i * output_size] += bias_ptr[j];
-      }
+    // the output features are the columns of the [N, output_size] output
+    Epilogue epilogue(bias_ptr, activation_, relux_max_limit_);
+    epilogue.per_column = true;
+
+    if (!sparse_weight_.empty()) {
+      BlockSparseGemv(sparse_weight_, input_ptr, N, output_ptr, &epilogue);
+    } else if (N <= kSkinnyGemmMaxBatch) {
+      SkinnyGemm(weight_ptr, input_ptr, N, input_size, output_size, output_ptr,
+                 &epilogue);
+    } else if (is_weight_packed_) {
+      Gemm(input_ptr, packed_weight_.data<float>(), 1, N, input_size,
+           output_size, output_ptr, false, true, false, true, &epilogue);
+    } else {
+      Gemv(weight_ptr, input_ptr, N, input_size, output_size, output_ptr,
+           &epilogue);
     }
 
-    DoActivation(output_ptr, output_ptr, output->size(), activation_,
-                 relux_max_limit_);
-
     return MACE_SUCCESS;
   }
+
+  Tensor packed_weight_;
+  bool is_weight_packed_;
+  BlockSparseMatrix sparse_weight_;
 };
 
 #ifdef MACE_ENABLE_OPENCL
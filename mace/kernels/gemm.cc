@@ -14,9 +14,13 @@
 
 #include <algorithm>
 #include <cstring>
+#include <vector>
 
 #include "mace/core/tensor.h"
+#include "mace/kernels/cpu_dispatch.h"
 #include "mace/kernels/gemm.h"
+#include "mace/kernels/simd.h"
+#include "mace/utils/utils.h"
 
 #if defined(MACE_ENABLE_NEON)
 #include <arm_neon.h>
@@ -1249,20 +1253,135 @@ inline void GemmTile(const float *A,
 #endif  // MACE_ENABLE_NEON
 }
 
-void Transpose(const float *src,
-               index_t height,
-               index_t width,
-               index_t stride_w,
-               float *dst) {
-  for (index_t h = 0; h < height; ++h) {
-    for (index_t w = 0; w < width; ++w) {
-      dst[w * height + h] = src[h * stride_w + w];
+// Packed layout: the K dimension is split into slices of gemm_k. The
+// slice [pc, pc + kc) of A is a row major height x kc matrix starting at
+// pc * height, so each mc x kc block is contiguous. The slice of B starts at
+// pc * width and holds the kc x nc blocks, row major, one after another.
+
+// Rows packed at a time. A transposed operand is read kPackRows contiguous
+// floats at a time rather than gathered a column at a time, which thrashes
+// the L1 sets if the rows are a power of two apart.
+const index_t kPackRows = 8;
+
+// Copies rows [h, h + rows) of the K slice [pc, pc + kc) of A to dst, rows
+// of kc floats.
+inline void PackGemmARows(const float *A,
+                          const index_t height,
+                          const index_t K,
+                          const index_t h,
+                          const index_t rows,
+                          const index_t pc,
+                          const index_t kc,
+                          const bool transpose_a,
+                          float *dst) {
+  if (transpose_a) {
+    // A[K, H]
+    for (index_t k = 0; k < kc; ++k) {
+      const float *src = A + (pc + k) * height + h;
+      for (index_t r = 0; r < rows; ++r) {
+        dst[r * kc + k] = src[r];
+      }
+    }
+  } else {
+    for (index_t r = 0; r < rows; ++r) {
+      memcpy(dst + r * kc, A + (h + r) * K + pc, kc * sizeof(float));
+    }
+  }
+}
+
+// Copies rows [pc + k, pc + k + rows) of B to the kc x nc blocks of its K
+// slice at dst.
+inline void PackGemmBRows(const float *B,
+                          const index_t K,
+                          const index_t width,
+                          const index_t pc,
+                          const index_t kc,
+                          const index_t k,
+                          const index_t rows,
+                          const bool transpose_b,
+                          const index_t block_n,
+                          float *dst) {
+  for (index_t jc = 0; jc < width; jc += block_n) {
+    const index_t nc = std::min(block_n, width - jc);
+    float *dst_row = dst + jc * kc + k * nc;
+    if (transpose_b) {
+      // B[W, K]
+      for (index_t j = 0; j < nc; ++j) {
+        const float *src = B + (jc + j) * K + pc + k;
+        for (index_t r = 0; r < rows; ++r) {
+          dst_row[r * nc + j] = src[r];
+        }
+      }
+    } else {
+      for (index_t r = 0; r < rows; ++r) {
+        memcpy(dst_row + r * nc, B + (pc + k + r) * width + jc,
+               nc * sizeof(float));
+      }
     }
   }
 }
 
 }  // namespace
 
+void GemmTileDefault(const float *A,
+                     const float *B,
+                     const index_t height,
+                     const index_t K,
+                     const index_t width,
+                     const index_t stride_a,
+                     const index_t stride_b,
+                     const index_t stride_c,
+                     const Epilogue *epilogue,
+                     float *C) {
+  GemmTile(A, B, height, K, width, stride_a, stride_b, stride_c, C);
+  if (epilogue != nullptr) {
+    ApplyEpilogue(*epilogue, height, width, stride_c, C);
+  }
+}
+
+void PackGemmA(const float *A,
+               const index_t batch,
+               const index_t height,
+               const index_t K,
+               const bool transpose_a,
+               float *packed_a) {
+  const index_t block_k = GetCPUBlocking().gemm_k;
+#pragma omp parallel for collapse(2)
+  for (index_t n = 0; n < batch; ++n) {
+    for (index_t h = 0; h < height; h += kPackRows) {
+      const index_t rows = std::min(kPackRows, height - h);
+      for (index_t pc = 0; pc < K; pc += block_k) {
+        const index_t kc = std::min(block_k, K - pc);
+        PackGemmARows(A + n * height * K, height, K, h, rows, pc, kc,
+                      transpose_a,
+                      packed_a + n * height * K + pc * height + h * kc);
+      }
+    }
+  }
+}
+
+void PackGemmB(const float *B,
+               const index_t batch,
+               const index_t K,
+               const index_t width,
+               const bool transpose_b,
+               float *packed_b) {
+  const CPUBlocking &blocking = GetCPUBlocking();
+  const index_t block_k = blocking.gemm_k;
+  // block_k is a multiple of kPackRows, the rows never span two slices
+#pragma omp parallel for collapse(2)
+  for (index_t n = 0; n < batch; ++n) {
+    for (index_t k = 0; k < K; k += kPackRows) {
+      const index_t pc = k / block_k * block_k;
+      const index_t kc = std::min(block_k, K - pc);
+      const index_t rows = std::min(kPackRows, K - k);
+      PackGemmBRows(B + n * K * width, K, width, pc, kc, k - pc, rows,
+                    transpose_b, blocking.gemm_n,
+                    packed_b + n * K * width + pc * width);
+    }
+  }
+}
+
 // A: height x K, B: K x width, C: height x width
 void Gemm(const float *A,
           const float *B,
@@ -1272,99 +1391,240 @@ void Gemm(const float *A,
           const index_t width,
           float *C,
           const bool transpose_a,
-          const bool transpose_b) {
-  if (width == 1) {
-    for (index_t b = 0; b < batch; ++b) {
-      Gemv(A + b * height * K, B + b * K, 1, K, height, C + b * height);
+          const bool transpose_b,
+          const bool packed_a,
+          const bool packed_b,
+          const Epilogue *epilogue) {
+  BatchGemm(A, B, batch, batch, height, K, width, C, transpose_a, transpose_b,
+            packed_a, packed_b, epilogue);
+}
+
+namespace {
+
+// The matrix of an operand multiplied into C[n], see BroadcastBatchGemm,
+// the batch cycles through the matrices without index.
+index_t BatchMatrixIndex(const index_t *index,
+                         const index_t n,
+                         const index_t matrices) {
+  return index == nullptr ? n % matrices : index[n];
+}
+
+// BroadcastBatchGemm without the shortcuts, blocked by blocking, which must
+// be GetCPUBlocking() if an operand is packed ahead of time. The rows of C
+// are stride_c apart.
+void BlockedBatchGemm(const float *A,
+                      const float *B,
+                      const index_t batch,
+                      const index_t a_batch,
+                      const index_t b_batch,
+                      const index_t *a_index,
+                      const index_t *b_index,
+                      const index_t height,
+                      const index_t K,
+                      const index_t width,
+                      float *C,
+                      const index_t stride_c,
+                      const bool transpose_a,
+                      const bool transpose_b,
+                      const bool packed_a,
+                      const bool packed_b,
+                      const Epilogue *epilogue,
+                      const CPUBlocking &blocking) {
+  if (stride_c == width) {
+    memset(C, 0, sizeof(float) * batch * height * width);
+  } else {
+    for (index_t i = 0; i < batch * height; ++i) {
+      memset(C + i * stride_c, 0, sizeof(float) * width);
     }
-    return;
   }
-  memset(C, 0, sizeof(float) * batch * height * width);
-
-  // It is better to use large block size if it fits for fast cache.
-  // Assume l1 cache size is 32k, we load three blocks at a time (A, B, C),
-  // the block size should be sqrt(32k / sizeof(T) / 3).
-  // As number of input channels of convolution is normally power of 2, and
-  // we have not optimized tiling remains, we use the following magic number
-  const index_t block_size = 64;
-  const index_t block_tile_height = RoundUpDiv(height, block_size);
-  const index_t block_tile_width = RoundUpDiv(width, block_size);
-  const index_t block_tile_k = RoundUpDiv(K, block_size);
-  const index_t block_tile[3] = {block_tile_height, block_tile_width,
-                                 block_tile_k};
-  const index_t remain_height = height % block_size;
-  const index_t remain_width = width % block_size;
-  const index_t remain_k = K % block_size;
-  const index_t remain[3] = {remain_height, remain_width, remain_k};
-
-#pragma omp parallel for collapse(3)
-  for (index_t n = 0; n < batch; ++n) {
-    for (index_t bh = 0; bh < block_tile[0]; ++bh) {
-      for (index_t bw = 0; bw < block_tile[1]; ++bw) {
-        const float *a_base = A + n * height * K;
-        const float *b_base = B + n * K * width;
-        float *c_base = C + n * height * width;
-
-        const index_t ih_begin = bh * block_size;
-        const index_t ih_end =
-            bh * block_size +
-            (bh == block_tile[0] - 1 && remain[0] > 0 ? remain[0] : block_size);
-        const index_t iw_begin = bw * block_size;
-        const index_t iw_end =
-            bw * block_size +
-            (bw == block_tile[1] - 1 && remain[1] > 0 ? remain[1] : block_size);
-
-        for (index_t bk = 0; bk < block_tile[2]; ++bk) {
-          const index_t ik_begin = bk * block_size;
-          const index_t ik_end =
-              bk * block_size + (bk == block_tile[2] - 1 && remain[2] > 0
-                                     ? remain[2]
-                                     : block_size);
-
-          Tensor trans_a;
-          Tensor trans_b;
-          const float *real_a = nullptr;
-          const float *real_b = nullptr;
-          float *real_c = c_base + (ih_begin * width + iw_begin);
-          index_t stride_a;
-          index_t stride_b;
-          index_t stride_c = width;
-
-          if (transpose_a) {
-            trans_a.Resize({block_size, block_size});
-            float *trans_a_data = trans_a.mutable_data<float>();
-            // A[K, H] -> A[H, K]
-            Transpose(a_base + (ik_begin * height + ih_begin),
-                      ik_end - ik_begin, ih_end - ih_begin, height,
-                      trans_a_data);
-            real_a = trans_a_data;
-            stride_a = ik_end - ik_begin;
-          } else {
-            real_a = a_base + (ih_begin * K + ik_begin);
-            stride_a = K;
-          }
 
-          if (transpose_b) {
-            trans_b.Resize({block_size, block_size});
-            float *trans_b_data = trans_b.mutable_data<float>();
-            // B[W, K] -> B[K, W]
-            Transpose(b_base + (iw_begin * K + ik_begin), iw_end - iw_begin,
-                      ik_end - ik_begin, K, trans_b_data);
-            real_b = trans_b_data;
-            stride_b = iw_end - iw_begin;
-          } else {
-            real_b = b_base + (ik_begin * width + iw_begin);
-            stride_b = width;
+  // Transposed operands are always packed. The micro kernel reads a row major
+  // A in place as fast as a packed one, while a row major B is packed only
+  // if it is reused by several row blocks.
+  const bool pack_a = !packed_a && transpose_a;
+  const index_t block_m = blocking.gemm_m;
+  const index_t block_k = blocking.gemm_k;
+  const index_t block_n = blocking.gemm_n;
+  const bool pack_b = !packed_b && (transpose_b || height > block_m);
+  const index_t max_kc = std::min(block_k, K);
+  Tensor a_buffer;
+  Tensor b_buffer;
+  float *a_buffer_data = nullptr;
+  float *b_buffer_data = nullptr;
+  if (pack_a) {
+    a_buffer.Resize({a_batch, height, max_kc});
+    a_buffer_data = a_buffer.mutable_data<float>();
+  }
+  if (pack_b) {
+    b_buffer.Resize({b_batch, max_kc, width});
+    b_buffer_data = b_buffer.mutable_data<float>();
+  }
+  const GemmTileFunc gemm_tile = GetCPUKernels().gemm_tile;
+  const index_t block_tile_height = RoundUpDiv(height, block_m);
+  const index_t block_tile_width = RoundUpDiv(width, block_n);
+
+  // one parallel region, the blocks of a K slice wait for its packing
+#pragma omp parallel
+  {
+    for (index_t pc = 0; pc < K; pc += block_k) {
+      const index_t kc = std::min(block_k, K - pc);
+      // pack the K slice of the operands once, shared by all blocks
+      if (pack_a) {
+#pragma omp for collapse(2)
+        for (index_t n = 0; n < a_batch; ++n) {
+          for (index_t h = 0; h < height; h += kPackRows) {
+            PackGemmARows(A + n * height * K, height, K, h,
+                          std::min(kPackRows, height - h), pc, kc,
+                          transpose_a, a_buffer_data + (n * height + h) * kc);
           }
+        }
+      }
+      if (pack_b) {
+#pragma omp for collapse(2)
+        for (index_t n = 0; n < b_batch; ++n) {
+          for (index_t k = 0; k < kc; k += kPackRows) {
+            PackGemmBRows(B + n * K * width, K, width, pc, kc, k,
+                          std::min(kPackRows, kc - k), transpose_b, block_n,
+                          b_buffer_data + n * kc * width);
+          }
+        }
+      }
+
+#pragma omp for collapse(3)
+      for (index_t n = 0; n < batch; ++n) {
+        for (index_t bh = 0; bh < block_tile_height; ++bh) {
+          for (index_t bw = 0; bw < block_tile_width; ++bw) {
+            const index_t ic = bh * block_m;
+            const index_t jc = bw * block_n;
+            const index_t mc = std::min(block_m, height - ic);
+            const index_t nc = std::min(block_n, width - jc);
+
+            const index_t an = BatchMatrixIndex(a_index, n, a_batch);
+            const index_t bn = BatchMatrixIndex(b_index, n, b_batch);
+            const float *a_ptr = nullptr;
+            index_t stride_a;
+            if (pack_a) {
+              a_ptr = a_buffer_data + (an * height + ic) * kc;
+              stride_a = kc;
+            } else if (packed_a) {
+              a_ptr = A + an * height * K + pc * height + ic * kc;
+              stride_a = kc;
+            } else {
+              a_ptr = A + an * height * K + ic * K + pc;
+              stride_a = K;
+            }
+            const float *b_ptr = nullptr;
+            index_t stride_b;
+            if (pack_b) {
+              b_ptr = b_buffer_data + bn * kc * width + jc * kc;
+              stride_b = nc;
+            } else if (packed_b) {
+              b_ptr = B + bn * K * width + pc * width + jc * kc;
+              stride_b = nc;
+            } else {
+              b_ptr = B + bn * K * width + pc * width + jc;
+              stride_b = width;
+            }
+            float *c_ptr = C + (n * height + ic) * stride_c + jc;
+
+            // C[ic, jc] += A[ic, pc] * B[pc, jc], the last K slice finishes it
+            if (epilogue != nullptr && pc + kc == K) {
+              const Epilogue block_epilogue = epilogue->Offset(ic, jc);
+              gemm_tile(a_ptr, b_ptr, mc, kc, nc, stride_a, stride_b,
+                        stride_c, &block_epilogue, c_ptr);
+            } else {
+              gemm_tile(a_ptr, b_ptr, mc, kc, nc, stride_a, stride_b,
+                        stride_c, nullptr, c_ptr);
+            }
+          }  // bw
+        }    // bh
+      }      // n
+    }        // pc
+  }          // omp parallel
+}
 
-          // inside block:
-          // calculate C[bh, bw] += A[bh, bk] * B[bk, bw] for one k
-          GemmTile(real_a, real_b, ih_end - ih_begin, ik_end - ik_begin,
-                   iw_end - iw_begin, stride_a, stride_b, stride_c, real_c);
-        }  // bk
-      }    // bw
-    }      // bh
-  }        // n
+}  // namespace
+
+void BatchGemm(const float *A,
+               const float *B,
+               const index_t batch,
+               const index_t a_batch,
+               const index_t height,
+               const index_t K,
+               const index_t width,
+               float *C,
+               const bool transpose_a,
+               const bool transpose_b,
+               const bool packed_a,
+               const bool packed_b,
+               const Epilogue *epilogue) {
+  MACE_CHECK(a_batch > 0 && batch % a_batch == 0, "batch ", batch,
+             " is not a multiple of ", a_batch);
+  BroadcastBatchGemm(A, B, batch, a_batch, batch, nullptr, nullptr, height, K,
+                     width, C, transpose_a, transpose_b, packed_a, packed_b,
+                     epilogue);
+}
+
+void BroadcastBatchGemm(const float *A,
+                        const float *B,
+                        const index_t batch,
+                        const index_t a_batch,
+                        const index_t b_batch,
+                        const index_t *a_index,
+                        const index_t *b_index,
+                        const index_t height,
+                        const index_t K,
+                        const index_t width,
+                        float *C,
+                        const bool transpose_a,
+                        const bool transpose_b,
+                        const bool packed_a,
+                        const bool packed_b,
+                        const Epilogue *epilogue) {
+  if (epilogue != nullptr && epilogue->IsNoop()) {
+    epilogue = nullptr;
+  }
+  // B[K, 1] and its transpose share the same layout, so does the packed one
+  if (width == 1 && !transpose_a && !packed_a &&
+      (epilogue == nullptr || !epilogue->per_column)) {
+    for (index_t n = 0; n < batch; ++n) {
+      SkinnyGemm(A + BatchMatrixIndex(a_index, n, a_batch) * height * K,
+                 B + BatchMatrixIndex(b_index, n, b_batch) * K, 1, K, height,
+                 C + n * height, epilogue);
+    }
+    return;
+  }
+  BlockedBatchGemm(A, B, batch, a_batch, b_batch, a_index, b_index, height, K,
+                   width, C, width, transpose_a, transpose_b, packed_a,
+                   packed_b, epilogue, GetCPUBlocking());
+}
+
+void GemmStridedC(const float *A,
+                  const float *B,
+                  const index_t height,
+                  const index_t K,
+                  const index_t width,
+                  const index_t stride_c,
+                  float *C,
+                  const bool packed_a,
+                  const Epilogue *epilogue) {
+  if (epilogue != nullptr && epilogue->IsNoop()) {
+    epilogue = nullptr;
+  }
+  BlockedBatchGemm(A, B, 1, 1, 1, nullptr, nullptr, height, K, width, C,
+                   stride_c, false, false, packed_a, false, epilogue,
+                   GetCPUBlocking());
+}
+
+void GemmWithBlocking(const float *A,
+                      const float *B,
+                      const index_t height,
+                      const index_t K,
+                      const index_t width,
+                      const CPUBlocking &blocking,
+                      float *C) {
+  BlockedBatchGemm(A, B, 1, 1, 1, nullptr, nullptr, height, K, width, C,
+                   width, false, false, false, false, nullptr, blocking);
 }
 
 // A: height x K, B: K x width, C: height x width
@@ -1377,45 +1637,23 @@ void GemmRef(const float *A,
              float *C,
              const bool transpose_a,
              const bool transpose_b) {
-  memset(C, 0, sizeof(float) * batch * height * width);
-
-  Tensor trans_a;
-  Tensor trans_b;
-  float *trans_a_data = nullptr;
-  float *trans_b_data = nullptr;
-  if (transpose_a) {
-    trans_a.Resize({height, K});
-    trans_a_data = trans_a.mutable_data<float>();
-  }
-  if (transpose_b) {
-    trans_b.Resize({K, width});
-    trans_b_data = trans_b.mutable_data<float>();
-  }
-
+  // A[K, H] and B[W, K] are read in place
+  const index_t a_stride_h = transpose_a ? 1 : K;
+  const index_t a_stride_k = transpose_a ? height : 1;
+  const index_t b_stride_k = transpose_b ? 1 : width;
+  const index_t b_stride_w = transpose_b ? K : 1;
   for (index_t b = 0; b < batch; ++b) {
-    const float *real_a = nullptr;
-    const float *real_b = nullptr;
+    const float *real_a = A + b * height * K;
+    const float *real_b = B + b * K * width;
     float *real_c = C + b * height * width;
-    if (transpose_a) {
-      // A[K, H] -> A[H, K]
-      Transpose(A + b * height * K, K, height, height, trans_a_data);
-      real_a = trans_a_data;
-    } else {
-      real_a = A + b * height * K;
-    }
-    if (transpose_b) {
-      // B[W, K] -> B[K, W]
-      Transpose(B + b * width * K, width, K, K, trans_b_data);
-      real_b = trans_b_data;
-    } else {
-      real_b = B + b * width * K;
-    }
-
     for (index_t i = 0; i < height; ++i) {
       for (index_t j = 0; j < width; ++j) {
+        float sum = 0;
         for (index_t k = 0; k < K; ++k) {
-          real_c[i * width + j] += real_a[i * K + k] * real_b[k * width + j];
+          sum += real_a[i * a_stride_h + k * a_stride_k] *
+                 real_b[k * b_stride_k + j * b_stride_w];
         }
+        real_c[i * width + j] = sum;
       }
     }
   }
@@ -1438,14 +1676,94 @@ void GemvRef(const float *m_ptr,
   }
 }
 
-// TODO(liyin): batched gemv can be transformed to gemm (w/ transpose)
 void Gemv(const float *m_ptr,
           const float *v_ptr,
           const index_t batch,
           const index_t width,
           const index_t height,
-          float *out_ptr) {
-#if defined(MACE_ENABLE_NEON)
+          float *out_ptr,
+          const Epilogue *epilogue) {
+  if (epilogue != nullptr && epilogue->IsNoop()) {
+    epilogue = nullptr;
+  }
+  GetCPUKernels().gemv(m_ptr, v_ptr, batch, width, height, epilogue, out_ptr);
+}
+
+void SkinnyGemm(const float *m_ptr,
+                const float *v_ptr,
+                const index_t batch,
+                const index_t width,
+                const index_t height,
+                float *out_ptr,
+                const Epilogue *epilogue) {
+  MACE_CHECK(batch <= kSkinnyGemmMaxBatch, "batch ", batch, " > ",
+             kSkinnyGemmMaxBatch);
+  if (epilogue != nullptr && epilogue->IsNoop()) {
+    epilogue = nullptr;
+  }
+  Epilogue row_epilogue;
+  if (epilogue != nullptr) {
+    row_epilogue = *epilogue;
+    row_epilogue.per_column = true;
+  }
+  const SkinnyGemmFunc skinny_gemm = GetCPUKernels().skinny_gemm;
+  // a task of 16 rows, a K slice of at least 1024
+  const index_t kRowBlock = 16;
+  const index_t kMinSliceWidth = 1024;
+  const index_t num_threads = GetOpenMPNumThreads();
+  const index_t row_blocks = RoundUpDiv(height, kRowBlock);
+
+  if (num_threads > 1 && row_blocks < num_threads
+      && width >= 2 * kMinSliceWidth) {
+    // too few rows to keep the threads busy, split K and sum up the slices
+    const index_t slices =
+        std::min<index_t>(num_threads, width / kMinSliceWidth);
+    const index_t slice_width = RoundUp<index_t>(RoundUpDiv(width, slices),
+                                                 16);
+    const index_t out_size = batch * height;
+    std::vector<float> slice_out(slices * out_size);
+#pragma omp parallel for
+    for (index_t s = 0; s < slices; ++s) {
+      const index_t k = s * slice_width;
+      const index_t kc = std::max<index_t>(
+          std::min<index_t>(slice_width, width - k), 0);
+      skinny_gemm(m_ptr + k, v_ptr + k, batch, kc, height, width, height,
+                  slice_out.data() + s * out_size);
+    }
+    for (index_t i = 0; i < out_size; ++i) {
+      float sum = 0;
+      for (index_t s = 0; s < slices; ++s) {
+        sum += slice_out[s * out_size + i];
+      }
+      out_ptr[i] = sum;
+    }
+    if (epilogue != nullptr) {
+      ApplyEpilogue(row_epilogue, batch, height, height, out_ptr);
+    }
+    return;
+  }
+
+#pragma omp parallel for
+  for (index_t h = 0; h < height; h += kRowBlock) {
+    const index_t rows = std::min(kRowBlock, height - h);
+    skinny_gemm(m_ptr + h * width, v_ptr, batch, width, rows, width, height,
+                out_ptr + h);
+    if (epilogue != nullptr) {
+      ApplyEpilogue(row_epilogue.Offset(0, h), batch, rows, height,
+                    out_ptr + h);
+    }
+  }
+}
+
+// TODO(liyin): batched gemv can be transformed to gemm (w/ transpose)
+void GemvDefault(const float *m_ptr,
+                 const float *v_ptr,
+                 const index_t batch,
+                 const index_t width,
+                 const index_t height,
+                 const Epilogue *epilogue,
+                 float *out_ptr) {
+  typedef Float4::Reg Reg;
 // TODO(liyin/wch): try height tiling = 8
 #pragma omp parallel for collapse(2)
   for (index_t b = 0; b < batch; ++b) {
@@ -1458,26 +1776,18 @@ void Gemv(const float *m_ptr,
         const float *v_ptr0 = v_ptr + b * width;
         float *out_ptr0 = out_ptr + b * height + h;
 
-        float32x4_t vm0, vm1, vm2, vm3;
-        float32x4_t vv;
-
-        float32x4_t vsum0 = vdupq_n_f32(0.f);
-        float32x4_t vsum1 = vdupq_n_f32(0.f);
-        float32x4_t vsum2 = vdupq_n_f32(0.f);
-        float32x4_t vsum3 = vdupq_n_f32(0.f);
+        Reg vsum0 = Float4::Zero();
+        Reg vsum1 = Float4::Zero();
+        Reg vsum2 = Float4::Zero();
+        Reg vsum3 = Float4::Zero();
 
         index_t w;
         for (w = 0; w + 3 < width; w += 4) {
-          vm0 = vld1q_f32(m_ptr0);
-          vm1 = vld1q_f32(m_ptr1);
-          vm2 = vld1q_f32(m_ptr2);
-          vm3 = vld1q_f32(m_ptr3);
-          vv = vld1q_f32(v_ptr0);
-
-          vsum0 = vmlaq_f32(vsum0, vm0, vv);
-          vsum1 = vmlaq_f32(vsum1, vm1, vv);
-          vsum2 = vmlaq_f32(vsum2, vm2, vv);
-          vsum3 = vmlaq_f32(vsum3, vm3, vv);
+          const Reg vv = Float4::Load(v_ptr0);
+          vsum0 = Float4::MulAdd(Float4::Load(m_ptr0), vv, vsum0);
+          vsum1 = Float4::MulAdd(Float4::Load(m_ptr1), vv, vsum1);
+          vsum2 = Float4::MulAdd(Float4::Load(m_ptr2), vv, vsum2);
+          vsum3 = Float4::MulAdd(Float4::Load(m_ptr3), vv, vsum3);
 
           m_ptr0 += 4;
           m_ptr1 += 4;
@@ -1485,10 +1795,10 @@ void Gemv(const float *m_ptr,
           m_ptr3 += 4;
           v_ptr0 += 4;
         }
-        float sum0 = vaddvq_f32(vsum0);
-        float sum1 = vaddvq_f32(vsum1);
-        float sum2 = vaddvq_f32(vsum2);
-        float sum3 = vaddvq_f32(vsum3);
+        float sum0 = Float4::HorizontalSum(vsum0);
+        float sum1 = Float4::HorizontalSum(vsum1);
+        float sum2 = Float4::HorizontalSum(vsum2);
+        float sum3 = Float4::HorizontalSum(vsum3);
 
         // handle remaining w
         for (; w < width; ++w) {
@@ -1508,18 +1818,17 @@ void Gemv(const float *m_ptr,
         *out_ptr0++ = sum3;
       } else {
         for (index_t hh = h; hh < height; ++hh) {
-          float32x4_t vsum0 = vdupq_n_f32(0.f);
+          Reg vsum0 = Float4::Zero();
           const float *m_ptr0 = m_ptr + hh * width;
           const float *v_ptr0 = v_ptr + b * width;
           index_t w;
           for (w = 0; w + 3 < width; w += 4) {
-            float32x4_t vm = vld1q_f32(m_ptr0);
-            float32x4_t vv = vld1q_f32(v_ptr0);
-            vsum0 = vmlaq_f32(vsum0, vm, vv);
+            vsum0 = Float4::MulAdd(Float4::Load(m_ptr0), Float4::Load(v_ptr0),
+                                   vsum0);
             m_ptr0 += 4;
             v_ptr0 += 4;
           }
-          float sum = vaddvq_f32(vsum0);
+          float sum = Float4::HorizontalSum(vsum0);
           for (; w < width; ++w) {
             sum += m_ptr0[0] * v_ptr0[0];
             m_ptr0++;
@@ -1530,9 +1839,44 @@ void Gemv(const float *m_ptr,
       }  // if
     }    // h
   }      // b
-#else
-  GemvRef(m_ptr, v_ptr, batch, width, height, out_ptr);
-#endif
+  // the output is as small as a row of the matrix
+  if (epilogue != nullptr) {
+    Epilogue row_epilogue(*epilogue);
+    row_epilogue.per_column = true;
+    ApplyEpilogue(row_epilogue, batch, height, height, out_ptr);
+  }
+}
+
+void SkinnyGemmDefault(const float *m_ptr,
+                       const float *v_ptr,
+                       const index_t batch,
+                       const index_t K,
+                       const index_t height,
+                       const index_t stride,
+                       const index_t out_stride,
+                       float *out_ptr) {
+  // the row stays in cache while it is multiplied by the whole batch
+  for (index_t h = 0; h < height; ++h) {
+    const float *m_row = m_ptr + h * stride;
+    for (index_t b = 0; b < batch; ++b) {
+      const float *v_row = v_ptr + b * stride;
+      index_t k = 0;
+      float sum = 0;
+      Float4::Reg vsum0 = Float4::Zero();
+      Float4::Reg vsum1 = Float4::Zero();
+      for (; k + 7 < K; k += 8) {
+        vsum0 = Float4::MulAdd(Float4::Load(m_row + k), Float4::Load(v_row + k),
+                               vsum0);
+        vsum1 = Float4::MulAdd(Float4::Load(m_row + k + 4),
+                               Float4::Load(v_row + k + 4), vsum1);
+      }
+      sum = Float4::HorizontalSum(Float4::Add(vsum0, vsum1));
+      for (; k < K; ++k) {
+        sum += m_row[k] * v_row[k];
+      }
+      out_ptr[b * out_stride + h] = sum;
+    }
+  }
 }
 
 }  // namespace kernels
@@ -20,10 +20,17 @@
 #endif
 
 #include "mace/core/types.h"
+#include "mace/kernels/cpu_blocking.h"
+#include "mace/kernels/epilogue.h"
 
 namespace mace {
 namespace kernels {
 
+// C = A * B, A: height x K, B: K x width, C: height x width.
+// An operand packed by PackGemmA/PackGemmB (packed_a/packed_b set) is used
+// as is, and its transpose flag is ignored. Constant operands, e.g., weights,
+// should be packed once ahead of time, others are packed on the fly.
+// The epilogue, if any, is applied to the blocks of C as they are finished.
 void Gemm(const float *A,
           const float *B,
           const index_t batch,
@@ -32,7 +39,91 @@ void Gemm(const float *A,
           const index_t width,
           float *C,
           const bool transpose_a = false,
-          const bool transpose_b = false);
+          const bool transpose_b = false,
+          const bool packed_a = false,
+          const bool packed_b = false,
+          const Epilogue *epilogue = nullptr);
+
+// Same as Gemm, but the batch cycles through a_batch matrices of A, i.e.,
+// C[n] = A[n % a_batch] * B[n], and batch is a multiple of a_batch, e.g.,
+// Winograd shares the filter of each tile position across the images. Many
+// small problems pay off as the batch and the blocks of every problem are
+// parallelized together in a single parallel region.
+void BatchGemm(const float *A,
+               const float *B,
+               const index_t batch,
+               const index_t a_batch,
+               const index_t height,
+               const index_t K,
+               const index_t width,
+               float *C,
+               const bool transpose_a = false,
+               const bool transpose_b = false,
+               const bool packed_a = false,
+               const bool packed_b = false,
+               const Epilogue *epilogue = nullptr);
+
+// Same as BatchGemm, but C[n] = A[a_index[n]] * B[b_index[n]] for the
+// a_batch matrices of A and the b_batch ones of B, e.g., a MatMul
+// broadcasting its batch dims. The shared matrices are packed once and none
+// is copied per batch. A null index cycles through the matrices like
+// BatchGemm does.
+void BroadcastBatchGemm(const float *A,
+                        const float *B,
+                        const index_t batch,
+                        const index_t a_batch,
+                        const index_t b_batch,
+                        const index_t *a_index,
+                        const index_t *b_index,
+                        const index_t height,
+                        const index_t K,
+                        const index_t width,
+                        float *C,
+                        const bool transpose_a = false,
+                        const bool transpose_b = false,
+                        const bool packed_a = false,
+                        const bool packed_b = false,
+                        const Epilogue *epilogue = nullptr);
+
+// Gemm of a single matrix whose rows of C are stride_c apart, e.g., a range
+// of the pixels of each channel of a convolution output.
+void GemmStridedC(const float *A,
+                  const float *B,
+                  const index_t height,
+                  const index_t K,
+                  const index_t width,
+                  const index_t stride_c,
+                  float *C,
+                  const bool packed_a = false,
+                  const Epilogue *epilogue = nullptr);
+
+// Gemm of row major operands blocked by blocking in place of
+// GetCPUBlocking(), e.g., to calibrate the blocking.
+void GemmWithBlocking(const float *A,
+                      const float *B,
+                      const index_t height,
+                      const index_t K,
+                      const index_t width,
+                      const CPUBlocking &blocking,
+                      float *C);
+
+// Packs A into the panels consumed by Gemm, packed_a has the size of A.
+// The layout follows GetCPUBlocking().
+void PackGemmA(const float *A,
+               const index_t batch,
+               const index_t height,
+               const index_t K,
+               const bool transpose_a,
+               float *packed_a);
+
+// Packs B into the panels consumed by Gemm, packed_b has the size of B.
+// The layout follows GetCPUBlocking().
+void PackGemmB(const float *B,
+               const index_t batch,
+               const index_t K,
+               const index_t width,
+               const bool transpose_b,
+               float *packed_b);
 
 void GemmRef(const float *A,
              const float *B,
@@ -44,12 +135,14 @@ void GemmRef(const float *A,
              const bool transpose_a = false,
              const bool transpose_b = false);
 
+// h is the channel of the epilogue
 void Gemv(const float *m_ptr,
           const float *v_ptr,
           const index_t batch,
           const index_t width,
           const index_t height,
-          float *out_ptr);
+          float *out_ptr,
+          const Epilogue *epilogue = nullptr);
 
 void GemvRef(const float *m_ptr,
              const float *v_ptr,
@@ -58,6 +151,50 @@ void GemvRef(const float *m_ptr,
              const index_t height,
              float *out_ptr);
 
+// The largest batch of SkinnyGemm, e.g., of a small batch fully connected.
+const index_t kSkinnyGemmMaxBatch = 16;
+
+// Same as Gemv, but each row of m is read from memory once for the whole
+// batch instead of once per batch. width is split across threads when height
+// is too small to keep them busy. batch <= kSkinnyGemmMaxBatch.
+void SkinnyGemm(const float *m_ptr,
+                const float *v_ptr,
+                const index_t batch,
+                const index_t width,
+                const index_t height,
+                float *out_ptr,
+                const Epilogue *epilogue = nullptr);
+
+// Kernels built for the compile-time target, i.e., NEON or portable C, which
+// are the defaults of the runtime dispatch in cpu_dispatch.h.
+void GemmTileDefault(const float *A,
+                     const float *B,
+                     const index_t height,
+                     const index_t K,
+                     const index_t width,
+                     const index_t stride_a,
+                     const index_t stride_b,
+                     const index_t stride_c,
+                     const Epilogue *epilogue,
+                     float *C);
+
+void GemvDefault(const float *m_ptr,
+                 const float *v_ptr,
+                 const index_t batch,
+                 const index_t width,
+                 const index_t height,
+                 const Epilogue *epilogue,
+                 float *out_ptr);
+
+void SkinnyGemmDefault(const float *m_ptr,
+                       const float *v_ptr,
+                       const index_t batch,
+                       const index_t K,
+                       const index_t height,
+                       const index_t stride,
+                       const index_t out_stride,
+                       float *out_ptr);
+
 }  // namespace kernels
 }  // namespace mace
 
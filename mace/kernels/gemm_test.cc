@@ -13,9 +13,12 @@
 // limitations under the License.
 
 #include <gtest/gtest.h>
+#include <algorithm>
 #include <memory>
 #include <random>
+#include <vector>
 
+#include "mace/core/runtime/cpu/cpu_runtime.h"
 #include "mace/core/types.h"
 #include "mace/kernels/gemm.h"
 
@@ -28,7 +31,9 @@ void GemmTest(index_t batch,
               index_t K,
               index_t M,
               bool transpose_a,
-              bool transpose_b) {
+              bool transpose_b,
+              bool packed_a = false,
+              bool packed_b = false) {
   std::unique_ptr<float[]> A(new float[batch * N * K]);
   std::unique_ptr<float[]> B(new float[batch * K * M]);
   std::unique_ptr<float[]> C(new float[batch * N * M]);
@@ -42,8 +47,17 @@ void GemmTest(index_t batch,
                 [&gen, &nd] { return nd(gen); });
   std::generate(B.get(), B.get() + batch * K * M,
                 [&gen, &nd] { return nd(gen); });
-  kernels::Gemm(A.get(), B.get(), batch, N, K, M, C.get(), transpose_a,
-                transpose_b);
+  std::unique_ptr<float[]> A_packed(new float[batch * N * K]);
+  std::unique_ptr<float[]> B_packed(new float[batch * K * M]);
+  if (packed_a) {
+    kernels::PackGemmA(A.get(), batch, N, K, transpose_a, A_packed.get());
+  }
+  if (packed_b) {
+    kernels::PackGemmB(B.get(), batch, K, M, transpose_b, B_packed.get());
+  }
+  kernels::Gemm(packed_a ? A_packed.get() : A.get(),
+                packed_b ? B_packed.get() : B.get(), batch, N, K, M, C.get(),
+                transpose_a, transpose_b, packed_a, packed_b);
   kernels::GemmRef(A.get(), B.get(), batch, N, K, M, C_ref.get(), transpose_a,
                    transpose_b);
 
@@ -72,6 +86,106 @@ void GemvTest(index_t batch, index_t N, index_t M) {
   }
 }
 
+// batch problems cycling through a_batch matrices of A
+void BatchGemmTest(index_t batch,
+                   index_t a_batch,
+                   index_t N,
+                   index_t K,
+                   index_t M,
+                   bool transpose_a,
+                   bool packed_a) {
+  std::unique_ptr<float[]> A(new float[a_batch * N * K]);
+  std::unique_ptr<float[]> A_packed(new float[a_batch * N * K]);
+  std::unique_ptr<float[]> B(new float[batch * K * M]);
+  std::unique_ptr<float[]> C(new float[batch * N * M]);
+  std::unique_ptr<float[]> C_ref(new float[N * M]);
+
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::normal_distribution<float> nd(0, 1);
+
+  std::generate(A.get(), A.get() + a_batch * N * K,
+                [&gen, &nd] { return nd(gen); });
+  std::generate(B.get(), B.get() + batch * K * M,
+                [&gen, &nd] { return nd(gen); });
+  if (packed_a) {
+    kernels::PackGemmA(A.get(), a_batch, N, K, transpose_a, A_packed.get());
+  }
+  kernels::BatchGemm(packed_a ? A_packed.get() : A.get(), B.get(), batch,
+                     a_batch, N, K, M, C.get(), transpose_a, false, packed_a);
+  for (index_t b = 0; b < batch; ++b) {
+    kernels::GemmRef(A.get() + b % a_batch * N * K, B.get() + b * K * M, 1, N,
+                     K, M, C_ref.get(), transpose_a);
+    for (int i = 0; i < N * M; ++i) {
+      EXPECT_NEAR(C_ref[i], C[b * N * M + i], 0.1);
+    }
+  }
+}
+
+// C[n] = A[a_index[n]] * B[b_index[n]], B packed if packed_b
+void BroadcastBatchGemmTest(const std::vector<index_t> &a_index,
+                            const std::vector<index_t> &b_index,
+                            index_t N,
+                            index_t K,
+                            index_t M,
+                            bool transpose_b,
+                            bool packed_b) {
+  const index_t batch = a_index.size();
+  const index_t a_batch =
+      *std::max_element(a_index.begin(), a_index.end()) + 1;
+  const index_t b_batch =
+      *std::max_element(b_index.begin(), b_index.end()) + 1;
+  std::vector<float> A(a_batch * N * K);
+  std::vector<float> B(b_batch * K * M);
+  std::vector<float> B_packed(B.size());
+  std::vector<float> C(batch * N * M);
+  std::vector<float> C_ref(N * M);
+
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::normal_distribution<float> nd(0, 1);
+
+  std::generate(A.begin(), A.end(), [&gen, &nd] { return nd(gen); });
+  std::generate(B.begin(), B.end(), [&gen, &nd] { return nd(gen); });
+  if (packed_b) {
+    kernels::PackGemmB(B.data(), b_batch, K, M, transpose_b,
+                       B_packed.data());
+  }
+  kernels::BroadcastBatchGemm(A.data(),
+                              packed_b ? B_packed.data() : B.data(), batch,
+                              a_batch, b_batch, a_index.data(),
+                              b_index.data(), N, K, M, C.data(), false,
+                              transpose_b, false, packed_b);
+  for (index_t b = 0; b < batch; ++b) {
+    kernels::GemmRef(A.data() + a_index[b] * N * K,
+                     B.data() + b_index[b] * K * M, 1, N, K, M, C_ref.data(),
+                     false, transpose_b);
+    for (int i = 0; i < N * M; ++i) {
+      EXPECT_NEAR(C_ref[i], C[b * N * M + i], 0.1);
+    }
+  }
+}
+
+void SkinnyGemmTest(index_t batch, index_t N, index_t M) {
+  std::unique_ptr<float[]> A(new float[N * M]);
+  std::unique_ptr<float[]> B(new float[batch * M]);
+  std::unique_ptr<float[]> C(new float[batch * N]);
+  std::unique_ptr<float[]> C_ref(new float[batch * N]);
+
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::normal_distribution<float> nd(0, 1);
+
+  std::generate(A.get(), A.get() + N * M, [&gen, &nd] { return nd(gen); });
+  std::generate(B.get(), B.get() + batch * M, [&gen, &nd] { return nd(gen); });
+  kernels::SkinnyGemm(A.get(), B.get(), batch, M, N, C.get());
+  kernels::GemvRef(A.get(), B.get(), batch, M, N, C_ref.get());
+
+  for (int i = 0; i < batch * N; ++i) {
+    EXPECT_NEAR(C_ref[i], C[i], 0.1);
+  }
+}
+
 }  // namespace
 
 TEST(GEMMTest, AlignedWithoutBatch) {
@@ -107,9 +221,123 @@ TEST(GEMMTest, UnalignedWithBatch) {
   GemmTest(3, 17, 63, 127, true, true);
 }
 
+TEST(GEMMTest, OddShapes) {
+  // cover every register tile remain of the cpu micro kernels
+  const index_t heights[] = {1, 5, 6, 7, 13};
+  const index_t ks[] = {1, 3, 65};
+  const index_t widths[] = {1, 7, 15, 16, 17, 33, 65};
+  int count = 0;
+  for (index_t height : heights) {
+    for (index_t k : ks) {
+      for (index_t width : widths) {
+        GemmTest(2, height, k, width, count & 1, count & 2);
+        ++count;
+      }
+    }
+  }
+}
+
+TEST(GEMMTest, Transposed) {
+  // MatMul(Q, K^T) and the like, rows not a multiple of the packed rows
+  for (int t = 0; t < 4; ++t) {
+    GemmTest(2, 77, 64, 77, t & 1, t & 2);
+    GemmTest(1, 201, 389, 45, t & 1, t & 2);
+    GemmTest(1, 201, 389, 45, t & 1, t & 2, true, true);
+  }
+}
+
+TEST(GEMMTest, LargeBlocks) {
+  // multiple blocks along every dimension, B packed on the fly
+  const kernels::CPUBlocking &blocking = kernels::GetCPUBlocking();
+  GemmTest(1, 2 * blocking.gemm_m + 6, 2 * blocking.gemm_k + 44,
+           2 * blocking.gemm_n + 4, false, false);
+  GemmTest(2, blocking.gemm_m + 1, 2 * blocking.gemm_k + 1,
+           blocking.gemm_n + 1, true, true);
+}
+
+TEST(GEMMTest, GemmWithBlocking) {
+  const index_t height = 150;
+  const index_t K = 300;
+  const index_t width = 260;
+  std::vector<float> A(height * K);
+  std::vector<float> B(K * width);
+  std::mt19937 gen(0);
+  std::normal_distribution<float> nd(0, 1);
+  std::generate(A.begin(), A.end(), [&gen, &nd] { return nd(gen); });
+  std::generate(B.begin(), B.end(), [&gen, &nd] { return nd(gen); });
+  std::vector<float> C_ref(height * width);
+  kernels::GemmRef(A.data(), B.data(), 1, height, K, width, C_ref.data());
+
+  for (const kernels::CPUBlocking &blocking : kernels::CPUBlockingCandidates(
+           kernels::DefaultCPUBlocking())) {
+    std::vector<float> C(height * width);
+    kernels::GemmWithBlocking(A.data(), B.data(), height, K, width, blocking,
+                              C.data());
+    for (index_t i = 0; i < height * width; ++i) {
+      EXPECT_NEAR(C_ref[i], C[i], 1e-3) << "blocking " << blocking.gemm_m
+                                        << "x" << blocking.gemm_k << "x"
+                                        << blocking.gemm_n << ", i " << i;
+    }
+  }
+}
+
+TEST(GEMMTest, PackedOperands) {
+  GemmTest(1, 7, 384, 129, false, false, false, true);
+  GemmTest(2, 73, 257, 129, false, true, true, false);
+  GemmTest(2, 73, 257, 129, true, false, true, true);
+  GemmTest(1, 5, 3, 1, false, true, false, true);
+  GemmTest(1, 5, 300, 1, true, false, true, false);
+}
+
+TEST(GEMMTest, BatchGemm) {
+  // Winograd: tile positions x images
+  BatchGemmTest(16 * 3, 16, 16, 16, 49, false, true);
+  BatchGemmTest(64 * 2, 64, 32, 24, 9, false, true);
+  BatchGemmTest(6, 3, 73, 130, 200, false, false);
+  BatchGemmTest(6, 2, 17, 33, 65, true, false);
+  BatchGemmTest(4, 4, 5, 300, 1, false, false);
+}
+
+TEST(GEMMTest, BroadcastBatchGemm) {
+  // heads x batches of A times the batches of B
+  BroadcastBatchGemmTest({0, 1, 2, 3, 4, 5}, {0, 0, 0, 1, 1, 1}, 16, 64, 33,
+                         false, false);
+  BroadcastBatchGemmTest({0, 0, 0, 1, 1, 1}, {0, 1, 2, 0, 1, 2}, 73, 130,
+                         200, true, false);
+  BroadcastBatchGemmTest({0, 1, 0, 1}, {1, 1, 0, 0}, 9, 257, 129, false,
+                         true);
+  BroadcastBatchGemmTest({2, 0, 1}, {0, 0, 0}, 5, 300, 1, true, true);
+}
+
 TEST(GEMMTest, gemv) {
   GemvTest(1, 17, 63);
   GemvTest(3, 17, 63);
 }
 
+TEST(GEMMTest, OddShapesGemv) {
+  GemvTest(1, 1, 1);
+  GemvTest(2, 3, 7);
+  GemvTest(2, 5, 9);
+  GemvTest(3, 9, 17);
+}
+
+TEST(GEMMTest, SkinnyGemm) {
+  for (index_t batch : {1, 2, 3, 5, 8, 16}) {
+    SkinnyGemmTest(batch, 1, 1);
+    SkinnyGemmTest(batch, 7, 13);
+    SkinnyGemmTest(batch, 33, 67);
+    SkinnyGemmTest(batch, 100, 300);
+  }
+}
+
+TEST(GEMMTest, SkinnyGemmSplitK) {
+  // few rows for many threads split K
+  const int num_threads = GetOpenMPNumThreads();
+  SetOpenMPNumThreads(4);
+  SkinnyGemmTest(1, 3, 4099);
+  SkinnyGemmTest(7, 10, 8192);
+  SkinnyGemmTest(16, 1, 2048);
+  SetOpenMPNumThreads(num_threads);
+}
+
 }  // namespace mace
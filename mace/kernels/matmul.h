@@ -29,6 +29,7 @@
 #include "mace/core/future.h"
 #include "mace/core/tensor.h"
 #include "mace/kernels/gemm.h"
+#include "mace/kernels/sparse_gemm.h"
 #include "mace/utils/utils.h"
 
 #ifdef MACE_ENABLE_OPENCL
@@ -38,8 +39,103 @@
 namespace mace {
 namespace kernels {
 
+// Broadcasts the batch dims of A and B like NumPy: aligned to the right,
+// a dim of 1 or a missing one takes the size of the other. The batch n of C
+// multiplies the matrix a_index[n] of A by the matrix b_index[n] of B.
+inline void BroadcastMatMulBatch(const std::vector<index_t> &a_batch_shape,
+                                 const std::vector<index_t> &b_batch_shape,
+                                 std::vector<index_t> *c_batch_shape,
+                                 std::vector<index_t> *a_index,
+                                 std::vector<index_t> *b_index) {
+  const size_t rank = std::max(a_batch_shape.size(), b_batch_shape.size());
+  std::vector<index_t> a_shape(rank - a_batch_shape.size(), 1);
+  std::vector<index_t> b_shape(rank - b_batch_shape.size(), 1);
+  a_shape.insert(a_shape.end(), a_batch_shape.begin(), a_batch_shape.end());
+  b_shape.insert(b_shape.end(), b_batch_shape.begin(), b_batch_shape.end());
+
+  // the strides of a broadcast dim are 0
+  c_batch_shape->resize(rank);
+  std::vector<index_t> a_strides(rank);
+  std::vector<index_t> b_strides(rank);
+  index_t batch = 1;
+  index_t a_stride = 1;
+  index_t b_stride = 1;
+  for (size_t i = rank; i-- > 0;) {
+    MACE_CHECK(a_shape[i] == b_shape[i] || a_shape[i] == 1 ||
+                   b_shape[i] == 1,
+               "batch dims of A ", MakeString(a_batch_shape), " and B ",
+               MakeString(b_batch_shape), " can not be broadcast");
+    (*c_batch_shape)[i] = std::max(a_shape[i], b_shape[i]);
+    a_strides[i] = a_shape[i] == 1 ? 0 : a_stride;
+    b_strides[i] = b_shape[i] == 1 ? 0 : b_stride;
+    a_stride *= a_shape[i];
+    b_stride *= b_shape[i];
+    batch *= (*c_batch_shape)[i];
+  }
+
+  a_index->resize(batch);
+  b_index->resize(batch);
+  std::vector<index_t> index(rank, 0);
+  index_t a_offset = 0;
+  index_t b_offset = 0;
+  for (index_t n = 0; n < batch; ++n) {
+    (*a_index)[n] = a_offset;
+    (*b_index)[n] = b_offset;
+    // the next index, carrying over the exhausted dims
+    for (size_t i = rank; i-- > 0;) {
+      ++index[i];
+      a_offset += a_strides[i];
+      b_offset += b_strides[i];
+      if (index[i] < (*c_batch_shape)[i]) break;
+      a_offset -= a_strides[i] * index[i];
+      b_offset -= b_strides[i] * index[i];
+      index[i] = 0;
+    }
+  }
+}
+
 template <DeviceType D, typename T>
 struct MatMulFunctor {
+  MatMulFunctor() : is_b_packed_(false) {}
+
+  // Packs a constant B once, the packed one is reused by every run. A pruned
+  // B of a single batch, tagged with the rows of its sparse blocks, is
+  // packed as the sparse lhs W = B^T of C^T = W * A^T instead.
+  MaceStatus Prepare(const Tensor *B, bool transpose_b,
+                     const int sparse_block_rows) {
+    if (!B->is_weight() || B->dim_size() < 2) return MACE_SUCCESS;
+    const index_t rank = B->dim_size();
+    index_t K = B->dim(rank - 2);
+    index_t width = B->dim(rank - 1);
+    if (transpose_b) {
+      std::swap(K, width);
+    }
+    const index_t batch = B->size() / (K * width);
+    Tensor::MappingGuard guardb(B);
+    if (sparse_block_rows > 0 && batch == 1) {
+      const T *b_ptr = B->data<T>();
+      std::vector<T> transposed_b;
+      if (!transpose_b) {
+        transposed_b.resize(B->size());
+        for (index_t k = 0; k < K; ++k) {
+          for (index_t w = 0; w < width; ++w) {
+            transposed_b[w * K + k] = b_ptr[k * width + w];
+          }
+        }
+        b_ptr = transposed_b.data();
+      }
+      if (TryPackBlockSparse(b_ptr, width, K, sparse_block_rows,
+                             &sparse_b_)) {
+        return MACE_SUCCESS;
+      }
+    }
+    MACE_RETURN_IF_ERROR(packed_b_.Resize(B->shape()));
+    PackGemmB(B->data<T>(), batch, K, width, transpose_b,
+              packed_b_.mutable_data<T>());
+    is_b_packed_ = true;
+    return MACE_SUCCESS;
+  }
+
   MaceStatus operator()(const Tensor *A,
                         const Tensor *B,
                         Tensor *C,
@@ -48,28 +144,28 @@ struct MatMulFunctor {
                         StatsFuture *future) {
     MACE_UNUSED(future);
 
-    index_t batch;
-    index_t height;
-    index_t K;
-    index_t width;
-
-    index_t rank = A->dim_size();
-    height = A->dim(rank - 2);
-    K = A->dim(rank - 1);
+    const index_t a_rank = A->dim_size();
+    const index_t b_rank = B->dim_size();
+    index_t height = A->dim(a_rank - 2);
+    index_t K = A->dim(a_rank - 1);
     if (transpose_a) {
       std::swap(height, K);
     }
-    if (transpose_b) {
-      width = B->dim(rank - 2);
-    } else {
-      width = B->dim(rank - 1);
-    }
-    batch = std::accumulate(A->shape().begin(), A->shape().end() - 2, 1,
-                            std::multiplies<index_t>());
-
-    std::vector<index_t> c_shape = A->shape();
-    c_shape[rank - 2] = height;
-    c_shape[rank - 1] = width;
+    const index_t width = transpose_b ? B->dim(b_rank - 2)
+                                      : B->dim(b_rank - 1);
+
+    std::vector<index_t> c_shape;
+    std::vector<index_t> a_index;
+    std::vector<index_t> b_index;
+    BroadcastMatMulBatch(
+        std::vector<index_t>(A->shape().begin(), A->shape().end() - 2),
+        std::vector<index_t>(B->shape().begin(), B->shape().end() - 2),
+        &c_shape, &a_index, &b_index);
+    const index_t batch = a_index.size();
+    const index_t a_batch = A->size() / (height * K);
+    const index_t b_batch = B->size() / (K * width);
+    c_shape.push_back(height);
+    c_shape.push_back(width);
 
     MACE_RETURN_IF_ERROR(C->Resize(c_shape));
 
@@ -80,21 +176,58 @@ struct MatMulFunctor {
     const T *b_ptr_base = B->data<T>();
     T *c_ptr_base = C->mutable_data<T>();
 
-    // It is better to use large block size if it fits for fast cache.
-    // Assume l1 cache size is 32k, we load three blocks at a time (A, B, C),
-    // the block size should be sqrt(32k / sizeof(T) / 3).
-    memset(c_ptr_base, 0, batch * height * width * sizeof(T));
-
-    Gemm(a_ptr_base, b_ptr_base, batch, height, K, width, c_ptr_base,
-         transpose_a, transpose_b);
+    // Gemm sizes its blocks by the caches of the cpu, see GetCPUBlocking().
+    // Transposed operands are read in place while being packed.
+    if (b_batch == 1 && !transpose_a) {
+      // a B shared by the batch, e.g., a weight, multiplies the rows of all
+      // the batches of A at once, which are not broadcast as B has none
+      const index_t rows = batch * height;
+      if (!sparse_b_.empty()) {
+        // the rows of A are the vectors of the sparse Gemv
+        BlockSparseGemv(sparse_b_, a_ptr_base, rows, c_ptr_base);
+      } else if (transpose_b && rows <= kSkinnyGemmMaxBatch) {
+        // a few rows of A times B laid out as a fully connected weight
+        SkinnyGemm(b_ptr_base, a_ptr_base, rows, K, width, c_ptr_base);
+      } else {
+        Gemm(a_ptr_base, is_b_packed_ ? packed_b_.data<T>() : b_ptr_base, 1,
+             rows, K, width, c_ptr_base, false, transpose_b, false,
+             is_b_packed_);
+      }
+    } else if (!transpose_a && transpose_b &&
+               height <= kSkinnyGemmMaxBatch) {
+      for (index_t i = 0; i < batch; ++i) {
+        SkinnyGemm(b_ptr_base + b_index[i] * width * K,
+                   a_ptr_base + a_index[i] * height * K, height, K, width,
+                   c_ptr_base + i * height * width);
+      }
+    } else {
+      // the broadcast matrices are indexed, not copied
+      BroadcastBatchGemm(a_ptr_base,
+                         is_b_packed_ ? packed_b_.data<T>() : b_ptr_base,
+                         batch, a_batch, b_batch, a_index.data(),
+                         b_index.data(), height, K, width, c_ptr_base,
+                         transpose_a, transpose_b, false, is_b_packed_);
+    }
 
     return MACE_SUCCESS;
   }
+
+  Tensor packed_b_;
+  bool is_b_packed_;
+  BlockSparseMatrix sparse_b_;
 };
 
 #ifdef MACE_ENABLE_OPENCL
 template <typename T>
 struct MatMulFunctor<DeviceType::GPU, T> {
+  MaceStatus Prepare(const Tensor *B, bool transpose_b,
+                     const int sparse_block_rows) {
+    MACE_UNUSED(B);
+    MACE_UNUSED(transpose_b);
+    MACE_UNUSED(sparse_block_rows);
+    return MACE_SUCCESS;
+  }
+
   MaceStatus operator()(const Tensor *A,
                         const Tensor *B,
                         Tensor *C,
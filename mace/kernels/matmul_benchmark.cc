@@ -14,11 +14,13 @@
 
 #include <Eigen/Dense>
 #include <algorithm>
+#include <random>
 #include <string>
 #include <vector>
 
 #include "mace/core/testing/test_benchmark.h"
 #include "mace/kernels/gemm.h"
+#include "mace/kernels/sparse_gemm.h"
 
 namespace mace {
 namespace kernels {
@@ -42,6 +44,173 @@ void MatmulBenchmark_Mace(int iters, int m, int k, int n) {
   }
 }
 
+// rhs is constant and packed ahead of time, like the weights
+void MatmulBenchmark_Packed(int iters, int m, int k, int n) {
+  mace::testing::StopTiming();
+  std::vector<float> lhs(m * k);
+  std::vector<float> rhs(k * n);
+  std::vector<float> packed_rhs(k * n);
+  std::vector<float> result(m * n);
+  PackGemmB(rhs.data(), 1, k, n, false, packed_rhs.data());
+  // warm up
+  Gemm(lhs.data(), packed_rhs.data(), 1, m, k, n, result.data(), false, false,
+       false, true);
+  mace::testing::StartTiming();
+  while (iters--) {
+    Gemm(lhs.data(), packed_rhs.data(), 1, m, k, n, result.data(), false,
+         false, false, true);
+  }
+}
+
+// A few rows of lhs times rhs laid out as a fully connected weight, (n, k)
+void MatmulBenchmark_Gemv(int iters, int m, int k, int n) {
+  mace::testing::StopTiming();
+  std::vector<float> lhs(m * k);
+  std::vector<float> rhs(k * n);
+  std::vector<float> result(m * n);
+  // warm up
+  Gemv(rhs.data(), lhs.data(), m, k, n, result.data());
+  mace::testing::StartTiming();
+  while (iters--) {
+    Gemv(rhs.data(), lhs.data(), m, k, n, result.data());
+  }
+}
+
+void MatmulBenchmark_Skinny(int iters, int m, int k, int n) {
+  mace::testing::StopTiming();
+  std::vector<float> lhs(m * k);
+  std::vector<float> rhs(k * n);
+  std::vector<float> result(m * n);
+  // warm up
+  SkinnyGemm(rhs.data(), lhs.data(), m, k, n, result.data());
+  mace::testing::StartTiming();
+  while (iters--) {
+    SkinnyGemm(rhs.data(), lhs.data(), m, k, n, result.data());
+  }
+}
+
+// Operands in the layouts of MatMul with transpose_a / transpose_b set, e.g.,
+// NT is lhs (m, k) times rhs (n, k) transposed
+void MatmulBenchmark_Transposed(int iters, int m, int k, int n,
+                                bool transpose_a, bool transpose_b) {
+  mace::testing::StopTiming();
+  std::vector<float> lhs(m * k);
+  std::vector<float> rhs(k * n);
+  std::vector<float> result(m * n);
+  // warm up
+  Gemm(lhs.data(), rhs.data(), 1, m, k, n, result.data(), transpose_a,
+       transpose_b);
+  mace::testing::StartTiming();
+  while (iters--) {
+    Gemm(lhs.data(), rhs.data(), 1, m, k, n, result.data(), transpose_a,
+         transpose_b);
+  }
+}
+
+void MatmulBenchmark_NT(int iters, int m, int k, int n) {
+  MatmulBenchmark_Transposed(iters, m, k, n, false, true);
+}
+
+void MatmulBenchmark_TN(int iters, int m, int k, int n) {
+  MatmulBenchmark_Transposed(iters, m, k, n, true, false);
+}
+
+void MatmulBenchmark_TT(int iters, int m, int k, int n) {
+  MatmulBenchmark_Transposed(iters, m, k, n, true, true);
+}
+
+// Blocked by the default blocking against the one of the running cpu
+void MatmulBenchmark_Fixed(int iters, int m, int k, int n) {
+  mace::testing::StopTiming();
+  std::vector<float> lhs(m * k);
+  std::vector<float> rhs(k * n);
+  std::vector<float> result(m * n);
+  const CPUBlocking blocking = DefaultCPUBlocking();
+  // warm up
+  GemmWithBlocking(lhs.data(), rhs.data(), m, k, n, blocking, result.data());
+  mace::testing::StartTiming();
+  while (iters--) {
+    GemmWithBlocking(lhs.data(), rhs.data(), m, k, n, blocking,
+                     result.data());
+  }
+}
+
+void MatmulBenchmark_Derived(int iters, int m, int k, int n) {
+  mace::testing::StopTiming();
+  std::vector<float> lhs(m * k);
+  std::vector<float> rhs(k * n);
+  std::vector<float> result(m * n);
+  const CPUBlocking &blocking = GetCPUBlocking();
+  // warm up
+  GemmWithBlocking(lhs.data(), rhs.data(), m, k, n, blocking, result.data());
+  mace::testing::StartTiming();
+  while (iters--) {
+    GemmWithBlocking(lhs.data(), rhs.data(), m, k, n, blocking,
+                     result.data());
+  }
+}
+
+// rows x cols with density percent of its block_rows x 4 blocks kept
+std::vector<float> PrunedMatrix(int rows, int cols, int block_rows,
+                                int density) {
+  std::vector<float> matrix(rows * cols, 0.f);
+  std::mt19937 rng(0);
+  std::uniform_int_distribution<int> percent(0, 99);
+  for (int row = 0; row < rows; row += block_rows) {
+    for (int col = 0; col < cols; col += kSparseBlockCols) {
+      if (percent(rng) >= density) continue;
+      for (int r = row; r < std::min(rows, row + block_rows); ++r) {
+        for (int c = col; c < std::min<int>(cols, col + kSparseBlockCols);
+             ++c) {
+          matrix[r * cols + c] = 0.5f;
+        }
+      }
+    }
+  }
+  return matrix;
+}
+
+// Pruned lhs (m, k) as a 1x1 conv filter, or pruned rhs (n, k) as a fully
+// connected weight if is_gemv
+void SparseBenchmark(int iters, int m, int k, int n, int block_rows,
+                     int density, bool is_gemv) {
+  mace::testing::StopTiming();
+  const int weight_rows = is_gemv ? n : m;
+  const std::vector<float> weight =
+      PrunedMatrix(weight_rows, k, block_rows, density);
+  BlockSparseMatrix sparse;
+  PackBlockSparse(weight.data(), weight_rows, k, block_rows, &sparse);
+  std::vector<float> dense(is_gemv ? m * k : k * n);
+  std::vector<float> result(m * n);
+  // warm up
+  if (is_gemv) {
+    BlockSparseGemv(sparse, dense.data(), m, result.data());
+  } else {
+    BlockSparseGemm(sparse, dense.data(), 1, n, result.data());
+  }
+  mace::testing::StartTiming();
+  while (iters--) {
+    if (is_gemv) {
+      BlockSparseGemv(sparse, dense.data(), m, result.data());
+    } else {
+      BlockSparseGemm(sparse, dense.data(), 1, n, result.data());
+    }
+  }
+}
+
+void MatmulBenchmark_Ref(int iters, int m, int k, int n) {
+  mace::testing::StopTiming();
+  std::vector<float> lhs(m * k);
+  std::vector<float> rhs(k * n);
+  std::vector<float> result(m * n);
+  // warm up
+  GemmRef(lhs.data(), rhs.data(), 1, m, k, n, result.data());
+  mace::testing::StartTiming();
+  while (iters--) {
+    GemmRef(lhs.data(), rhs.data(), 1, m, k, n, result.data());
+  }
+}
+
 void MatmulBenchmark_Eigen(int iters, int m, int k, int n) {
   mace::testing::StopTiming();
   Eigen::MatrixXd lhs = Eigen::MatrixXd::Random(m, k);
@@ -71,6 +240,63 @@ void MatmulBenchmark_Eigen(int iters, int m, int k, int n) {
   MACE_BM_MATMUL_FUNC(M, K, N, Mace);  \
   MACE_BM_MATMUL_FUNC(M, K, N, Eigen);
 
+// Optimized gemm against the scalar reference, GFLOPS = 2 * MACC(G/s)
+#define MACE_BM_GEMM(M, K, N)          \
+  MACE_BM_MATMUL_FUNC(M, K, N, Mace);  \
+  MACE_BM_MATMUL_FUNC(M, K, N, Ref);
+
+// Packed on the fly against pre-packed constant rhs
+#define MACE_BM_GEMM_PACKED(M, K, N)   \
+  MACE_BM_MATMUL_FUNC(M, K, N, Mace);  \
+  MACE_BM_MATMUL_FUNC(M, K, N, Packed);
+
+// Batched gemv against streaming the weight once for the batch
+#define MACE_BM_SKINNY_GEMM(M, K, N)   \
+  MACE_BM_MATMUL_FUNC(M, K, N, Gemv);  \
+  MACE_BM_MATMUL_FUNC(M, K, N, Skinny);
+
+// Row major operands against the transposed layouts
+#define MACE_BM_GEMM_TRANSPOSE(M, K, N) \
+  MACE_BM_MATMUL_FUNC(M, K, N, Mace);   \
+  MACE_BM_MATMUL_FUNC(M, K, N, NT);     \
+  MACE_BM_MATMUL_FUNC(M, K, N, TN);     \
+  MACE_BM_MATMUL_FUNC(M, K, N, TT);
+
+// Fixed blocking against the one derived from the caches
+#define MACE_BM_GEMM_BLOCKING(M, K, N)  \
+  MACE_BM_MATMUL_FUNC(M, K, N, Fixed);  \
+  MACE_BM_MATMUL_FUNC(M, K, N, Derived);
+
+// MACC of the dense matmul, i.e., the equivalent throughput
+#define MACE_BM_SPARSE_FUNC(M, K, N, BR, DENSITY, TYPE, IS_GEMV)          \
+  static void                                                              \
+      MACE_BM_##TYPE##_##M##_##K##_##N##_##BR##x4_##DENSITY(int iters) {   \
+    const int64_t macc = static_cast<int64_t>(iters) * M * K * N;          \
+    const int64_t tot = static_cast<int64_t>(iters) * (M + N) * K;         \
+    mace::testing::MaccProcessed(macc);                                    \
+    mace::testing::BytesProcessed(tot * sizeof(float));                    \
+    SparseBenchmark(iters, M, K, N, BR, DENSITY, IS_GEMV);                 \
+  }                                                                        \
+  MACE_BENCHMARK(MACE_BM_##TYPE##_##M##_##K##_##N##_##BR##x4_##DENSITY)
+
+#define MACE_BM_SPARSE_DENSITIES(M, K, N, TYPE, IS_GEMV)   \
+  MACE_BM_SPARSE_FUNC(M, K, N, 1, 10, TYPE, IS_GEMV);      \
+  MACE_BM_SPARSE_FUNC(M, K, N, 1, 30, TYPE, IS_GEMV);      \
+  MACE_BM_SPARSE_FUNC(M, K, N, 1, 50, TYPE, IS_GEMV);      \
+  MACE_BM_SPARSE_FUNC(M, K, N, 4, 10, TYPE, IS_GEMV);      \
+  MACE_BM_SPARSE_FUNC(M, K, N, 4, 30, TYPE, IS_GEMV);      \
+  MACE_BM_SPARSE_FUNC(M, K, N, 4, 50, TYPE, IS_GEMV);
+
+// Pruned 1x1 conv filter against the dense gemm
+#define MACE_BM_SPARSE_GEMM(M, K, N)  \
+  MACE_BM_MATMUL_FUNC(M, K, N, Mace); \
+  MACE_BM_SPARSE_DENSITIES(M, K, N, SPARSE_GEMM, false)
+
+// Pruned fully connected weight against the dense skinny gemm
+#define MACE_BM_SPARSE_GEMV(M, K, N)    \
+  MACE_BM_MATMUL_FUNC(M, K, N, Skinny); \
+  MACE_BM_SPARSE_DENSITIES(M, K, N, SPARSE_GEMV, true)
+
 // Embedding size 384
 MACE_BM_MATMUL(7, 384, 384);
 MACE_BM_MATMUL(7, 384, 1536);
@@ -89,6 +315,49 @@ MACE_BM_MATMUL(1, 384, 44678);
 MACE_BM_MATMUL(1, 128, 1536);
 MACE_BM_MATMUL(1, 128, 44678);
 
+// Square and odd shapes
+MACE_BM_GEMM(64, 64, 64);
+MACE_BM_GEMM(127, 127, 127);
+MACE_BM_GEMM(256, 256, 256);
+// 1x1 conv: out_channels x in_channels x (height * width)
+MACE_BM_GEMM(64, 64, 3136);
+MACE_BM_GEMM(128, 128, 784);
+MACE_BM_GEMM(255, 255, 193);
+
+// Transformer: sequence length x hidden size x (hidden size | ffn size)
+MACE_BM_GEMM_PACKED(128, 768, 768);
+MACE_BM_GEMM_PACKED(128, 768, 3072);
+MACE_BM_GEMM_PACKED(128, 3072, 768);
+// CNN: im2col/1x1 conv, (height * width) x in_channels x out_channels
+MACE_BM_GEMM_PACKED(3136, 64, 256);
+MACE_BM_GEMM_PACKED(784, 512, 128);
+MACE_BM_GEMM_PACKED(196, 1152, 256);
+
+// Fully connected with small batches, and with few outputs
+MACE_BM_SKINNY_GEMM(1, 4096, 4096);
+MACE_BM_SKINNY_GEMM(4, 4096, 4096);
+MACE_BM_SKINNY_GEMM(8, 2048, 4096);
+MACE_BM_SKINNY_GEMM(16, 1024, 1000);
+MACE_BM_SKINNY_GEMM(1, 65536, 10);
+
+// Attention: Q K^T with head size 64, then the scores times V
+MACE_BM_GEMM_TRANSPOSE(128, 64, 128);
+MACE_BM_GEMM_TRANSPOSE(384, 64, 384);
+MACE_BM_GEMM_TRANSPOSE(384, 384, 64);
+MACE_BM_GEMM_TRANSPOSE(512, 512, 512);
+
+// 1x1 conv: out_channels x in_channels x (height * width)
+MACE_BM_SPARSE_GEMM(128, 256, 784);
+MACE_BM_SPARSE_GEMM(256, 256, 196);
+// Fully connected: batch x input size x output size
+MACE_BM_SPARSE_GEMV(1, 2048, 2048);
+MACE_BM_SPARSE_GEMV(8, 2048, 1024);
+
+MACE_BM_GEMM_BLOCKING(512, 512, 512);
+MACE_BM_GEMM_BLOCKING(1024, 1024, 1024);
+MACE_BM_GEMM_BLOCKING(196, 1152, 256);
+MACE_BM_GEMM_BLOCKING(64, 576, 3136);
+
 }  // namespace test
 }  // namespace kernels
 }  // namespace mace
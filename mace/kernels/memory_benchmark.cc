@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <algorithm>
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -88,8 +89,40 @@ void MemoryAccessBenchmark_NHCW(
   }
 }
 
+// Copies one half of a working set of size bytes to the other over and over,
+// the bandwidth drops as it spills out of each cache level.
+void MemoryCopyBenchmark(int iters, int size) {
+  mace::testing::StopTiming();
+  std::vector<char> buffer(size, 1);
+  const int half = size / 2;
+  mace::testing::StartTiming();
+
+  for (int i = 0; i < iters; ++i) {
+    // alternate the direction so that no copy is redundant
+    char *src = buffer.data() + (i % 2) * half;
+    char *dst = buffer.data() + (1 - i % 2) * half;
+    memcpy(dst, src, half);
+  }
+}
+
 }  // namespace
 
+#define MACE_BM_MEMORY_COPY(KB)                                     \
+  static void MACE_BM_MEMORY_COPY_##KB##K(int iters) {              \
+    const int64_t tot = static_cast<int64_t>(iters) * KB * 1024;    \
+    mace::testing::BytesProcessed(tot);                             \
+    MemoryCopyBenchmark(iters, KB * 1024);                          \
+  }                                                                 \
+  MACE_BENCHMARK(MACE_BM_MEMORY_COPY_##KB##K)
+
+// Spans L1, L2, L3 and DRAM on most cpus, compare with the cache sizes
+// GetCPUBlocking() is derived from.
+MACE_BM_MEMORY_COPY(16);
+MACE_BM_MEMORY_COPY(128);
+MACE_BM_MEMORY_COPY(512);
+MACE_BM_MEMORY_COPY(4096);
+MACE_BM_MEMORY_COPY(65536);
+
 #define MACE_BM_MEMORY_ACCESS(N, H, W, C, ORDER)                     \
   static void MACE_BM_MEMORY_ACCESS_##N##_##H##_##W##_##C##_##ORDER( \
       int iters) {                                                   \
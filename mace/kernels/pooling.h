@@ -23,6 +23,7 @@
 #include "mace/core/future.h"
 #include "mace/core/tensor.h"
 #include "mace/kernels/conv_pool_2d_util.h"
+#include "mace/kernels/cpu_dispatch.h"
 
 #ifdef MACE_ENABLE_OPENCL
 #include "mace/core/runtime/opencl/cl2_header.h"
@@ -59,113 +60,114 @@ struct PoolingFunctorBase {
   const int *dilations_;
 };
 
-template <DeviceType D, typename T>
-struct PoolingFunctor;
-
-template <>
-struct PoolingFunctor<DeviceType::CPU, float>: PoolingFunctorBase {
-  PoolingFunctor(const PoolingType pooling_type,
-                 const int *kernels,
-                 const int *strides,
-                 const Padding padding_type,
-                 const std::vector<int> &paddings,
-                 const int *dilations)
-      : PoolingFunctorBase(
-            pooling_type, kernels, strides, padding_type, paddings, dilations) {
-  }
-
-  void MaxPooling(const float *input,
-                  const index_t *in_shape,
-                  const index_t *out_shape,
-                  const int *filter_hw,
-                  const int *stride_hw,
-                  const int *dilation_hw,
-                  const int *pad_hw,
-                  float *output) {
-    const index_t in_image_size = in_shape[2] * in_shape[3];
-    const index_t out_image_size = out_shape[2] * out_shape[3];
-    const index_t in_batch_size = in_shape[1] * in_image_size;
-    const index_t out_batch_size = out_shape[1] * out_image_size;
+// Defaults of the pooling kernels in cpu_dispatch.h
+inline void MaxPoolingDefault(const float *input,
+                              const index_t *in_shape,
+                              const index_t *out_shape,
+                              const int *filter_hw,
+                              const int *stride_hw,
+                              const int *dilation_hw,
+                              const int *pad_hw,
+                              float *output) {
+  const index_t in_image_size = in_shape[2] * in_shape[3];
+  const index_t out_image_size = out_shape[2] * out_shape[3];
+  const index_t in_batch_size = in_shape[1] * in_image_size;
+  const index_t out_batch_size = out_shape[1] * out_image_size;
 
 #pragma omp parallel for collapse(2)
-    for (index_t b = 0; b < out_shape[0]; ++b) {
-      for (index_t c = 0; c < out_shape[1]; ++c) {
-        const index_t out_base = b * out_batch_size + c * out_image_size;
-        const index_t in_base = b * in_batch_size + c * in_image_size;
-        const index_t out_height = out_shape[2];
-        const index_t out_width = out_shape[3];
-        const index_t in_height = in_shape[2];
-        const index_t in_width = in_shape[3];
-
-        for (index_t h = 0; h < out_height; ++h) {
-          for (index_t w = 0; w < out_width; ++w) {
-            const index_t out_offset = out_base + h * out_width + w;
-            float res = std::numeric_limits<float>::lowest();
-            for (int fh = 0; fh < filter_hw[0]; ++fh) {
-              for (int fw = 0; fw < filter_hw[1]; ++fw) {
-                index_t inh =
-                    h * stride_hw[0] + dilation_hw[0] * fh - pad_hw[0];
-                index_t inw =
-                    w * stride_hw[1] + dilation_hw[1] * fw - pad_hw[1];
-                if (inh >= 0 && inh < in_height && inw >= 0 && inw < in_width) {
-                  index_t input_offset = in_base + inh * in_width + inw;
-                  res = std::max(res, input[input_offset]);
-                }
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t c = 0; c < out_shape[1]; ++c) {
+      const index_t out_base = b * out_batch_size + c * out_image_size;
+      const index_t in_base = b * in_batch_size + c * in_image_size;
+      const index_t out_height = out_shape[2];
+      const index_t out_width = out_shape[3];
+      const index_t in_height = in_shape[2];
+      const index_t in_width = in_shape[3];
+
+      for (index_t h = 0; h < out_height; ++h) {
+        for (index_t w = 0; w < out_width; ++w) {
+          const index_t out_offset = out_base + h * out_width + w;
+          float res = std::numeric_limits<float>::lowest();
+          for (int fh = 0; fh < filter_hw[0]; ++fh) {
+            for (int fw = 0; fw < filter_hw[1]; ++fw) {
+              index_t inh =
+                  h * stride_hw[0] + dilation_hw[0] * fh - pad_hw[0];
+              index_t inw =
+                  w * stride_hw[1] + dilation_hw[1] * fw - pad_hw[1];
+              if (inh >= 0 && inh < in_height && inw >= 0 && inw < in_width) {
+                index_t input_offset = in_base + inh * in_width + inw;
+                res = std::max(res, input[input_offset]);
               }
             }
-            output[out_offset] = res;
           }
+          output[out_offset] = res;
         }
       }
     }
   }
+}
 
-  void AvgPooling(const float *input,
-                  const index_t *in_shape,
-                  const index_t *out_shape,
-                  const int *filter_hw,
-                  const int *stride_hw,
-                  const int *dilation_hw,
-                  const int *pad_hw,
-                  float *output) {
-    const index_t in_image_size = in_shape[2] * in_shape[3];
-    const index_t out_image_size = out_shape[2] * out_shape[3];
-    const index_t in_batch_size = in_shape[1] * in_image_size;
-    const index_t out_batch_size = out_shape[1] * out_image_size;
+inline void AvgPoolingDefault(const float *input,
+                              const index_t *in_shape,
+                              const index_t *out_shape,
+                              const int *filter_hw,
+                              const int *stride_hw,
+                              const int *dilation_hw,
+                              const int *pad_hw,
+                              float *output) {
+  const index_t in_image_size = in_shape[2] * in_shape[3];
+  const index_t out_image_size = out_shape[2] * out_shape[3];
+  const index_t in_batch_size = in_shape[1] * in_image_size;
+  const index_t out_batch_size = out_shape[1] * out_image_size;
 
 #pragma omp parallel for collapse(2)
-    for (index_t b = 0; b < out_shape[0]; ++b) {
-      for (index_t c = 0; c < out_shape[1]; ++c) {
-        const index_t out_base = b * out_batch_size + c * out_image_size;
-        const index_t in_base = b * in_batch_size + c * in_image_size;
-        const index_t in_height = in_shape[2];
-        const index_t in_width = in_shape[3];
-        const index_t out_height = out_shape[2];
-        const index_t out_width = out_shape[3];
-        for (index_t h = 0; h < out_height; ++h) {
-          for (index_t w = 0; w < out_width; ++w) {
-            const index_t out_offset = out_base + h * out_width + w;
-            float res = 0;
-            int block_size = 0;
-            for (int fh = 0; fh < filter_hw[0]; ++fh) {
-              for (int fw = 0; fw < filter_hw[1]; ++fw) {
-                index_t inh =
-                    h * stride_hw[0] + dilation_hw[0] * fh - pad_hw[0];
-                index_t inw =
-                    w * stride_hw[1] + dilation_hw[1] * fw - pad_hw[1];
-                if (inh >= 0 && inh < in_height && inw >= 0 && inw < in_width) {
-                  index_t input_offset = in_base + inh * in_width + inw;
-                  res += input[input_offset];
-                  ++block_size;
-                }
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t c = 0; c < out_shape[1]; ++c) {
+      const index_t out_base = b * out_batch_size + c * out_image_size;
+      const index_t in_base = b * in_batch_size + c * in_image_size;
+      const index_t in_height = in_shape[2];
+      const index_t in_width = in_shape[3];
+      const index_t out_height = out_shape[2];
+      const index_t out_width = out_shape[3];
+      for (index_t h = 0; h < out_height; ++h) {
+        for (index_t w = 0; w < out_width; ++w) {
+          const index_t out_offset = out_base + h * out_width + w;
+          float res = 0;
+          int block_size = 0;
+          for (int fh = 0; fh < filter_hw[0]; ++fh) {
+            for (int fw = 0; fw < filter_hw[1]; ++fw) {
+              index_t inh =
+                  h * stride_hw[0] + dilation_hw[0] * fh - pad_hw[0];
+              index_t inw =
+                  w * stride_hw[1] + dilation_hw[1] * fw - pad_hw[1];
+              if (inh >= 0 && inh < in_height && inw >= 0 && inw < in_width) {
+                index_t input_offset = in_base + inh * in_width + inw;
+                res += input[input_offset];
+                ++block_size;
               }
             }
-            output[out_offset] = res / block_size;
           }
+          output[out_offset] = res / block_size;
         }
       }
     }
   }
+}
+
+template <DeviceType D, typename T>
+struct PoolingFunctor;
+
+template <>
+struct PoolingFunctor<DeviceType::CPU, float>: PoolingFunctorBase {
+  PoolingFunctor(const PoolingType pooling_type,
+                 const int *kernels,
+                 const int *strides,
+                 const Padding padding_type,
+                 const std::vector<int> &paddings,
+                 const int *dilations)
+      : PoolingFunctorBase(
+            pooling_type, kernels, strides, padding_type, paddings, dilations) {
+  }
 
   MaceStatus operator()(const Tensor *input_tensor,
                   Tensor *output_tensor,
@@ -200,23 +202,23 @@ struct PoolingFunctor<DeviceType::CPU, float>: PoolingFunctorBase {
     int pad_hw[2] = {paddings[0] / 2, paddings[1] / 2};
 
     if (pooling_type_ == PoolingType::MAX) {
-      MaxPooling(input,
-                 input_shape,
-                 output_shape.data(),
-                 kernels_,
-                 strides_,
-                 dilations_,
-                 pad_hw,
-                 output);
+      GetCPUKernels().max_pooling(input,
+                                  input_shape,
+                                  output_shape.data(),
+                                  kernels_,
+                                  strides_,
+                                  dilations_,
+                                  pad_hw,
+                                  output);
     } else if (pooling_type_ == PoolingType::AVG) {
-      AvgPooling(input,
-                 input_shape,
-                 output_shape.data(),
-                 kernels_,
-                 strides_,
-                 dilations_,
-                 pad_hw,
-                 output);
+      GetCPUKernels().avg_pooling(input,
+                                  input_shape,
+                                  output_shape.data(),
+                                  kernels_,
+                                  strides_,
+                                  dilations_,
+                                  pad_hw,
+                                  output);
     } else {
       MACE_NOT_IMPLEMENTED;
     }
@@ -0,0 +1,223 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_SIMD_H_
+#define MACE_KERNELS_SIMD_H_
+
+#if defined(MACE_ENABLE_NEON)
+#include <arm_neon.h>
+#endif
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "mace/core/types.h"
+
+namespace mace {
+namespace kernels {
+
+// Vectors of floats for kernels written once for every instruction set.
+// A vector type V has
+//   V::Reg, the register, and V::kWidth, its lanes,
+//   Zero(), Set1(f), Load(p), Store(p, v), unaligned,
+//   Add(a, b), Sub(a, b), Mul(a, b), MulAdd(a, b, c) = a * b + c,
+//   MulAddLane<i>(a, b, c) = a * b[i] + c, HorizontalSum(v),
+//   LoadStride2(p) = [p[0], p[2], ..., p[2 * kWidth - 2]], reading
+//   2 * kWidth floats, and Gather(p, stride) = [p[0], p[stride], ...].
+// The kernels are templates of V, or use Float4 directly.
+
+// 4 floats, NEON, SSE2 (any x86-64) or scalar. The NEON operations are
+// those the hand-written NEON kernels use, e.g., MulAdd is vmlaq_f32.
+struct Float4 {
+#if defined(MACE_ENABLE_NEON)
+  typedef float32x4_t Reg;
+#elif defined(__SSE2__)
+  typedef __m128 Reg;
+#else
+  struct Reg {
+    float v[4];
+  };
+#endif
+  static const int kWidth = 4;
+
+#if defined(MACE_ENABLE_NEON)
+  static Reg Zero() { return vdupq_n_f32(0.f); }
+  static Reg Set1(const float f) { return vdupq_n_f32(f); }
+  static Reg Load(const float *p) { return vld1q_f32(p); }
+  static void Store(float *p, const Reg v) { vst1q_f32(p, v); }
+  static Reg Add(const Reg a, const Reg b) { return vaddq_f32(a, b); }
+  static Reg Sub(const Reg a, const Reg b) { return vsubq_f32(a, b); }
+  static Reg Mul(const Reg a, const Reg b) { return vmulq_f32(a, b); }
+  static Reg MulAdd(const Reg a, const Reg b, const Reg c) {
+    return vmlaq_f32(c, a, b);
+  }
+  template <int i>
+  static Reg MulAddLane(const Reg a, const Reg b, const Reg c) {
+#if defined(__aarch64__)
+    return vfmaq_laneq_f32(c, a, b, i);
+#else
+    return i < 2 ? vmlaq_lane_f32(c, a, vget_low_f32(b), i & 1)
+                 : vmlaq_lane_f32(c, a, vget_high_f32(b), i & 1);
+#endif
+  }
+  static float HorizontalSum(const Reg v) {
+#if defined(__aarch64__)
+    return vaddvq_f32(v);
+#else
+    return v[0] + v[1] + v[2] + v[3];
+#endif
+  }
+  static Reg LoadStride2(const float *p) { return vld2q_f32(p).val[0]; }
+  static Reg Gather(const float *p, const index_t stride) {
+    const float lanes[4] = {p[0], p[stride], p[2 * stride], p[3 * stride]};
+    return vld1q_f32(lanes);
+  }
+#elif defined(__SSE2__)
+  static Reg Zero() { return _mm_setzero_ps(); }
+  static Reg Set1(const float f) { return _mm_set1_ps(f); }
+  static Reg Load(const float *p) { return _mm_loadu_ps(p); }
+  static void Store(float *p, const Reg v) { _mm_storeu_ps(p, v); }
+  static Reg Add(const Reg a, const Reg b) { return _mm_add_ps(a, b); }
+  static Reg Sub(const Reg a, const Reg b) { return _mm_sub_ps(a, b); }
+  static Reg Mul(const Reg a, const Reg b) { return _mm_mul_ps(a, b); }
+  // no FMA before AVX2
+  static Reg MulAdd(const Reg a, const Reg b, const Reg c) {
+    return _mm_add_ps(_mm_mul_ps(a, b), c);
+  }
+  template <int i>
+  static Reg MulAddLane(const Reg a, const Reg b, const Reg c) {
+    return MulAdd(a, _mm_shuffle_ps(b, b, _MM_SHUFFLE(i, i, i, i)), c);
+  }
+  static float HorizontalSum(const Reg v) {
+    const __m128 sum = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    return _mm_cvtss_f32(
+        _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1))));
+  }
+  static Reg LoadStride2(const float *p) {
+    return _mm_shuffle_ps(_mm_loadu_ps(p), _mm_loadu_ps(p + 4),
+                          _MM_SHUFFLE(2, 0, 2, 0));
+  }
+  static Reg Gather(const float *p, const index_t stride) {
+    return _mm_setr_ps(p[0], p[stride], p[2 * stride], p[3 * stride]);
+  }
+#else
+  static Reg Zero() { return Set1(0); }
+  static Reg Set1(const float f) { return {{f, f, f, f}}; }
+  static Reg Load(const float *p) { return {{p[0], p[1], p[2], p[3]}}; }
+  static void Store(float *p, const Reg v) {
+    for (int i = 0; i < 4; ++i) {
+      p[i] = v.v[i];
+    }
+  }
+  static Reg Add(const Reg a, const Reg b) {
+    return {{a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2],
+             a.v[3] + b.v[3]}};
+  }
+  static Reg Sub(const Reg a, const Reg b) {
+    return {{a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2],
+             a.v[3] - b.v[3]}};
+  }
+  static Reg Mul(const Reg a, const Reg b) {
+    return {{a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2],
+             a.v[3] * b.v[3]}};
+  }
+  static Reg MulAdd(const Reg a, const Reg b, const Reg c) {
+    return Add(Mul(a, b), c);
+  }
+  template <int i>
+  static Reg MulAddLane(const Reg a, const Reg b, const Reg c) {
+    return MulAdd(a, Set1(b.v[i]), c);
+  }
+  static float HorizontalSum(const Reg v) {
+    return v.v[0] + v.v[1] + v.v[2] + v.v[3];
+  }
+  static Reg LoadStride2(const float *p) {
+    return {{p[0], p[2], p[4], p[6]}};
+  }
+  static Reg Gather(const float *p, const index_t stride) {
+    return {{p[0], p[stride], p[2 * stride], p[3 * stride]}};
+  }
+#endif
+};
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Float8 is compiled for AVX2/FMA regardless of the global compiler flags,
+// only for callers with the same target, i.e., kernels reached through the
+// dispatch table of AVX2.
+#define MACE_SIMD_AVX2_TARGET __attribute__((target("avx2,fma")))
+
+// 8 floats, AVX2 and FMA.
+struct Float8 {
+  typedef __m256 Reg;
+  static const int kWidth = 8;
+
+  MACE_SIMD_AVX2_TARGET static Reg Zero() { return _mm256_setzero_ps(); }
+  MACE_SIMD_AVX2_TARGET static Reg Set1(const float f) {
+    return _mm256_set1_ps(f);
+  }
+  MACE_SIMD_AVX2_TARGET static Reg Load(const float *p) {
+    return _mm256_loadu_ps(p);
+  }
+  MACE_SIMD_AVX2_TARGET static void Store(float *p, const Reg v) {
+    _mm256_storeu_ps(p, v);
+  }
+  MACE_SIMD_AVX2_TARGET static Reg Add(const Reg a, const Reg b) {
+    return _mm256_add_ps(a, b);
+  }
+  MACE_SIMD_AVX2_TARGET static Reg Sub(const Reg a, const Reg b) {
+    return _mm256_sub_ps(a, b);
+  }
+  MACE_SIMD_AVX2_TARGET static Reg Mul(const Reg a, const Reg b) {
+    return _mm256_mul_ps(a, b);
+  }
+  MACE_SIMD_AVX2_TARGET static Reg MulAdd(const Reg a, const Reg b,
+                                          const Reg c) {
+    return _mm256_fmadd_ps(a, b, c);
+  }
+  template <int i>
+  MACE_SIMD_AVX2_TARGET static Reg MulAddLane(const Reg a, const Reg b,
+                                              const Reg c) {
+    return _mm256_fmadd_ps(
+        a, _mm256_permutevar8x32_ps(b, _mm256_set1_epi32(i)), c);
+  }
+  MACE_SIMD_AVX2_TARGET static float HorizontalSum(const Reg v) {
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v),
+                            _mm256_extractf128_ps(v, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    return _mm_cvtss_f32(
+        _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1))));
+  }
+  // the even lanes of each 128 bit half, then the halves interleaved
+  MACE_SIMD_AVX2_TARGET static Reg LoadStride2(const float *p) {
+    const __m256 even = _mm256_shuffle_ps(_mm256_loadu_ps(p),
+                                          _mm256_loadu_ps(p + 8),
+                                          _MM_SHUFFLE(2, 0, 2, 0));
+    return _mm256_castpd_ps(
+        _mm256_permute4x64_pd(_mm256_castps_pd(even), _MM_SHUFFLE(3, 1, 2, 0)));
+  }
+  MACE_SIMD_AVX2_TARGET static Reg Gather(const float *p,
+                                          const index_t stride) {
+    return _mm256_setr_ps(p[0], p[stride], p[2 * stride], p[3 * stride],
+                          p[4 * stride], p[5 * stride], p[6 * stride],
+                          p[7 * stride]);
+  }
+};
+
+#endif  // __x86_64__ || __i386__
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_SIMD_H_
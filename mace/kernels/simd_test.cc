@@ -0,0 +1,93 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <vector>
+
+#include "mace/core/runtime/cpu/cpu_runtime.h"
+#include "mace/kernels/simd.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+
+// The results of every operation of V on a = [1, 2, ...], b = [-2, -1, ...]
+// and c = [0.5, 0.5, ...], concatenated.
+#define MACE_SIMD_TEST_OPS(V, TARGET)                                        \
+  TARGET std::vector<float> V##Ops() {                                       \
+    const int n = V::kWidth;                                                 \
+    std::vector<float> a(2 * n), b(n), out(10 * n);                          \
+    for (int i = 0; i < 2 * n; ++i) {                                        \
+      a[i] = i + 1;                                                          \
+    }                                                                        \
+    for (int i = 0; i < n; ++i) {                                            \
+      b[i] = i - 2;                                                          \
+    }                                                                        \
+    const V::Reg va = V::Load(a.data());                                     \
+    const V::Reg vb = V::Load(b.data());                                     \
+    const V::Reg vc = V::Set1(0.5f);                                         \
+    V::Store(out.data(), V::Zero());                                         \
+    V::Store(out.data() + n, V::Add(va, vb));                                \
+    V::Store(out.data() + 2 * n, V::Sub(va, vb));                            \
+    V::Store(out.data() + 3 * n, V::Mul(va, vb));                            \
+    V::Store(out.data() + 4 * n, V::MulAdd(va, vb, vc));                     \
+    V::Store(out.data() + 5 * n, V::MulAddLane<1>(va, vb, vc));              \
+    V::Store(out.data() + 6 * n, V::MulAddLane<3>(va, vb, vc));              \
+    V::Store(out.data() + 7 * n, V::LoadStride2(a.data()));                  \
+    V::Store(out.data() + 8 * n, V::Gather(a.data(), 2));                    \
+    out[9 * n] = V::HorizontalSum(va);                                       \
+    return out;                                                              \
+  }
+
+MACE_SIMD_TEST_OPS(Float4, )
+#if defined(__x86_64__) || defined(__i386__)
+MACE_SIMD_TEST_OPS(Float8, MACE_SIMD_AVX2_TARGET)
+#endif
+
+#undef MACE_SIMD_TEST_OPS
+
+void CheckOps(const int n, const std::vector<float> &out) {
+  for (int i = 0; i < n; ++i) {
+    const float a = i + 1;
+    const float b = i - 2;
+    EXPECT_EQ(0, out[i]);
+    EXPECT_EQ(a + b, out[n + i]);
+    EXPECT_EQ(a - b, out[2 * n + i]);
+    EXPECT_EQ(a * b, out[3 * n + i]);
+    EXPECT_EQ(a * b + 0.5f, out[4 * n + i]);
+    EXPECT_EQ(a * -1 + 0.5f, out[5 * n + i]);
+    EXPECT_EQ(a * 1 + 0.5f, out[6 * n + i]);
+    EXPECT_EQ(2 * i + 1, out[7 * n + i]);
+    EXPECT_EQ(2 * i + 1, out[8 * n + i]);
+  }
+  EXPECT_EQ(n * (n + 1) / 2, out[9 * n]);
+}
+
+}  // namespace
+
+TEST(SIMDTest, Float4) {
+  CheckOps(4, Float4Ops());
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+TEST(SIMDTest, Float8) {
+  if (IsCPUISASupported(CPU_ISA_AVX2, DetectCPUISA())) {
+    CheckOps(8, Float8Ops());
+  }
+}
+#endif
+
+}  // namespace kernels
+}  // namespace mace
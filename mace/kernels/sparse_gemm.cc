@@ -0,0 +1,253 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include "mace/kernels/sparse_gemm.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "mace/kernels/cpu_dispatch.h"
+#include "mace/utils/logging.h"
+#include "mace/utils/utils.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+
+// The first column of block column bc, see BlockSparseMatrix.
+index_t BlockColumnStart(const index_t bc, const index_t cols) {
+  return std::min(bc * kSparseBlockCols, cols - kSparseBlockCols);
+}
+
+// Whether the block at (row, col) of the dense matrix has a nonzero, the
+// columns before skip_cols are covered by the previous block.
+bool IsNonzeroBlock(const float *dense,
+                    const index_t cols,
+                    const index_t row,
+                    const index_t col,
+                    const index_t skip_cols,
+                    const index_t block_rows) {
+  for (index_t r = 0; r < block_rows; ++r) {
+    const float *dense_row = dense + (row + r) * cols + col;
+    for (index_t c = skip_cols; c < kSparseBlockCols; ++c) {
+      if (dense_row[c] != 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+
+}  // namespace
+
+bool IsBlockSparseShape(const index_t rows,
+                        const index_t cols,
+                        const index_t block_rows) {
+  return (block_rows == 1 || block_rows == 4) && rows > 0 &&
+         rows % block_rows == 0 && cols >= kSparseBlockCols;
+}
+
+float BlockDensity(const float *dense,
+                   const index_t rows,
+                   const index_t cols,
+                   const index_t block_rows) {
+  MACE_CHECK(IsBlockSparseShape(rows, cols, block_rows), "matrix ", rows,
+             "x", cols, " has no ", block_rows, "x", kSparseBlockCols,
+             " blocks");
+  const index_t block_cols = RoundUpDiv4(cols);
+  index_t nonzero_blocks = 0;
+  for (index_t row = 0; row < rows; row += block_rows) {
+    for (index_t bc = 0; bc < block_cols; ++bc) {
+      const index_t col = BlockColumnStart(bc, cols);
+      if (IsNonzeroBlock(dense, cols, row, col, bc * kSparseBlockCols - col,
+                         block_rows)) {
+        ++nonzero_blocks;
+      }
+    }
+  }
+  return static_cast<float>(nonzero_blocks) /
+         (rows / block_rows * block_cols);
+}
+
+void PackBlockSparse(const float *dense,
+                     const index_t rows,
+                     const index_t cols,
+                     const index_t block_rows,
+                     BlockSparseMatrix *sparse) {
+  MACE_CHECK_NOTNULL(sparse);
+  MACE_CHECK(IsBlockSparseShape(rows, cols, block_rows), "matrix ", rows,
+             "x", cols, " has no ", block_rows, "x", kSparseBlockCols,
+             " blocks");
+  const index_t block_cols = RoundUpDiv4(cols);
+  const index_t block_size = block_rows * kSparseBlockCols;
+  sparse->rows = rows;
+  sparse->cols = cols;
+  sparse->block_rows = block_rows;
+  sparse->block_ptr.assign(1, 0);
+  sparse->block_col.clear();
+  sparse->values.clear();
+  for (index_t row = 0; row < rows; row += block_rows) {
+    for (index_t bc = 0; bc < block_cols; ++bc) {
+      const index_t col = BlockColumnStart(bc, cols);
+      const index_t skip_cols = bc * kSparseBlockCols - col;
+      if (!IsNonzeroBlock(dense, cols, row, col, skip_cols, block_rows)) {
+        continue;
+      }
+      sparse->block_col.push_back(static_cast<int32_t>(col));
+      sparse->values.resize(sparse->values.size() + block_size, 0);
+      float *block = sparse->values.data() + sparse->values.size() -
+                     block_size;
+      for (index_t r = 0; r < block_rows; ++r) {
+        memcpy(block + r * kSparseBlockCols + skip_cols,
+               dense + (row + r) * cols + col + skip_cols,
+               (kSparseBlockCols - skip_cols) * sizeof(float));
+      }
+    }
+    sparse->block_ptr.push_back(
+        static_cast<int32_t>(sparse->block_col.size()));
+  }
+}
+
+bool TryPackBlockSparse(const float *dense,
+                        const index_t rows,
+                        const index_t cols,
+                        index_t block_rows,
+                        BlockSparseMatrix *sparse) {
+  MACE_CHECK_NOTNULL(sparse);
+  if (!IsBlockSparseShape(rows, cols, block_rows)) {
+    block_rows = 1;
+  }
+  if (!IsBlockSparseShape(rows, cols, block_rows)) {
+    *sparse = BlockSparseMatrix();
+    return false;
+  }
+  PackBlockSparse(dense, rows, cols, block_rows, sparse);
+  return true;
+}
+
+void BlockSparseGemm(const BlockSparseMatrix &W,
+                     const float *B,
+                     const index_t batch,
+                     const index_t width,
+                     float *C,
+                     const Epilogue *epilogue) {
+  MACE_CHECK(!W.empty(), "block sparse matrix is not packed");
+  if (epilogue != nullptr && epilogue->IsNoop()) {
+    epilogue = nullptr;
+  }
+  const BlockSparseGemmFunc block_sparse_gemm =
+      GetCPUKernels().block_sparse_gemm;
+  const index_t block_rows = W.block_rows;
+  const index_t block_size = block_rows * kSparseBlockCols;
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t i = 0; i < W.rows / block_rows; ++i) {
+      const index_t row = i * block_rows;
+      const index_t block_begin = W.block_ptr[i];
+      float *c = C + (b * W.rows + row) * width;
+      block_sparse_gemm(W.values.data() + block_begin * block_size,
+                        W.block_col.data() + block_begin,
+                        W.block_ptr[i + 1] - block_begin, block_rows,
+                        B + b * W.cols * width, width, width, width, c);
+      if (epilogue != nullptr) {
+        ApplyEpilogue(epilogue->Offset(row, 0), block_rows, width, width, c);
+      }
+    }
+  }
+}
+
+void BlockSparseGemv(const BlockSparseMatrix &W,
+                     const float *v,
+                     const index_t batch,
+                     float *out,
+                     const Epilogue *epilogue) {
+  MACE_CHECK(!W.empty(), "block sparse matrix is not packed");
+  if (epilogue != nullptr && epilogue->IsNoop()) {
+    epilogue = nullptr;
+  }
+  const BlockSparseGemvFunc block_sparse_gemv =
+      GetCPUKernels().block_sparse_gemv;
+  const index_t block_rows = W.block_rows;
+  const index_t block_size = block_rows * kSparseBlockCols;
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t i = 0; i < W.rows / block_rows; ++i) {
+      const index_t row = i * block_rows;
+      const index_t block_begin = W.block_ptr[i];
+      float *out_ptr = out + b * W.rows + row;
+      block_sparse_gemv(W.values.data() + block_begin * block_size,
+                        W.block_col.data() + block_begin,
+                        W.block_ptr[i + 1] - block_begin, block_rows,
+                        v + b * W.cols, out_ptr);
+      if (epilogue != nullptr) {
+        for (index_t r = 0; r < block_rows; ++r) {
+          out_ptr[r] = ApplyEpilogue(*epilogue, row + r, out_ptr[r]);
+        }
+      }
+    }
+  }
+}
+
+void BlockSparseGemmDefault(const float *values,
+                            const int32_t *block_col,
+                            const index_t num_blocks,
+                            const index_t block_rows,
+                            const float *B,
+                            const index_t width,
+                            const index_t stride_b,
+                            const index_t stride_c,
+                            float *C) {
+  const index_t block_size = block_rows * kSparseBlockCols;
+  for (index_t r = 0; r < block_rows; ++r) {
+    float *c_row = C + r * stride_c;
+    std::fill(c_row, c_row + width, 0.f);
+    for (index_t j = 0; j < num_blocks; ++j) {
+      const float *block_row = values + j * block_size + r * kSparseBlockCols;
+      const float *b_row = B + block_col[j] * stride_b;
+      for (index_t c = 0; c < kSparseBlockCols; ++c) {
+        const float a = block_row[c];
+        for (index_t w = 0; w < width; ++w) {
+          c_row[w] += a * b_row[w];
+        }
+        b_row += stride_b;
+      }
+    }
+  }
+}
+
+void BlockSparseGemvDefault(const float *values,
+                            const int32_t *block_col,
+                            const index_t num_blocks,
+                            const index_t block_rows,
+                            const float *v,
+                            float *out) {
+  const index_t block_size = block_rows * kSparseBlockCols;
+  for (index_t r = 0; r < block_rows; ++r) {
+    float sum = 0;
+    for (index_t j = 0; j < num_blocks; ++j) {
+      const float *block_row = values + j * block_size + r * kSparseBlockCols;
+      const float *v_ptr = v + block_col[j];
+      for (index_t c = 0; c < kSparseBlockCols; ++c) {
+        sum += block_row[c] * v_ptr[c];
+      }
+    }
+    out[r] = sum;
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -0,0 +1,120 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_SPARSE_GEMM_H_
+#define MACE_KERNELS_SPARSE_GEMM_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "mace/core/types.h"
+#include "mace/kernels/epilogue.h"
+
+namespace mace {
+namespace kernels {
+
+// Columns of a sparse block, the rows are 1 or 4.
+const index_t kSparseBlockCols = 4;
+
+// Pruned weights in block compressed sparse row format. The rows x cols
+// matrix is split into block_rows x kSparseBlockCols blocks, of which only
+// the ones with a nonzero are kept. Block row i holds the blocks
+// [block_ptr[i], block_ptr[i + 1]), block j starts at column block_col[j]
+// and its values are the row major block_rows x 4 floats at
+// values[j * block_rows * 4]. If cols is not a multiple of 4, the last
+// block column starts at cols - 4 with the columns of the previous one
+// zeroed, so that no block reaches beyond the matrix.
+struct BlockSparseMatrix {
+  index_t rows;
+  index_t cols;
+  index_t block_rows;
+  std::vector<int32_t> block_ptr;
+  std::vector<int32_t> block_col;
+  std::vector<float> values;
+
+  BlockSparseMatrix() : rows(0), cols(0), block_rows(0) {}
+
+  bool empty() const { return block_ptr.empty(); }
+  index_t num_blocks() const { return block_col.size(); }
+};
+
+// Whether a rows x cols matrix can be split into block_rows x 4 blocks.
+bool IsBlockSparseShape(const index_t rows,
+                        const index_t cols,
+                        const index_t block_rows);
+
+// The part of the block_rows x 4 blocks of the row major rows x cols
+// matrix with a nonzero.
+float BlockDensity(const float *dense,
+                   const index_t rows,
+                   const index_t cols,
+                   const index_t block_rows);
+
+// Packs the row major rows x cols matrix, whose shape must pass
+// IsBlockSparseShape.
+void PackBlockSparse(const float *dense,
+                     const index_t rows,
+                     const index_t cols,
+                     const index_t block_rows,
+                     BlockSparseMatrix *sparse);
+
+// Packs the matrix in block_rows x 4 blocks, or 1 x 4 ones if its rows do
+// not split by block_rows. Returns false, leaving sparse empty, if neither
+// fits, e.g., fewer than 4 columns.
+bool TryPackBlockSparse(const float *dense,
+                        const index_t rows,
+                        const index_t cols,
+                        index_t block_rows,
+                        BlockSparseMatrix *sparse);
+
+// C[n] = W * B[n], B[n]: W.cols x width, C[n]: W.rows x width, e.g., conv
+// 1x1 with a pruned filter. The epilogue channels are the rows of C.
+void BlockSparseGemm(const BlockSparseMatrix &W,
+                     const float *B,
+                     const index_t batch,
+                     const index_t width,
+                     float *C,
+                     const Epilogue *epilogue = nullptr);
+
+// out[b, h] = sum_k W[h, k] * v[b, k], e.g., fully connected with a pruned
+// weight. The epilogue channels are the columns of out, i.e., h.
+void BlockSparseGemv(const BlockSparseMatrix &W,
+                     const float *v,
+                     const index_t batch,
+                     float *out,
+                     const Epilogue *epilogue = nullptr);
+
+// Defaults of the block_sparse_gemm and block_sparse_gemv kernels in
+// cpu_dispatch.h
+void BlockSparseGemmDefault(const float *values,
+                            const int32_t *block_col,
+                            const index_t num_blocks,
+                            const index_t block_rows,
+                            const float *B,
+                            const index_t width,
+                            const index_t stride_b,
+                            const index_t stride_c,
+                            float *C);
+
+void BlockSparseGemvDefault(const float *values,
+                            const int32_t *block_col,
+                            const index_t num_blocks,
+                            const index_t block_rows,
+                            const float *v,
+                            float *out);
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_SPARSE_GEMM_H_
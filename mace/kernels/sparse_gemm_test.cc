@@ -0,0 +1,174 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+#include "mace/kernels/gemm.h"
+#include "mace/kernels/sparse_gemm.h"
+
+namespace mace {
+namespace kernels {
+
+namespace {
+
+// rows x cols of which about density of the entries are nonzero
+std::vector<float> PrunedMatrix(index_t rows, index_t cols, float density) {
+  std::random_device rd;
+  std::mt19937 gen(rd());
+  std::normal_distribution<float> nd(0, 1);
+  std::uniform_real_distribution<float> ud(0, 1);
+  std::vector<float> matrix(rows * cols);
+  for (float &value : matrix) {
+    value = ud(gen) < density ? nd(gen) : 0;
+  }
+  return matrix;
+}
+
+void BlockSparseGemmTest(index_t batch,
+                         index_t rows,
+                         index_t cols,
+                         index_t width,
+                         index_t block_rows,
+                         float density,
+                         const Epilogue *epilogue = nullptr) {
+  const std::vector<float> W = PrunedMatrix(rows, cols, density);
+  const std::vector<float> B = PrunedMatrix(batch * cols, width, 1);
+  std::vector<float> C(batch * rows * width);
+  std::vector<float> C_ref(C.size());
+  BlockSparseMatrix sparse;
+  PackBlockSparse(W.data(), rows, cols, block_rows, &sparse);
+  BlockSparseGemm(sparse, B.data(), batch, width, C.data(), epilogue);
+  for (index_t b = 0; b < batch; ++b) {
+    GemmRef(W.data(), B.data() + b * cols * width, 1, rows, cols, width,
+            C_ref.data() + b * rows * width);
+  }
+  for (size_t i = 0; i < C.size(); ++i) {
+    const float expected =
+        epilogue == nullptr
+            ? C_ref[i]
+            : ApplyEpilogue(*epilogue, i / width % rows, C_ref[i]);
+    EXPECT_NEAR(expected, C[i], 1e-3);
+  }
+}
+
+void BlockSparseGemvTest(index_t batch,
+                         index_t rows,
+                         index_t cols,
+                         index_t block_rows,
+                         float density,
+                         const Epilogue *epilogue = nullptr) {
+  const std::vector<float> W = PrunedMatrix(rows, cols, density);
+  const std::vector<float> v = PrunedMatrix(batch, cols, 1);
+  std::vector<float> out(batch * rows);
+  std::vector<float> out_ref(out.size());
+  BlockSparseMatrix sparse;
+  PackBlockSparse(W.data(), rows, cols, block_rows, &sparse);
+  BlockSparseGemv(sparse, v.data(), batch, out.data(), epilogue);
+  GemvRef(W.data(), v.data(), batch, cols, rows, out_ref.data());
+  for (size_t i = 0; i < out.size(); ++i) {
+    const float expected =
+        epilogue == nullptr ? out_ref[i]
+                            : ApplyEpilogue(*epilogue, i % rows, out_ref[i]);
+    EXPECT_NEAR(expected, out[i], 1e-3);
+  }
+}
+
+}  // namespace
+
+TEST(SparseGemmTest, Pack) {
+  // 4 x 6, the last block column starts at column 2
+  const std::vector<float> W = {
+      1, 0, 0, 0, 0, 0,
+      0, 0, 0, 0, 0, 2,
+      0, 0, 0, 0, 0, 0,
+      0, 3, 0, 0, 0, 0,
+  };
+  BlockSparseMatrix sparse;
+  PackBlockSparse(W.data(), 4, 6, 1, &sparse);
+  EXPECT_EQ(3, sparse.num_blocks());
+  EXPECT_EQ(std::vector<int32_t>({0, 1, 2, 2, 3}), sparse.block_ptr);
+  EXPECT_EQ(std::vector<int32_t>({0, 2, 0}), sparse.block_col);
+  EXPECT_EQ(std::vector<float>({1, 0, 0, 0, 0, 0, 0, 2, 0, 3, 0, 0}),
+            sparse.values);
+  EXPECT_FLOAT_EQ(3.f / 8, BlockDensity(W.data(), 4, 6, 1));
+
+  PackBlockSparse(W.data(), 4, 6, 4, &sparse);
+  EXPECT_EQ(2, sparse.num_blocks());
+  EXPECT_EQ(std::vector<int32_t>({0, 2}), sparse.block_ptr);
+  EXPECT_EQ(std::vector<int32_t>({0, 2}), sparse.block_col);
+  // the columns 2 and 3 of the tail block belong to the first one
+  EXPECT_EQ(std::vector<float>({1, 0, 0, 0,
+                                0, 0, 0, 0,
+                                0, 0, 0, 0,
+                                0, 3, 0, 0,
+                                0, 0, 0, 0,
+                                0, 0, 0, 2,
+                                0, 0, 0, 0,
+                                0, 0, 0, 0}),
+            sparse.values);
+  EXPECT_FLOAT_EQ(1, BlockDensity(W.data(), 4, 6, 4));
+}
+
+TEST(SparseGemmTest, TryPack) {
+  const std::vector<float> W(6 * 8, 1);
+  BlockSparseMatrix sparse;
+  // 6 rows do not split by 4
+  EXPECT_TRUE(TryPackBlockSparse(W.data(), 6, 8, 4, &sparse));
+  EXPECT_EQ(1, sparse.block_rows);
+  EXPECT_FALSE(TryPackBlockSparse(W.data(), 16, 3, 4, &sparse));
+  EXPECT_TRUE(sparse.empty());
+}
+
+TEST(SparseGemmTest, Gemm) {
+  for (index_t block_rows : {1, 4}) {
+    BlockSparseGemmTest(1, 4, 4, 1, block_rows, 0.5f);
+    BlockSparseGemmTest(1, 16, 37, 45, block_rows, 0.1f);
+    BlockSparseGemmTest(2, 64, 64, 49, block_rows, 0.3f);
+    BlockSparseGemmTest(1, 32, 130, 196, block_rows, 1);
+    BlockSparseGemmTest(1, 8, 16, 8, block_rows, 0);
+  }
+}
+
+TEST(SparseGemmTest, Gemv) {
+  for (index_t block_rows : {1, 4}) {
+    BlockSparseGemvTest(1, 4, 4, block_rows, 0.5f);
+    BlockSparseGemvTest(3, 16, 37, block_rows, 0.1f);
+    BlockSparseGemvTest(1, 64, 1023, block_rows, 0.3f);
+    BlockSparseGemvTest(16, 32, 130, block_rows, 1);
+    BlockSparseGemvTest(2, 8, 16, block_rows, 0);
+  }
+}
+
+TEST(SparseGemmTest, Epilogue) {
+  std::vector<float> bias(64);
+  std::vector<float> alpha(64, 0.25f);
+  for (size_t i = 0; i < bias.size(); ++i) {
+    bias[i] = i * 0.1f - 3;
+  }
+  const Epilogue epilogues[] = {
+      Epilogue(bias.data(), RELU, 0),
+      Epilogue(bias.data(), RELUX, 0.5f),
+      Epilogue(nullptr, PRELU, 0, alpha.data()),
+      Epilogue(bias.data(), SIGMOID, 0),
+  };
+  for (const Epilogue &epilogue : epilogues) {
+    BlockSparseGemmTest(2, 64, 37, 45, 4, 0.3f, &epilogue);
+    BlockSparseGemvTest(3, 64, 37, 1, 0.3f, &epilogue);
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
@@ -0,0 +1,96 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include <algorithm>
+
+#include "mace/kernels/x86/activation_x86.h"
+
+namespace mace {
+namespace kernels {
+
+// max/min return their second operand if either one is NaN, so input goes
+// second to propagate NaN like std::max/std::min in the default kernel.
+
+__attribute__((target("sse4.2")))
+void BiasClampSSE(const float *input,
+                  const index_t size,
+                  const float bias,
+                  const float lower,
+                  const float upper,
+                  float *output) {
+  const __m128 vbias = _mm_set1_ps(bias);
+  const __m128 vlower = _mm_set1_ps(lower);
+  const __m128 vupper = _mm_set1_ps(upper);
+  const index_t aligned_size = size - size % 4;
+
+  for (index_t i = 0; i < aligned_size; i += 4) {
+    const __m128 v = _mm_add_ps(_mm_loadu_ps(input + i), vbias);
+    _mm_storeu_ps(output + i, _mm_min_ps(vupper, _mm_max_ps(vlower, v)));
+  }
+  for (index_t i = aligned_size; i < size; ++i) {
+    output[i] = std::min(std::max(input[i] + bias, lower), upper);
+  }
+}
+
+__attribute__((target("avx2")))
+void BiasClampAVX2(const float *input,
+                   const index_t size,
+                   const float bias,
+                   const float lower,
+                   const float upper,
+                   float *output) {
+  const __m256 vbias = _mm256_set1_ps(bias);
+  const __m256 vlower = _mm256_set1_ps(lower);
+  const __m256 vupper = _mm256_set1_ps(upper);
+  const index_t aligned_size = size - size % 8;
+
+  for (index_t i = 0; i < aligned_size; i += 8) {
+    const __m256 v = _mm256_add_ps(_mm256_loadu_ps(input + i), vbias);
+    _mm256_storeu_ps(output + i,
+                     _mm256_min_ps(vupper, _mm256_max_ps(vlower, v)));
+  }
+  for (index_t i = aligned_size; i < size; ++i) {
+    output[i] = std::min(std::max(input[i] + bias, lower), upper);
+  }
+}
+
+__attribute__((target("avx512f")))
+void BiasClampAVX512(const float *input,
+                     const index_t size,
+                     const float bias,
+                     const float lower,
+                     const float upper,
+                     float *output) {
+  const __m512 vbias = _mm512_set1_ps(bias);
+  const __m512 vlower = _mm512_set1_ps(lower);
+  const __m512 vupper = _mm512_set1_ps(upper);
+  const index_t aligned_size = size - size % 16;
+
+  for (index_t i = 0; i < aligned_size; i += 16) {
+    const __m512 v = _mm512_add_ps(_mm512_loadu_ps(input + i), vbias);
+    _mm512_storeu_ps(output + i,
+                     _mm512_min_ps(vupper, _mm512_max_ps(vlower, v)));
+  }
+  for (index_t i = aligned_size; i < size; ++i) {
+    output[i] = std::min(std::max(input[i] + bias, lower), upper);
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // __x86_64__ || __i386__
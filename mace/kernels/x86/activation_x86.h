@@ -0,0 +1,52 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_X86_ACTIVATION_X86_H_
+#define MACE_KERNELS_X86_ACTIVATION_X86_H_
+
+#include "mace/core/types.h"
+
+namespace mace {
+namespace kernels {
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// output[i] = min(max(input[i] + bias, lower), upper), NaN is propagated.
+void BiasClampSSE(const float *input,
+                  const index_t size,
+                  const float bias,
+                  const float lower,
+                  const float upper,
+                  float *output);
+
+void BiasClampAVX2(const float *input,
+                   const index_t size,
+                   const float bias,
+                   const float lower,
+                   const float upper,
+                   float *output);
+
+void BiasClampAVX512(const float *input,
+                     const index_t size,
+                     const float bias,
+                     const float lower,
+                     const float upper,
+                     float *output);
+
+#endif  // __x86_64__ || __i386__
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_X86_ACTIVATION_X86_H_
@@ -0,0 +1,156 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include "mace/kernels/simd.h"
+#include "mace/kernels/x86/conv_2d_x86.h"
+
+// The functions below are compiled for SSE4.2 regardless of the global
+// compiler flags, they are only reached through the dispatch table of SSE4.2.
+#define MACE_CONV_2D_X86_TARGET __attribute__((target("sse4.2")))
+
+#include "mace/kernels/x86/conv_2d_x86_impl.h"
+
+namespace mace {
+namespace kernels {
+
+void Conv2dK3x3S1SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     const Epilogue *epilogue,
+                     float *output) {
+  conv_2d_x86::Conv2d<Float4, 3, 3, 1>(input, filter, in_shape, out_shape,
+                                       epilogue, output);
+}
+
+void Conv2dK3x3S2SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     const Epilogue *epilogue,
+                     float *output) {
+  conv_2d_x86::Conv2d<Float4, 3, 3, 2>(input, filter, in_shape, out_shape,
+                                       epilogue, output);
+}
+
+void Conv2dK5x5S1SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     float *output) {
+  conv_2d_x86::Conv2d<Float4, 5, 5, 1>(input, filter, in_shape, out_shape,
+                                       nullptr, output);
+}
+
+void Conv2dK1x7S1SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     float *output) {
+  conv_2d_x86::Conv2d<Float4, 1, 7, 1>(input, filter, in_shape, out_shape,
+                                       nullptr, output);
+}
+
+void Conv2dK7x1S1SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     float *output) {
+  conv_2d_x86::Conv2d<Float4, 7, 1, 1>(input, filter, in_shape, out_shape,
+                                       nullptr, output);
+}
+
+void Conv2dK7x7S1SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     float *output) {
+  conv_2d_x86::Conv2d<Float4, 7, 7, 1>(input, filter, in_shape, out_shape,
+                                       nullptr, output);
+}
+
+void Conv2dK7x7S2SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     float *output) {
+  conv_2d_x86::Conv2d<Float4, 7, 7, 2>(input, filter, in_shape, out_shape,
+                                       nullptr, output);
+}
+
+void Conv2dK7x7S3SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     float *output) {
+  conv_2d_x86::Conv2d<Float4, 7, 7, 3>(input, filter, in_shape, out_shape,
+                                       nullptr, output);
+}
+
+void Conv2dK1x15S1SSE(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      float *output) {
+  conv_2d_x86::Conv2d<Float4, 1, 15, 1>(input, filter, in_shape, out_shape,
+                                        nullptr, output);
+}
+
+void Conv2dK15x1S1SSE(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      float *output) {
+  conv_2d_x86::Conv2d<Float4, 15, 1, 1>(input, filter, in_shape, out_shape,
+                                        nullptr, output);
+}
+
+void DepthwiseConv2dK3x3S1SSE(const float *input,
+                              const float *filter,
+                              const index_t *in_shape,
+                              const index_t *out_shape,
+                              const int *pad_hw,
+                              const index_t valid_h_start,
+                              const index_t valid_h_stop,
+                              const index_t valid_w_start,
+                              const index_t valid_w_stop,
+                              const Epilogue *epilogue,
+                              float *output) {
+  conv_2d_x86::DepthwiseConv2dK3x3<Float4, 1>(
+      input, filter, in_shape, out_shape, pad_hw, valid_h_start,
+      valid_h_stop, valid_w_start, valid_w_stop, epilogue, output);
+}
+
+void DepthwiseConv2dK3x3S2SSE(const float *input,
+                              const float *filter,
+                              const index_t *in_shape,
+                              const index_t *out_shape,
+                              const int *pad_hw,
+                              const index_t valid_h_start,
+                              const index_t valid_h_stop,
+                              const index_t valid_w_start,
+                              const index_t valid_w_stop,
+                              const Epilogue *epilogue,
+                              float *output) {
+  conv_2d_x86::DepthwiseConv2dK3x3<Float4, 2>(
+      input, filter, in_shape, out_shape, pad_hw, valid_h_start,
+      valid_h_stop, valid_w_start, valid_w_stop, epilogue, output);
+}
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // __x86_64__ || __i386__
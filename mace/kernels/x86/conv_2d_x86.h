@@ -0,0 +1,208 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_X86_CONV_2D_X86_H_
+#define MACE_KERNELS_X86_CONV_2D_X86_H_
+
+#include "mace/core/types.h"
+#include "mace/kernels/epilogue.h"
+
+namespace mace {
+namespace kernels {
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// The direct convolution kernels of conv_2d_neon.h and
+// depthwise_conv2d_neon.h for SSE and AVX2, same arguments. The dense ones
+// compute tiles of 4 output channels x 2 vectors of pixels summed over all
+// input channels in registers, and overwrite the output.
+
+void Conv2dK3x3S1SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     const Epilogue *epilogue,
+                     float *output);
+
+void Conv2dK3x3S2SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     const Epilogue *epilogue,
+                     float *output);
+
+void Conv2dK5x5S1SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     float *output);
+
+void Conv2dK1x7S1SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     float *output);
+
+void Conv2dK7x1S1SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     float *output);
+
+void Conv2dK7x7S1SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     float *output);
+
+void Conv2dK7x7S2SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     float *output);
+
+void Conv2dK7x7S3SSE(const float *input,
+                     const float *filter,
+                     const index_t *in_shape,
+                     const index_t *out_shape,
+                     float *output);
+
+void Conv2dK1x15S1SSE(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      float *output);
+
+void Conv2dK15x1S1SSE(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      float *output);
+
+void DepthwiseConv2dK3x3S1SSE(const float *input,
+                              const float *filter,
+                              const index_t *in_shape,
+                              const index_t *out_shape,
+                              const int *pad_hw,
+                              const index_t valid_h_start,
+                              const index_t valid_h_stop,
+                              const index_t valid_w_start,
+                              const index_t valid_w_stop,
+                              const Epilogue *epilogue,
+                              float *output);
+
+void DepthwiseConv2dK3x3S2SSE(const float *input,
+                              const float *filter,
+                              const index_t *in_shape,
+                              const index_t *out_shape,
+                              const int *pad_hw,
+                              const index_t valid_h_start,
+                              const index_t valid_h_stop,
+                              const index_t valid_w_start,
+                              const index_t valid_w_stop,
+                              const Epilogue *epilogue,
+                              float *output);
+
+void Conv2dK3x3S1AVX2(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      const Epilogue *epilogue,
+                      float *output);
+
+void Conv2dK3x3S2AVX2(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      const Epilogue *epilogue,
+                      float *output);
+
+void Conv2dK5x5S1AVX2(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      float *output);
+
+void Conv2dK1x7S1AVX2(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      float *output);
+
+void Conv2dK7x1S1AVX2(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      float *output);
+
+void Conv2dK7x7S1AVX2(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      float *output);
+
+void Conv2dK7x7S2AVX2(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      float *output);
+
+void Conv2dK7x7S3AVX2(const float *input,
+                      const float *filter,
+                      const index_t *in_shape,
+                      const index_t *out_shape,
+                      float *output);
+
+void Conv2dK1x15S1AVX2(const float *input,
+                       const float *filter,
+                       const index_t *in_shape,
+                       const index_t *out_shape,
+                       float *output);
+
+void Conv2dK15x1S1AVX2(const float *input,
+                       const float *filter,
+                       const index_t *in_shape,
+                       const index_t *out_shape,
+                       float *output);
+
+void DepthwiseConv2dK3x3S1AVX2(const float *input,
+                               const float *filter,
+                               const index_t *in_shape,
+                               const index_t *out_shape,
+                               const int *pad_hw,
+                               const index_t valid_h_start,
+                               const index_t valid_h_stop,
+                               const index_t valid_w_start,
+                               const index_t valid_w_stop,
+                               const Epilogue *epilogue,
+                               float *output);
+
+void DepthwiseConv2dK3x3S2AVX2(const float *input,
+                               const float *filter,
+                               const index_t *in_shape,
+                               const index_t *out_shape,
+                               const int *pad_hw,
+                               const index_t valid_h_start,
+                               const index_t valid_h_stop,
+                               const index_t valid_w_start,
+                               const index_t valid_w_stop,
+                               const Epilogue *epilogue,
+                               float *output);
+
+#endif  // __x86_64__ || __i386__
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_X86_CONV_2D_X86_H_
@@ -0,0 +1,378 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_X86_CONV_2D_X86_IMPL_H_
+#define MACE_KERNELS_X86_CONV_2D_X86_IMPL_H_
+
+#include <algorithm>
+
+#include "mace/core/types.h"
+#include "mace/kernels/epilogue.h"
+#include "mace/kernels/simd.h"
+#include "mace/utils/utils.h"
+
+// The kernels of conv_2d_x86.h as templates of the vector type of simd.h,
+// only for conv_2d_sse.cc and conv_2d_avx2.cc. They define
+// MACE_CONV_2D_X86_TARGET, the target attribute of their instruction set.
+#ifndef MACE_CONV_2D_X86_TARGET
+#error "conv_2d_x86_impl.h needs MACE_CONV_2D_X86_TARGET"
+#endif
+
+namespace mace {
+namespace kernels {
+namespace conv_2d_x86 {
+
+const index_t kChannelTile = 4;
+
+// [p[0], p[S], ..., p[(kWidth - 1) * S]], reading past the last lane
+// unless kExact
+template <typename V, int S, bool kExact>
+MACE_CONV_2D_X86_TARGET inline typename V::Reg LoadStrided(const float *p) {
+  if (S == 1) {
+    return V::Load(p);
+  } else if (S == 2 && !kExact) {
+    return V::LoadStride2(p);
+  }
+  return V::Gather(p, S);
+}
+
+// Output pixels [0, n) of a row whose vectors read within the input row.
+template <int KW, int S, bool kExact>
+inline index_t VectorPixels(const index_t in_width, const index_t out_width) {
+  const index_t over_read = S == 2 && !kExact ? 1 : 0;
+  const index_t last_start = in_width - KW - over_read;
+  return last_start < 0 ? 0 : std::min(out_width, last_start / S + 1);
+}
+
+#define MACE_CONV_2D_X86_MULADD(i)                            \
+  if (kChannels > i) {                                        \
+    const Reg f = V::Set1(f_ptr[i * filter_stride]);          \
+    acc##i##0 = V::MulAdd(x0, f, acc##i##0);                  \
+    if (kVectors > 1) {                                       \
+      acc##i##1 = V::MulAdd(x1, f, acc##i##1);                \
+    }                                                         \
+  }
+
+#define MACE_CONV_2D_X86_STORE(i)                                         \
+  if (kChannels > i) {                                                    \
+    V::Store(output + i * out_image_size, acc##i##0);                     \
+    if (kVectors > 1) {                                                   \
+      V::Store(output + i * out_image_size + V::kWidth, acc##i##1);       \
+    }                                                                     \
+  }
+
+// kChannels output channels x kVectors vectors of consecutive pixels of a
+// row, input points at the first field, filter at the filter of the first
+// output channel and output at its first pixel.
+template <typename V, int KH, int KW, int S, int kChannels, int kVectors,
+          bool kExact = false>
+MACE_CONV_2D_X86_TARGET inline void Conv2dTile(const float *input,
+                                               const float *filter,
+                                               const index_t in_channels,
+                                               const index_t in_image_size,
+                                               const index_t in_width,
+                                               const index_t out_image_size,
+                                               float *output) {
+  typedef typename V::Reg Reg;
+  const index_t filter_stride = in_channels * KH * KW;
+  Reg acc00 = V::Zero(), acc01 = V::Zero(), acc10 = V::Zero(),
+      acc11 = V::Zero(), acc20 = V::Zero(), acc21 = V::Zero(),
+      acc30 = V::Zero(), acc31 = V::Zero();
+  for (index_t c = 0; c < in_channels; ++c) {
+    const float *in_c = input + c * in_image_size;
+    const float *filter_c = filter + c * KH * KW;
+    for (int kh = 0; kh < KH; ++kh) {
+      const float *in_row = in_c + kh * in_width;
+      for (int kw = 0; kw < KW; ++kw) {
+        const Reg x0 = LoadStrided<V, S, kExact>(in_row + kw);
+        const Reg x1 =
+            kVectors > 1
+                ? LoadStrided<V, S, kExact>(in_row + kw + V::kWidth * S)
+                : x0;
+        const float *f_ptr = filter_c + kh * KW + kw;
+        MACE_CONV_2D_X86_MULADD(0);
+        MACE_CONV_2D_X86_MULADD(1);
+        MACE_CONV_2D_X86_MULADD(2);
+        MACE_CONV_2D_X86_MULADD(3);
+      }
+    }
+  }
+  MACE_CONV_2D_X86_STORE(0);
+  MACE_CONV_2D_X86_STORE(1);
+  MACE_CONV_2D_X86_STORE(2);
+  MACE_CONV_2D_X86_STORE(3);
+}
+
+#undef MACE_CONV_2D_X86_MULADD
+#undef MACE_CONV_2D_X86_STORE
+
+// One output pixel of one channel.
+template <int KH, int KW>
+inline float Conv2dPixel(const float *input,
+                         const float *filter,
+                         const index_t in_channels,
+                         const index_t in_image_size,
+                         const index_t in_width) {
+  float sum = 0;
+  for (index_t c = 0; c < in_channels; ++c) {
+    const float *in_c = input + c * in_image_size;
+    const float *filter_c = filter + c * KH * KW;
+    for (int kh = 0; kh < KH; ++kh) {
+      for (int kw = 0; kw < KW; ++kw) {
+        sum += in_c[kh * in_width + kw] * filter_c[kh * KW + kw];
+      }
+    }
+  }
+  return sum;
+}
+
+// The output rows of kChannels channels, vector tiles then single pixels.
+template <typename V, int KH, int KW, int S, int kChannels>
+MACE_CONV_2D_X86_TARGET inline void Conv2dRow(const float *input,
+                                              const float *filter,
+                                              const index_t in_channels,
+                                              const index_t in_image_size,
+                                              const index_t in_width,
+                                              const index_t out_width,
+                                              const index_t out_image_size,
+                                              float *output) {
+  const index_t vector_pixels =
+      VectorPixels<KW, S, false>(in_width, out_width);
+  const index_t exact_pixels = VectorPixels<KW, S, true>(in_width, out_width);
+  index_t w = 0;
+  for (; w + 2 * V::kWidth <= vector_pixels; w += 2 * V::kWidth) {
+    Conv2dTile<V, KH, KW, S, kChannels, 2>(input + w * S, filter, in_channels,
+                                           in_image_size, in_width,
+                                           out_image_size, output + w);
+  }
+  for (; w + V::kWidth <= vector_pixels; w += V::kWidth) {
+    Conv2dTile<V, KH, KW, S, kChannels, 1>(input + w * S, filter, in_channels,
+                                           in_image_size, in_width,
+                                           out_image_size, output + w);
+  }
+  // the last vector overlaps the previous one, which it overwrites
+  if (w < vector_pixels && vector_pixels >= V::kWidth) {
+    w = vector_pixels - V::kWidth;
+    Conv2dTile<V, KH, KW, S, kChannels, 1>(input + w * S, filter, in_channels,
+                                           in_image_size, in_width,
+                                           out_image_size, output + w);
+    w = vector_pixels;
+  }
+  // the last pixels of stride 2 without reading past the row
+  if (w < exact_pixels && exact_pixels >= V::kWidth) {
+    w = exact_pixels - V::kWidth;
+    Conv2dTile<V, KH, KW, S, kChannels, 1, true>(
+        input + w * S, filter, in_channels, in_image_size, in_width,
+        out_image_size, output + w);
+    w = exact_pixels;
+  }
+  const index_t filter_stride = in_channels * KH * KW;
+  for (; w < out_width; ++w) {
+    for (int i = 0; i < kChannels; ++i) {
+      output[i * out_image_size + w] = Conv2dPixel<KH, KW>(
+          input + w * S, filter + i * filter_stride, in_channels,
+          in_image_size, in_width);
+    }
+  }
+}
+
+// Convolution of the padded input without dilation, in_shape and out_shape
+// are NCHW and the filter is OIHW.
+template <typename V, int KH, int KW, int S>
+MACE_CONV_2D_X86_TARGET void Conv2d(const float *input,
+                                    const float *filter,
+                                    const index_t *in_shape,
+                                    const index_t *out_shape,
+                                    const Epilogue *epilogue,
+                                    float *output) {
+  const index_t in_channels = in_shape[1];
+  const index_t in_width = in_shape[3];
+  const index_t in_image_size = in_shape[2] * in_shape[3];
+  const index_t out_channels = out_shape[1];
+  const index_t out_height = out_shape[2];
+  const index_t out_width = out_shape[3];
+  const index_t out_image_size = out_height * out_width;
+  const index_t filter_stride = in_channels * KH * KW;
+  const index_t channel_tiles = RoundUpDiv(out_channels, kChannelTile);
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < out_shape[0]; ++b) {
+    for (index_t t = 0; t < channel_tiles; ++t) {
+      const index_t m = t * kChannelTile;
+      const index_t channels = std::min(kChannelTile, out_channels - m);
+      const float *in_base = input + b * in_channels * in_image_size;
+      const float *filter_ptr = filter + m * filter_stride;
+      float *out_base = output + (b * out_channels + m) * out_image_size;
+      for (index_t h = 0; h < out_height; ++h) {
+        const float *in_ptr = in_base + h * S * in_width;
+        float *out_ptr = out_base + h * out_width;
+        if (channels == kChannelTile) {
+          Conv2dRow<V, KH, KW, S, kChannelTile>(
+              in_ptr, filter_ptr, in_channels, in_image_size, in_width,
+              out_width, out_image_size, out_ptr);
+        } else {
+          for (index_t i = 0; i < channels; ++i) {
+            Conv2dRow<V, KH, KW, S, 1>(
+                in_ptr, filter_ptr + i * filter_stride, in_channels,
+                in_image_size, in_width, out_width, out_image_size,
+                out_ptr + i * out_image_size);
+          }
+        }
+        if (epilogue != nullptr) {
+          for (index_t i = 0; i < channels; ++i) {
+            float *row = out_ptr + i * out_image_size;
+            ApplyEpilogue(*epilogue, m + i, row, out_width, row);
+          }
+        }
+      }
+    }
+  }
+}
+
+// One output pixel of the unpadded input, skipping the taps in the padding.
+inline float DepthwiseConv2dPixel(const float *input,
+                                  const float *filter,
+                                  const index_t in_h,
+                                  const index_t in_w,
+                                  const index_t in_height,
+                                  const index_t in_width) {
+  float sum = 0;
+  for (index_t kh = 0; kh < 3; ++kh) {
+    for (index_t kw = 0; kw < 3; ++kw) {
+      const index_t h = in_h + kh;
+      const index_t w = in_w + kw;
+      if (h >= 0 && h < in_height && w >= 0 && w < in_width) {
+        sum += input[h * in_width + w] * filter[kh * 3 + kw];
+      }
+    }
+  }
+  return sum;
+}
+
+// kVectors vectors of consecutive pixels of a row, input points at the first
+// field, within the input.
+template <typename V, int S, int kVectors, bool kExact = false>
+MACE_CONV_2D_X86_TARGET inline void DepthwiseConv2dTile(
+    const float *input, const float *filter, const index_t in_width,
+    float *output) {
+  typedef typename V::Reg Reg;
+  Reg acc0 = V::Zero(), acc1 = V::Zero();
+  for (int kh = 0; kh < 3; ++kh) {
+    const float *in_row = input + kh * in_width;
+    for (int kw = 0; kw < 3; ++kw) {
+      const Reg f = V::Set1(filter[kh * 3 + kw]);
+      acc0 = V::MulAdd(LoadStrided<V, S, kExact>(in_row + kw), f, acc0);
+      if (kVectors > 1) {
+        acc1 = V::MulAdd(
+            LoadStrided<V, S, kExact>(in_row + kw + V::kWidth * S), f, acc1);
+      }
+    }
+  }
+  V::Store(output, acc0);
+  if (kVectors > 1) {
+    V::Store(output + V::kWidth, acc1);
+  }
+}
+
+// 3x3 depthwise convolution of the unpadded input, the rows [valid_h_start,
+// valid_h_stop) and columns [valid_w_start, valid_w_stop) of the output
+// having their fields within it.
+template <typename V, int S>
+MACE_CONV_2D_X86_TARGET void DepthwiseConv2dK3x3(const float *input,
+                                                 const float *filter,
+                                                 const index_t *in_shape,
+                                                 const index_t *out_shape,
+                                                 const int *pad_hw,
+                                                 const index_t valid_h_start,
+                                                 const index_t valid_h_stop,
+                                                 const index_t valid_w_start,
+                                                 const index_t valid_w_stop,
+                                                 const Epilogue *epilogue,
+                                                 float *output) {
+  const index_t in_channels = in_shape[1];
+  const index_t in_height = in_shape[2];
+  const index_t in_width = in_shape[3];
+  const index_t in_image_size = in_height * in_width;
+  const index_t out_channels = out_shape[1];
+  const index_t out_height = out_shape[2];
+  const index_t out_width = out_shape[3];
+  const index_t out_image_size = out_height * out_width;
+  const index_t multiplier = out_channels / in_channels;
+  const index_t pad_top = pad_hw[0];
+  const index_t pad_left = pad_hw[1];
+  // the valid pixels whose vectors read within the input row, which starts
+  // pad_left columns into the padded one
+  const index_t vector_stop = std::min(
+      valid_w_stop, VectorPixels<3, S, false>(in_width + pad_left, out_width));
+  const index_t exact_stop = std::min(
+      valid_w_stop, VectorPixels<3, S, true>(in_width + pad_left, out_width));
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < in_shape[0]; ++b) {
+    for (index_t m = 0; m < out_channels; ++m) {
+      const index_t c = m / multiplier;
+      const index_t multi_index = m % multiplier;
+      const float *in_base = input + (b * in_channels + c) * in_image_size;
+      const float *filter_ptr = filter + (multi_index * in_channels + c) * 9;
+      float *out_base = output + (b * out_channels + m) * out_image_size;
+      for (index_t h = 0; h < out_height; ++h) {
+        const index_t in_h = h * S - pad_top;
+        float *out_row = out_base + h * out_width;
+        index_t w = 0;
+        if (h >= valid_h_start && h < valid_h_stop) {
+          for (; w < valid_w_start; ++w) {
+            out_row[w] = DepthwiseConv2dPixel(in_base, filter_ptr, in_h,
+                                              w * S - pad_left, in_height,
+                                              in_width);
+          }
+          const float *in_row = in_base + in_h * in_width - pad_left;
+          for (; w + 2 * V::kWidth <= vector_stop; w += 2 * V::kWidth) {
+            DepthwiseConv2dTile<V, S, 2>(in_row + w * S, filter_ptr,
+                                         in_width, out_row + w);
+          }
+          for (; w + V::kWidth <= vector_stop; w += V::kWidth) {
+            DepthwiseConv2dTile<V, S, 1>(in_row + w * S, filter_ptr,
+                                         in_width, out_row + w);
+          }
+          if (w < vector_stop && vector_stop - valid_w_start >= V::kWidth) {
+            DepthwiseConv2dTile<V, S, 1>(
+                in_row + (vector_stop - V::kWidth) * S, filter_ptr, in_width,
+                out_row + vector_stop - V::kWidth);
+            w = vector_stop;
+          }
+          if (w < exact_stop && exact_stop - valid_w_start >= V::kWidth) {
+            DepthwiseConv2dTile<V, S, 1, true>(
+                in_row + (exact_stop - V::kWidth) * S, filter_ptr, in_width,
+                out_row + exact_stop - V::kWidth);
+            w = exact_stop;
+          }
+        }
+        for (; w < out_width; ++w) {
+          out_row[w] = DepthwiseConv2dPixel(in_base, filter_ptr, in_h,
+                                            w * S - pad_left, in_height,
+                                            in_width);
+        }
+      }
+      if (epilogue != nullptr) {
+        ApplyEpilogue(*epilogue, m, out_base, out_image_size, out_base);
+      }
+    }
+  }
+}
+
+}  // namespace conv_2d_x86
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_X86_CONV_2D_X86_IMPL_H_
@@ -0,0 +1,527 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include <algorithm>
+
+#include "mace/kernels/sparse_gemm.h"
+#include "mace/kernels/x86/gemm_avx2.h"
+#include "mace/utils/logging.h"
+
+// The functions below are compiled for AVX2/FMA regardless of the global
+// compiler flags, they are only reached through the dispatch table of AVX2.
+#define MACE_AVX2_TARGET __attribute__((target("avx2,fma")))
+
+namespace mace {
+namespace kernels {
+
+namespace {
+
+const int kRegHeightTile = 6;
+const int kRegWidthTile = 16;
+
+// lanes [0, n) are enabled
+MACE_AVX2_TARGET inline __m256i TailMask(const index_t n) {
+  const int count = static_cast<int>(std::min<index_t>(std::max<index_t>(n, 0),
+                                                       8));
+  return _mm256_cmpgt_epi32(_mm256_set1_epi32(count),
+                            _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+}
+
+MACE_AVX2_TARGET inline float HorizontalSum(const __m256 v) {
+  __m128 sum = _mm_add_ps(_mm256_castps256_ps128(v),
+                          _mm256_extractf128_ps(v, 1));
+  sum = _mm_hadd_ps(sum, sum);
+  sum = _mm_hadd_ps(sum, sum);
+  return _mm_cvtss_f32(sum);
+}
+
+// [sum(a0), sum(a1), sum(a2), sum(a3)]
+MACE_AVX2_TARGET inline __m128 HorizontalSum4(const __m256 a0,
+                                              const __m256 a1,
+                                              const __m256 a2,
+                                              const __m256 a3) {
+  const __m256 sum = _mm256_hadd_ps(_mm256_hadd_ps(a0, a1),
+                                    _mm256_hadd_ps(a2, a3));
+  return _mm_add_ps(_mm256_castps256_ps128(sum),
+                    _mm256_extractf128_ps(sum, 1));
+}
+
+inline float Finish(const float sum,
+                    const Epilogue *epilogue,
+                    const index_t channel) {
+  return epilogue == nullptr ? sum : ApplyEpilogue(*epilogue, channel, sum);
+}
+
+#define MACE_GEMM_AVX2_FMA(i)                                    \
+  if (kRows > i) {                                               \
+    const __m256 a = _mm256_broadcast_ss(a_ptr + i * stride_a);  \
+    c##i##0 = _mm256_fmadd_ps(a, b0, c##i##0);                   \
+    c##i##1 = _mm256_fmadd_ps(a, b1, c##i##1);                   \
+  }
+
+#define MACE_GEMM_AVX2_STORE(i)                                              \
+  if (kRows > i) {                                                           \
+    float *c_ptr = C + i * stride_c;                                         \
+    __m256 v0, v1;                                                           \
+    if (kMasked) {                                                           \
+      v0 = _mm256_add_ps(_mm256_maskload_ps(c_ptr, mask0), c##i##0);         \
+      v1 = _mm256_add_ps(_mm256_maskload_ps(c_ptr + 8, mask1), c##i##1);     \
+    } else {                                                                 \
+      v0 = _mm256_add_ps(_mm256_loadu_ps(c_ptr), c##i##0);                   \
+      v1 = _mm256_add_ps(_mm256_loadu_ps(c_ptr + 8), c##i##1);               \
+    }                                                                        \
+    if (epilogue != nullptr) {                                               \
+      const __m256 bias = _mm256_set1_ps(                                    \
+          row_bias == nullptr ? 0 : row_bias[i]);                            \
+      v0 = BiasClamp(v0, _mm256_add_ps(col_bias0, bias), lower, upper);      \
+      v1 = BiasClamp(v1, _mm256_add_ps(col_bias1, bias), lower, upper);      \
+    }                                                                        \
+    if (kMasked) {                                                           \
+      _mm256_maskstore_ps(c_ptr, mask0, v0);                                 \
+      _mm256_maskstore_ps(c_ptr + 8, mask1, v1);                             \
+    } else {                                                                 \
+      _mm256_storeu_ps(c_ptr, v0);                                           \
+      _mm256_storeu_ps(c_ptr + 8, v1);                                       \
+    }                                                                        \
+  }
+
+// max/min return their second operand if either one is NaN
+MACE_AVX2_TARGET inline __m256 BiasClamp(const __m256 v,
+                                         const __m256 bias,
+                                         const __m256 lower,
+                                         const __m256 upper) {
+  return _mm256_min_ps(upper, _mm256_max_ps(lower, _mm256_add_ps(v, bias)));
+}
+
+// C[kRows, 16] += A[kRows, K] * B[K, 16], accumulated in 12 ymm registers.
+// When kMasked, only the columns enabled by mask0/mask1 are touched. The
+// epilogue, if any, must be a bias clamp, it is applied in registers.
+template <int kRows, bool kMasked>
+MACE_AVX2_TARGET void GemmKernel6x16(const float *A,
+                                     const float *B,
+                                     const index_t K,
+                                     const index_t stride_a,
+                                     const index_t stride_b,
+                                     const index_t stride_c,
+                                     const __m256i mask0,
+                                     const __m256i mask1,
+                                     const Epilogue *epilogue,
+                                     float *C) {
+  __m256 c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+  __m256 c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+  __m256 c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+  __m256 c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+  __m256 c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+  __m256 c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+  for (index_t k = 0; k < K; ++k) {
+    const float *a_ptr = A + k;
+    const float *b_ptr = B + k * stride_b;
+    __m256 b0, b1;
+    if (kMasked) {
+      b0 = _mm256_maskload_ps(b_ptr, mask0);
+      b1 = _mm256_maskload_ps(b_ptr + 8, mask1);
+    } else {
+      b0 = _mm256_loadu_ps(b_ptr);
+      b1 = _mm256_loadu_ps(b_ptr + 8);
+    }
+    MACE_GEMM_AVX2_FMA(0);
+    MACE_GEMM_AVX2_FMA(1);
+    MACE_GEMM_AVX2_FMA(2);
+    MACE_GEMM_AVX2_FMA(3);
+    MACE_GEMM_AVX2_FMA(4);
+    MACE_GEMM_AVX2_FMA(5);
+  }
+
+  __m256 lower = _mm256_setzero_ps(), upper = _mm256_setzero_ps();
+  __m256 col_bias0 = _mm256_setzero_ps(), col_bias1 = _mm256_setzero_ps();
+  const float *row_bias = nullptr;
+  if (epilogue != nullptr) {
+    lower = _mm256_set1_ps(epilogue->lower());
+    upper = _mm256_set1_ps(epilogue->upper());
+    if (epilogue->bias != nullptr && epilogue->per_column) {
+      col_bias0 = _mm256_maskload_ps(epilogue->bias, mask0);
+      col_bias1 = _mm256_maskload_ps(epilogue->bias + 8, mask1);
+    } else {
+      row_bias = epilogue->bias;
+    }
+  }
+  MACE_GEMM_AVX2_STORE(0);
+  MACE_GEMM_AVX2_STORE(1);
+  MACE_GEMM_AVX2_STORE(2);
+  MACE_GEMM_AVX2_STORE(3);
+  MACE_GEMM_AVX2_STORE(4);
+  MACE_GEMM_AVX2_STORE(5);
+}
+
+#undef MACE_GEMM_AVX2_FMA
+#undef MACE_GEMM_AVX2_STORE
+
+template <bool kMasked>
+MACE_AVX2_TARGET void GemmKernelX16(const float *A,
+                                    const float *B,
+                                    const index_t rows,
+                                    const index_t K,
+                                    const index_t stride_a,
+                                    const index_t stride_b,
+                                    const index_t stride_c,
+                                    const __m256i mask0,
+                                    const __m256i mask1,
+                                    const Epilogue *epilogue,
+                                    float *C) {
+  switch (rows) {
+    case 1:
+      GemmKernel6x16<1, kMasked>(A, B, K, stride_a, stride_b, stride_c,
+                                 mask0, mask1, epilogue, C);
+      break;
+    case 2:
+      GemmKernel6x16<2, kMasked>(A, B, K, stride_a, stride_b, stride_c,
+                                 mask0, mask1, epilogue, C);
+      break;
+    case 3:
+      GemmKernel6x16<3, kMasked>(A, B, K, stride_a, stride_b, stride_c,
+                                 mask0, mask1, epilogue, C);
+      break;
+    case 4:
+      GemmKernel6x16<4, kMasked>(A, B, K, stride_a, stride_b, stride_c,
+                                 mask0, mask1, epilogue, C);
+      break;
+    case 5:
+      GemmKernel6x16<5, kMasked>(A, B, K, stride_a, stride_b, stride_c,
+                                 mask0, mask1, epilogue, C);
+      break;
+    case 6:
+      GemmKernel6x16<6, kMasked>(A, B, K, stride_a, stride_b, stride_c,
+                                 mask0, mask1, epilogue, C);
+      break;
+    default:
+      MACE_NOT_IMPLEMENTED;
+  }
+}
+
+// kRows x (8 * kVecs) of C from the blocks of a sparse block row, the
+// accumulators stay in registers while the blocks stream through.
+template <int kRows, int kVecs>
+MACE_AVX2_TARGET void BlockSparseGemmKernel(const float *values,
+                                            const int32_t *block_col,
+                                            const index_t num_blocks,
+                                            const float *B,
+                                            const index_t stride_b,
+                                            const index_t stride_c,
+                                            float *C) {
+  __m256 vsum[kRows][kVecs];
+  for (int r = 0; r < kRows; ++r) {
+    for (int v = 0; v < kVecs; ++v) {
+      vsum[r][v] = _mm256_setzero_ps();
+    }
+  }
+  for (index_t j = 0; j < num_blocks; ++j) {
+    const float *block = values + j * kRows * kSparseBlockCols;
+    const float *b_row = B + block_col[j] * stride_b;
+    for (int c = 0; c < kSparseBlockCols; ++c) {
+      __m256 vb[kVecs];
+      for (int v = 0; v < kVecs; ++v) {
+        vb[v] = _mm256_loadu_ps(b_row + v * 8);
+      }
+      for (int r = 0; r < kRows; ++r) {
+        const __m256 va = _mm256_broadcast_ss(block + r * kSparseBlockCols + c);
+        for (int v = 0; v < kVecs; ++v) {
+          vsum[r][v] = _mm256_fmadd_ps(va, vb[v], vsum[r][v]);
+        }
+      }
+      b_row += stride_b;
+    }
+  }
+  for (int r = 0; r < kRows; ++r) {
+    for (int v = 0; v < kVecs; ++v) {
+      _mm256_storeu_ps(C + r * stride_c + v * 8, vsum[r][v]);
+    }
+  }
+}
+
+}  // namespace
+
+MACE_AVX2_TARGET void GemmTileAVX2(const float *A,
+                                   const float *B,
+                                   const index_t height,
+                                   const index_t K,
+                                   const index_t width,
+                                   const index_t stride_a,
+                                   const index_t stride_b,
+                                   const index_t stride_c,
+                                   const Epilogue *epilogue,
+                                   float *C) {
+  const __m256i full_mask = _mm256_set1_epi32(-1);
+  const bool fused = epilogue != nullptr && epilogue->IsBiasClamp();
+  // a kc x 16 panel of B stays in L1 while sweeping the rows of A
+  for (index_t w = 0; w < width; w += kRegWidthTile) {
+    const index_t remain_w = width - w;
+    const bool masked = remain_w < kRegWidthTile;
+    const __m256i mask0 = masked ? TailMask(remain_w) : full_mask;
+    const __m256i mask1 = masked ? TailMask(remain_w - 8) : full_mask;
+    for (index_t h = 0; h < height; h += kRegHeightTile) {
+      const index_t rows = std::min<index_t>(kRegHeightTile, height - h);
+      const float *a_ptr = A + h * stride_a;
+      float *c_ptr = C + h * stride_c + w;
+      Epilogue block_epilogue;
+      if (epilogue != nullptr) {
+        block_epilogue = epilogue->Offset(h, w);
+      }
+      const Epilogue *kernel_epilogue = fused ? &block_epilogue : nullptr;
+      if (masked) {
+        GemmKernelX16<true>(a_ptr, B + w, rows, K, stride_a, stride_b,
+                            stride_c, mask0, mask1, kernel_epilogue, c_ptr);
+      } else {
+        GemmKernelX16<false>(a_ptr, B + w, rows, K, stride_a, stride_b,
+                             stride_c, mask0, mask1, kernel_epilogue, c_ptr);
+      }
+      // other activations run on the block just stored, still in L1
+      if (epilogue != nullptr && !fused) {
+        ApplyEpilogue(block_epilogue, rows,
+                      std::min<index_t>(kRegWidthTile, remain_w), stride_c,
+                      c_ptr);
+      }
+    }
+  }
+}
+
+MACE_AVX2_TARGET void GemvAVX2(const float *m_ptr,
+                               const float *v_ptr,
+                               const index_t batch,
+                               const index_t width,
+                               const index_t height,
+                               const Epilogue *epilogue,
+                               float *out_ptr) {
+  const index_t remain_w = width % 8;
+  const index_t aligned_w = width - remain_w;
+  const __m256i tail_mask = TailMask(remain_w);
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t h = 0; h < height; h += 4) {
+      const float *v_ptr0 = v_ptr + b * width;
+      float *out_ptr0 = out_ptr + b * height + h;
+      if (h + 3 < height) {
+        const float *m_ptr0 = m_ptr + h * width;
+        const float *m_ptr1 = m_ptr0 + width;
+        const float *m_ptr2 = m_ptr1 + width;
+        const float *m_ptr3 = m_ptr2 + width;
+
+        __m256 vsum0 = _mm256_setzero_ps();
+        __m256 vsum1 = _mm256_setzero_ps();
+        __m256 vsum2 = _mm256_setzero_ps();
+        __m256 vsum3 = _mm256_setzero_ps();
+        for (index_t w = 0; w < aligned_w; w += 8) {
+          const __m256 vv = _mm256_loadu_ps(v_ptr0 + w);
+          vsum0 = _mm256_fmadd_ps(_mm256_loadu_ps(m_ptr0 + w), vv, vsum0);
+          vsum1 = _mm256_fmadd_ps(_mm256_loadu_ps(m_ptr1 + w), vv, vsum1);
+          vsum2 = _mm256_fmadd_ps(_mm256_loadu_ps(m_ptr2 + w), vv, vsum2);
+          vsum3 = _mm256_fmadd_ps(_mm256_loadu_ps(m_ptr3 + w), vv, vsum3);
+        }
+        if (remain_w > 0) {
+          const __m256 vv = _mm256_maskload_ps(v_ptr0 + aligned_w, tail_mask);
+          vsum0 = _mm256_fmadd_ps(
+              _mm256_maskload_ps(m_ptr0 + aligned_w, tail_mask), vv, vsum0);
+          vsum1 = _mm256_fmadd_ps(
+              _mm256_maskload_ps(m_ptr1 + aligned_w, tail_mask), vv, vsum1);
+          vsum2 = _mm256_fmadd_ps(
+              _mm256_maskload_ps(m_ptr2 + aligned_w, tail_mask), vv, vsum2);
+          vsum3 = _mm256_fmadd_ps(
+              _mm256_maskload_ps(m_ptr3 + aligned_w, tail_mask), vv, vsum3);
+        }
+        out_ptr0[0] = Finish(HorizontalSum(vsum0), epilogue, h);
+        out_ptr0[1] = Finish(HorizontalSum(vsum1), epilogue, h + 1);
+        out_ptr0[2] = Finish(HorizontalSum(vsum2), epilogue, h + 2);
+        out_ptr0[3] = Finish(HorizontalSum(vsum3), epilogue, h + 3);
+      } else {
+        for (index_t hh = h; hh < height; ++hh) {
+          const float *m_ptr0 = m_ptr + hh * width;
+          __m256 vsum = _mm256_setzero_ps();
+          for (index_t w = 0; w < aligned_w; w += 8) {
+            vsum = _mm256_fmadd_ps(_mm256_loadu_ps(m_ptr0 + w),
+                                   _mm256_loadu_ps(v_ptr0 + w), vsum);
+          }
+          if (remain_w > 0) {
+            vsum = _mm256_fmadd_ps(
+                _mm256_maskload_ps(m_ptr0 + aligned_w, tail_mask),
+                _mm256_maskload_ps(v_ptr0 + aligned_w, tail_mask), vsum);
+          }
+          out_ptr0[hh - h] = Finish(HorizontalSum(vsum), epilogue, hh);
+        }
+      }
+    }  // h
+  }    // b
+}
+
+namespace {
+
+// out[b, 0..3] of kBatch batches, 4 rows by kBatch in 8 or 4 accumulators
+template <int kBatch>
+MACE_AVX2_TARGET void SkinnyGemmKernel4(const float *m_ptr,
+                                        const float *v_ptr,
+                                        const index_t K,
+                                        const index_t stride,
+                                        const index_t out_stride,
+                                        float *out_ptr) {
+  const index_t remain_k = K % 8;
+  const index_t aligned_k = K - remain_k;
+  const float *m_ptr0 = m_ptr;
+  const float *m_ptr1 = m_ptr0 + stride;
+  const float *m_ptr2 = m_ptr1 + stride;
+  const float *m_ptr3 = m_ptr2 + stride;
+  const float *v_ptr0 = v_ptr;
+  const float *v_ptr1 = v_ptr + stride;
+  __m256 vsum00 = _mm256_setzero_ps();
+  __m256 vsum01 = _mm256_setzero_ps();
+  __m256 vsum02 = _mm256_setzero_ps();
+  __m256 vsum03 = _mm256_setzero_ps();
+  __m256 vsum10 = _mm256_setzero_ps();
+  __m256 vsum11 = _mm256_setzero_ps();
+  __m256 vsum12 = _mm256_setzero_ps();
+  __m256 vsum13 = _mm256_setzero_ps();
+  for (index_t k = 0; k < aligned_k; k += 8) {
+    const __m256 vm0 = _mm256_loadu_ps(m_ptr0 + k);
+    const __m256 vm1 = _mm256_loadu_ps(m_ptr1 + k);
+    const __m256 vm2 = _mm256_loadu_ps(m_ptr2 + k);
+    const __m256 vm3 = _mm256_loadu_ps(m_ptr3 + k);
+    const __m256 vv0 = _mm256_loadu_ps(v_ptr0 + k);
+    vsum00 = _mm256_fmadd_ps(vm0, vv0, vsum00);
+    vsum01 = _mm256_fmadd_ps(vm1, vv0, vsum01);
+    vsum02 = _mm256_fmadd_ps(vm2, vv0, vsum02);
+    vsum03 = _mm256_fmadd_ps(vm3, vv0, vsum03);
+    if (kBatch > 1) {
+      const __m256 vv1 = _mm256_loadu_ps(v_ptr1 + k);
+      vsum10 = _mm256_fmadd_ps(vm0, vv1, vsum10);
+      vsum11 = _mm256_fmadd_ps(vm1, vv1, vsum11);
+      vsum12 = _mm256_fmadd_ps(vm2, vv1, vsum12);
+      vsum13 = _mm256_fmadd_ps(vm3, vv1, vsum13);
+    }
+  }
+  if (remain_k > 0) {
+    const __m256i mask = TailMask(remain_k);
+    const __m256 vm0 = _mm256_maskload_ps(m_ptr0 + aligned_k, mask);
+    const __m256 vm1 = _mm256_maskload_ps(m_ptr1 + aligned_k, mask);
+    const __m256 vm2 = _mm256_maskload_ps(m_ptr2 + aligned_k, mask);
+    const __m256 vm3 = _mm256_maskload_ps(m_ptr3 + aligned_k, mask);
+    const __m256 vv0 = _mm256_maskload_ps(v_ptr0 + aligned_k, mask);
+    vsum00 = _mm256_fmadd_ps(vm0, vv0, vsum00);
+    vsum01 = _mm256_fmadd_ps(vm1, vv0, vsum01);
+    vsum02 = _mm256_fmadd_ps(vm2, vv0, vsum02);
+    vsum03 = _mm256_fmadd_ps(vm3, vv0, vsum03);
+    if (kBatch > 1) {
+      const __m256 vv1 = _mm256_maskload_ps(v_ptr1 + aligned_k, mask);
+      vsum10 = _mm256_fmadd_ps(vm0, vv1, vsum10);
+      vsum11 = _mm256_fmadd_ps(vm1, vv1, vsum11);
+      vsum12 = _mm256_fmadd_ps(vm2, vv1, vsum12);
+      vsum13 = _mm256_fmadd_ps(vm3, vv1, vsum13);
+    }
+  }
+  _mm_storeu_ps(out_ptr, HorizontalSum4(vsum00, vsum01, vsum02, vsum03));
+  if (kBatch > 1) {
+    _mm_storeu_ps(out_ptr + out_stride,
+                  HorizontalSum4(vsum10, vsum11, vsum12, vsum13));
+  }
+}
+
+}  // namespace
+
+MACE_AVX2_TARGET void SkinnyGemmAVX2(const float *m_ptr,
+                                     const float *v_ptr,
+                                     const index_t batch,
+                                     const index_t K,
+                                     const index_t height,
+                                     const index_t stride,
+                                     const index_t out_stride,
+                                     float *out_ptr) {
+  const index_t remain_k = K % 8;
+  const index_t aligned_k = K - remain_k;
+  const __m256i tail_mask = TailMask(remain_k);
+  index_t h = 0;
+  // 4 rows stay in L1 while they are multiplied by the whole batch
+  for (; h + 3 < height; h += 4) {
+    const float *m_rows = m_ptr + h * stride;
+    index_t b = 0;
+    for (; b + 1 < batch; b += 2) {
+      SkinnyGemmKernel4<2>(m_rows, v_ptr + b * stride, K, stride, out_stride,
+                           out_ptr + b * out_stride + h);
+    }
+    if (b < batch) {
+      SkinnyGemmKernel4<1>(m_rows, v_ptr + b * stride, K, stride, out_stride,
+                           out_ptr + b * out_stride + h);
+    }
+  }
+  for (; h < height; ++h) {
+    const float *m_row = m_ptr + h * stride;
+    for (index_t b = 0; b < batch; ++b) {
+      const float *v_row = v_ptr + b * stride;
+      __m256 vsum = _mm256_setzero_ps();
+      for (index_t k = 0; k < aligned_k; k += 8) {
+        vsum = _mm256_fmadd_ps(_mm256_loadu_ps(m_row + k),
+                               _mm256_loadu_ps(v_row + k), vsum);
+      }
+      if (remain_k > 0) {
+        vsum = _mm256_fmadd_ps(
+            _mm256_maskload_ps(m_row + aligned_k, tail_mask),
+            _mm256_maskload_ps(v_row + aligned_k, tail_mask), vsum);
+      }
+      out_ptr[b * out_stride + h] = HorizontalSum(vsum);
+    }
+  }
+}
+
+MACE_AVX2_TARGET void BlockSparseGemmAVX2(const float *values,
+                                          const int32_t *block_col,
+                                          const index_t num_blocks,
+                                          const index_t block_rows,
+                                          const float *B,
+                                          const index_t width,
+                                          const index_t stride_b,
+                                          const index_t stride_c,
+                                          float *C) {
+  index_t w = 0;
+  if (block_rows == 4) {
+    for (; w + 23 < width; w += 24) {
+      BlockSparseGemmKernel<4, 3>(values, block_col, num_blocks, B + w,
+                                  stride_b, stride_c, C + w);
+    }
+  } else {
+    for (; w + 31 < width; w += 32) {
+      BlockSparseGemmKernel<1, 4>(values, block_col, num_blocks, B + w,
+                                  stride_b, stride_c, C + w);
+    }
+  }
+  for (; w + 7 < width; w += 8) {
+    if (block_rows == 4) {
+      BlockSparseGemmKernel<4, 1>(values, block_col, num_blocks, B + w,
+                                  stride_b, stride_c, C + w);
+    } else {
+      BlockSparseGemmKernel<1, 1>(values, block_col, num_blocks, B + w,
+                                  stride_b, stride_c, C + w);
+    }
+  }
+  if (w < width) {
+    BlockSparseGemmDefault(values, block_col, num_blocks, block_rows, B + w,
+                           width - w, stride_b, stride_c, C + w);
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
+
+#undef MACE_AVX2_TARGET
+
+#endif  // __x86_64__ || __i386__
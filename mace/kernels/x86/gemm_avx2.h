@@ -0,0 +1,76 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_X86_GEMM_AVX2_H_
+#define MACE_KERNELS_X86_GEMM_AVX2_H_
+
+#include "mace/core/types.h"
+#include "mace/kernels/epilogue.h"
+
+namespace mace {
+namespace kernels {
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// C[height, width] += A[height, K] * B[K, width], all row major with strides.
+// Computed by 6x16 register blocks, tails are handled by masked loads/stores.
+// Bias, RELU and RELUX epilogues are applied in registers.
+void GemmTileAVX2(const float *A,
+                  const float *B,
+                  const index_t height,
+                  const index_t K,
+                  const index_t width,
+                  const index_t stride_a,
+                  const index_t stride_b,
+                  const index_t stride_c,
+                  const Epilogue *epilogue,
+                  float *C);
+
+// out[b, h] = sum_w m[h, w] * v[b, w], same layout as Gemv
+void GemvAVX2(const float *m_ptr,
+              const float *v_ptr,
+              const index_t batch,
+              const index_t width,
+              const index_t height,
+              const Epilogue *epilogue,
+              float *out_ptr);
+
+// SkinnyGemmFunc in cpu_dispatch.h, rows of m are reduced 4 at a time
+void SkinnyGemmAVX2(const float *m_ptr,
+                    const float *v_ptr,
+                    const index_t batch,
+                    const index_t K,
+                    const index_t height,
+                    const index_t stride,
+                    const index_t out_stride,
+                    float *out_ptr);
+
+// BlockSparseGemmFunc in cpu_dispatch.h, C is computed 24 (4 rows) or 32
+// (1 row) columns at a time
+void BlockSparseGemmAVX2(const float *values,
+                         const int32_t *block_col,
+                         const index_t num_blocks,
+                         const index_t block_rows,
+                         const float *B,
+                         const index_t width,
+                         const index_t stride_b,
+                         const index_t stride_c,
+                         float *C);
+
+#endif  // __x86_64__ || __i386__
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_X86_GEMM_AVX2_H_
@@ -0,0 +1,230 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include <algorithm>
+
+#include "mace/kernels/x86/gemm_avx512.h"
+#include "mace/utils/logging.h"
+
+// The functions below are compiled for AVX-512F regardless of the global
+// compiler flags, they are only reached through the dispatch table of AVX512.
+#define MACE_AVX512_TARGET __attribute__((target("avx512f")))
+
+namespace mace {
+namespace kernels {
+
+namespace {
+
+const int kRegHeightTile = 8;
+const int kRegWidthTile = 32;
+
+// lanes [0, n) are enabled
+inline __mmask16 TailMask(const index_t n) {
+  const int count = static_cast<int>(std::min<index_t>(std::max<index_t>(n, 0),
+                                                       16));
+  return static_cast<__mmask16>((1u << count) - 1);
+}
+
+#define MACE_GEMM_AVX512_FMA(i)                                 \
+  if (kRows > i) {                                              \
+    const __m512 a = _mm512_set1_ps(a_ptr[i * stride_a]);       \
+    c##i##0 = _mm512_fmadd_ps(a, b0, c##i##0);                  \
+    c##i##1 = _mm512_fmadd_ps(a, b1, c##i##1);                  \
+  }
+
+#define MACE_GEMM_AVX512_STORE(i)                                            \
+  if (kRows > i) {                                                           \
+    float *c_ptr = C + i * stride_c;                                         \
+    __m512 v0 = _mm512_add_ps(_mm512_maskz_loadu_ps(mask0, c_ptr), c##i##0); \
+    __m512 v1 =                                                              \
+        _mm512_add_ps(_mm512_maskz_loadu_ps(mask1, c_ptr + 16), c##i##1);    \
+    if (epilogue != nullptr) {                                               \
+      const __m512 bias = _mm512_set1_ps(                                    \
+          row_bias == nullptr ? 0 : row_bias[i]);                            \
+      v0 = BiasClamp(v0, _mm512_add_ps(col_bias0, bias), lower, upper);      \
+      v1 = BiasClamp(v1, _mm512_add_ps(col_bias1, bias), lower, upper);      \
+    }                                                                        \
+    _mm512_mask_storeu_ps(c_ptr, mask0, v0);                                 \
+    _mm512_mask_storeu_ps(c_ptr + 16, mask1, v1);                            \
+  }
+
+// max/min return their second operand if either one is NaN
+MACE_AVX512_TARGET inline __m512 BiasClamp(const __m512 v,
+                                           const __m512 bias,
+                                           const __m512 lower,
+                                           const __m512 upper) {
+  return _mm512_min_ps(upper, _mm512_max_ps(lower, _mm512_add_ps(v, bias)));
+}
+
+// C[kRows, 32] += A[kRows, K] * B[K, 32], accumulated in 16 zmm registers.
+// Only the columns enabled by mask0/mask1 are touched, full masks cost the
+// same as plain loads/stores. The epilogue, if any, must be a bias clamp, it
+// is applied in registers.
+template <int kRows>
+MACE_AVX512_TARGET void GemmKernel8x32(const float *A,
+                                       const float *B,
+                                       const index_t K,
+                                       const index_t stride_a,
+                                       const index_t stride_b,
+                                       const index_t stride_c,
+                                       const __mmask16 mask0,
+                                       const __mmask16 mask1,
+                                       const Epilogue *epilogue,
+                                       float *C) {
+  __m512 c00 = _mm512_setzero_ps(), c01 = _mm512_setzero_ps();
+  __m512 c10 = _mm512_setzero_ps(), c11 = _mm512_setzero_ps();
+  __m512 c20 = _mm512_setzero_ps(), c21 = _mm512_setzero_ps();
+  __m512 c30 = _mm512_setzero_ps(), c31 = _mm512_setzero_ps();
+  __m512 c40 = _mm512_setzero_ps(), c41 = _mm512_setzero_ps();
+  __m512 c50 = _mm512_setzero_ps(), c51 = _mm512_setzero_ps();
+  __m512 c60 = _mm512_setzero_ps(), c61 = _mm512_setzero_ps();
+  __m512 c70 = _mm512_setzero_ps(), c71 = _mm512_setzero_ps();
+
+  for (index_t k = 0; k < K; ++k) {
+    const float *a_ptr = A + k;
+    const float *b_ptr = B + k * stride_b;
+    const __m512 b0 = _mm512_maskz_loadu_ps(mask0, b_ptr);
+    const __m512 b1 = _mm512_maskz_loadu_ps(mask1, b_ptr + 16);
+    MACE_GEMM_AVX512_FMA(0);
+    MACE_GEMM_AVX512_FMA(1);
+    MACE_GEMM_AVX512_FMA(2);
+    MACE_GEMM_AVX512_FMA(3);
+    MACE_GEMM_AVX512_FMA(4);
+    MACE_GEMM_AVX512_FMA(5);
+    MACE_GEMM_AVX512_FMA(6);
+    MACE_GEMM_AVX512_FMA(7);
+  }
+
+  __m512 lower = _mm512_setzero_ps(), upper = _mm512_setzero_ps();
+  __m512 col_bias0 = _mm512_setzero_ps(), col_bias1 = _mm512_setzero_ps();
+  const float *row_bias = nullptr;
+  if (epilogue != nullptr) {
+    lower = _mm512_set1_ps(epilogue->lower());
+    upper = _mm512_set1_ps(epilogue->upper());
+    if (epilogue->bias != nullptr && epilogue->per_column) {
+      col_bias0 = _mm512_maskz_loadu_ps(mask0, epilogue->bias);
+      col_bias1 = _mm512_maskz_loadu_ps(mask1, epilogue->bias + 16);
+    } else {
+      row_bias = epilogue->bias;
+    }
+  }
+  MACE_GEMM_AVX512_STORE(0);
+  MACE_GEMM_AVX512_STORE(1);
+  MACE_GEMM_AVX512_STORE(2);
+  MACE_GEMM_AVX512_STORE(3);
+  MACE_GEMM_AVX512_STORE(4);
+  MACE_GEMM_AVX512_STORE(5);
+  MACE_GEMM_AVX512_STORE(6);
+  MACE_GEMM_AVX512_STORE(7);
+}
+
+#undef MACE_GEMM_AVX512_FMA
+#undef MACE_GEMM_AVX512_STORE
+
+MACE_AVX512_TARGET void GemmKernelX32(const float *A,
+                                      const float *B,
+                                      const index_t rows,
+                                      const index_t K,
+                                      const index_t stride_a,
+                                      const index_t stride_b,
+                                      const index_t stride_c,
+                                      const __mmask16 mask0,
+                                      const __mmask16 mask1,
+                                      const Epilogue *epilogue,
+                                      float *C) {
+  switch (rows) {
+    case 1:
+      GemmKernel8x32<1>(A, B, K, stride_a, stride_b, stride_c, mask0, mask1,
+                        epilogue, C);
+      break;
+    case 2:
+      GemmKernel8x32<2>(A, B, K, stride_a, stride_b, stride_c, mask0, mask1,
+                        epilogue, C);
+      break;
+    case 3:
+      GemmKernel8x32<3>(A, B, K, stride_a, stride_b, stride_c, mask0, mask1,
+                        epilogue, C);
+      break;
+    case 4:
+      GemmKernel8x32<4>(A, B, K, stride_a, stride_b, stride_c, mask0, mask1,
+                        epilogue, C);
+      break;
+    case 5:
+      GemmKernel8x32<5>(A, B, K, stride_a, stride_b, stride_c, mask0, mask1,
+                        epilogue, C);
+      break;
+    case 6:
+      GemmKernel8x32<6>(A, B, K, stride_a, stride_b, stride_c, mask0, mask1,
+                        epilogue, C);
+      break;
+    case 7:
+      GemmKernel8x32<7>(A, B, K, stride_a, stride_b, stride_c, mask0, mask1,
+                        epilogue, C);
+      break;
+    case 8:
+      GemmKernel8x32<8>(A, B, K, stride_a, stride_b, stride_c, mask0, mask1,
+                        epilogue, C);
+      break;
+    default:
+      MACE_NOT_IMPLEMENTED;
+  }
+}
+
+}  // namespace
+
+MACE_AVX512_TARGET void GemmTileAVX512(const float *A,
+                                       const float *B,
+                                       const index_t height,
+                                       const index_t K,
+                                       const index_t width,
+                                       const index_t stride_a,
+                                       const index_t stride_b,
+                                       const index_t stride_c,
+                                       const Epilogue *epilogue,
+                                       float *C) {
+  const bool fused = epilogue != nullptr && epilogue->IsBiasClamp();
+  // a kc x 32 panel of B stays in L1 while sweeping the rows of A
+  for (index_t w = 0; w < width; w += kRegWidthTile) {
+    const index_t remain_w = width - w;
+    const __mmask16 mask0 = TailMask(remain_w);
+    const __mmask16 mask1 = TailMask(remain_w - 16);
+    for (index_t h = 0; h < height; h += kRegHeightTile) {
+      const index_t rows = std::min<index_t>(kRegHeightTile, height - h);
+      float *c_ptr = C + h * stride_c + w;
+      Epilogue block_epilogue;
+      if (epilogue != nullptr) {
+        block_epilogue = epilogue->Offset(h, w);
+      }
+      GemmKernelX32(A + h * stride_a, B + w, rows, K, stride_a, stride_b,
+                    stride_c, mask0, mask1,
+                    fused ? &block_epilogue : nullptr, c_ptr);
+      // other activations run on the block just stored, still in L1
+      if (epilogue != nullptr && !fused) {
+        ApplyEpilogue(block_epilogue, rows,
+                      std::min<index_t>(kRegWidthTile, remain_w), stride_c,
+                      c_ptr);
+      }
+    }
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
+
+#undef MACE_AVX512_TARGET
+
+#endif  // __x86_64__ || __i386__
@@ -0,0 +1,43 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_X86_GEMM_AVX512_H_
+#define MACE_KERNELS_X86_GEMM_AVX512_H_
+
+#include "mace/core/types.h"
+#include "mace/kernels/epilogue.h"
+
+namespace mace {
+namespace kernels {
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Same as GemmTileAVX2 with 8x32 register blocks in zmm registers.
+void GemmTileAVX512(const float *A,
+                    const float *B,
+                    const index_t height,
+                    const index_t K,
+                    const index_t width,
+                    const index_t stride_a,
+                    const index_t stride_b,
+                    const index_t stride_c,
+                    const Epilogue *epilogue,
+                    float *C);
+
+#endif  // __x86_64__ || __i386__
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_X86_GEMM_AVX512_H_
@@ -0,0 +1,423 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#if defined(__x86_64__) || defined(__i386__)
+
+#include <immintrin.h>
+#include <algorithm>
+
+#include "mace/kernels/sparse_gemm.h"
+#include "mace/kernels/x86/gemm_sse.h"
+#include "mace/utils/logging.h"
+
+// The functions below are compiled for SSE4.2 regardless of the global
+// compiler flags, they are only reached through the dispatch table of SSE4.2.
+#define MACE_SSE_TARGET __attribute__((target("sse4.2")))
+
+namespace mace {
+namespace kernels {
+
+namespace {
+
+const int kRegHeightTile = 6;
+const int kRegWidthTile = 8;
+
+MACE_SSE_TARGET inline float HorizontalSum(const __m128 v) {
+  __m128 sum = _mm_hadd_ps(v, v);
+  sum = _mm_hadd_ps(sum, sum);
+  return _mm_cvtss_f32(sum);
+}
+
+// [sum(a0), sum(a1), sum(a2), sum(a3)]
+MACE_SSE_TARGET inline __m128 HorizontalSum4(const __m128 a0,
+                                             const __m128 a1,
+                                             const __m128 a2,
+                                             const __m128 a3) {
+  return _mm_hadd_ps(_mm_hadd_ps(a0, a1), _mm_hadd_ps(a2, a3));
+}
+
+// out[b, 0..3] of kBatch batches, 4 rows by kBatch in 8 or 4 accumulators
+template <int kBatch>
+MACE_SSE_TARGET void SkinnyGemmKernel4(const float *m_ptr,
+                                       const float *v_ptr,
+                                       const index_t K,
+                                       const index_t stride,
+                                       const index_t out_stride,
+                                       float *out_ptr) {
+  const index_t aligned_k = K - K % 4;
+  const float *m_ptr0 = m_ptr;
+  const float *m_ptr1 = m_ptr0 + stride;
+  const float *m_ptr2 = m_ptr1 + stride;
+  const float *m_ptr3 = m_ptr2 + stride;
+  const float *v_ptr0 = v_ptr;
+  const float *v_ptr1 = v_ptr + stride;
+  __m128 vsum00 = _mm_setzero_ps();
+  __m128 vsum01 = _mm_setzero_ps();
+  __m128 vsum02 = _mm_setzero_ps();
+  __m128 vsum03 = _mm_setzero_ps();
+  __m128 vsum10 = _mm_setzero_ps();
+  __m128 vsum11 = _mm_setzero_ps();
+  __m128 vsum12 = _mm_setzero_ps();
+  __m128 vsum13 = _mm_setzero_ps();
+  for (index_t k = 0; k < aligned_k; k += 4) {
+    const __m128 vm0 = _mm_loadu_ps(m_ptr0 + k);
+    const __m128 vm1 = _mm_loadu_ps(m_ptr1 + k);
+    const __m128 vm2 = _mm_loadu_ps(m_ptr2 + k);
+    const __m128 vm3 = _mm_loadu_ps(m_ptr3 + k);
+    const __m128 vv0 = _mm_loadu_ps(v_ptr0 + k);
+    vsum00 = _mm_add_ps(vsum00, _mm_mul_ps(vm0, vv0));
+    vsum01 = _mm_add_ps(vsum01, _mm_mul_ps(vm1, vv0));
+    vsum02 = _mm_add_ps(vsum02, _mm_mul_ps(vm2, vv0));
+    vsum03 = _mm_add_ps(vsum03, _mm_mul_ps(vm3, vv0));
+    if (kBatch > 1) {
+      const __m128 vv1 = _mm_loadu_ps(v_ptr1 + k);
+      vsum10 = _mm_add_ps(vsum10, _mm_mul_ps(vm0, vv1));
+      vsum11 = _mm_add_ps(vsum11, _mm_mul_ps(vm1, vv1));
+      vsum12 = _mm_add_ps(vsum12, _mm_mul_ps(vm2, vv1));
+      vsum13 = _mm_add_ps(vsum13, _mm_mul_ps(vm3, vv1));
+    }
+  }
+  __m128 vsum0 = HorizontalSum4(vsum00, vsum01, vsum02, vsum03);
+  __m128 vsum1 = HorizontalSum4(vsum10, vsum11, vsum12, vsum13);
+  for (index_t k = aligned_k; k < K; ++k) {
+    const __m128 vm = _mm_setr_ps(m_ptr0[k], m_ptr1[k], m_ptr2[k], m_ptr3[k]);
+    vsum0 = _mm_add_ps(vsum0, _mm_mul_ps(vm, _mm_set1_ps(v_ptr0[k])));
+    if (kBatch > 1) {
+      vsum1 = _mm_add_ps(vsum1, _mm_mul_ps(vm, _mm_set1_ps(v_ptr1[k])));
+    }
+  }
+  _mm_storeu_ps(out_ptr, vsum0);
+  if (kBatch > 1) {
+    _mm_storeu_ps(out_ptr + out_stride, vsum1);
+  }
+}
+
+#define MACE_GEMM_SSE_MUL_ADD(i)                            \
+  if (kRows > i) {                                          \
+    const __m128 a = _mm_set1_ps(a_ptr[i * stride_a]);      \
+    c##i##0 = _mm_add_ps(c##i##0, _mm_mul_ps(a, b0));       \
+    c##i##1 = _mm_add_ps(c##i##1, _mm_mul_ps(a, b1));       \
+  }
+
+#define MACE_GEMM_SSE_STORE(i)                                             \
+  if (kRows > i) {                                                         \
+    float *c_ptr = C + i * stride_c;                                       \
+    _mm_storeu_ps(c_ptr, _mm_add_ps(_mm_loadu_ps(c_ptr), c##i##0));        \
+    _mm_storeu_ps(c_ptr + 4, _mm_add_ps(_mm_loadu_ps(c_ptr + 4), c##i##1)); \
+  }
+
+// C[kRows, 8] += A[kRows, K] * B[K, 8], accumulated in 12 xmm registers.
+template <int kRows>
+MACE_SSE_TARGET void GemmKernel6x8(const float *A,
+                                   const float *B,
+                                   const index_t K,
+                                   const index_t stride_a,
+                                   const index_t stride_b,
+                                   const index_t stride_c,
+                                   float *C) {
+  __m128 c00 = _mm_setzero_ps(), c01 = _mm_setzero_ps();
+  __m128 c10 = _mm_setzero_ps(), c11 = _mm_setzero_ps();
+  __m128 c20 = _mm_setzero_ps(), c21 = _mm_setzero_ps();
+  __m128 c30 = _mm_setzero_ps(), c31 = _mm_setzero_ps();
+  __m128 c40 = _mm_setzero_ps(), c41 = _mm_setzero_ps();
+  __m128 c50 = _mm_setzero_ps(), c51 = _mm_setzero_ps();
+
+  for (index_t k = 0; k < K; ++k) {
+    const float *a_ptr = A + k;
+    const float *b_ptr = B + k * stride_b;
+    const __m128 b0 = _mm_loadu_ps(b_ptr);
+    const __m128 b1 = _mm_loadu_ps(b_ptr + 4);
+    MACE_GEMM_SSE_MUL_ADD(0);
+    MACE_GEMM_SSE_MUL_ADD(1);
+    MACE_GEMM_SSE_MUL_ADD(2);
+    MACE_GEMM_SSE_MUL_ADD(3);
+    MACE_GEMM_SSE_MUL_ADD(4);
+    MACE_GEMM_SSE_MUL_ADD(5);
+  }
+
+  MACE_GEMM_SSE_STORE(0);
+  MACE_GEMM_SSE_STORE(1);
+  MACE_GEMM_SSE_STORE(2);
+  MACE_GEMM_SSE_STORE(3);
+  MACE_GEMM_SSE_STORE(4);
+  MACE_GEMM_SSE_STORE(5);
+}
+
+#undef MACE_GEMM_SSE_MUL_ADD
+#undef MACE_GEMM_SSE_STORE
+
+MACE_SSE_TARGET void GemmKernelX8(const float *A,
+                                  const float *B,
+                                  const index_t rows,
+                                  const index_t K,
+                                  const index_t stride_a,
+                                  const index_t stride_b,
+                                  const index_t stride_c,
+                                  float *C) {
+  switch (rows) {
+    case 1:
+      GemmKernel6x8<1>(A, B, K, stride_a, stride_b, stride_c, C);
+      break;
+    case 2:
+      GemmKernel6x8<2>(A, B, K, stride_a, stride_b, stride_c, C);
+      break;
+    case 3:
+      GemmKernel6x8<3>(A, B, K, stride_a, stride_b, stride_c, C);
+      break;
+    case 4:
+      GemmKernel6x8<4>(A, B, K, stride_a, stride_b, stride_c, C);
+      break;
+    case 5:
+      GemmKernel6x8<5>(A, B, K, stride_a, stride_b, stride_c, C);
+      break;
+    case 6:
+      GemmKernel6x8<6>(A, B, K, stride_a, stride_b, stride_c, C);
+      break;
+    default:
+      MACE_NOT_IMPLEMENTED;
+  }
+}
+
+// kRows x (4 * kVecs) of C from the blocks of a sparse block row, the
+// accumulators stay in registers while the blocks stream through.
+template <int kRows, int kVecs>
+MACE_SSE_TARGET void BlockSparseGemmKernel(const float *values,
+                                           const int32_t *block_col,
+                                           const index_t num_blocks,
+                                           const float *B,
+                                           const index_t stride_b,
+                                           const index_t stride_c,
+                                           float *C) {
+  __m128 vsum[kRows][kVecs];
+  for (int r = 0; r < kRows; ++r) {
+    for (int v = 0; v < kVecs; ++v) {
+      vsum[r][v] = _mm_setzero_ps();
+    }
+  }
+  for (index_t j = 0; j < num_blocks; ++j) {
+    const float *block = values + j * kRows * kSparseBlockCols;
+    const float *b_row = B + block_col[j] * stride_b;
+    for (int c = 0; c < kSparseBlockCols; ++c) {
+      __m128 vb[kVecs];
+      for (int v = 0; v < kVecs; ++v) {
+        vb[v] = _mm_loadu_ps(b_row + v * 4);
+      }
+      for (int r = 0; r < kRows; ++r) {
+        const __m128 va = _mm_set1_ps(block[r * kSparseBlockCols + c]);
+        for (int v = 0; v < kVecs; ++v) {
+          vsum[r][v] = _mm_add_ps(vsum[r][v], _mm_mul_ps(va, vb[v]));
+        }
+      }
+      b_row += stride_b;
+    }
+  }
+  for (int r = 0; r < kRows; ++r) {
+    for (int v = 0; v < kVecs; ++v) {
+      _mm_storeu_ps(C + r * stride_c + v * 4, vsum[r][v]);
+    }
+  }
+}
+
+}  // namespace
+
+MACE_SSE_TARGET void GemmTileSSE(const float *A,
+                                 const float *B,
+                                 const index_t height,
+                                 const index_t K,
+                                 const index_t width,
+                                 const index_t stride_a,
+                                 const index_t stride_b,
+                                 const index_t stride_c,
+                                 const Epilogue *epilogue,
+                                 float *C) {
+  const index_t aligned_w = width - width % kRegWidthTile;
+  for (index_t w = 0; w < aligned_w; w += kRegWidthTile) {
+    for (index_t h = 0; h < height; h += kRegHeightTile) {
+      const index_t rows = std::min<index_t>(kRegHeightTile, height - h);
+      GemmKernelX8(A + h * stride_a, B + w, rows, K, stride_a, stride_b,
+                   stride_c, C + h * stride_c + w);
+    }
+  }
+  // without masked loads, the remaining columns are done one by one
+  for (index_t h = 0; h < height; ++h) {
+    for (index_t w = aligned_w; w < width; ++w) {
+      float sum = 0;
+      for (index_t k = 0; k < K; ++k) {
+        sum += A[h * stride_a + k] * B[k * stride_b + w];
+      }
+      C[h * stride_c + w] += sum;
+    }
+  }
+  // the tile is still in cache
+  if (epilogue != nullptr) {
+    ApplyEpilogue(*epilogue, height, width, stride_c, C);
+  }
+}
+
+MACE_SSE_TARGET void GemvSSE(const float *m_ptr,
+                             const float *v_ptr,
+                             const index_t batch,
+                             const index_t width,
+                             const index_t height,
+                             const Epilogue *epilogue,
+                             float *out_ptr) {
+  const index_t aligned_w = width - width % 4;
+
+#pragma omp parallel for collapse(2)
+  for (index_t b = 0; b < batch; ++b) {
+    for (index_t h = 0; h < height; h += 4) {
+      const float *v_ptr0 = v_ptr + b * width;
+      float *out_ptr0 = out_ptr + b * height + h;
+      const index_t rows = std::min<index_t>(4, height - h);
+      for (index_t hh = 0; hh < rows; ++hh) {
+        const float *m_ptr0 = m_ptr + (h + hh) * width;
+        __m128 vsum0 = _mm_setzero_ps();
+        for (index_t w = 0; w < aligned_w; w += 4) {
+          vsum0 = _mm_add_ps(vsum0, _mm_mul_ps(_mm_loadu_ps(m_ptr0 + w),
+                                               _mm_loadu_ps(v_ptr0 + w)));
+        }
+        float sum = HorizontalSum(vsum0);
+        for (index_t w = aligned_w; w < width; ++w) {
+          sum += m_ptr0[w] * v_ptr0[w];
+        }
+        out_ptr0[hh] =
+            epilogue == nullptr ? sum : ApplyEpilogue(*epilogue, h + hh, sum);
+      }
+    }  // h
+  }    // b
+}
+
+MACE_SSE_TARGET void SkinnyGemmSSE(const float *m_ptr,
+                                   const float *v_ptr,
+                                   const index_t batch,
+                                   const index_t K,
+                                   const index_t height,
+                                   const index_t stride,
+                                   const index_t out_stride,
+                                   float *out_ptr) {
+  const index_t aligned_k = K - K % 4;
+  index_t h = 0;
+  // 4 rows stay in L1 while they are multiplied by the whole batch
+  for (; h + 3 < height; h += 4) {
+    const float *m_rows = m_ptr + h * stride;
+    index_t b = 0;
+    for (; b + 1 < batch; b += 2) {
+      SkinnyGemmKernel4<2>(m_rows, v_ptr + b * stride, K, stride, out_stride,
+                           out_ptr + b * out_stride + h);
+    }
+    if (b < batch) {
+      SkinnyGemmKernel4<1>(m_rows, v_ptr + b * stride, K, stride, out_stride,
+                           out_ptr + b * out_stride + h);
+    }
+  }
+  for (; h < height; ++h) {
+    const float *m_row = m_ptr + h * stride;
+    for (index_t b = 0; b < batch; ++b) {
+      const float *v_row = v_ptr + b * stride;
+      __m128 vsum = _mm_setzero_ps();
+      for (index_t k = 0; k < aligned_k; k += 4) {
+        vsum = _mm_add_ps(vsum, _mm_mul_ps(_mm_loadu_ps(m_row + k),
+                                           _mm_loadu_ps(v_row + k)));
+      }
+      float sum = HorizontalSum(vsum);
+      for (index_t k = aligned_k; k < K; ++k) {
+        sum += m_row[k] * v_row[k];
+      }
+      out_ptr[b * out_stride + h] = sum;
+    }
+  }
+}
+
+MACE_SSE_TARGET void BlockSparseGemmSSE(const float *values,
+                                        const int32_t *block_col,
+                                        const index_t num_blocks,
+                                        const index_t block_rows,
+                                        const float *B,
+                                        const index_t width,
+                                        const index_t stride_b,
+                                        const index_t stride_c,
+                                        float *C) {
+  index_t w = 0;
+  if (block_rows == 4) {
+    for (; w + 7 < width; w += 8) {
+      BlockSparseGemmKernel<4, 2>(values, block_col, num_blocks, B + w,
+                                  stride_b, stride_c, C + w);
+    }
+  } else {
+    for (; w + 15 < width; w += 16) {
+      BlockSparseGemmKernel<1, 4>(values, block_col, num_blocks, B + w,
+                                  stride_b, stride_c, C + w);
+    }
+  }
+  for (; w + 3 < width; w += 4) {
+    if (block_rows == 4) {
+      BlockSparseGemmKernel<4, 1>(values, block_col, num_blocks, B + w,
+                                  stride_b, stride_c, C + w);
+    } else {
+      BlockSparseGemmKernel<1, 1>(values, block_col, num_blocks, B + w,
+                                  stride_b, stride_c, C + w);
+    }
+  }
+  if (w < width) {
+    BlockSparseGemmDefault(values, block_col, num_blocks, block_rows, B + w,
+                           width - w, stride_b, stride_c, C + w);
+  }
+}
+
+MACE_SSE_TARGET void BlockSparseGemvSSE(const float *values,
+                                        const int32_t *block_col,
+                                        const index_t num_blocks,
+                                        const index_t block_rows,
+                                        const float *v,
+                                        float *out) {
+  if (block_rows == 4) {
+    __m128 vsum0 = _mm_setzero_ps();
+    __m128 vsum1 = _mm_setzero_ps();
+    __m128 vsum2 = _mm_setzero_ps();
+    __m128 vsum3 = _mm_setzero_ps();
+    for (index_t j = 0; j < num_blocks; ++j) {
+      const float *block = values + j * 16;
+      const __m128 vv = _mm_loadu_ps(v + block_col[j]);
+      vsum0 = _mm_add_ps(vsum0, _mm_mul_ps(_mm_loadu_ps(block), vv));
+      vsum1 = _mm_add_ps(vsum1, _mm_mul_ps(_mm_loadu_ps(block + 4), vv));
+      vsum2 = _mm_add_ps(vsum2, _mm_mul_ps(_mm_loadu_ps(block + 8), vv));
+      vsum3 = _mm_add_ps(vsum3, _mm_mul_ps(_mm_loadu_ps(block + 12), vv));
+    }
+    _mm_storeu_ps(out, HorizontalSum4(vsum0, vsum1, vsum2, vsum3));
+  } else {
+    // two chains hide the latency of the adds
+    __m128 vsum0 = _mm_setzero_ps();
+    __m128 vsum1 = _mm_setzero_ps();
+    index_t j = 0;
+    for (; j + 1 < num_blocks; j += 2) {
+      vsum0 = _mm_add_ps(vsum0, _mm_mul_ps(_mm_loadu_ps(values + j * 4),
+                                           _mm_loadu_ps(v + block_col[j])));
+      vsum1 = _mm_add_ps(vsum1,
+                         _mm_mul_ps(_mm_loadu_ps(values + j * 4 + 4),
+                                    _mm_loadu_ps(v + block_col[j + 1])));
+    }
+    if (j < num_blocks) {
+      vsum0 = _mm_add_ps(vsum0, _mm_mul_ps(_mm_loadu_ps(values + j * 4),
+                                           _mm_loadu_ps(v + block_col[j])));
+    }
+    out[0] = HorizontalSum(_mm_add_ps(vsum0, vsum1));
+  }
+}
+
+}  // namespace kernels
+}  // namespace mace
+
+#undef MACE_SSE_TARGET
+
+#endif  // __x86_64__ || __i386__
@@ -0,0 +1,81 @@
+// Copyright 2018 Xiaomi, Inc.  All rights reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+#ifndef MACE_KERNELS_X86_GEMM_SSE_H_
+#define MACE_KERNELS_X86_GEMM_SSE_H_
+
+#include "mace/core/types.h"
+#include "mace/kernels/epilogue.h"
+
+namespace mace {
+namespace kernels {
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Same as GemmTileAVX2 with 6x8 register blocks, for hosts without AVX.
+void GemmTileSSE(const float *A,
+                 const float *B,
+                 const index_t height,
+                 const index_t K,
+                 const index_t width,
+                 const index_t stride_a,
+                 const index_t stride_b,
+                 const index_t stride_c,
+                 const Epilogue *epilogue,
+                 float *C);
+
+void GemvSSE(const float *m_ptr,
+             const float *v_ptr,
+             const index_t batch,
+             const index_t width,
+             const index_t height,
+             const Epilogue *epilogue,
+             float *out_ptr);
+
+void SkinnyGemmSSE(const float *m_ptr,
+                   const float *v_ptr,
+                   const index_t batch,
+                   const index_t K,
+                   const index_t height,
+                   const index_t stride,
+                   const index_t out_stride,
+                   float *out_ptr);
+
+// BlockSparseGemmFunc in cpu_dispatch.h, C is computed 8 (4 rows) or 16
+// (1 row) columns at a time
+void BlockSparseGemmSSE(const float *values,
+                        const int32_t *block_col,
+                        const index_t num_blocks,
+                        const index_t block_rows,
+                        const float *B,
+                        const index_t width,
+                        const index_t stride_b,
+                        const index_t stride_c,
+                        float *C);
+
+// BlockSparseGemvFunc in cpu_dispatch.h, a block row of 4 x 4 blocks is
+// reduced by HorizontalSum4
+void BlockSparseGemvSSE(const float *values,
+                        const int32_t *block_col,
+                        const index_t num_blocks,
+                        const index_t block_rows,
+                        const float *v,
+                        float *out);
+
+#endif  // __x86_64__ || __i386__
+
+}  // namespace kernels
+}  // namespace mace
+
+#endif  // MACE_KERNELS_X86_GEMM_SSE_H_
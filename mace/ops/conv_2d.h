@@ -17,6 +17,7 @@
 
 #include <memory>
 #include <string>
+#include <vector>
 
 #include "mace/core/operator.h"
 #include "mace/kernels/conv_2d.h"
@@ -50,6 +51,18 @@ class Conv2dOp : public ConvPool2dOpBase<D, T> {
     return functor_(input, filter, bias, output, future);
   }
 
+  MaceStatus Prepare() override {
+    const OperatorDef &op_def = OperatorBase::debug_def();
+    std::vector<index_t> output_shape;
+    if (op_def.output_shape_size() > 0) {
+      output_shape.assign(op_def.output_shape(0).dims().begin(),
+                          op_def.output_shape(0).dims().end());
+    }
+    return functor_.Prepare(
+        this->Input(FILTER), output_shape,
+        OperatorBase::GetOptionalArg<int>("sparse_block_rows", 0));
+  }
+
  private:
   kernels::Conv2dFunctor<D, T> functor_;
 
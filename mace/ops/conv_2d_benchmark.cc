@@ -35,7 +35,8 @@ void Conv2d(int iters,
             int stride,
             int dilation,
             Padding padding,
-            int output_channels) {
+            int output_channels,
+            const char *activation = "NOOP") {
   mace::testing::StopTiming();
 
   OpsTestNet net;
@@ -62,6 +63,7 @@ void Conv2d(int iters,
       .AddIntsArg("strides", {stride, stride})
       .AddIntArg("padding", padding)
       .AddIntsArg("dilations", {dilation, dilation})
+      .AddStringArg("activation", activation)
       .AddIntArg("T", static_cast<int>(DataTypeToEnum<T>::value))
       .Finalize(net.NewOperatorDef());
   } else if (D == DeviceType::GPU) {
@@ -86,6 +88,10 @@ void Conv2d(int iters,
   }
 
   net.Setup(D);
+  if (D == DeviceType::CPU) {
+    // the filter is packed ahead of the runs, like a model's
+    net.Prepare();
+  }
 
   // Warm-up
   for (int i = 0; i < 2; ++i) {
@@ -137,6 +143,23 @@ void Conv2d(int iters,
   MACE_BM_CONV_2D_MACRO(N, C, H, W, KH, KW, S, D, P, OC, float, GPU);    \
   MACE_BM_CONV_2D_MACRO(N, C, H, W, KH, KW, S, D, P, OC, half, GPU);
 
+// The bias and activation fused into the kernels, CPU only
+#define MACE_BM_CONV_2D_ACT(N, C, H, W, KH, KW, STRIDE, P, OC, ACT)           \
+  static void                                                                 \
+      MACE_BM_CONV_2D_##N##_##C##_##H##_##W##_K##KH##x##KW##S##STRIDE##_##P\
+        ##_##OC##_##ACT##_float_CPU(int iters) {                              \
+    const int64_t tot = static_cast<int64_t>(iters) * N * C * H * W;          \
+    const int64_t macc = static_cast<int64_t>(iters) * N * OC * H * W         \
+        * (KH * KW * C + 1) / (STRIDE * STRIDE);                              \
+    mace::testing::MaccProcessed(macc);                                       \
+    mace::testing::BytesProcessed(tot *(sizeof(float)));                      \
+    Conv2d<CPU, float>(iters, N, C, H, W, KH, KW, STRIDE, 1,                  \
+                       mace::Padding::P, OC, #ACT);                           \
+  }                                                                           \
+  MACE_BENCHMARK(                                                             \
+      MACE_BM_CONV_2D_##N##_##C##_##H##_##W##_K##KH##x##KW##S##STRIDE##_##P\
+        ##_##OC##_##ACT##_float_CPU)
+
 
 
 // Filter sizes and data alignments
@@ -165,6 +188,10 @@ MACE_BM_CONV_2D(1, 32, 256, 256, 3, 3, 1, 4, VALID, 32);
 MACE_BM_CONV_2D(1, 128, 56, 56, 1, 1, 1, 1, SAME, 128);
 MACE_BM_CONV_2D(1, 1024, 7, 7, 1, 1, 1, 1, SAME, 1024);
 
+MACE_BM_CONV_2D_ACT(1, 128, 56, 56, 1, 1, 1, SAME, 128, RELU);
+MACE_BM_CONV_2D_ACT(1, 64, 112, 112, 3, 3, 1, SAME, 64, RELUX);
+MACE_BM_CONV_2D_ACT(1, 64, 32, 31, 7, 7, 1, SAME, 128, RELU);
+
 MACE_BM_CONV_2D(64, 32, 34, 34, 3, 3, 1, 1, VALID, 32);
 MACE_BM_CONV_2D(1, 32, 34, 34, 3, 3, 1, 1, VALID, 32);
 
@@ -180,6 +207,16 @@ MACE_BM_CONV_2D(1, 3, 128, 128, 3, 3, 1, 1, SAME, 16);
 MACE_BM_CONV_2D(1, 3, 256, 256, 3, 3, 1, 1, SAME, 16);
 MACE_BM_CONV_2D(1, 3, 64, 64, 3, 3, 1, 1, SAME, 16);
 
+// No hand-written kernel, im2col gemm
+MACE_BM_CONV_2D(1, 64, 56, 56, 1, 1, 2, 1, VALID, 128);
+MACE_BM_CONV_2D(1, 64, 56, 56, 3, 3, 1, 2, SAME, 64);
+MACE_BM_CONV_2D(1, 128, 28, 28, 3, 3, 1, 4, SAME, 128);
+MACE_BM_CONV_2D(1, 32, 64, 64, 5, 5, 2, 1, SAME, 64);
+MACE_BM_CONV_2D(1, 64, 32, 32, 3, 5, 1, 1, SAME, 64);
+MACE_BM_CONV_2D(1, 64, 32, 32, 2, 2, 2, 1, VALID, 128);
+MACE_BM_CONV_2D(1, 64, 32, 32, 3, 3, 3, 1, VALID, 64);
+MACE_BM_CONV_2D(1, 3, 227, 227, 11, 11, 4, 1, VALID, 96);
+
 }  // namespace test
 }  // namespace ops
 }  // namespace mace
@@ -1069,6 +1069,183 @@ TEST_F(Conv2dOpTest, OPENCLUnalignedPad4) {
   TestArbitraryPadConvNxN<DeviceType::GPU, float>({107, 113, 5, 7}, {4, 4});
 }
 
+namespace {
+// The winograd filter prepared ahead of the first run must give the same
+// result, even if the recorded output shape implies another tile size.
+void TestPreparedWinograd(const std::vector<index_t> &output_shape_hint) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", {1, 8, 32, 32});
+  net.AddRandomInput<DeviceType::CPU, float>("SmallInput", {1, 8, 8, 8});
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", {8, 8, 3, 3});
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {8});
+
+  auto conv = [&](const std::string &input, const std::string &output,
+                  bool prepare) {
+    OpDefBuilder("Conv2D", "Conv2DTest")
+        .Input(input)
+        .Input("Filter")
+        .Input("Bias")
+        .Output(output)
+        .OutputShape(output_shape_hint)
+        .AddIntsArg("strides", {1, 1})
+        .AddIntArg("padding", Padding::SAME)
+        .AddIntsArg("dilations", {1, 1})
+        .Finalize(net.NewOperatorDef());
+    net.Setup(DeviceType::CPU);
+    if (prepare) {
+      EXPECT_EQ(MACE_SUCCESS, net.Prepare());
+    }
+  };
+
+  conv("Input", "Expected", false);
+  net.Run();
+  conv("SmallInput", "SmallExpected", false);
+  net.Run();
+
+  conv("Input", "Output", true);
+  net.Run();
+  ExpectTensorNear<float>(*net.GetOutput("Expected"),
+                          *net.GetOutput("Output"), 1e-4, 1e-4);
+  // the input size changes, so does the tile size
+  net.ws()->GetTensor("Input")->Copy(*net.ws()->GetTensor("SmallInput"));
+  net.Run();
+  ExpectTensorNear<float>(*net.GetOutput("SmallExpected"),
+                          *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+}  // namespace
+
+TEST_F(Conv2dOpTest, CPUPreparedWinograd) {
+  TestPreparedWinograd({1, 8, 32, 32});
+  TestPreparedWinograd({1, 8, 8, 8});
+  TestPreparedWinograd({});
+}
+
+TEST_F(Conv2dOpTest, CPUPrepared1x1) {
+  // the 1x1 filter is packed for gemm ahead of the first run
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", {2, 37, 9, 11});
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", {75, 37, 1, 1});
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {75});
+
+  auto conv = [&](const std::string &output, bool prepare) {
+    OpDefBuilder("Conv2D", "Conv2DTest")
+        .Input("Input")
+        .Input("Filter")
+        .Input("Bias")
+        .Output(output)
+        .AddIntsArg("strides", {1, 1})
+        .AddIntArg("padding", Padding::VALID)
+        .AddIntsArg("dilations", {1, 1})
+        .Finalize(net.NewOperatorDef());
+    net.Setup(DeviceType::CPU);
+    if (prepare) {
+      EXPECT_EQ(MACE_SUCCESS, net.Prepare());
+    }
+    net.Run();
+  };
+
+  conv("Expected", false);
+  conv("Output", true);
+  ExpectTensorNear<float>(*net.GetOutput("Expected"),
+                          *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+
+namespace {
+// A pruned 1x1 filter runs as sparse once it is packed ahead of the first
+// run, the padded input is the one of the gemm.
+void TestSparse1x1(const std::vector<int> &paddings, int sparse_block_rows) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", {2, 37, 9, 11});
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", {64, 37, 1, 1});
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {64});
+  Tensor *filter = net.ws()->GetTensor("Filter");
+  filter->SetIsWeight(true);
+  float *filter_data = filter->mutable_data<float>();
+  for (index_t i = 0; i < filter->size(); ++i) {
+    if (i / 4 % 3 != 0) filter_data[i] = 0;
+  }
+
+  auto conv = [&](const std::string &output, int block_rows) {
+    OpDefBuilder("Conv2D", "Conv2DTest")
+        .Input("Input")
+        .Input("Filter")
+        .Input("Bias")
+        .Output(output)
+        .AddIntsArg("strides", {1, 1})
+        .AddIntsArg("padding_values", paddings)
+        .AddIntsArg("dilations", {1, 1})
+        .AddStringArg("activation", "RELUX")
+        .AddFloatArg("max_limit", 1.5f)
+        .AddIntArg("sparse_block_rows", block_rows)
+        .Finalize(net.NewOperatorDef());
+    net.Setup(DeviceType::CPU);
+    EXPECT_EQ(MACE_SUCCESS, net.Prepare());
+    net.Run();
+  };
+
+  conv("Expected", 0);
+  conv("Output", sparse_block_rows);
+  ExpectTensorNear<float>(*net.GetOutput("Expected"),
+                          *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+}  // namespace
+
+TEST_F(Conv2dOpTest, CPUSparse1x1) {
+  TestSparse1x1({0, 0}, 1);
+  TestSparse1x1({0, 0}, 4);
+  TestSparse1x1({2, 2}, 4);
+}
+
+namespace {
+// A dilated 3x3 filter, which runs as im2col gemm, is the 5x5 filter with
+// zeros between its taps, which has a hand-written kernel.
+void TestDilatedGemm(Padding padding, bool prepare) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", {2, 7, 19, 17});
+  net.AddRandomInput<DeviceType::CPU, float>("Filter", {9, 7, 3, 3});
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {9});
+  const Tensor *filter = net.ws()->GetTensor("Filter");
+  std::vector<float> dense_filter(9 * 7 * 5 * 5, 0);
+  for (index_t i = 0; i < 9 * 7; ++i) {
+    for (index_t k = 0; k < 9; ++k) {
+      dense_filter[i * 25 + k / 3 * 10 + k % 3 * 2] =
+          filter->data<float>()[i * 9 + k];
+    }
+  }
+  net.AddInputFromArray<DeviceType::CPU, float>("DenseFilter", {9, 7, 5, 5},
+                                                dense_filter);
+
+  auto conv = [&](const std::string &filter, const std::string &output,
+                  int dilation) {
+    OpDefBuilder("Conv2D", "Conv2DTest")
+        .Input("Input")
+        .Input(filter)
+        .Input("Bias")
+        .Output(output)
+        .AddIntsArg("strides", {1, 1})
+        .AddIntArg("padding", padding)
+        .AddIntsArg("dilations", {dilation, dilation})
+        .AddStringArg("activation", "RELU")
+        .Finalize(net.NewOperatorDef());
+    net.Setup(DeviceType::CPU);
+    if (prepare) {
+      EXPECT_EQ(MACE_SUCCESS, net.Prepare());
+    }
+    net.Run();
+  };
+
+  conv("DenseFilter", "Expected", 1);
+  conv("Filter", "Output", 2);
+  ExpectTensorNear<float>(*net.GetOutput("Expected"),
+                          *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+}  // namespace
+
+TEST_F(Conv2dOpTest, CPUConvGemm) {
+  TestDilatedGemm(Padding::VALID, false);
+  TestDilatedGemm(Padding::SAME, true);
+}
+
 }  // namespace test
 }  // namespace ops
 }  // namespace mace
@@ -12,6 +12,9 @@
 // See the License for the specific language governing permissions and
 // limitations under the License.
 
+#include "mace/core/runtime/cpu/cpu_runtime.h"
+#include "mace/kernels/conv_pool_2d_util.h"
+#include "mace/kernels/eltwise.h"
 #include "mace/ops/ops_test_util.h"
 
 namespace mace {
@@ -67,6 +70,111 @@ TEST(CoreTest, INIT_MODE) {
                           1e-5);
 }
 
+namespace {
+void AddBranchOperators(OpsTestNet *net, bool run_one_by_one) {
+  // Input -> Conv0 ----------> Eltwise -> Output
+  //       -> Conv1 -> Relu -->
+  std::vector<OperatorDef *> op_defs;
+  for (int i = 0; i < 2; ++i) {
+    op_defs.push_back(run_one_by_one ? net->NewOperatorDef()
+                                     : net->AddNewOperatorDef());
+    OpDefBuilder("Conv2D", MakeString("Conv", i))
+        .Input("Input")
+        .Input(MakeString("Filter", i))
+        .Input("Bias")
+        .Output(MakeString("Conv", i))
+        .AddIntsArg("strides", {1, 1})
+        .AddIntArg("padding", Padding::SAME)
+        .AddIntsArg("dilations", {1, 1})
+        .Finalize(op_defs.back());
+    if (run_one_by_one) net->RunOp(DeviceType::CPU);
+  }
+  OpDefBuilder("Activation", "Relu")
+      .Input("Conv1")
+      .Output("Relu")
+      .AddStringArg("activation", "RELU")
+      .Finalize(run_one_by_one ? net->NewOperatorDef()
+                               : net->AddNewOperatorDef());
+  if (run_one_by_one) net->RunOp(DeviceType::CPU);
+  OpDefBuilder("Eltwise", "Sum")
+      .Input("Conv0")
+      .Input("Relu")
+      .Output("Output")
+      .AddIntArg("type", static_cast<int>(kernels::EltwiseType::SUM))
+      .Finalize(run_one_by_one ? net->NewOperatorDef()
+                               : net->AddNewOperatorDef());
+  if (run_one_by_one) net->RunOp(DeviceType::CPU);
+}
+}  // namespace
+
+TEST(CoreTest, CPUParallelBranches) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", {1, 16, 32, 32}, false);
+  net.AddRandomInput<DeviceType::CPU, float>("Filter0", {16, 16, 3, 3}, false);
+  net.AddRandomInput<DeviceType::CPU, float>("Filter1", {16, 16, 3, 3}, false);
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {16}, false);
+
+  AddBranchOperators(&net, true);
+  Tensor expected;
+  expected.Copy(*net.GetOutput("Output"));
+
+  net.op_defs_.clear();
+  AddBranchOperators(&net, false);
+  net.Setup(DeviceType::CPU);
+  EXPECT_TRUE(dynamic_cast<ParallelNet *>(net.net_.get()) != nullptr);
+
+  const int num_threads = GetOpenMPNumThreads();
+  for (int threads : {1, 4}) {
+    SetOpenMPNumThreads(threads);
+    RunMetadata run_metadata;
+    EXPECT_EQ(MACE_SUCCESS, net.net_->Run(&run_metadata));
+    EXPECT_EQ(4u, run_metadata.op_stats.size());
+    EXPECT_EQ(threads, GetOpenMPNumThreads());
+    ExpectTensorNear<float>(expected, *net.GetOutput("Output"), 1e-5, 1e-4);
+  }
+  SetOpenMPNumThreads(num_threads);
+}
+
+TEST(CoreTest, OpDependencies) {
+  // op3 reuses the memory block of op0, so it must wait for op2 reading it,
+  // likewise op4 waits for op3 reading the block of op1.
+  std::vector<OperatorDef> op_defs(5);
+  const std::vector<std::vector<std::string>> inputs = {
+      {"Input"}, {"Input"}, {"T0"}, {"T1"}, {"T2", "T3"}};
+  const std::vector<int> mem_ids = {0, 1, 2, 0, 1};
+  for (int i = 0; i < 5; ++i) {
+    for (auto &input : inputs[i]) op_defs[i].add_input(input);
+    op_defs[i].add_output(MakeString("T", i));
+    op_defs[i].add_mem_id(mem_ids[i]);
+  }
+  std::vector<const OperatorDef *> op_def_ptrs;
+  for (auto &op_def : op_defs) op_def_ptrs.push_back(&op_def);
+
+  OpDependencies dependencies;
+  BuildOpDependencies(op_def_ptrs, &dependencies);
+  EXPECT_EQ(std::vector<int>({2, 3}), dependencies.consumers[0]);
+  EXPECT_EQ(std::vector<int>({3, 4}), dependencies.consumers[1]);
+  EXPECT_EQ(std::vector<int>({3, 4}), dependencies.consumers[2]);
+  EXPECT_EQ(std::vector<int>({4}), dependencies.consumers[3]);
+  EXPECT_EQ(std::vector<int>({0, 0, 1, 3, 3}), dependencies.num_producers);
+  EXPECT_EQ(std::vector<int>({0, 1, 0, 0, 0}), dependencies.lanes);
+  EXPECT_EQ(2, dependencies.num_lanes);
+}
+
+TEST(CoreTest, PartitionPipelineStages) {
+  std::vector<int> stage_begins;
+  PartitionPipelineStages({4, 1, 1, 1, 1, 4, 2, 2}, 3, &stage_begins);
+  EXPECT_EQ(std::vector<int>({0, 3, 6, 8}), stage_begins);
+
+  // one op is the bottleneck
+  PartitionPipelineStages({1, 10, 1, 1}, 2, &stage_begins);
+  EXPECT_EQ(std::vector<int>({0, 2, 4}), stage_begins);
+
+  // no more stages than ops
+  PartitionPipelineStages({3, 5}, 4, &stage_begins);
+  EXPECT_EQ(std::vector<int>({0, 1, 2}), stage_begins);
+}
+
 }  // namespace test
 }  // namespace ops
 }  // namespace mace
@@ -16,6 +16,7 @@
 #define MACE_OPS_FULLY_CONNECTED_H_
 
 #include <string>
+#include <vector>
 
 #include "mace/core/operator.h"
 #include "mace/kernels/fully_connected.h"
@@ -58,6 +59,18 @@ class FullyConnectedOp : public Operator<D, T> {
     return functor_(input, weight, bias, output, future);
   }
 
+  MaceStatus Prepare() override {
+    const OperatorDef &op_def = OperatorBase::debug_def();
+    std::vector<index_t> output_shape;
+    if (op_def.output_shape_size() > 0) {
+      output_shape.assign(op_def.output_shape(0).dims().begin(),
+                          op_def.output_shape(0).dims().end());
+    }
+    return functor_.Prepare(
+        this->Input(WEIGHT), output_shape,
+        OperatorBase::GetOptionalArg<int>("sparse_block_rows", 0));
+  }
+
  private:
   kernels::FullyConnectedFunctor<D, T> functor_;
 
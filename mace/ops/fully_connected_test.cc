@@ -101,6 +101,78 @@ TEST_F(FullyConnectedOpTest, SimpleCPUWithBatch) {
                           {1, 2, 3, 4}, {1}, {2}, {2, 1, 1, 1}, {32, 72});
 }
 
+TEST_F(FullyConnectedOpTest, CPUPreparedWithBatch) {
+  // the packed weight is used by a batched input only
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", {3, 8, 5, 5});
+  net.AddRandomInput<DeviceType::CPU, float>("Weight", {33, 8, 5, 5});
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {33});
+  net.ws()->GetTensor("Weight")->SetIsWeight(true);
+
+  auto fc = [&](const std::string &output, bool prepare) {
+    OpDefBuilder("FullyConnected", "FullyConnectedTest")
+        .Input("Input")
+        .Input("Weight")
+        .Input("Bias")
+        .Output(output)
+        .OutputShape({3, 33, 1, 1})
+        .Finalize(net.NewOperatorDef());
+    net.Setup(DeviceType::CPU);
+    if (prepare) {
+      EXPECT_EQ(MACE_SUCCESS, net.Prepare());
+    }
+    net.Run();
+  };
+
+  fc("Expected", false);
+  fc("Output", true);
+  ExpectTensorNear<float>(*net.GetOutput("Expected"),
+                          *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+
+namespace {
+// A pruned weight runs as sparse once it is packed ahead of the first run.
+void TestSparseWeight(index_t batch, index_t output_size,
+                      int sparse_block_rows) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("Input", {batch, 16, 3, 3});
+  net.AddRandomInput<DeviceType::CPU, float>("Weight",
+                                             {output_size, 16, 3, 3});
+  net.AddRandomInput<DeviceType::CPU, float>("Bias", {output_size});
+  Tensor *weight = net.ws()->GetTensor("Weight");
+  weight->SetIsWeight(true);
+  float *weight_data = weight->mutable_data<float>();
+  for (index_t i = 0; i < weight->size(); ++i) {
+    if (i / 4 % 3 != 0) weight_data[i] = 0;
+  }
+
+  auto fc = [&](const std::string &output, int block_rows) {
+    OpDefBuilder("FullyConnected", "FullyConnectedTest")
+        .Input("Input")
+        .Input("Weight")
+        .Input("Bias")
+        .Output(output)
+        .AddStringArg("activation", "RELU")
+        .AddIntArg("sparse_block_rows", block_rows)
+        .Finalize(net.NewOperatorDef());
+    net.Setup(DeviceType::CPU);
+    EXPECT_EQ(MACE_SUCCESS, net.Prepare());
+    net.Run();
+  };
+
+  fc("Expected", 0);
+  fc("Output", sparse_block_rows);
+  ExpectTensorNear<float>(*net.GetOutput("Expected"),
+                          *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+}  // namespace
+
+TEST_F(FullyConnectedOpTest, CPUSparseWeight) {
+  TestSparseWeight(1, 32, 1);
+  TestSparseWeight(1, 32, 4);
+  TestSparseWeight(20, 30, 4);
+}
+
 TEST_F(FullyConnectedOpTest, SimpleOPENCL) {
   Simple<DeviceType::GPU>({1, 2, 2, 2}, {1, 2, 3, 4, 5, 6, 7, 8}, {1, 2, 2, 2},
                           {1, 3, 5, 7, 2, 4, 6, 8}, {1}, {2}, {1, 1, 1, 1},
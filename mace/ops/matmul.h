@@ -30,19 +30,29 @@ class MatMulOp : public Operator<D, T> {
         transpose_b_(OperatorBase::GetOptionalArg<bool>("transpose_b", false)) {
   }
 
+  MaceStatus Prepare() override {
+    return functor_.Prepare(
+        this->Input(INPUT_B), transpose_b_,
+        OperatorBase::GetOptionalArg<int>("sparse_block_rows", 0));
+  }
+
   MaceStatus Run(StatsFuture *future) override {
     const Tensor *A = this->Input(INPUT_A);
     const Tensor *B = this->Input(INPUT_B);
     Tensor *C = this->Output(OUTPUT);
-    MACE_CHECK(A->dim_size() == B->dim_size() && A->dim_size() >= 2,
-               "rank(A) should be equal to rank(B), rank should be greater "
-               "than or equal to 2");
-    index_t rank = A->dim_size();
-    for (index_t i = 0; i < rank - 2; ++i) {
-      MACE_CHECK(A->dim(i) == B->dim(i), "batch dimensions are not equal");
+    MACE_CHECK(A->dim_size() >= 2 && B->dim_size() >= 2,
+               "rank of A and B should be greater than or equal to 2");
+    const index_t a_rank = A->dim_size();
+    const index_t b_rank = B->dim_size();
+    if (D == DeviceType::GPU) {
+      MACE_CHECK(a_rank == b_rank, "rank(A) should be equal to rank(B)");
+      for (index_t i = 0; i < a_rank - 2; ++i) {
+        MACE_CHECK(A->dim(i) == B->dim(i), "batch dimensions are not equal");
+      }
     }
-    index_t ak = transpose_a_ ? A->dim(rank - 2) : A->dim(rank - 1);
-    index_t bk = transpose_b_ ? B->dim(rank - 1) : B->dim(rank - 2);
+    // the batch dims of CPU are broadcast, see kernels::BroadcastMatMulBatch
+    index_t ak = transpose_a_ ? A->dim(a_rank - 2) : A->dim(a_rank - 1);
+    index_t bk = transpose_b_ ? B->dim(b_rank - 1) : B->dim(b_rank - 2);
     MACE_CHECK(ak == bk, "the number of A's column ", ak,
                " must be equal to B's row ", bk);
 
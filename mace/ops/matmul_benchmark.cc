@@ -13,6 +13,7 @@
 // limitations under the License.
 
 #include <string>
+#include <vector>
 
 #include "mace/core/operator.h"
 #include "mace/core/testing/test_benchmark.h"
@@ -100,6 +101,38 @@ void MatMulTransposeBenchmark(
   }
   net.Sync();
 }
+
+// The batch dims of A and B are broadcast, e.g., the keys shared by the
+// heads of multi-query attention or a weight shared by the batch.
+void MatMulBroadcastBenchmark(int iters,
+                              const std::vector<index_t> &a_shape,
+                              const std::vector<index_t> &b_shape,
+                              bool transpose_b) {
+  mace::testing::StopTiming();
+
+  OpsTestNet net;
+
+  // Add input data
+  net.AddRandomInput<DeviceType::CPU, float>("A", a_shape);
+  net.AddRandomInput<DeviceType::CPU, float>("B", b_shape);
+
+  OpDefBuilder("MatMul", "MatMulBM")
+      .Input("A")
+      .Input("B")
+      .AddIntArg("transpose_b", transpose_b ? 1 : 0)
+      .Output("Output")
+      .Finalize(net.NewOperatorDef());
+
+  // Warm-up
+  for (int i = 0; i < 5; ++i) {
+    net.RunOp(DeviceType::CPU);
+  }
+
+  mace::testing::StartTiming();
+  while (iters--) {
+    net.RunOp(DeviceType::CPU);
+  }
+}
 }  // namespace
 
 #define MACE_BM_MATMUL_MACRO(N, H, C, W, TYPE, DEVICE)                         \
@@ -146,6 +179,51 @@ MACE_BM_MATMUL_TRANPOSE(16, 128, 128, 49);
 MACE_BM_MATMUL_TRANPOSE(16, 128, 128, 961);
 MACE_BM_MATMUL_TRANPOSE(16, 128, 128, 3969);
 
+// Attention of HEADS heads over S positions of D channels whose keys and
+// values are shared by the heads (Broadcast) or repeated for each (Tiled),
+// i.e., Q * K^T and the attention times V.
+#define MACE_BM_MATMUL_HEADS_MACRO(N, HEADS, S, D, MODE, B_HEADS)              \
+  static void MACE_BM_MATMUL_HEADS_##N##_##HEADS##_##S##_##D##_##MODE(         \
+      int iters) {                                                             \
+    const int64_t macc = static_cast<int64_t>(iters) * N * HEADS * S * S * D;  \
+    const int64_t tot = static_cast<int64_t>(iters) * N * HEADS * S * S;       \
+    mace::testing::MaccProcessed(macc * 2);                                    \
+    mace::testing::BytesProcessed(tot *(sizeof(float)));                       \
+    MatMulBroadcastBenchmark(iters, {N, HEADS, S, D}, {N, B_HEADS, S, D},      \
+                             true);                                            \
+    MatMulBroadcastBenchmark(iters, {N, HEADS, S, S}, {N, B_HEADS, S, D},      \
+                             false);                                           \
+  }                                                                            \
+  MACE_BENCHMARK(MACE_BM_MATMUL_HEADS_##N##_##HEADS##_##S##_##D##_##MODE)
+
+#define MACE_BM_MATMUL_HEADS(N, HEADS, S, D)                 \
+  MACE_BM_MATMUL_HEADS_MACRO(N, HEADS, S, D, Broadcast, 1);  \
+  MACE_BM_MATMUL_HEADS_MACRO(N, HEADS, S, D, Tiled, HEADS)
+
+// The projection of the N x S positions of C channels by a weight shared by
+// the batch (Broadcast) or repeated for each batch (Tiled).
+#define MACE_BM_MATMUL_SHARED_MACRO(N, S, C, W, MODE, ...)                     \
+  static void MACE_BM_MATMUL_SHARED_##N##_##S##_##C##_##W##_##MODE(            \
+      int iters) {                                                             \
+    const int64_t macc = static_cast<int64_t>(iters) * N * S * C * W;          \
+    const int64_t tot = static_cast<int64_t>(iters) * N * (S * C + S * W);     \
+    mace::testing::MaccProcessed(macc);                                        \
+    mace::testing::BytesProcessed(tot *(sizeof(float)));                       \
+    MatMulBroadcastBenchmark(iters, {N, S, C}, {__VA_ARGS__}, false);          \
+  }                                                                            \
+  MACE_BENCHMARK(MACE_BM_MATMUL_SHARED_##N##_##S##_##C##_##W##_##MODE)
+
+#define MACE_BM_MATMUL_SHARED(N, S, C, W)                    \
+  MACE_BM_MATMUL_SHARED_MACRO(N, S, C, W, Broadcast, C, W);  \
+  MACE_BM_MATMUL_SHARED_MACRO(N, S, C, W, Tiled, N, C, W)
+
+MACE_BM_MATMUL_HEADS(1, 8, 128, 64);
+MACE_BM_MATMUL_HEADS(1, 12, 128, 64);
+MACE_BM_MATMUL_HEADS(4, 12, 128, 64);
+
+MACE_BM_MATMUL_SHARED(8, 128, 768, 768);
+MACE_BM_MATMUL_SHARED(4, 128, 512, 2048);
+
 }  // namespace test
 }  // namespace ops
 }  // namespace mace
@@ -13,8 +13,11 @@
 // limitations under the License.
 
 #include <fstream>
+#include <functional>
+#include <numeric>
 
 #include "mace/core/operator.h"
+#include "mace/kernels/gemm.h"
 #include "mace/ops/ops_test_util.h"
 
 namespace mace {
@@ -90,6 +93,147 @@ TEST_F(MatMulOpTest, SimpleCPUWithBatch) {
                           {2, 2, 2}, {22, 28, 49, 64, 22, 28, 49, 64});
 }
 
+namespace {
+// A constant B is packed once when the op is prepared, in sparse blocks of
+// sparse_block_rows rows if not 0, in which case most of B is pruned.
+void TestPreparedConstB(const std::vector<index_t> &A_shape,
+                        const std::vector<index_t> &B_shape,
+                        bool transpose_b,
+                        int sparse_block_rows = 0) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("A", A_shape);
+  net.AddRandomInput<DeviceType::CPU, float>("B", B_shape);
+  Tensor *B = net.ws()->GetTensor("B");
+  B->SetIsWeight(true);
+  if (sparse_block_rows > 0) {
+    float *b_data = B->mutable_data<float>();
+    for (index_t i = 0; i < B->size(); ++i) {
+      if (i / 5 % 4 != 0) b_data[i] = 0;
+    }
+  }
+
+  auto matmul = [&](const std::string &output, bool prepare) {
+    OpDefBuilder("MatMul", "MatMulTest")
+        .Input("A")
+        .Input("B")
+        .Output(output)
+        .AddIntArg("transpose_b", transpose_b ? 1 : 0)
+        .AddIntArg("sparse_block_rows", prepare ? sparse_block_rows : 0)
+        .Finalize(net.NewOperatorDef());
+    net.Setup(DeviceType::CPU);
+    if (prepare) {
+      EXPECT_EQ(MACE_SUCCESS, net.Prepare());
+    }
+    net.Run();
+  };
+
+  matmul("Expected", false);
+  matmul("Output", true);
+  ExpectTensorNear<float>(*net.GetOutput("Expected"),
+                          *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+}  // namespace
+
+TEST_F(MatMulOpTest, CPUPreparedConstB) {
+  TestPreparedConstB({1, 7, 300}, {1, 300, 130}, false);
+  TestPreparedConstB({2, 80, 31}, {2, 129, 31}, true);
+  // a weight shared by the batch
+  TestPreparedConstB({3, 7, 300}, {300, 130}, false);
+  TestPreparedConstB({2, 3, 20, 31}, {1, 129, 31}, true);
+  TestPreparedConstB({4, 2, 50, 31}, {4, 1, 31, 129}, false);
+}
+
+TEST_F(MatMulOpTest, CPUSparseConstB) {
+  TestPreparedConstB({1, 7, 300}, {1, 300, 130}, false, 1);
+  TestPreparedConstB({1, 20, 31}, {1, 128, 31}, true, 4);
+  // 130 rows of B^T fall back to 1 x 4 blocks
+  TestPreparedConstB({1, 3, 64}, {1, 130, 64}, true, 4);
+  TestPreparedConstB({2, 3, 20, 31}, {128, 31}, true, 4);
+}
+
+namespace {
+// Tiles the batches of input to batch_shape, as broadcast by MatMul.
+std::vector<float> TileBatch(const Tensor &input,
+                             const std::vector<index_t> &batch_shape) {
+  const index_t rank = input.dim_size();
+  const index_t offset = batch_shape.size() + 2 - rank;
+  const index_t matrix_size = input.dim(rank - 2) * input.dim(rank - 1);
+  const index_t batch =
+      std::accumulate(batch_shape.begin(), batch_shape.end(), index_t(1),
+                      std::multiplies<index_t>());
+  const float *input_data = input.data<float>();
+  std::vector<float> tiled;
+  std::vector<index_t> index(batch_shape.size(), 0);
+  for (index_t n = 0; n < batch; ++n) {
+    index_t input_n = 0;
+    for (index_t i = 0; i < rank - 2; ++i) {
+      const index_t dim = input.dim(i);
+      input_n = input_n * dim + (dim == 1 ? 0 : index[i + offset]);
+    }
+    tiled.insert(tiled.end(), input_data + input_n * matrix_size,
+                 input_data + (input_n + 1) * matrix_size);
+    for (index_t i = batch_shape.size(); i-- > 0;) {
+      if (++index[i] < batch_shape[i]) break;
+      index[i] = 0;
+    }
+  }
+  return tiled;
+}
+
+// The batch dims of A and B broadcast to batch_shape, compared with the
+// reference gemm of A and B tiled to it.
+void TestBroadcast(const std::vector<index_t> &A_shape,
+                   const std::vector<index_t> &B_shape,
+                   const std::vector<index_t> &batch_shape,
+                   bool transpose_a,
+                   bool transpose_b) {
+  OpsTestNet net;
+  net.AddRandomInput<DeviceType::CPU, float>("A", A_shape);
+  net.AddRandomInput<DeviceType::CPU, float>("B", B_shape);
+
+  OpDefBuilder("MatMul", "MatMulTest")
+      .Input("A")
+      .Input("B")
+      .Output("Output")
+      .AddIntArg("transpose_a", transpose_a ? 1 : 0)
+      .AddIntArg("transpose_b", transpose_b ? 1 : 0)
+      .Finalize(net.NewOperatorDef());
+  net.RunOp(DeviceType::CPU);
+
+  const index_t a_rank = A_shape.size();
+  const index_t b_rank = B_shape.size();
+  const index_t height = A_shape[a_rank - (transpose_a ? 1 : 2)];
+  const index_t K = A_shape[a_rank - (transpose_a ? 2 : 1)];
+  const index_t width = B_shape[b_rank - (transpose_b ? 2 : 1)];
+  const index_t batch =
+      std::accumulate(batch_shape.begin(), batch_shape.end(), index_t(1),
+                      std::multiplies<index_t>());
+  const std::vector<float> A = TileBatch(*net.GetTensor("A"), batch_shape);
+  const std::vector<float> B = TileBatch(*net.GetTensor("B"), batch_shape);
+  std::vector<float> C(batch * height * width);
+  kernels::GemmRef(A.data(), B.data(), batch, height, K, width, C.data(),
+                   transpose_a, transpose_b);
+  std::vector<index_t> C_shape(batch_shape);
+  C_shape.push_back(height);
+  C_shape.push_back(width);
+  auto expected = CreateTensor<float>(C_shape, C);
+  ExpectTensorNear<float>(*expected, *net.GetOutput("Output"), 1e-4, 1e-4);
+}
+}  // namespace
+
+TEST_F(MatMulOpTest, CPUBroadcastBatch) {
+  TestBroadcast({2, 3, 5, 7}, {1, 7, 4}, {2, 3}, false, false);
+  TestBroadcast({1, 5, 7}, {3, 7, 4}, {3}, false, false);
+  TestBroadcast({2, 1, 5, 7}, {1, 3, 7, 40}, {2, 3}, false, false);
+  TestBroadcast({4, 5, 7}, {7, 4}, {4}, false, false);
+  TestBroadcast({5, 7}, {2, 2, 7, 4}, {2, 2}, false, false);
+  // skinny per batch
+  TestBroadcast({2, 3, 5, 37}, {2, 1, 40, 37}, {2, 3}, false, true);
+  TestBroadcast({3, 30, 37}, {1, 40, 37}, {3}, false, true);
+  TestBroadcast({2, 1, 7, 5}, {1, 3, 7, 20}, {2, 3}, true, false);
+  TestBroadcast({3, 1, 37, 20}, {4, 40, 37}, {3, 4}, true, true);
+}
+
 TEST_F(MatMulOpTest, SimpleOPENCL) {
   Simple<DeviceType::GPU>({1, 2, 3}, {1, 2, 3, 4, 5, 6}, {1, 3, 2},
                           {1, 2, 3, 4, 5, 6}, {1, 2, 2}, {22, 28, 49, 64});
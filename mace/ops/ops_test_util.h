@@ -52,6 +52,14 @@ class OpDefBuilder {
     return *this;
   }
 
+  OpDefBuilder &OutputShape(const std::vector<index_t> &output_shape) {
+    auto shape = op_def_.add_output_shape();
+    for (auto dim : output_shape) {
+      shape->add_dims(dim);
+    }
+    return *this;
+  }
+
   OpDefBuilder &OutputType(const std::vector<DataType> &output_type) {
     for (auto out_t : output_type) {
       op_def_.add_output_type(out_t);
@@ -361,6 +369,11 @@ class OpsTestNet {
     return net_->Run();
   }
 
+  MaceStatus Prepare() {
+    MACE_CHECK_NOTNULL(net_);
+    return net_->Prepare();
+  }
+
   // DEPRECATED(liyin):
   // Test and benchmark should setup model once and run multiple times.
   // Setup time should not be counted during benchmark.
@@ -83,6 +83,37 @@ void BMWinogradConvolution(
   }
   net.Sync();
 }
+
+// The CPU Conv2D picks Winograd by itself for 3x3 stride 1 convolutions of at
+// least 8 channels, with 6x6 output tiles for inputs larger than 16x16.
+void BMWinogradConvolutionCPU(int iters, int batch, int height, int width,
+                              int in_channels, int out_channels) {
+  mace::testing::StopTiming();
+  OpsTestNet net;
+  net.AddRandomInput<CPU, float>("Input",
+                                 {batch, in_channels, height, width});
+  net.AddRandomInput<CPU, float>("Filter", {out_channels, in_channels, 3, 3});
+  net.AddRandomInput<CPU, float>("Bias", {out_channels});
+
+  OpDefBuilder("Conv2D", "Conv2dTest")
+      .Input("Input")
+      .Input("Filter")
+      .Input("Bias")
+      .Output("Output")
+      .AddIntsArg("strides", {1, 1})
+      .AddIntArg("padding", Padding::SAME)
+      .AddIntsArg("dilations", {1, 1})
+      .Finalize(net.NewOperatorDef());
+  net.Setup(CPU);
+  // Warm-up
+  for (int i = 0; i < 2; ++i) {
+    net.Run();
+  }
+  mace::testing::StartTiming();
+  while (iters--) {
+    net.Run();
+  }
+}
 }  // namespace
 
 #define MACE_BM_WINOGRAD_CONV_MACRO(N, H, W, IC, OC, M, TYPE, DEVICE)          \
@@ -116,6 +147,27 @@ MACE_BM_WINOGRAD_CONV(1, 56, 56, 256, 256, 4);
 MACE_BM_WINOGRAD_CONV(1, 128, 128, 128, 256, 2);
 MACE_BM_WINOGRAD_CONV(1, 128, 128, 128, 256, 4);
 
+#define MACE_BM_WINOGRAD_CONV_CPU(N, H, W, IC, OC)                             \
+  static void MACE_BM_WINOGRAD_CONV_##N##_##H##_##W##_##IC##_##OC##_float_CPU(\
+      int iters) {                                                             \
+    const int64_t tot = static_cast<int64_t>(iters) * N * IC * H * W;          \
+    const int64_t macc =                                                       \
+        static_cast<int64_t>(iters) * N * OC * H * W * (3 * 3 * IC + 1);       \
+    mace::testing::MaccProcessed(macc);                                        \
+    mace::testing::BytesProcessed(tot *(sizeof(float)));                       \
+    BMWinogradConvolutionCPU(iters, N, H, W, IC, OC);                          \
+  }                                                                            \
+  MACE_BENCHMARK(                                                              \
+      MACE_BM_WINOGRAD_CONV_##N##_##H##_##W##_##IC##_##OC##_float_CPU)
+
+// Low channel layers spend most of the time outside the gemm
+MACE_BM_WINOGRAD_CONV_CPU(1, 16, 16, 16, 16);
+MACE_BM_WINOGRAD_CONV_CPU(1, 64, 64, 16, 16);
+MACE_BM_WINOGRAD_CONV_CPU(8, 16, 16, 16, 16);
+MACE_BM_WINOGRAD_CONV_CPU(8, 32, 32, 32, 32);
+MACE_BM_WINOGRAD_CONV_CPU(1, 56, 56, 64, 64);
+MACE_BM_WINOGRAD_CONV_CPU(4, 28, 28, 128, 128);
+
 }  // namespace test
 }  // namespace ops
 }  // namespace mace
@@ -114,6 +114,23 @@ class MaceEngine {
                  std::map<std::string, MaceTensor> *outputs,
                  RunMetadata *run_metadata);
 
+  // Split batched inputs into sub-batches run concurrently by num_groups
+  // groups of the current cpus, each with its own activations. Only for
+  // initialized CPU engines, num_groups <= 1 disables it.
+  MaceStatus SetBatchSplit(int num_groups);
+
+  // Pipelined execution of a stream of frames on an initialized CPU engine.
+  // The ops are divided into num_stages stages balanced by the op times in
+  // run_metadata, estimated if it is null, each on its own core group. Each
+  // frame in flight has its own activations.
+  MaceStatus StartPipeline(int num_stages, const RunMetadata *run_metadata);
+  // Blocks while num_stages frames are in flight.
+  MaceStatus PushInput(const std::map<std::string, MaceTensor> &inputs);
+  // Blocks until the oldest pushed frame is done, to be called by one
+  // thread at a time.
+  MaceStatus PullOutput(std::map<std::string, MaceTensor> *outputs);
+  MaceStatus StopPipeline();
+
  private:
   class Impl;
   std::unique_ptr<Impl> impl_;
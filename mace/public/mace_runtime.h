@@ -45,6 +45,12 @@ enum CPUAffinityPolicy {
   AFFINITY_NONE = 0,
   AFFINITY_BIG_ONLY = 1,
   AFFINITY_LITTLE_ONLY = 2,
+  // One logical CPU per physical core, i.e., SMT siblings are excluded.
+  AFFINITY_PHYSICAL_CORES_ONLY = 3,
+  // Physical cores sharing the largest last level cache domain.
+  AFFINITY_SINGLE_LLC = 4,
+  // Physical cores of the NUMA node with the most cores.
+  AFFINITY_SINGLE_NUMA_NODE = 5,
 };
 
 class KVStorage {
@@ -97,17 +103,26 @@ void SetGPUHints(GPUPerfHint perf_hint, GPUPriorityHint priority_hint);
 //
 // num_threads_hint is only a hint. When num_threads_hint is zero or negative,
 // the function will set the threads number equaling to the number of
-// big (AFFINITY_BIG_ONLY), little (AFFINITY_LITTLE_ONLY) or all
-// (AFFINITY_NONE) cores according to the policy. The threads number will
-// also be truncated to the corresponding cores number when num_threads_hint
-// is larger than it.
+// big (AFFINITY_BIG_ONLY), little (AFFINITY_LITTLE_ONLY), selected
+// (AFFINITY_PHYSICAL_CORES_ONLY, AFFINITY_SINGLE_LLC,
+// AFFINITY_SINGLE_NUMA_NODE) or all (AFFINITY_NONE) cores according to the
+// policy. The threads number will also be truncated to the corresponding
+// cores number when num_threads_hint is larger than it.
 //
-// The OpenMP threads will be bind to (via sched_setaffinity) big cores
-// (AFFINITY_BIG_ONLY) and little cores (AFFINITY_LITTLE_ONLY).
+// The OpenMP threads and the calling thread will be bind to (via
+// sched_setaffinity) the cores selected by the policy. With
+// AFFINITY_SINGLE_NUMA_NODE, their preferred memory node is also set to the
+// selected node (via set_mempolicy), so the buffers they allocate afterwards
+// are placed on it. Model weights mapped from file are not migrated.
+//
+// The topology aware policies are derived from
+// /sys/devices/system/cpu/cpu*/topology, /sys/devices/system/cpu/cpu*/cache
+// and /sys/devices/system/node, which target x86 and ARM servers where all
+// cores share the same max frequency.
 //
 // If successful, it returns MACE_SUCCESS and error if it can't reliabley
-// detect big-LITTLE cores (see GetBigLittleCoreIDs). In such cases, it's
-// suggested to use AFFINITY_NONE to use all cores.
+// detect big-LITTLE cores (see GetBigLittleCoreIDs) or CPU topology. In such
+// cases, it's suggested to use AFFINITY_NONE to use all cores.
 MaceStatus SetOpenMPThreadPolicy(int num_threads_hint,
                                  CPUAffinityPolicy policy);
 
@@ -132,6 +147,25 @@ void SetOpenMPThreadAffinity(int num_threads, const std::vector<int> &cpu_ids);
 MaceStatus GetBigLittleCoreIDs(std::vector<int> *big_core_ids,
                                std::vector<int> *little_core_ids);
 
+// Get the CPU cores selected by the affinity policy.
+//
+// cpu_ids will be filled with the selected core ids and topology_info (if not
+// null) with a human readable summary of the detected CPU topology, e.g.,
+// "16 logical CPUs, 8 physical cores, 2 LLC domains, 1 NUMA nodes".
+//
+// If successful, it returns MACE_SUCCESS and error if it can't reliabley
+// detect the CPU topology required by the policy.
+MaceStatus GetCPUAffinityCoreIDs(CPUAffinityPolicy policy,
+                                 std::vector<int> *cpu_ids,
+                                 std::string *topology_info);
+
+// Get the SIMD instruction set the CPU kernels run with, e.g., "avx2".
+//
+// It's the best one supported by both the build and the running CPU, which
+// can be lowered for testing by the MACE_CPU_ISA environment variable, one of
+// "generic", "sse4.2", "avx2" and "avx512" on x86.
+const char *GetCPUISAName();
+
 }  // namespace mace
 
 #endif  // MACE_PUBLIC_MACE_RUNTIME_H_
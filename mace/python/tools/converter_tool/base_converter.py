@@ -160,6 +160,7 @@ class MaceKeyword(object):
     mace_transpose_a_str = 'transpose_a'
     mace_transpose_b_str = 'transpose_b'
     mace_op_data_type_str = 'T'
+    mace_sparse_block_rows_str = 'sparse_block_rows'
 
 
 class TransformerRule(Enum):
@@ -185,6 +186,7 @@ class TransformerRule(Enum):
     ADD_IN_OUT_TENSOR_INFO = 20
     ADD_MACE_INPUT_AND_OUTPUT_NODES = 21
     UPDATE_FLOAT_OP_DATA_TYPE = 22
+    TAG_SPARSE_WEIGHTS = 23
 
 
 class ConverterInterface(object):
@@ -252,6 +254,7 @@ class ConverterOption(object):
                 TransformerRule.ADD_IN_OUT_TENSOR_INFO,
                 TransformerRule.TRANSFORM_GLOBAL_CONV_TO_FC,
                 TransformerRule.RESHAPE_FC_WEIGHT,
+                TransformerRule.TAG_SPARSE_WEIGHTS,
                 TransformerRule.TRANSFORM_BUFFER_IMAGE,
                 TransformerRule.ADD_DEVICE,
                 TransformerRule.UPDATE_FLOAT_OP_DATA_TYPE,
@@ -31,6 +31,11 @@ from mace.python.tools.converter_tool.base_converter import TransformerRule
 from mace.python.tools.convert_util import mace_check
 
 OPENCL_IMAGE_MAX_SIZE = 16384
+# The CPU runs a weight with at most this part of nonzero blocks as sparse.
+# A sparse gemv (FC, MatMul) is bound by the weight it reads, while the dense
+# gemm of a 1x1 conv reuses its operands in registers and is hard to beat.
+SPARSE_GEMV_MAX_DENSITY = 0.5
+SPARSE_GEMM_MAX_DENSITY = 0.15
 
 
 class OpenCLBufferType(enum.Enum):
@@ -80,6 +85,7 @@ class Transformer(base_converter.ConverterInterface):
             TransformerRule.TRANSFORM_GLOBAL_CONV_TO_FC:
                 self.transform_global_conv_to_fc,
             TransformerRule.RESHAPE_FC_WEIGHT: self.reshape_fc_weight,
+            TransformerRule.TAG_SPARSE_WEIGHTS: self.tag_sparse_weights,
             TransformerRule.TRANSFORM_BUFFER_IMAGE:
                 self.transform_buffer_image,
             TransformerRule.ADD_DEVICE:
@@ -923,6 +929,102 @@ class Transformer(base_converter.ConverterInterface):
 
         return False
 
+    @staticmethod
+    def block_density(weight_data, block_rows):
+        """The part of the block_rows x 4 blocks of the 2D weight with a
+        nonzero, None if its rows do not split into blocks."""
+        rows, cols = weight_data.shape
+        if rows % block_rows != 0 or cols < 4:
+            return None
+        padded_cols = (cols + 3) // 4 * 4
+        padded = np.zeros((rows, padded_cols))
+        padded[:, :cols] = weight_data
+        blocks = padded.reshape(rows // block_rows, block_rows,
+                                padded_cols // 4, 4)
+        return np.mean(np.any(blocks != 0, axis=(1, 3)))
+
+    def sparse_weight_data(self, op):
+        """The 2D weight of op the CPU may run as sparse, whose rows are the
+        output channels, and the block rows it supports, or None."""
+        if op.type == MaceOp.FullyConnected.name:
+            weight = self._consts.get(op.input[1])
+            if weight is None:
+                return None
+            weight_data = np.array(weight.float_data).reshape(
+                weight.dims[0], -1)
+            return weight_data, [1, 4]
+        elif op.type == MaceOp.Conv2D.name:
+            strides_arg = ConverterUtil.get_arg(op,
+                                                MaceKeyword.mace_strides_str)
+            dilations_arg = ConverterUtil.get_arg(
+                op, MaceKeyword.mace_dilations_str)
+            filter = self._consts.get(op.input[1])
+            if filter is None or filter.dims[2:] != [1, 1] \
+                    or (strides_arg is not None
+                        and list(strides_arg.ints) != [1, 1]) \
+                    or (dilations_arg is not None
+                        and list(dilations_arg.ints) != [1, 1]):
+                return None
+            # only 4 x 4 blocks reuse the input enough to beat dense gemm
+            weight_data = np.array(filter.float_data).reshape(
+                filter.dims[0], -1)
+            return weight_data, [4]
+        elif op.type == MaceOp.MatMul.name:
+            transpose_a_arg = ConverterUtil.get_arg(
+                op, MaceKeyword.mace_transpose_a_str)
+            transpose_b_arg = ConverterUtil.get_arg(
+                op, MaceKeyword.mace_transpose_b_str)
+            weight = self._consts.get(op.input[1])
+            if weight is None or len(weight.dims) < 2 \
+                    or np.prod(weight.dims[:-2]) != 1 \
+                    or (transpose_a_arg is not None and transpose_a_arg.i):
+                return None
+            weight_data = np.array(weight.float_data).reshape(
+                weight.dims[-2:])
+            if transpose_b_arg is None or not transpose_b_arg.i:
+                weight_data = weight_data.transpose(1, 0)
+            return weight_data, [1, 4]
+        return None
+
+    def tag_sparse_weights(self):
+        """Tag the pruned weights of FC, 1x1 conv and MatMul with the rows of
+        their sparse blocks, 4 x 4 ones are preferred for their register
+        reuse unless they have notably more nonzero blocks than 1 x 4 ones.
+        The CPU packs the tagged weights in sparse blocks before the first
+        run, the model data stays dense."""
+        if self._option.device != DeviceType.CPU.value:
+            return False
+
+        net = self._model
+        for op in net.op:
+            if ConverterUtil.get_arg(
+                    op, MaceKeyword.mace_sparse_block_rows_str) is not None:
+                continue
+            weight_info = self.sparse_weight_data(op)
+            if weight_info is None:
+                continue
+            weight_data, supported_block_rows = weight_info
+            max_density = SPARSE_GEMM_MAX_DENSITY \
+                if op.type == MaceOp.Conv2D.name else SPARSE_GEMV_MAX_DENSITY
+            densities = {}
+            for block_rows in supported_block_rows:
+                density = self.block_density(weight_data, block_rows)
+                if density is not None and density <= max_density:
+                    densities[block_rows] = density
+            if not densities:
+                continue
+            block_rows = 4
+            if 4 not in densities or \
+                    (1 in densities and densities[4] > densities[1] * 1.25):
+                block_rows = 1
+            print("Tag sparse weight of %s: %dx4 blocks, density %.2f"
+                  % (op.name, block_rows, densities[block_rows]))
+            arg = op.arg.add()
+            arg.name = MaceKeyword.mace_sparse_block_rows_str
+            arg.i = block_rows
+
+        return False
+
     def buffer_to_image(self, op, input_idx, input_type):
         net = self._model
         input_name = op.input[input_idx]
@@ -352,8 +352,141 @@ void MaceRun(const int in_out_size,
   CheckOutputs<DeviceType::GPU, T>(*net_def, inputs, outputs, data);
 }
 
+// Conv + Relu on CPU, the batch split run must equal the serial run.
+void MaceRunBatchSplit(const std::vector<int64_t> &input_shape,
+                       const std::vector<int64_t> &filter_shape,
+                       const int num_groups) {
+  const std::vector<std::string> input_names = {"input0"};
+  const std::vector<std::string> output_names = {"output0"};
+  const DeviceType device = DeviceType::CPU;
+
+  std::shared_ptr<NetDef> net_def(new NetDef());
+  std::vector<float> data;
+  ops::test::GenerateRandomRealTypeData<float>(filter_shape, &data);
+  AddTensor<float>("filter", filter_shape, 0, data.size(), net_def.get());
+  Conv3x3<float>("mace_input_node_input0", "filter", "conv_output", {},
+                 device, net_def.get());
+  Relu<float>("conv_output", "mace_output_node_output0", device,
+              net_def.get());
+  net_def->add_input_info()->set_name(input_names[0]);
+  net_def->add_output_info()->set_name(output_names[0]);
+
+  MaceEngine engine(device);
+  ASSERT_EQ(MaceStatus::MACE_SUCCESS,
+            engine.Init(net_def.get(), input_names, output_names,
+                        reinterpret_cast<unsigned char *>(data.data())));
+
+  std::vector<int64_t> output_shape = {input_shape[0], filter_shape[0],
+                                       input_shape[2], input_shape[3]};
+  std::map<std::string, mace::MaceTensor> inputs;
+  std::map<std::string, mace::MaceTensor> serial_outputs;
+  std::map<std::string, mace::MaceTensor> split_outputs;
+  GenerateInputs(input_names, input_shape, &inputs);
+  GenerateOutputs(output_names, output_shape, &serial_outputs);
+  GenerateOutputs(output_names, output_shape, &split_outputs);
+
+  ASSERT_EQ(MaceStatus::MACE_SUCCESS, engine.Run(inputs, &serial_outputs));
+  ASSERT_EQ(MaceStatus::MACE_SUCCESS, engine.SetBatchSplit(num_groups));
+  for (int i = 0; i < 2; ++i) {
+    ASSERT_EQ(MaceStatus::MACE_SUCCESS, engine.Run(inputs, &split_outputs));
+  }
+
+  const int64_t output_size =
+      std::accumulate(output_shape.begin(), output_shape.end(), 1,
+                      std::multiplies<int64_t>());
+  const float *expected = serial_outputs["output0"].data().get();
+  const float *actual = split_outputs["output0"].data().get();
+  for (int64_t i = 0; i < output_size; ++i) {
+    EXPECT_NEAR(expected[i], actual[i], 1e-5) << "index: " << i;
+  }
+}
+
+// Conv + Relu + Conv + Relu on CPU, frames through the pipeline must equal
+// the serial runs.
+void MaceRunPipeline(const std::vector<int64_t> &input_shape,
+                     const int num_stages,
+                     const int num_frames) {
+  const std::vector<std::string> input_names = {"input0"};
+  const std::vector<std::string> output_names = {"output0"};
+  const DeviceType device = DeviceType::CPU;
+  const std::vector<int64_t> filter_shape = {input_shape[1], input_shape[1],
+                                             3, 3};
+
+  std::shared_ptr<NetDef> net_def(new NetDef());
+  std::vector<float> data;
+  ops::test::GenerateRandomRealTypeData<float>(filter_shape, &data);
+  AddTensor<float>("filter", filter_shape, 0, data.size(), net_def.get());
+  Conv3x3<float>("mace_input_node_input0", "filter", "conv0", {},
+                 device, net_def.get());
+  Relu<float>("conv0", "relu0", device, net_def.get());
+  Conv3x3<float>("relu0", "filter", "conv1", {}, device, net_def.get());
+  Relu<float>("conv1", "mace_output_node_output0", device, net_def.get());
+  net_def->add_input_info()->set_name(input_names[0]);
+  net_def->add_output_info()->set_name(output_names[0]);
+
+  MaceEngine engine(device);
+  ASSERT_EQ(MaceStatus::MACE_SUCCESS,
+            engine.Init(net_def.get(), input_names, output_names,
+                        reinterpret_cast<unsigned char *>(data.data())));
+
+  std::vector<std::map<std::string, mace::MaceTensor>> inputs(num_frames);
+  std::vector<std::map<std::string, mace::MaceTensor>> serial_outputs(
+      num_frames);
+  std::vector<std::map<std::string, mace::MaceTensor>> pipeline_outputs(
+      num_frames);
+  RunMetadata run_metadata;
+  for (int i = 0; i < num_frames; ++i) {
+    GenerateInputs(input_names, input_shape, &inputs[i]);
+    GenerateOutputs(output_names, input_shape, &serial_outputs[i]);
+    GenerateOutputs(output_names, input_shape, &pipeline_outputs[i]);
+    ASSERT_EQ(MaceStatus::MACE_SUCCESS,
+              engine.Run(inputs[i], &serial_outputs[i], &run_metadata));
+  }
+
+  ASSERT_EQ(MaceStatus::MACE_SUCCESS,
+            engine.StartPipeline(num_stages, &run_metadata));
+  // keep num_stages frames in flight
+  for (int i = 0; i < num_frames + num_stages; ++i) {
+    if (i >= num_stages) {
+      ASSERT_EQ(MaceStatus::MACE_SUCCESS,
+                engine.PullOutput(&pipeline_outputs[i - num_stages]));
+    }
+    if (i < num_frames) {
+      ASSERT_EQ(MaceStatus::MACE_SUCCESS, engine.PushInput(inputs[i]));
+    }
+  }
+  EXPECT_EQ(MaceStatus::MACE_INVALID_ARGS,
+            engine.PullOutput(&pipeline_outputs[0]));
+  ASSERT_EQ(MaceStatus::MACE_SUCCESS, engine.StopPipeline());
+
+  const int64_t output_size =
+      std::accumulate(input_shape.begin(), input_shape.end(), 1,
+                      std::multiplies<int64_t>());
+  for (int i = 0; i < num_frames; ++i) {
+    const float *expected = serial_outputs[i]["output0"].data().get();
+    const float *actual = pipeline_outputs[i]["output0"].data().get();
+    for (int64_t j = 0; j < output_size; ++j) {
+      ASSERT_NEAR(expected[j], actual[j], 1e-5) << "frame: " << i;
+    }
+  }
+}
+
 }  // namespace
 
+TEST_F(MaceAPITest, CPUPipeline) {
+  MaceRunPipeline({1, 8, 16, 16}, 2, 7);
+  MaceRunPipeline({2, 4, 9, 11}, 3, 5);
+  // more stages than ops
+  MaceRunPipeline({1, 4, 8, 8}, 8, 3);
+}
+
+TEST_F(MaceAPITest, CPUBatchSplit) {
+  MaceRunBatchSplit({4, 8, 16, 16}, {8, 8, 3, 3}, 2);
+  // uneven sub-batches, more groups than samples
+  MaceRunBatchSplit({5, 3, 7, 9}, {4, 3, 3, 3}, 3);
+  MaceRunBatchSplit({2, 3, 7, 9}, {4, 3, 3, 3}, 4);
+}
+
 TEST_F(MaceAPITest, GPUSingleInputOutput) {
   MaceRun<float>(1, {{1, 32, 32, 16}}, {{1, 32, 32, 16}}, {16, 16, 3, 3});
   MaceRun<half>(1, {{1, 32, 32, 16}}, {{1, 32, 32, 16}}, {16, 16, 3, 3});
@@ -189,7 +189,9 @@ DEFINE_int32(gpu_perf_hint, 3, "0:DEFAULT/1:LOW/2:NORMAL/3:HIGH");
 DEFINE_int32(gpu_priority_hint, 3, "0:DEFAULT/1:LOW/2:NORMAL/3:HIGH");
 DEFINE_int32(omp_num_threads, -1, "num of openmp threads");
 DEFINE_int32(cpu_affinity_policy, 1,
-             "0:AFFINITY_NONE/1:AFFINITY_BIG_ONLY/2:AFFINITY_LITTLE_ONLY");
+             "0:AFFINITY_NONE/1:AFFINITY_BIG_ONLY/2:AFFINITY_LITTLE_ONLY/"
+             "3:AFFINITY_PHYSICAL_CORES_ONLY/4:AFFINITY_SINGLE_LLC/"
+             "5:AFFINITY_SINGLE_NUMA_NODE");
 
 bool RunModel(const std::string &model_name,
               const std::vector<std::string> &input_names,
@@ -201,6 +203,14 @@ bool RunModel(const std::string &model_name,
   mace::SetOpenMPThreadPolicy(
       FLAGS_omp_num_threads,
       static_cast<CPUAffinityPolicy >(FLAGS_cpu_affinity_policy));
+  std::vector<int> cpu_ids;
+  std::string cpu_topology;
+  if (mace::GetCPUAffinityCoreIDs(
+          static_cast<CPUAffinityPolicy >(FLAGS_cpu_affinity_policy),
+          &cpu_ids, &cpu_topology) == MaceStatus::MACE_SUCCESS) {
+    LOG(INFO) << "CPU topology: " << cpu_topology
+              << ", selected CPU cores: " << MakeString(cpu_ids);
+  }
 #ifdef MACE_ENABLE_OPENCL
   if (device_type == DeviceType::GPU) {
     mace::SetGPUHints(
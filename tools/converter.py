@@ -1257,7 +1257,9 @@ def parse_args():
         "--cpu_affinity_policy",
         type=int,
         default=DefaultValues.cpu_affinity_policy,
-        help="0:AFFINITY_NONE/1:AFFINITY_BIG_ONLY/2:AFFINITY_LITTLE_ONLY")
+        help="0:AFFINITY_NONE/1:AFFINITY_BIG_ONLY/2:AFFINITY_LITTLE_ONLY/"
+             "3:AFFINITY_PHYSICAL_CORES_ONLY/4:AFFINITY_SINGLE_LLC/"
+             "5:AFFINITY_SINGLE_NUMA_NODE")
     run_bm_parent_parser.add_argument(
         "--gpu_perf_hint",
         type=int,